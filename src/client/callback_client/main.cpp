@@ -1,15 +1,24 @@
 // standard headers
-#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
 #include <memory>
-#include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 
 // grpc headers
 #include <grpcpp/grpcpp.h>
 #include <robl/api/service.grpc.pb.h>
 
+// project headers
+#include "channel/channel_pool.hpp"
+#include "coro/client_call.hpp"
+#include "coro/executor.hpp"
+#include "coro/hedged_call.hpp"
+#include "coro/task.hpp"
+
 using robl::api::ChatRequest;
 using robl::api::ChatResponse;
 using robl::api::HelloRequest;
@@ -18,42 +27,38 @@ using robl::api::SubscribeProgressRequest;
 using robl::api::SubscribeProgressResponse;
 using robl::api::TestService;
 
+// Every call is a coroutine on top of the stub's callback API. A call costs a coroutine frame rather than a thread,
+// and it is resumed on the client's executor when its callback fires. Each call leases the least busy connection of
+// the client's pool for as long as it runs. SayHello is idempotent, so its calls are hedged and retried under the
+// policy of the method.
 class TestClient
 {
 public:
-    TestClient(std::shared_ptr<grpc::Channel> channel)
-        : stub_(TestService::NewStub(channel))
+    using ChannelPool = robl::ChannelPool<TestService>;
+
+    TestClient(const std::string &target, std::shared_ptr<grpc::ChannelCredentials> credentials,
+               const ChannelPool::Options &options, robl::coro::Executor &executor)
+        : pool_(target, std::move(credentials), options)
+        , executor_(executor)
+        , budget_(robl::coro::RetryBudget::Options())
+        , hello_policy_(HelloPolicy(), budget_)
     {
     }
 
     // Assembles the client's payload, sends it and presents the response back
     // from the server.
-    void SayHello(void)
+    robl::coro::Task<void> SayHello(void)
     {
         HelloRequest request;
         HelloResponse response;
-        grpc::ClientContext context;
 
         request.set_name("world");
 
-        std::mutex mu;
-        std::condition_variable cv;
-        bool done = false;
-        grpc::Status status;
-
         // The actual RPC.
-        stub_->async()->SayHello(&context, &request, &response, [&mu, &cv, &done, &status](grpc::Status s) {
-            status = std::move(s);
-            std::lock_guard<std::mutex> lock(mu);
-            done = true;
-            cv.notify_one();
-        });
-
-        std::unique_lock<std::mutex> lock(mu);
-        while (!done)
-        {
-            cv.wait(lock);
-        }
+        const auto stub = pool_.Acquire();
+        const auto status = co_await robl::coro::HedgedCall(executor_, stub->async(),
+                                                            &TestService::Stub::async::SayHello, hello_policy_,
+                                                            request, &response);
 
         // Act upon its status.
         if (status.ok())
@@ -66,57 +71,59 @@ public:
         }
     }
 
-    void SubscribeProgress(void)
+    // Runs a number of SayHello calls at once and reports how long they took together.
+    robl::coro::Task<void> SayHelloMany(int count)
     {
-        class Reader : public grpc::ClientReadReactor<SubscribeProgressResponse>
-        {
-        public:
-            Reader(TestService::Stub *stub, const SubscribeProgressRequest &request)
-                : request_(request)
-                , done_(false)
-            {
-                stub->async()->SubscribeProgress(&context_, &request_, this);
-                StartRead(&response_);
-                StartCall();
-            }
-
-            void OnReadDone(bool ok) override
+        auto failed = std::atomic<int>(0);
+        const auto call = [this, &failed](int index) -> robl::coro::Task<void> {
+            HelloRequest request;
+            HelloResponse response;
+
+            request.set_name("world " + std::to_string(index));
+            const auto stub = pool_.Acquire();
+            const auto status = co_await robl::coro::HedgedCall(executor_, stub->async(),
+                                                                &TestService::Stub::async::SayHello, hello_policy_,
+                                                                request, &response);
+            if (!status.ok())
             {
-                if (ok)
-                {
-                    std::cout << "Received: " << response_.progress() << std::endl;
-                    StartRead(&response_);
-                }
+                failed.fetch_add(1, std::memory_order_relaxed);
             }
+        };
 
-            void OnDone(const grpc::Status &status) override
-            {
-                std::lock_guard<std::mutex> lock(mu_);
-                status_ = status;
-                done_ = true;
-                cv_.notify_one();
-            }
+        auto calls = std::vector<robl::coro::Task<void>>();
+        calls.reserve(count);
+        for (auto i = 0; i < count; ++i)
+        {
+            calls.push_back(call(i));
+        }
 
-            grpc::Status Await(void)
-            {
-                std::unique_lock<std::mutex> lock(mu_);
-                cv_.wait(lock, [this] { return done_; });
-                return std::move(status_);
-            }
+        const auto start = std::chrono::steady_clock::now();
+        co_await robl::coro::WhenAll(std::move(calls));
+        const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
 
-        private:
-            grpc::ClientContext context_;
-            const SubscribeProgressRequest request_;
-            SubscribeProgressResponse response_;
-            std::mutex mu_;
-            std::condition_variable cv_;
-            grpc::Status status_;
-            bool done_;
-        };
+        std::cout << count << " concurrent SayHello calls over " << pool_.Size() << " channels took "
+                  << elapsed.count() << " ms, " << failed.load() << " failed" << std::endl;
+        const auto counters = hello_policy_.Snapshot();
+        std::cout << counters.attempts << " attempts, " << counters.hedges << " hedges (" << counters.hedge_wins
+                  << " won), " << counters.retries << " retries, " << counters.budget_exhausted
+                  << " turned down by the retry budget" << std::endl;
+    }
 
+    robl::coro::Task<void> SubscribeProgress(void)
+    {
         SubscribeProgressRequest request;
-        Reader reader(stub_.get(), request);
-        grpc::Status status = reader.Await();
+        grpc::ClientContext context;
+        robl::coro::ReadStream<SubscribeProgressResponse> stream(executor_);
+
+        const auto stub = pool_.Acquire();
+        stub->async()->SubscribeProgress(&context, &request, &stream);
+        stream.StartCall();
+        while (const auto *response = co_await stream.Next())
+        {
+            std::cout << "Received: " << response->progress() << std::endl;
+        }
+
+        const auto status = co_await stream.Finish();
         if (status.ok())
         {
             std::cout << "Subscription Finished!" << std::endl;
@@ -127,98 +134,109 @@ public:
         }
     }
 
-    void Chat()
+    // Reads the messages to send from the console on the input loop, so waiting for a line holds up no other call.
+    robl::coro::Task<void> Chat(robl::coro::RunLoop &input)
     {
-        class Chatter : public grpc::ClientBidiReactor<ChatRequest, ChatResponse>
-        {
-        public:
-            explicit Chatter(TestService::Stub *stub)
-            {
-                stub->async()->Chat(&context_, this);
-                StartCall();
-                StartRead(&response_);
-                NextWrite();
-            }
+        grpc::ClientContext context;
+        robl::coro::BidiStream<ChatRequest, ChatResponse> stream(executor_);
 
-            void OnWriteDone(bool /*ok*/) override
-            {
-                NextWrite();
-            }
+        const auto stub = pool_.Acquire();
+        stub->async()->Chat(&context, &stream);
+        stream.StartCall();
 
-            void OnReadDone(bool ok) override
-            {
-                if (ok)
-                {
-                    std::cout << "Got message " << response_.message() << std::endl;
-                    StartRead(&response_);
-                }
-            }
+        auto sides = std::vector<robl::coro::Task<void>>();
+        sides.push_back(ReadChat(stream));
+        sides.push_back(WriteChat(stream, input));
+        co_await robl::coro::WhenAll(std::move(sides));
 
-            void OnDone(const grpc::Status &s) override
-            {
-                std::lock_guard<std::mutex> lock(mu_);
-                status_ = s;
-                done_ = true;
-                cv_.notify_one();
-            }
+        const auto status = co_await stream.Finish();
+        if (!status.ok())
+        {
+            std::cout << status.error_code() << ": " << status.error_message() << std::endl;
+            std::cout << "RouteChat rpc failed." << std::endl;
+        }
+    }
 
-            grpc::Status Await()
+private:
+    static robl::coro::Task<void> ReadChat(robl::coro::BidiStream<ChatRequest, ChatResponse> &stream)
+    {
+        while (const auto *response = co_await stream.Read())
+        {
+            std::cout << "Got message " << response->message() << std::endl;
+        }
+    }
+
+    static robl::coro::Task<void> WriteChat(robl::coro::BidiStream<ChatRequest, ChatResponse> &stream,
+                                            robl::coro::RunLoop &input)
+    {
+        while (true)
+        {
+            co_await input.Schedule();
+            ChatRequest request;
+            if (!std::getline(std::cin, *request.mutable_message()) || request.message() == "q")
             {
-                std::unique_lock<std::mutex> lock(mu_);
-                cv_.wait(lock, [this] { return done_; });
-                return std::move(status_);
+                std::cout << "You closed the chat" << std::endl;
+                co_await stream.WritesDone();
+                co_return;
             }
 
-        private:
-            void NextWrite()
+            if (!co_await stream.Write(request))
             {
-                ChatRequest request;
-                std::string message;
-                std::getline(std::cin, *request.mutable_message());
-
-                if (request.message() == "q")
-                {
-                    std::cout << "You closed the chat" << std::endl;
-                    StartWritesDone();
-                }
-                else
-                {
-                    StartWrite(&request);
-                }
+                co_return;
             }
-            grpc::ClientContext context_;
-            ChatResponse response_;
-            std::mutex mu_;
-            std::condition_variable cv_;
-            grpc::Status status_;
-            bool done_ = false;
-        };
-
-        Chatter chatter(stub_.get());
-        grpc::Status status = chatter.Await();
-        if (!status.ok())
-        {
-            std::cout << status.error_code() << ": " << status.error_message() << std::endl;
-            std::cout << "RouteChat rpc failed." << std::endl;
         }
     }
 
-private:
-    std::unique_ptr<TestService::Stub> stub_;
+    static robl::coro::UnaryPolicy::Options HelloPolicy(void)
+    {
+        auto options = robl::coro::UnaryPolicy::Options();
+        options.idempotent = true;
+        return options;
+    }
+
+    ChannelPool pool_;
+    robl::coro::Executor &executor_;
+    robl::coro::RetryBudget budget_;
+    robl::coro::UnaryPolicy hello_policy_;
 };
 
+robl::coro::Task<void> RunExamples(TestClient &client, robl::coro::RunLoop &input)
+{
+    auto examples = std::vector<robl::coro::Task<void>>();
+    examples.push_back(client.SayHello());
+    examples.push_back(client.SubscribeProgress());
+    examples.push_back(client.Chat(input));
+    co_await robl::coro::WhenAll(std::move(examples));
+}
+
 int main(int argc, char **argv)
 {
     const auto &server_address = std::string("localhost:50051");
-    TestClient greeter(grpc::CreateChannel(server_address, grpc::InsecureChannelCredentials()));
 
-    std::thread t1(&TestClient::SayHello, &greeter);
-    std::thread t2(&TestClient::SubscribeProgress, &greeter);
-    std::thread t3(&TestClient::Chat, &greeter);
+    // --hello N [--channels K] runs N calls at once over K connections.
+    auto options = TestClient::ChannelPool::Options();
+    if (argc > 4 && std::string(argv[3]) == "--channels")
+    {
+        options.size = std::atoi(argv[4]);
+    }
+
+    // All the calls run on the loop of the main thread.
+    robl::coro::RunLoop loop;
+    TestClient greeter(server_address, grpc::InsecureChannelCredentials(), options, loop);
+
+    if (argc > 2 && std::string(argv[1]) == "--hello")
+    {
+        loop.Run(greeter.SayHelloMany(std::atoi(argv[2])));
+        return 0;
+    }
+
+    robl::coro::RunLoop input;
+    std::thread input_thread([&input]() { input.Run(); });
+
+    loop.Run(RunExamples(greeter, input));
 
-    t1.join();
-    t2.join();
-    t3.join();
+    input.Stop();
+    input_thread.join();
 
     return 0;
 }
@@ -0,0 +1,295 @@
+#pragma once
+
+// standard headers
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+
+// grpc headers
+#include <grpcpp/grpcpp.h>
+#include <robl/api/service.grpc.pb.h>
+
+// project headers
+#include "coro/call_policy.hpp"
+#include "coro/executor.hpp"
+#include "metrics/hdr_histogram.hpp"
+#include "metrics/rpc_interceptors.hpp"
+
+/*=========================================================================*/
+
+enum class LoadMode
+{
+    Closed, // a fixed number of calls in flight, each started when the previous one ends
+    Open,   // calls started at a fixed rate, however long the earlier ones take
+};
+
+struct LoadOptions
+{
+    std::string target = "localhost:50051";
+    // Connects with TLS, trusting this CA certificate, instead of in plain text.
+    std::string ca_path;
+    std::string scenario = "SayHello";
+    LoadMode mode = LoadMode::Closed;
+    int channels = 4;
+    // Closed loop: the calls in flight over all channels.
+    int workers = 64;
+    // Open loop: the calls started per second over all channels, and the calls in flight per channel beyond which
+    // arrivals are counted as missed instead of piling up.
+    double rate = 1000.0;
+    int max_outstanding = 10000;
+    std::chrono::seconds warmup = std::chrono::seconds(2);
+    std::chrono::seconds duration = std::chrono::seconds(10);
+    std::chrono::milliseconds timeout = std::chrono::seconds(10);
+    // Streaming calls: the messages per call, and the size of a Chat message or an UploadFile chunk.
+    int messages = 1;
+    std::size_t payload = 1024;
+    std::uint32_t marker_id = 1;
+    // Hedges and retries the calls of idempotent unary methods, SayHello and GetMarker.
+    bool hedge = false;
+    // Serves the per-method metrics of the client's calls on this address during the run.
+    std::string metrics_address;
+    std::string json_path;
+    std::string csv_path;
+};
+
+/**
+ * @class LoadLane
+ * @brief One channel of the load with the loop its calls run on and what they measured.
+ *
+ * The calls of a lane are resumed on its loop thread only, so they record into the lane without locks. The lane's
+ * results are read once the loop has stopped.
+ */
+class LoadLane
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    LoadLane(const LoadOptions &options, int index);
+    ~LoadLane();
+
+    /**
+     * Latencies in microseconds, up to a minute, within 0.1%.
+     */
+    static robl::HdrHistogram NewLatencyHistogram(void)
+    {
+        const auto minute = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::minutes(1));
+        return robl::HdrHistogram(minute.count(), 3);
+    }
+
+    void Start(void);
+    void Stop(void);
+
+    /**
+     * Only calls intended to start within the window are recorded, so warmup and drain do not skew the results.
+     */
+    void SetWindow(Clock::time_point start, Clock::time_point end);
+
+    const LoadOptions &Options(void) const
+    {
+        return options_;
+    }
+
+    int Index(void) const
+    {
+        return index_;
+    }
+
+    robl::coro::RunLoop &Loop(void)
+    {
+        return loop_;
+    }
+
+    robl::api::TestService::Stub *Stub(void)
+    {
+        return stub_.get();
+    }
+
+    std::uint64_t NextId(void)
+    {
+        return next_id_++;
+    }
+
+    /**
+     * The policy of an idempotent unary method. The methods of a lane share one retry budget, as they share its
+     * channel.
+     */
+    robl::coro::UnaryPolicy &Policy(const std::string &method)
+    {
+        return *policies_.at(method);
+    }
+
+    const std::map<std::string, std::unique_ptr<robl::coro::UnaryPolicy>> &Policies(void) const
+    {
+        return policies_;
+    }
+
+    // Calls in flight, counted from whichever thread starts them.
+    void BeginCall(void);
+    void EndCall(void);
+    int Outstanding(void) const;
+
+    /**
+     * Records a call by the time it was meant to start, which is later than it did start in an open loop that falls
+     * behind, so the latency includes the time it waited.
+     */
+    void Record(Clock::time_point intended_start, const grpc::Status &status);
+
+    // Called by the pacer for an arrival which found too many calls in flight.
+    void RecordMissed(Clock::time_point intended_start);
+
+    const robl::HdrHistogram &LatencyUs(void) const
+    {
+        return latency_us_;
+    }
+
+    std::uint64_t Completed(void) const
+    {
+        return completed_;
+    }
+
+    std::uint64_t Missed(void) const
+    {
+        return missed_.load();
+    }
+
+    const std::map<grpc::StatusCode, std::uint64_t> &Errors(void) const
+    {
+        return errors_;
+    }
+
+private:
+    bool InWindow(Clock::time_point intended_start) const;
+
+    const LoadOptions &options_;
+    const int index_;
+    std::unique_ptr<robl::api::TestService::Stub> stub_;
+    robl::coro::RunLoop loop_;
+    std::thread thread_;
+    Clock::time_point window_start_;
+    Clock::time_point window_end_;
+    std::uint64_t next_id_;
+    std::atomic<int> outstanding_;
+    robl::HdrHistogram latency_us_;
+    std::uint64_t completed_;
+    std::atomic<std::uint64_t> missed_;
+    std::map<grpc::StatusCode, std::uint64_t> errors_;
+    robl::coro::RetryBudget budget_;
+    std::map<std::string, std::unique_ptr<robl::coro::UnaryPolicy>> policies_;
+};
+
+/*=========================================================================*/
+
+inline LoadLane::LoadLane(const LoadOptions &options, int index)
+    : options_(options)
+    , index_(index)
+    , next_id_(0)
+    , outstanding_(0)
+    , latency_us_(NewLatencyHistogram())
+    , completed_(0)
+    , missed_(0)
+    , budget_(robl::coro::RetryBudget::Options())
+{
+    auto idempotent = robl::coro::UnaryPolicy::Options();
+    idempotent.idempotent = true;
+    for (const auto *method : { "SayHello", "GetMarker" })
+    {
+        policies_.emplace(method, std::make_unique<robl::coro::UnaryPolicy>(idempotent, budget_));
+    }
+
+    auto credentials = grpc::InsecureChannelCredentials();
+    if (!options.ca_path.empty())
+    {
+        std::ifstream ca(options.ca_path);
+        auto ssl_options = grpc::SslCredentialsOptions();
+        ssl_options.pem_root_certs.assign(std::istreambuf_iterator<char>(ca), std::istreambuf_iterator<char>());
+        credentials = grpc::SslCredentials(ssl_options);
+    }
+
+    // Every lane gets its own connection rather than sharing one subchannel.
+    auto arguments = grpc::ChannelArguments();
+    arguments.SetInt("robl.loadgen_lane", index);
+    const auto channel = options.metrics_address.empty()
+                             ? grpc::CreateCustomChannel(options.target, credentials, arguments)
+                             : grpc::experimental::CreateCustomChannelWithInterceptors(
+                                   options.target, credentials, arguments, robl::ClientMetricsInterceptors());
+    stub_ = robl::api::TestService::NewStub(channel);
+}
+
+inline LoadLane::~LoadLane()
+{
+    Stop();
+}
+
+inline void LoadLane::Start(void)
+{
+    thread_ = std::thread([this]() { loop_.Run(); });
+}
+
+inline void LoadLane::Stop(void)
+{
+    if (thread_.joinable())
+    {
+        loop_.Stop();
+        thread_.join();
+    }
+}
+
+inline void LoadLane::SetWindow(Clock::time_point start, Clock::time_point end)
+{
+    window_start_ = start;
+    window_end_ = end;
+}
+
+inline void LoadLane::BeginCall(void)
+{
+    outstanding_.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline void LoadLane::EndCall(void)
+{
+    outstanding_.fetch_sub(1, std::memory_order_release);
+}
+
+inline int LoadLane::Outstanding(void) const
+{
+    return outstanding_.load(std::memory_order_acquire);
+}
+
+inline void LoadLane::Record(Clock::time_point intended_start, const grpc::Status &status)
+{
+    if (!InWindow(intended_start))
+    {
+        return;
+    }
+
+    if (!status.ok())
+    {
+        ++errors_[status.error_code()];
+        return;
+    }
+
+    const auto latency = Clock::now() - intended_start;
+    latency_us_.Record(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+    ++completed_;
+}
+
+inline void LoadLane::RecordMissed(Clock::time_point intended_start)
+{
+    if (InWindow(intended_start))
+    {
+        missed_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+inline bool LoadLane::InWindow(Clock::time_point intended_start) const
+{
+    return intended_start >= window_start_ && intended_start < window_end_;
+}
+
+/*=========================================================================*/
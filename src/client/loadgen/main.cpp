@@ -0,0 +1,277 @@
+// standard headers
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+// project headers
+#include "coro/task.hpp"
+#include "load_lane.hpp"
+#include "metrics/metrics_endpoint.hpp"
+#include "report.hpp"
+#include "scenarios.hpp"
+
+using Clock = LoadLane::Clock;
+
+/*=========================================================================*/
+
+// A closed-loop worker: it starts a call as soon as the previous one ends, until the end of the run.
+robl::coro::Task<void> RunWorker(LoadLane &lane, Scenario scenario, Clock::time_point end)
+{
+    co_await lane.Loop().Schedule();
+    while (Clock::now() < end)
+    {
+        const auto start = Clock::now();
+        const auto status = co_await scenario(lane);
+        lane.Record(start, status);
+    }
+    lane.EndCall();
+}
+
+// An open-loop arrival: one call, measured from when it was due rather than from when it got to start.
+robl::coro::Task<void> RunArrival(LoadLane &lane, Scenario scenario, Clock::time_point intended_start)
+{
+    co_await lane.Loop().Schedule();
+    const auto status = co_await scenario(lane);
+    lane.Record(intended_start, status);
+    lane.EndCall();
+}
+
+// Starts calls at the fixed rate, spread over the lanes in turn. A late wakeup starts every call which is due at once,
+// each with its own intended start, so a stall of the generator or of the server shows in the latencies instead of
+// silently lowering the rate.
+void Pace(const LoadOptions &options, const std::vector<std::unique_ptr<LoadLane>> &lanes, Scenario scenario,
+          Clock::time_point start, Clock::time_point end)
+{
+    const auto period = std::chrono::duration<double>(1.0 / options.rate);
+    const auto interval = std::chrono::duration_cast<Clock::duration>(period);
+    auto next = start;
+    auto arrival = std::size_t(0);
+    while (next < end)
+    {
+        std::this_thread::sleep_until(next);
+        const auto now = Clock::now();
+        for (; next <= now && next < end; next += interval, ++arrival)
+        {
+            auto &lane = *lanes[arrival % lanes.size()];
+            if (lane.Outstanding() >= options.max_outstanding)
+            {
+                lane.RecordMissed(next);
+                continue;
+            }
+
+            lane.BeginCall();
+            robl::coro::Spawn(RunArrival(lane, scenario, next));
+        }
+    }
+}
+
+void RunLoad(const LoadOptions &options, Scenario scenario)
+{
+    auto metrics = std::unique_ptr<robl::MetricsEndpoint>();
+    if (!options.metrics_address.empty())
+    {
+        metrics = std::make_unique<robl::MetricsEndpoint>(options.metrics_address, robl::RpcMetrics::Instance());
+    }
+
+    auto lanes = std::vector<std::unique_ptr<LoadLane>>();
+    for (auto i = 0; i < options.channels; ++i)
+    {
+        lanes.push_back(std::make_unique<LoadLane>(options, i));
+        lanes.back()->Start();
+    }
+
+    const auto start = Clock::now();
+    const auto window_start = start + options.warmup;
+    const auto end = window_start + options.duration;
+    for (auto &lane : lanes)
+    {
+        lane->SetWindow(window_start, end);
+    }
+
+    if (options.mode == LoadMode::Closed)
+    {
+        for (auto i = 0; i < options.workers; ++i)
+        {
+            auto &lane = *lanes[i % lanes.size()];
+            lane.BeginCall();
+            robl::coro::Spawn(RunWorker(lane, scenario, end));
+        }
+        std::this_thread::sleep_until(end);
+    }
+    else
+    {
+        Pace(options, lanes, scenario, start, end);
+    }
+
+    // The calls still in flight end by their deadline at the latest.
+    for (auto &lane : lanes)
+    {
+        while (lane->Outstanding() > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        lane->Stop();
+    }
+
+    const auto report = LoadReport(options, lanes);
+    report.PrintSummary(std::cout);
+    if (options.json_path == "-")
+    {
+        report.WriteJson(std::cout);
+    }
+    else if (!options.json_path.empty())
+    {
+        std::ofstream json(options.json_path);
+        report.WriteJson(json);
+    }
+    if (!options.csv_path.empty() && !report.AppendCsv(options.csv_path))
+    {
+        std::cerr << "Could not write " << options.csv_path << std::endl;
+    }
+}
+
+void PrintUsage(const char *program)
+{
+    std::cerr << "usage: " << program << " [options]\n"
+              << "  --target HOST:PORT     server to load (localhost:50051)\n"
+              << "  --ca PATH              connect with TLS, trusting this CA certificate\n"
+              << "  --scenario NAME        one of:";
+    for (const auto &scenario : Scenarios())
+    {
+        std::cerr << " " << scenario.first;
+    }
+    std::cerr << " (SayHello)\n"
+              << "  --mode closed|open     fixed concurrency or fixed arrival rate (closed)\n"
+              << "  --channels M           connections to spread the calls over (4)\n"
+              << "  --workers N            closed loop: calls in flight (64)\n"
+              << "  --rate R               open loop: calls started per second (1000)\n"
+              << "  --max-outstanding N    open loop: calls in flight per channel before arrivals are missed (10000)\n"
+              << "  --warmup S             seconds before recording starts (2)\n"
+              << "  --seconds S            seconds to record (10)\n"
+              << "  --timeout-ms T         deadline of every call (10000)\n"
+              << "  --messages N           messages per streaming call (1)\n"
+              << "  --payload BYTES        size of a Chat message or an UploadFile chunk (1024)\n"
+              << "  --marker-id ID         marker GetMarker asks for (1)\n"
+              << "  --hedge                hedge and retry SayHello and GetMarker calls\n"
+              << "  --metrics-address A    serve the client's per-method metrics on HOST:PORT during the run\n"
+              << "  --json PATH|-          write the summary as JSON\n"
+              << "  --csv PATH             append the summary to a CSV table" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    auto options = LoadOptions();
+    for (auto i = 1; i < argc; ++i)
+    {
+        const auto arg = std::string(argv[i]);
+        const auto has_value = i + 1 < argc;
+        if (arg == "--target" && has_value)
+        {
+            options.target = argv[++i];
+        }
+        else if (arg == "--ca" && has_value)
+        {
+            options.ca_path = argv[++i];
+        }
+        else if (arg == "--scenario" && has_value)
+        {
+            options.scenario = argv[++i];
+        }
+        else if (arg == "--mode" && has_value)
+        {
+            const auto mode = std::string(argv[++i]);
+            if (mode != "closed" && mode != "open")
+            {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+            options.mode = mode == "closed" ? LoadMode::Closed : LoadMode::Open;
+        }
+        else if (arg == "--channels" && has_value)
+        {
+            options.channels = std::atoi(argv[++i]);
+        }
+        else if (arg == "--workers" && has_value)
+        {
+            options.workers = std::atoi(argv[++i]);
+        }
+        else if (arg == "--rate" && has_value)
+        {
+            options.rate = std::atof(argv[++i]);
+        }
+        else if (arg == "--max-outstanding" && has_value)
+        {
+            options.max_outstanding = std::atoi(argv[++i]);
+        }
+        else if (arg == "--warmup" && has_value)
+        {
+            options.warmup = std::chrono::seconds(std::atoi(argv[++i]));
+        }
+        else if (arg == "--seconds" && has_value)
+        {
+            options.duration = std::chrono::seconds(std::atoi(argv[++i]));
+        }
+        else if (arg == "--timeout-ms" && has_value)
+        {
+            options.timeout = std::chrono::milliseconds(std::atoi(argv[++i]));
+        }
+        else if (arg == "--messages" && has_value)
+        {
+            options.messages = std::atoi(argv[++i]);
+        }
+        else if (arg == "--payload" && has_value)
+        {
+            options.payload = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--marker-id" && has_value)
+        {
+            options.marker_id = static_cast<std::uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--hedge")
+        {
+            options.hedge = true;
+        }
+        else if (arg == "--metrics-address" && has_value)
+        {
+            options.metrics_address = argv[++i];
+        }
+        else if (arg == "--json" && has_value)
+        {
+            options.json_path = argv[++i];
+        }
+        else if (arg == "--csv" && has_value)
+        {
+            options.csv_path = argv[++i];
+        }
+        else
+        {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    const auto scenario = Scenarios().find(options.scenario);
+    if (scenario == Scenarios().end() || options.channels < 1 || options.workers < 1 || options.rate <= 0.0 ||
+        options.duration.count() < 1 || options.messages < 1)
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    try
+    {
+        RunLoad(options, scenario->second);
+    }
+    catch (const std::system_error &ex)
+    {
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,239 @@
+#pragma once
+
+// standard headers
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// grpc headers
+#include <grpcpp/support/status.h>
+
+// project headers
+#include "coro/call_policy.hpp"
+#include "load_lane.hpp"
+#include "metrics/hdr_histogram.hpp"
+#include "metrics/rpc_metrics.hpp"
+
+/*=========================================================================*/
+
+// The percentiles every summary reports, with the names of their JSON and CSV fields.
+struct ReportedPercentile
+{
+    double percentile;
+    const char *name;
+};
+
+inline const std::vector<ReportedPercentile> &ReportedPercentiles(void)
+{
+    static const auto percentiles = std::vector<ReportedPercentile>{
+        { 50.0, "p50" }, { 90.0, "p90" }, { 99.0, "p99" }, { 99.9, "p999" }, { 99.99, "p9999" },
+    };
+    return percentiles;
+}
+
+/**
+ * @class LoadReport
+ * @brief The results of all the lanes of a run, merged.
+ */
+class LoadReport
+{
+public:
+    LoadReport(const LoadOptions &options, const std::vector<std::unique_ptr<LoadLane>> &lanes);
+
+    void PrintSummary(std::ostream &out) const;
+    void WriteJson(std::ostream &out) const;
+
+    /**
+     * Appends a row to the CSV file and writes the header first if the file is new, so that runs of a sweep end up
+     * in one table.
+     */
+    bool AppendCsv(const std::string &path) const;
+
+private:
+    static std::string JsonString(const std::string &value);
+
+    double Throughput(void) const
+    {
+        return static_cast<double>(completed_) / options_.duration.count();
+    }
+
+    std::uint64_t ErrorCount(void) const;
+
+    const LoadOptions &options_;
+    robl::HdrHistogram latency_us_;
+    std::uint64_t completed_;
+    std::uint64_t missed_;
+    std::map<grpc::StatusCode, std::uint64_t> errors_;
+    // Of all the lanes, warmup included.
+    robl::coro::UnaryPolicy::Counters hedging_;
+};
+
+/*=========================================================================*/
+
+inline LoadReport::LoadReport(const LoadOptions &options, const std::vector<std::unique_ptr<LoadLane>> &lanes)
+    : options_(options)
+    , latency_us_(LoadLane::NewLatencyHistogram())
+    , completed_(0)
+    , missed_(0)
+    , hedging_()
+{
+    for (const auto &lane : lanes)
+    {
+        for (const auto &policy : lane->Policies())
+        {
+            const auto counters = policy.second->Snapshot();
+            hedging_.calls += counters.calls;
+            hedging_.attempts += counters.attempts;
+            hedging_.hedges += counters.hedges;
+            hedging_.hedge_wins += counters.hedge_wins;
+            hedging_.retries += counters.retries;
+            hedging_.budget_exhausted += counters.budget_exhausted;
+            hedging_.failures += counters.failures;
+        }
+        latency_us_.Add(lane->LatencyUs());
+        completed_ += lane->Completed();
+        missed_ += lane->Missed();
+        for (const auto &[code, count] : lane->Errors())
+        {
+            errors_[code] += count;
+        }
+    }
+}
+
+inline void LoadReport::PrintSummary(std::ostream &out) const
+{
+    out << options_.scenario << ", ";
+    if (options_.mode == LoadMode::Closed)
+    {
+        out << options_.workers << " workers";
+    }
+    else
+    {
+        out << options_.rate << " calls/s offered";
+    }
+    out << " over " << options_.channels << " channels against " << options_.target << std::endl;
+    out << std::fixed << std::setprecision(1) << completed_ << " calls in " << options_.duration.count() << " s, "
+        << Throughput() << " calls/s, " << ErrorCount() << " errors, " << missed_ << " missed" << std::endl;
+
+    out << "latency us: min " << latency_us_.Min() << ", mean " << latency_us_.Mean();
+    for (const auto &reported : ReportedPercentiles())
+    {
+        out << ", " << reported.name << " " << latency_us_.ValueAtPercentile(reported.percentile);
+    }
+    out << ", max " << latency_us_.Max() << std::endl;
+
+    for (const auto &[code, count] : errors_)
+    {
+        out << "  " << robl::StatusCodeName(code) << ": " << count << std::endl;
+    }
+
+    if (options_.hedge)
+    {
+        out << "hedging: " << hedging_.attempts << " attempts for " << hedging_.calls << " calls, " << hedging_.hedges
+            << " hedges (" << hedging_.hedge_wins << " won), " << hedging_.retries << " retries, "
+            << hedging_.budget_exhausted << " over budget" << std::endl;
+    }
+}
+
+inline void LoadReport::WriteJson(std::ostream &out) const
+{
+    out << std::fixed << std::setprecision(3);
+    out << "{\n"
+        << "  \"scenario\": " << JsonString(options_.scenario) << ",\n"
+        << "  \"mode\": \"" << (options_.mode == LoadMode::Closed ? "closed" : "open") << "\",\n"
+        << "  \"target\": " << JsonString(options_.target) << ",\n"
+        << "  \"channels\": " << options_.channels << ",\n"
+        << "  \"workers\": " << (options_.mode == LoadMode::Closed ? options_.workers : 0) << ",\n"
+        << "  \"offered_rate\": " << (options_.mode == LoadMode::Open ? options_.rate : 0.0) << ",\n"
+        << "  \"messages\": " << options_.messages << ",\n"
+        << "  \"payload\": " << options_.payload << ",\n"
+        << "  \"seconds\": " << options_.duration.count() << ",\n"
+        << "  \"completed\": " << completed_ << ",\n"
+        << "  \"errors\": " << ErrorCount() << ",\n"
+        << "  \"missed\": " << missed_ << ",\n"
+        << "  \"throughput\": " << Throughput() << ",\n"
+        << "  \"latency_us\": {\"min\": " << latency_us_.Min() << ", \"mean\": " << latency_us_.Mean();
+    for (const auto &reported : ReportedPercentiles())
+    {
+        out << ", \"" << reported.name << "\": " << latency_us_.ValueAtPercentile(reported.percentile);
+    }
+    out << ", \"max\": " << latency_us_.Max() << "},\n"
+        << "  \"errors_by_code\": {";
+    auto separator = "";
+    for (const auto &[code, count] : errors_)
+    {
+        out << separator << "\"" << robl::StatusCodeName(code) << "\": " << count;
+        separator = ", ";
+    }
+    out << "},\n"
+        << "  \"hedging\": {\"enabled\": " << (options_.hedge ? "true" : "false")
+        << ", \"calls\": " << hedging_.calls << ", \"attempts\": " << hedging_.attempts
+        << ", \"hedges\": " << hedging_.hedges << ", \"hedge_wins\": " << hedging_.hedge_wins
+        << ", \"retries\": " << hedging_.retries << ", \"budget_exhausted\": " << hedging_.budget_exhausted << "}\n"
+        << "}" << std::endl;
+}
+
+inline bool LoadReport::AppendCsv(const std::string &path) const
+{
+    const auto is_new = !std::ifstream(path).good();
+    std::ofstream out(path, std::ios_base::app);
+    if (!out)
+    {
+        return false;
+    }
+
+    if (is_new)
+    {
+        out << "scenario,mode,channels,workers,offered_rate,messages,payload,seconds,completed,errors,missed,"
+               "throughput,min_us,mean_us";
+        for (const auto &reported : ReportedPercentiles())
+        {
+            out << "," << reported.name << "_us";
+        }
+        out << ",max_us" << std::endl;
+    }
+
+    out << std::fixed << std::setprecision(3) << options_.scenario << ","
+        << (options_.mode == LoadMode::Closed ? "closed" : "open") << "," << options_.channels << ","
+        << (options_.mode == LoadMode::Closed ? options_.workers : 0) << ","
+        << (options_.mode == LoadMode::Open ? options_.rate : 0.0) << "," << options_.messages << ","
+        << options_.payload << "," << options_.duration.count() << "," << completed_ << "," << ErrorCount() << ","
+        << missed_ << "," << Throughput() << "," << latency_us_.Min() << "," << latency_us_.Mean();
+    for (const auto &reported : ReportedPercentiles())
+    {
+        out << "," << latency_us_.ValueAtPercentile(reported.percentile);
+    }
+    out << "," << latency_us_.Max() << std::endl;
+    return out.good();
+}
+
+inline std::uint64_t LoadReport::ErrorCount(void) const
+{
+    auto count = std::uint64_t(0);
+    for (const auto &error : errors_)
+    {
+        count += error.second;
+    }
+    return count;
+}
+
+inline std::string LoadReport::JsonString(const std::string &value)
+{
+    auto quoted = std::string("\"");
+    for (const auto c : value)
+    {
+        if (c == '"' || c == '\\')
+        {
+            quoted += '\\';
+        }
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+/*=========================================================================*/
@@ -0,0 +1,250 @@
+#pragma once
+
+// standard headers
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+
+// grpc headers
+#include <grpcpp/grpcpp.h>
+#include <robl/api/service.grpc.pb.h>
+
+// project headers
+#include "coro/client_call.hpp"
+#include "coro/hedged_call.hpp"
+#include "coro/task.hpp"
+#include "load_lane.hpp"
+
+/*=========================================================================*/
+
+// One call of a scenario, run on the lane's loop. It returns the status the call is recorded with.
+using Scenario = robl::coro::Task<grpc::Status> (*)(LoadLane &lane);
+
+/*=========================================================================*/
+
+namespace scenarios
+{
+
+inline std::chrono::system_clock::time_point Deadline(const LoadLane &lane)
+{
+    return std::chrono::system_clock::now() + lane.Options().timeout;
+}
+
+inline void PrepareContext(grpc::ClientContext *context, const LoadLane &lane)
+{
+    context->set_deadline(Deadline(lane));
+}
+
+// Reads what is left of a stream so that its status can be awaited. The co_await stays out of the loop condition,
+// which GCC 12 miscompiles in a coroutine template.
+template <typename Stream>
+robl::coro::Task<void> Drain(Stream &stream)
+{
+    const auto *message = co_await stream.Read();
+    while (message != nullptr)
+    {
+        message = co_await stream.Read();
+    }
+}
+
+inline robl::coro::Task<grpc::Status> SayHello(LoadLane &lane)
+{
+    auto request = robl::api::HelloRequest();
+    auto response = robl::api::HelloResponse();
+
+    request.set_name("loadgen");
+    if (lane.Options().hedge)
+    {
+        co_return co_await robl::coro::HedgedCall(lane.Loop(), lane.Stub()->async(),
+                                                  &robl::api::TestService::Stub::async::SayHello,
+                                                  lane.Policy("SayHello"), request, &response, Deadline(lane));
+    }
+
+    grpc::ClientContext context;
+    PrepareContext(&context, lane);
+    co_return co_await robl::coro::Call(lane.Loop(), lane.Stub()->async(),
+                                        &robl::api::TestService::Stub::async::SayHello, &context, &request,
+                                        &response);
+}
+
+inline robl::coro::Task<grpc::Status> RegisterAccount(LoadLane &lane)
+{
+    grpc::ClientContext context;
+    auto request = robl::api::RegisterAccountRequest();
+    auto response = robl::api::RegisterAccountResponse();
+
+    PrepareContext(&context, lane);
+    request.set_session_id(-1);
+    request.set_tick(static_cast<std::uint32_t>(lane.NextId()));
+    request.set_ip_str("127.0.0.1");
+    request.set_account("loadgen");
+    co_return co_await robl::coro::Call(lane.Loop(), lane.Stub()->async(),
+                                        &robl::api::TestService::Stub::async::RegisterAccount, &context, &request,
+                                        &response);
+}
+
+inline robl::coro::Task<grpc::Status> GetMarker(LoadLane &lane)
+{
+    auto request = robl::api::MarkerRequest();
+    auto response = robl::api::MarkerResponse();
+
+    request.set_id(lane.Options().marker_id);
+    if (lane.Options().hedge)
+    {
+        co_return co_await robl::coro::HedgedCall(lane.Loop(), lane.Stub()->async(),
+                                                  &robl::api::TestService::Stub::async::GetMarker,
+                                                  lane.Policy("GetMarker"), request, &response, Deadline(lane));
+    }
+
+    grpc::ClientContext context;
+    PrepareContext(&context, lane);
+    co_return co_await robl::coro::Call(lane.Loop(), lane.Stub()->async(),
+                                        &robl::api::TestService::Stub::async::GetMarker, &context, &request,
+                                        &response);
+}
+
+// Subscribes until the given number of updates arrived, then cancels. The progress is published once a second, so
+// this measures how long a subscriber waits for its updates.
+inline robl::coro::Task<grpc::Status> SubscribeProgress(LoadLane &lane)
+{
+    grpc::ClientContext context;
+    auto request = robl::api::SubscribeProgressRequest();
+    robl::coro::ReadStream<robl::api::SubscribeProgressResponse> stream(lane.Loop());
+
+    PrepareContext(&context, lane);
+    lane.Stub()->async()->SubscribeProgress(&context, &request, &stream);
+    stream.StartCall();
+
+    auto received = 0;
+    while (received < lane.Options().messages && co_await stream.Next())
+    {
+        ++received;
+    }
+
+    context.TryCancel();
+    while (co_await stream.Next())
+    {
+    }
+    const auto status = co_await stream.Finish();
+    co_return received == lane.Options().messages ? grpc::Status::OK : status;
+}
+
+// Joins a room of its own, so that calls do not see each other's messages, and waits for every message it posts to
+// come back.
+inline robl::coro::Task<grpc::Status> Chat(LoadLane &lane)
+{
+    grpc::ClientContext context;
+    robl::coro::BidiStream<robl::api::ChatRequest, robl::api::ChatResponse> stream(lane.Loop());
+
+    PrepareContext(&context, lane);
+    context.AddMetadata("chat-room", "loadgen-" + std::to_string(lane.Index()) + "-" + std::to_string(lane.NextId()));
+    lane.Stub()->async()->Chat(&context, &stream);
+    stream.StartCall();
+
+    auto request = robl::api::ChatRequest();
+    request.set_message(std::string(lane.Options().payload, 'x'));
+    for (auto i = 0; i < lane.Options().messages; ++i)
+    {
+        if (!co_await stream.Write(request))
+        {
+            break;
+        }
+
+        // Skip the clock messages the server posts to every room.
+        const auto *response = co_await stream.Read();
+        while (response != nullptr && response->message().rfind("Server: ", 0) == 0)
+        {
+            response = co_await stream.Read();
+        }
+        if (response == nullptr)
+        {
+            break;
+        }
+    }
+
+    co_await stream.WritesDone();
+    co_await Drain(stream);
+    co_return co_await stream.Finish();
+}
+
+// Exchanges the given number of heartbeats one at a time.
+inline robl::coro::Task<grpc::Status> HeartBeat(LoadLane &lane)
+{
+    grpc::ClientContext context;
+    robl::coro::BidiStream<robl::api::ClientHeartBeat, robl::api::ServerHeartBeat> stream(lane.Loop());
+
+    PrepareContext(&context, lane);
+    lane.Stub()->async()->HeartBeat(&context, &stream);
+    stream.StartCall();
+
+    auto request = robl::api::ClientHeartBeat();
+    request.set_session_id(1);
+    for (auto i = 0; i < lane.Options().messages; ++i)
+    {
+        request.set_tick(i);
+        if (!co_await stream.Write(request))
+        {
+            break;
+        }
+        if (co_await stream.Read() == nullptr)
+        {
+            break;
+        }
+    }
+
+    co_await stream.WritesDone();
+    co_await Drain(stream);
+    co_return co_await stream.Finish();
+}
+
+// Uploads the given number of chunks and waits for the acknowledgement of each one. The files are named after a
+// bounded set of slots, so a long run overwrites them instead of filling the server's disk.
+inline robl::coro::Task<grpc::Status> UploadFile(LoadLane &lane)
+{
+    grpc::ClientContext context;
+    robl::coro::BidiStream<robl::api::FileContent, robl::api::Status> stream(lane.Loop());
+
+    PrepareContext(&context, lane);
+    lane.Stub()->async()->UploadFile(&context, &stream);
+    stream.StartCall();
+
+    auto request = robl::api::FileContent();
+    request.set_name("loadgen-" + std::to_string(lane.Index()) + "-" + std::to_string(lane.NextId() % 64) + ".bin");
+    request.set_content(std::string(lane.Options().payload, 'x'));
+    for (auto i = 0; i < lane.Options().messages; ++i)
+    {
+        if (!co_await stream.Write(request))
+        {
+            break;
+        }
+        if (co_await stream.Read() == nullptr)
+        {
+            break;
+        }
+    }
+
+    co_await stream.WritesDone();
+    co_await Drain(stream);
+    co_return co_await stream.Finish();
+}
+
+} // namespace scenarios
+
+/*=========================================================================*/
+
+inline const std::map<std::string, Scenario> &Scenarios(void)
+{
+    static const auto table = std::map<std::string, Scenario>{
+        { "SayHello", &scenarios::SayHello },
+        { "SubscribeProgress", &scenarios::SubscribeProgress },
+        { "Chat", &scenarios::Chat },
+        { "RegisterAccount", &scenarios::RegisterAccount },
+        { "HeartBeat", &scenarios::HeartBeat },
+        { "UploadFile", &scenarios::UploadFile },
+        { "GetMarker", &scenarios::GetMarker },
+    };
+    return table;
+}
+
+/*=========================================================================*/
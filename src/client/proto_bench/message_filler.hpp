@@ -0,0 +1,205 @@
+#pragma once
+
+// standard headers
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+// grpc headers
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/message.h>
+#include <robl/api/header.pb.h>
+
+/*=========================================================================*/
+
+/**
+ * The instance of a message a benchmark measures.
+ *
+ * A representative instance holds the values the services exchange: small numbers, short ASCII strings, and payloads
+ * of bytes. A worst-case instance holds the values which encode to the most bytes: numbers at the limit of their
+ * type, which take ten bytes as negative varints, and strings of multi-byte UTF-8 as long as the payloads, which the
+ * parser validates character by character.
+ */
+struct MessageShape
+{
+    // The elements of every repeated field of the message itself. Nested ones get at most kNestedElements, so that
+    // the size of a message grows with the elements rather than with their power.
+    int elements = 16;
+    // The size of every bytes field, and of every string field of a worst-case instance.
+    int bytes = 256;
+    bool worst_case = false;
+};
+
+/**
+ * Sets every field of the message, and of the messages it holds, after the shape. Of the fields of a oneof, the first
+ * is set. A google.protobuf.Any holds a RequestHeader, the message the ResponseHeader of the API echoes.
+ */
+void FillMessage(google::protobuf::Message *message, const MessageShape &shape, int depth = 0);
+
+/**
+ * Whether the size of an instance of the message depends on the shape, i.e. whether it holds a repeated, string or
+ * bytes field at any depth.
+ */
+bool IsScalable(const google::protobuf::Descriptor *descriptor, int depth = 0);
+
+/*=========================================================================*/
+
+namespace detail
+{
+
+constexpr auto kNestedElements = 8;
+constexpr auto kMaxDepth = 8;
+constexpr auto kRepresentativeString = "representative-text"; // 19 bytes, a name or a short message
+
+inline std::string FillString(const google::protobuf::FieldDescriptor *field, const MessageShape &shape, int index)
+{
+    if (field->type() == google::protobuf::FieldDescriptor::TYPE_BYTES)
+    {
+        auto bytes = std::string(shape.bytes, '\0');
+        for (auto i = std::size_t(0); i < bytes.size(); ++i)
+        {
+            bytes[i] = static_cast<char>((i * 31 + index) & 0xff);
+        }
+        return bytes;
+    }
+    if (!shape.worst_case)
+    {
+        return kRepresentativeString + std::to_string(index);
+    }
+
+    // "é" is two bytes of UTF-8.
+    auto text = std::string();
+    text.reserve(shape.bytes + 1);
+    while (static_cast<int>(text.size()) + 2 <= shape.bytes)
+    {
+        text += "\xc3\xa9";
+    }
+    return text;
+}
+
+inline void FillField(google::protobuf::Message *message, const google::protobuf::FieldDescriptor *field,
+                      const MessageShape &shape, int depth, int index)
+{
+    using google::protobuf::FieldDescriptor;
+
+    const auto *reflection = message->GetReflection();
+    const auto repeated = field->is_repeated();
+    const auto worst = shape.worst_case;
+    switch (field->cpp_type())
+    {
+    case FieldDescriptor::CPPTYPE_INT32: {
+        const auto value = worst ? std::numeric_limits<std::int32_t>::min() : 42 + index;
+        repeated ? reflection->AddInt32(message, field, value) : reflection->SetInt32(message, field, value);
+        break;
+    }
+    case FieldDescriptor::CPPTYPE_INT64: {
+        const auto value = worst ? std::numeric_limits<std::int64_t>::min() : std::int64_t(1'700'000'000) + index;
+        repeated ? reflection->AddInt64(message, field, value) : reflection->SetInt64(message, field, value);
+        break;
+    }
+    case FieldDescriptor::CPPTYPE_UINT32: {
+        const auto value = worst ? std::numeric_limits<std::uint32_t>::max() : 1000u + index;
+        repeated ? reflection->AddUInt32(message, field, value) : reflection->SetUInt32(message, field, value);
+        break;
+    }
+    case FieldDescriptor::CPPTYPE_UINT64: {
+        const auto value = worst ? std::numeric_limits<std::uint64_t>::max() : std::uint64_t(1'700'000'000'000) + index;
+        repeated ? reflection->AddUInt64(message, field, value) : reflection->SetUInt64(message, field, value);
+        break;
+    }
+    case FieldDescriptor::CPPTYPE_DOUBLE: {
+        const auto value = (worst ? M_PI : 1.25) * (index + 1);
+        repeated ? reflection->AddDouble(message, field, value) : reflection->SetDouble(message, field, value);
+        break;
+    }
+    case FieldDescriptor::CPPTYPE_FLOAT: {
+        const auto value = static_cast<float>((worst ? M_PI : 0.5) * (index + 1));
+        repeated ? reflection->AddFloat(message, field, value) : reflection->SetFloat(message, field, value);
+        break;
+    }
+    case FieldDescriptor::CPPTYPE_BOOL:
+        repeated ? reflection->AddBool(message, field, true) : reflection->SetBool(message, field, true);
+        break;
+    case FieldDescriptor::CPPTYPE_ENUM: {
+        const auto *type = field->enum_type();
+        const auto *value = type->value(worst ? type->value_count() - 1 : std::min(1, type->value_count() - 1));
+        repeated ? reflection->AddEnum(message, field, value) : reflection->SetEnum(message, field, value);
+        break;
+    }
+    case FieldDescriptor::CPPTYPE_STRING: {
+        auto value = FillString(field, shape, index);
+        repeated ? reflection->AddString(message, field, std::move(value))
+                 : reflection->SetString(message, field, std::move(value));
+        break;
+    }
+    case FieldDescriptor::CPPTYPE_MESSAGE:
+        FillMessage(repeated ? reflection->AddMessage(message, field) : reflection->MutableMessage(message, field),
+                    shape, depth + 1);
+        break;
+    }
+}
+
+} // namespace detail
+
+inline void FillMessage(google::protobuf::Message *message, const MessageShape &shape, int depth)
+{
+    const auto *descriptor = message->GetDescriptor();
+    const auto *reflection = message->GetReflection();
+    if (depth > detail::kMaxDepth)
+    {
+        return;
+    }
+
+    if (descriptor->full_name() == "google.protobuf.Any")
+    {
+        auto header = robl::api::RequestHeader();
+        FillMessage(&header, shape, depth + 1);
+        reflection->SetString(message, descriptor->FindFieldByName("type_url"),
+                              "type.googleapis.com/" + header.GetDescriptor()->full_name());
+        reflection->SetString(message, descriptor->FindFieldByName("value"), header.SerializeAsString());
+        return;
+    }
+
+    for (auto i = 0; i < descriptor->field_count(); ++i)
+    {
+        const auto *field = descriptor->field(i);
+        if (field->real_containing_oneof() != nullptr && field->index_in_oneof() != 0)
+        {
+            continue;
+        }
+
+        if (!field->is_repeated())
+        {
+            detail::FillField(message, field, shape, depth, 0);
+            continue;
+        }
+        const auto count = depth == 0 ? shape.elements : std::min(shape.elements, detail::kNestedElements);
+        for (auto index = 0; index < count; ++index)
+        {
+            detail::FillField(message, field, shape, depth, index);
+        }
+    }
+}
+
+inline bool IsScalable(const google::protobuf::Descriptor *descriptor, int depth)
+{
+    if (depth > detail::kMaxDepth)
+    {
+        return false;
+    }
+
+    for (auto i = 0; i < descriptor->field_count(); ++i)
+    {
+        const auto *field = descriptor->field(i);
+        if (field->is_repeated() || field->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_STRING ||
+            (field->message_type() != nullptr && IsScalable(field->message_type(), depth + 1)))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*=========================================================================*/
@@ -0,0 +1,263 @@
+// standard headers
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <new>
+#include <set>
+#include <string>
+#include <vector>
+
+// grpc headers
+#include <benchmark/benchmark.h>
+#include <google/protobuf/arena.h>
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/descriptor.pb.h>
+#include <google/protobuf/message.h>
+#include <robl/api/auth.pb.h>
+#include <robl/api/data_chunk.pb.h>
+#include <robl/api/geofence.pb.h>
+#include <robl/api/point_cloud.pb.h>
+#include <robl/api/test.pb.h>
+#include <robl/api/transform.pb.h>
+#include <robl/api/version.pb.h>
+
+// project headers
+#include "message_filler.hpp"
+
+/*=========================================================================*/
+
+// Counts the allocations of the process, to report them per operation. The benchmarks run on one thread.
+namespace
+{
+std::atomic<std::int64_t> allocations{ 0 };
+} // namespace
+
+void *operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (auto *memory = std::malloc(size == 0 ? 1 : size))
+    {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+/*=========================================================================*/
+
+namespace
+{
+
+// The elements of the repeated fields of an instance. Its bytes fields, and the strings of a worst case, are 16 bytes
+// per element.
+const auto element_counts = std::vector<int>{ 1, 16, 256, 4096 };
+constexpr auto bytes_per_element = 16;
+
+// Enough for the arena of every instance but the largest, whose parse spills into heap blocks like a server's would.
+constexpr auto arena_block_size = std::size_t(1024 * 1024);
+
+/**
+ * An instance of a message and its wire format, shared by the benchmarks of the same message and shape.
+ */
+struct Instance
+{
+    const google::protobuf::Message *prototype;
+    std::unique_ptr<google::protobuf::Message> message;
+    std::string wire;
+};
+
+std::shared_ptr<const Instance> MakeInstance(const google::protobuf::Descriptor *descriptor, const MessageShape &shape)
+{
+    auto instance = std::make_shared<Instance>();
+    instance->prototype = google::protobuf::MessageFactory::generated_factory()->GetPrototype(descriptor);
+    instance->message.reset(instance->prototype->New());
+    FillMessage(instance->message.get(), shape);
+    instance->wire = instance->message->SerializeAsString();
+    return instance;
+}
+
+/**
+ * Runs the operation once per iteration and reports the size of the wire format and the allocations per operation.
+ */
+void Measure(benchmark::State &state, const Instance &instance, const std::function<void(void)> &operation)
+{
+    const auto before = allocations.load(std::memory_order_relaxed);
+    for (auto _ : state)
+    {
+        operation();
+    }
+    const auto allocated = allocations.load(std::memory_order_relaxed) - before;
+
+    state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(instance.wire.size()));
+    state.counters["bytes"] = static_cast<double>(instance.wire.size());
+    state.counters["allocs"] = benchmark::Counter(static_cast<double>(allocated), benchmark::Counter::kAvgIterations);
+}
+
+void Serialize(benchmark::State &state, const Instance &instance)
+{
+    auto wire = std::string();
+    Measure(state, instance, [&]() {
+        instance.message->SerializeToString(&wire);
+        benchmark::DoNotOptimize(wire.data());
+    });
+}
+
+// ByteSizeLong() walks the whole message, as every serialization does first, and caches the sizes on the way.
+void ByteSize(benchmark::State &state, const Instance &instance)
+{
+    Measure(state, instance, [&]() { benchmark::DoNotOptimize(instance.message->ByteSizeLong()); });
+}
+
+// A message allocated for every parse, as a synchronous handler's request is.
+void ParseHeap(benchmark::State &state, const Instance &instance)
+{
+    Measure(state, instance, [&]() {
+        const auto message = std::unique_ptr<google::protobuf::Message>(instance.prototype->New());
+        benchmark::DoNotOptimize(message->ParseFromString(instance.wire));
+    });
+}
+
+// A message parsed into over and over, which keeps the capacity of its repeated fields and strings.
+void ParseReused(benchmark::State &state, const Instance &instance)
+{
+    const auto message = std::unique_ptr<google::protobuf::Message>(instance.prototype->New());
+    Measure(state, instance, [&]() { benchmark::DoNotOptimize(message->ParseFromString(instance.wire)); });
+}
+
+// A message on an arena which is reset after every parse and keeps its initial block, as ArenaMessageAllocator does.
+void ParseArena(benchmark::State &state, const Instance &instance)
+{
+    const auto block = std::make_unique<char[]>(arena_block_size);
+    auto options = google::protobuf::ArenaOptions();
+    options.initial_block = block.get();
+    options.initial_block_size = arena_block_size;
+    auto arena = google::protobuf::Arena(options);
+
+    Measure(state, instance, [&]() {
+        auto *message = instance.prototype->New(&arena);
+        benchmark::DoNotOptimize(message->ParseFromString(instance.wire));
+        arena.Reset();
+    });
+}
+
+using Operation = void (*)(benchmark::State &, const Instance &);
+
+struct NamedOperation
+{
+    const char *name;
+    Operation operation;
+};
+
+const auto operations = std::vector<NamedOperation>{
+    { "Serialize", &Serialize },
+    { "ByteSize", &ByteSize },
+    { "ParseHeap", &ParseHeap },
+    { "ParseReused", &ParseReused },
+    { "ParseArena", &ParseArena },
+};
+
+void AddMessages(const google::protobuf::Descriptor *descriptor, std::vector<const google::protobuf::Descriptor *> *all)
+{
+    if (descriptor->options().map_entry())
+    {
+        return;
+    }
+    all->push_back(descriptor);
+    for (auto i = 0; i < descriptor->nested_type_count(); ++i)
+    {
+        AddMessages(descriptor->nested_type(i), all);
+    }
+}
+
+// Every message of the API: of the files of the messages below, one per file the services use, and of the API files
+// they import. Naming a message of a file also links the file in.
+std::vector<const google::protobuf::Descriptor *> ApiMessages(void)
+{
+    auto files = std::vector<const google::protobuf::FileDescriptor *>{
+        robl::api::LoginRequest::descriptor()->file(),
+        robl::api::DataChunk::descriptor()->file(),
+        robl::api::LoadZonesRequest::descriptor()->file(),
+        robl::api::PointCloudChunk::descriptor()->file(),
+        robl::api::HelloRequest::descriptor()->file(),
+        robl::api::TransformPointsRequest::descriptor()->file(),
+        robl::api::GetSoftwareReleaseRequest::descriptor()->file(),
+    };
+    auto seen = std::set<const google::protobuf::FileDescriptor *>(files.begin(), files.end());
+    for (auto i = std::size_t(0); i < files.size(); ++i)
+    {
+        for (auto d = 0; d < files[i]->dependency_count(); ++d)
+        {
+            const auto *dependency = files[i]->dependency(d);
+            if (dependency->package() == "robl.api" && seen.insert(dependency).second)
+            {
+                files.push_back(dependency);
+            }
+        }
+    }
+
+    auto messages = std::vector<const google::protobuf::Descriptor *>();
+    for (const auto *file : files)
+    {
+        for (auto i = 0; i < file->message_type_count(); ++i)
+        {
+            AddMessages(file->message_type(i), &messages);
+        }
+    }
+    return messages;
+}
+
+// Registers <operation>/<message>/<shape>/<elements> for every message, e.g. Serialize/robl.api.FileContent/worst/256.
+// A message whose size does not depend on the elements is measured once. There are thousands, so pick with
+// --benchmark_filter, e.g. '/robl.api.FileContent/'.
+void RegisterBenchmarks(void)
+{
+    for (const auto *descriptor : ApiMessages())
+    {
+        const auto counts = IsScalable(descriptor) ? element_counts : std::vector<int>{ 1 };
+        for (const auto worst_case : { false, true })
+        {
+            for (const auto elements : counts)
+            {
+                const auto shape = MessageShape{ elements, elements * bytes_per_element, worst_case };
+                const auto instance = MakeInstance(descriptor, shape);
+                for (const auto &operation : operations)
+                {
+                    const auto name = std::string(operation.name) + "/" + descriptor->full_name() + "/" +
+                                      (worst_case ? "worst" : "representative") + "/" + std::to_string(elements);
+                    benchmark::RegisterBenchmark(name.c_str(), [instance, run = operation.operation](
+                                                                   benchmark::State &state) { run(state, *instance); });
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+/*=========================================================================*/
+
+int main(int argc, char **argv)
+{
+    RegisterBenchmarks();
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
+
+/*=========================================================================*/
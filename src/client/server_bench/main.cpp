@@ -0,0 +1,332 @@
+// standard headers
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// grpc headers
+#include <grpcpp/grpcpp.h>
+#include <robl/api/service.grpc.pb.h>
+
+using robl::api::HelloRequest;
+using robl::api::HelloResponse;
+using robl::api::TestService;
+
+/*=========================================================================*/
+
+struct BenchOptions
+{
+    std::string address = "localhost:50051";
+    int server_cores = 0; // 0 leaves the servers unpinned
+    int clients = 4;
+    int depth = 64;
+    std::chrono::seconds warmup = std::chrono::seconds(2);
+    std::chrono::seconds duration = std::chrono::seconds(10);
+    std::vector<std::string> servers;
+};
+
+struct LoadSnapshot
+{
+    std::uint64_t completed;
+    std::uint64_t failed;
+    std::uint64_t latency_us;
+};
+
+// Keeps a fixed number of SayHello calls in flight on each of its channels, one completion queue thread per channel.
+class LoadGenerator
+{
+public:
+    explicit LoadGenerator(const BenchOptions &options)
+        : options_(options)
+        , stopping_(false)
+        , completed_(0)
+        , failed_(0)
+        , latency_us_(0)
+    {
+    }
+
+    void Start(void)
+    {
+        for (auto i = 0; i < options_.clients; ++i)
+        {
+            threads_.emplace_back(&LoadGenerator::Run, this, i);
+        }
+    }
+
+    void Stop(void)
+    {
+        stopping_ = true;
+        for (auto &thread : threads_)
+        {
+            thread.join();
+        }
+        threads_.clear();
+    }
+
+    LoadSnapshot Snapshot(void) const
+    {
+        return LoadSnapshot{ completed_.load(), failed_.load(), latency_us_.load() };
+    }
+
+private:
+    struct Call
+    {
+        std::optional<grpc::ClientContext> context;
+        HelloResponse reply;
+        grpc::Status status;
+        std::unique_ptr<grpc::ClientAsyncResponseReader<HelloResponse>> reader;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    void Run(int index)
+    {
+        // Every client gets its own connection rather than sharing one subchannel.
+        auto arguments = grpc::ChannelArguments();
+        arguments.SetInt("robl.bench_client", index);
+        auto stub = TestService::NewStub(
+            grpc::CreateCustomChannel(options_.address, grpc::InsecureChannelCredentials(), arguments));
+
+        auto request = HelloRequest();
+        request.set_name("bench");
+
+        grpc::CompletionQueue cq;
+        auto calls = std::vector<Call>(options_.depth);
+        const auto issue = [&](Call &call) {
+            call.context.emplace();
+            call.start = std::chrono::steady_clock::now();
+            call.reader = stub->AsyncSayHello(&*call.context, request, &cq);
+            call.reader->Finish(&call.reply, &call.status, &call);
+        };
+        for (auto &call : calls)
+        {
+            issue(call);
+        }
+
+        auto in_flight = calls.size();
+        void *tag = nullptr;
+        auto ok = false;
+        while (in_flight > 0 && cq.Next(&tag, &ok))
+        {
+            auto &call = *static_cast<Call *>(tag);
+            if (ok && call.status.ok())
+            {
+                const auto latency = std::chrono::steady_clock::now() - call.start;
+                completed_.fetch_add(1, std::memory_order_relaxed);
+                latency_us_.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(latency).count(),
+                                      std::memory_order_relaxed);
+            }
+            else
+            {
+                failed_.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            if (stopping_)
+            {
+                --in_flight;
+            }
+            else
+            {
+                issue(call);
+            }
+        }
+        cq.Shutdown();
+        while (cq.Next(&tag, &ok))
+        {
+        }
+    }
+
+    const BenchOptions &options_;
+    std::atomic_bool stopping_;
+    std::atomic<std::uint64_t> completed_;
+    std::atomic<std::uint64_t> failed_;
+    std::atomic<std::uint64_t> latency_us_;
+    std::vector<std::thread> threads_;
+};
+
+/*=========================================================================*/
+
+// The user and system time the process spent so far, summed over all of its threads.
+double ProcessCpuSeconds(pid_t pid)
+{
+    std::ifstream stat("/proc/" + std::to_string(pid) + "/stat");
+    auto line = std::string();
+    std::getline(stat, line);
+
+    // The fields after the parenthesized command name, starting with the state as field 3.
+    std::istringstream fields(line.substr(line.rfind(')') + 2));
+    auto field = std::string();
+    auto ticks = 0.0;
+    for (auto i = 3; i <= 15 && fields >> field; ++i)
+    {
+        if (i == 14 || i == 15)
+        {
+            ticks += std::stod(field);
+        }
+    }
+    return ticks / static_cast<double>(sysconf(_SC_CLK_TCK));
+}
+
+// Starts a server with its output discarded, pinned to the first cores if requested.
+pid_t LaunchServer(const std::string &path, int cores)
+{
+    const auto pid = fork();
+    if (pid != 0)
+    {
+        return pid;
+    }
+
+    if (cores > 0)
+    {
+        auto cpus = cpu_set_t();
+        CPU_ZERO(&cpus);
+        for (auto cpu = 0; cpu < cores; ++cpu)
+        {
+            CPU_SET(cpu, &cpus);
+        }
+        sched_setaffinity(0, sizeof(cpus), &cpus);
+    }
+
+    const auto null = open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+    execl(path.c_str(), path.c_str(), static_cast<char *>(nullptr));
+    std::cerr << "Could not start " << path << std::endl;
+    _exit(127);
+}
+
+// Keeps the load generator off the cores given to the servers, as long as there are other cores.
+void AvoidServerCores(int cores)
+{
+    auto cpus = cpu_set_t();
+    if (cores <= 0 || sched_getaffinity(0, sizeof(cpus), &cpus) != 0)
+    {
+        return;
+    }
+
+    for (auto cpu = 0; cpu < cores; ++cpu)
+    {
+        CPU_CLR(cpu, &cpus);
+    }
+    if (CPU_COUNT(&cpus) > 0)
+    {
+        sched_setaffinity(0, sizeof(cpus), &cpus);
+    }
+}
+
+bool WaitForServer(const std::string &address)
+{
+    auto channel = grpc::CreateChannel(address, grpc::InsecureChannelCredentials());
+    return channel->WaitForConnected(std::chrono::system_clock::now() + std::chrono::seconds(10));
+}
+
+void BenchServer(const BenchOptions &options, const std::string &path)
+{
+    const auto pid = LaunchServer(path, options.server_cores);
+    if (!WaitForServer(options.address))
+    {
+        std::cerr << path << " did not start listening on " << options.address << std::endl;
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+        return;
+    }
+
+    auto load = LoadGenerator(options);
+    load.Start();
+    std::this_thread::sleep_for(options.warmup);
+
+    const auto first = load.Snapshot();
+    const auto first_cpu = ProcessCpuSeconds(pid);
+    const auto start = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(options.duration);
+    const auto last = load.Snapshot();
+    const auto last_cpu = ProcessCpuSeconds(pid);
+    const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    load.Stop();
+    kill(pid, SIGTERM);
+    waitpid(pid, nullptr, 0);
+
+    const auto completed = last.completed - first.completed;
+    const auto rps = completed / seconds;
+    const auto cores_used = (last_cpu - first_cpu) / seconds;
+    const auto mean_latency_us =
+        completed > 0 ? static_cast<double>(last.latency_us - first.latency_us) / completed : 0.0;
+
+    const auto name = path.substr(path.rfind('/') + 1);
+    std::cout << std::left << std::setw(18) << name << std::right << std::fixed << std::setprecision(0)
+              << std::setw(12) << rps << std::setprecision(2) << std::setw(12) << cores_used << std::setprecision(0)
+              << std::setw(14) << (cores_used > 0.0 ? rps / cores_used : 0.0) << std::setprecision(1) << std::setw(12)
+              << mean_latency_us << std::setw(10) << last.failed - first.failed << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    auto options = BenchOptions();
+    for (auto i = 1; i < argc; ++i)
+    {
+        const auto arg = std::string(argv[i]);
+        const auto has_value = i + 1 < argc;
+        if (arg == "--cores" && has_value)
+        {
+            options.server_cores = std::atoi(argv[++i]);
+        }
+        else if (arg == "--clients" && has_value)
+        {
+            options.clients = std::atoi(argv[++i]);
+        }
+        else if (arg == "--depth" && has_value)
+        {
+            options.depth = std::atoi(argv[++i]);
+        }
+        else if (arg == "--warmup" && has_value)
+        {
+            options.warmup = std::chrono::seconds(std::atoi(argv[++i]));
+        }
+        else if (arg == "--seconds" && has_value)
+        {
+            options.duration = std::chrono::seconds(std::atoi(argv[++i]));
+        }
+        else if (arg.rfind("--", 0) == 0)
+        {
+            std::cerr << "usage: " << argv[0]
+                      << " [--cores N] [--clients N] [--depth N] [--warmup S] [--seconds S] [server ...]" << std::endl;
+            return 1;
+        }
+        else
+        {
+            options.servers.push_back(arg);
+        }
+    }
+    if (options.servers.empty())
+    {
+        options.servers = { ROBL_SYNC_SERVER_PATH, ROBL_CALLBACK_SERVER_PATH, ROBL_ASYNC_SERVER_PATH };
+    }
+
+    AvoidServerCores(options.server_cores);
+
+    std::cout << "SayHello, " << options.clients << " channels x " << options.depth << " calls in flight, "
+              << (options.server_cores > 0 ? std::to_string(options.server_cores) : std::string("all"))
+              << " server cores" << std::endl
+              << std::left << std::setw(18) << "server" << std::right << std::setw(12) << "rps" << std::setw(12)
+              << "cores used" << std::setw(14) << "rps per core" << std::setw(12) << "mean us" << std::setw(10)
+              << "errors" << std::endl;
+    for (const auto &server : options.servers)
+    {
+        BenchServer(options, server);
+    }
+
+    return 0;
+}
@@ -8,6 +8,9 @@
 #include <grpcpp/grpcpp.h>
 #include <robl/api/service.grpc.pb.h>
 
+// project headers
+#include "channel/channel_pool.hpp"
+
 using robl::api::ChatRequest;
 using robl::api::ChatResponse;
 using robl::api::HelloRequest;
@@ -19,8 +22,11 @@ using robl::api::TestService;
 class TestClient
 {
 public:
-    TestClient(std::shared_ptr<grpc::Channel> channel)
-        : stub_(TestService::NewStub(channel))
+    using ChannelPool = robl::ChannelPool<TestService>;
+
+    TestClient(const std::string &target, std::shared_ptr<grpc::ChannelCredentials> credentials,
+               const ChannelPool::Options &options)
+        : pool_(target, std::move(credentials), options)
     {
     }
 
@@ -40,7 +46,7 @@ public:
         grpc::ClientContext context;
 
         // The actual RPC.
-        grpc::Status status = stub_->SayHello(&context, request, &reply);
+        grpc::Status status = pool_.Acquire()->SayHello(&context, request, &reply);
 
         // Act upon its status.
         if (status.ok())
@@ -60,7 +66,8 @@ public:
         SubscribeProgressResponse response;
 
         grpc::ClientContext context;
-        std::unique_ptr<grpc::ClientReader<SubscribeProgressResponse>> reader(stub_->SubscribeProgress(&context, request));
+        auto stub = pool_.Acquire();
+        std::unique_ptr<grpc::ClientReader<SubscribeProgressResponse>> reader(stub->SubscribeProgress(&context, request));
 
         while (reader->Read(&response))
         {
@@ -81,7 +88,8 @@ public:
     void Chat(void)
     {
         grpc::ClientContext context;
-        std::shared_ptr<grpc::ClientReaderWriter<ChatRequest, ChatResponse>> stream(stub_->Chat(&context));
+        auto stub = pool_.Acquire();
+        std::shared_ptr<grpc::ClientReaderWriter<ChatRequest, ChatResponse>> stream(stub->Chat(&context));
 
         std::thread writer([stream]() {
             ChatRequest request;
@@ -113,13 +121,14 @@ public:
     }
 
 private:
-    std::unique_ptr<TestService::Stub> stub_;
+    // The streams and the calls made meanwhile go over different connections.
+    ChannelPool pool_;
 };
 
 int main(void)
 {
     const auto &server_address = std::string("localhost:50051");
-    TestClient client(grpc::CreateChannel(server_address, grpc::InsecureChannelCredentials()));
+    TestClient client(server_address, grpc::InsecureChannelCredentials(), TestClient::ChannelPool::Options());
 
     std::string user("world");
     std::string reply = client.SayHello(user);
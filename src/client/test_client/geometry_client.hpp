@@ -0,0 +1,120 @@
+#pragma once
+
+// standard headers
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// grpc headers
+#include <robl/api/service.grpc.pb.h>
+
+/*=========================================================================*/
+
+using robl::api::GeometryService;
+using robl::api::TransformPointsRequest;
+using robl::api::TransformPointsResponse;
+
+/*=========================================================================*/
+
+class GeometryClient
+{
+public:
+    explicit GeometryClient(std::shared_ptr<grpc::Channel> channel)
+        : stub_(GeometryService::NewStub(channel))
+    {
+    }
+
+    // GeometryService rpc methods
+    bool TransformPointStream(std::size_t point_count, std::size_t batch_size);
+
+private:
+    std::unique_ptr<GeometryService::Stub> stub_;
+};
+
+/*=========================================================================*/
+
+inline bool GeometryClient::TransformPointStream(std::size_t point_count, std::size_t batch_size)
+{
+    // A quarter turn about z and a shift, so every coordinate of the result is easy to check.
+    constexpr auto tx = 1.0f, ty = 2.0f, tz = 3.0f;
+
+    grpc::ClientContext context;
+    auto stream = stub_->TransformPointStream(&context);
+
+    const auto begin = std::chrono::steady_clock::now();
+    auto request = TransformPointsRequest();
+    auto response = TransformPointsResponse();
+    auto max_error = 0.0f;
+    auto transformed = std::size_t(0);
+    for (auto first = std::size_t(0); first < point_count; first += batch_size)
+    {
+        const auto size = std::min(batch_size, point_count - first);
+
+        // Only the first batch carries the pose; the others use it too.
+        request.Clear();
+        if (first == 0)
+        {
+            auto *pose = request.mutable_target_tform_source();
+            pose->mutable_position()->set_x(tx);
+            pose->mutable_position()->set_y(ty);
+            pose->mutable_position()->set_z(tz);
+            pose->mutable_rotation()->set_z(static_cast<float>(std::sqrt(0.5)));
+            pose->mutable_rotation()->set_w(static_cast<float>(std::sqrt(0.5)));
+        }
+        auto *points = request.mutable_points();
+        points->mutable_x()->Resize(static_cast<int>(size), 0.0f);
+        points->mutable_y()->Resize(static_cast<int>(size), 0.0f);
+        points->mutable_z()->Resize(static_cast<int>(size), 0.0f);
+        for (auto i = std::size_t(0); i < size; ++i)
+        {
+            const auto value = static_cast<float>((first + i) % 1000) * 0.01f;
+            points->set_x(static_cast<int>(i), value);
+            points->set_y(static_cast<int>(i), -value);
+            points->set_z(static_cast<int>(i), value * 0.5f);
+        }
+
+        if (!stream->Write(request) || !stream->Read(&response))
+        {
+            break;
+        }
+
+        const auto &out = response.points();
+        if (static_cast<std::size_t>(out.x_size()) != size)
+        {
+            break;
+        }
+        for (auto i = std::size_t(0); i < size; ++i)
+        {
+            // (x, y, z) turns into (-y, x, z), then moves by the translation.
+            const auto x = points->x(static_cast<int>(i)), y = points->y(static_cast<int>(i));
+            const auto z = points->z(static_cast<int>(i));
+            max_error = std::max({ max_error, std::abs(out.x(static_cast<int>(i)) - (-y + tx)),
+                                   std::abs(out.y(static_cast<int>(i)) - (x + ty)),
+                                   std::abs(out.z(static_cast<int>(i)) - (z + tz)) });
+        }
+        transformed += size;
+    }
+    stream->WritesDone();
+
+    const auto status = stream->Finish();
+    if (!status.ok())
+    {
+        std::cerr << "TransformPointStream rpc failed: " << status.error_code() << ": " << status.error_message()
+                  << std::endl;
+        return false;
+    }
+
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    std::cout << "[TransformPointStream] points: " << transformed << " of " << point_count << std::endl
+              << "[TransformPointStream] batches of: " << batch_size << std::endl
+              << "[TransformPointStream] max error: " << max_error << std::endl
+              << "[TransformPointStream] Mpoints/s: " << (elapsed > 0.0 ? transformed / elapsed / 1e6 : 0.0)
+              << std::endl;
+
+    return transformed == point_count;
+}
+
+/*=========================================================================*/
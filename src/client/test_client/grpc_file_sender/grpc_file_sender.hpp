@@ -8,6 +8,7 @@
 #include <robl/api/test.pb.h>
 
 // project headers
+#include "metrics/profiler.hpp"
 #include "sequential_file_reader.h"
 
 template <class GrpcWriter>
@@ -23,12 +24,21 @@ public:
 protected:
     virtual void OnChunkAvailable(const void *data, std::size_t size) override
     {
+        static const auto chunk_zone = robl::Profiler::Instance().Zone("UploadFile.OnChunkAvailable");
+        static const auto write_zone = robl::Profiler::Instance().Zone("UploadFile.Write");
+        const auto profiled = robl::ProfileZone(chunk_zone);
+
         robl::api::FileContent fc;
 
         fc.set_name(std::filesystem::path(GetFilePath()).filename());
         fc.set_content(data, size);
 
-        if (!writer_.Write(fc))
+        auto written = false;
+        {
+            const auto profiled_write = robl::ProfileZone(write_zone);
+            written = writer_.Write(fc);
+        }
+        if (!written)
         {
             throw std::system_error(std::make_error_code(std::errc::connection_aborted),
                                     "The server aborted the connection.");
@@ -0,0 +1,120 @@
+#pragma once
+
+// standard headers
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <sys/resource.h>
+
+// grpc headers
+#include <grpcpp/grpcpp.h>
+#include <robl/api/service.grpc.pb.h>
+
+// project headers
+#include "channel/local_transport.hpp"
+#include "channel/tls_credentials.hpp"
+#include "metrics/hdr_histogram.hpp"
+
+/*=========================================================================*/
+
+/**
+ * The handshakes of a series of reconnects: how many were full and how many resumed a session, how long each kind
+ * took to connect, in microseconds, and the CPU time the client spent.
+ */
+struct HandshakeStats
+{
+    robl::HdrHistogram full = robl::HdrHistogram(60'000'000, 2);
+    robl::HdrHistogram resumed = robl::HdrHistogram(60'000'000, 2);
+    int failed = 0;
+    double cpu_seconds = 0.0;
+};
+
+/**
+ * Reconnects to the server as a boat does after its link flapped: every connection is a new channel, which connects
+ * and makes one call. With a session cache, every connection after the first one resumes a session.
+ */
+HandshakeStats ProbeHandshakes(const std::string &target, const std::shared_ptr<grpc::ChannelCredentials> &credentials,
+                               const robl::TlsSessionCache *session_cache, int connections);
+
+void ReportHandshakes(std::ostream &out, const std::string &label, const HandshakeStats &stats);
+
+/*=========================================================================*/
+
+namespace detail
+{
+
+inline double CpuSeconds(void)
+{
+    auto usage = rusage();
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+} // namespace detail
+
+inline HandshakeStats ProbeHandshakes(const std::string &target,
+                                      const std::shared_ptr<grpc::ChannelCredentials> &credentials,
+                                      const robl::TlsSessionCache *session_cache, int connections)
+{
+    auto stats = HandshakeStats();
+    const auto cpu_begin = detail::CpuSeconds();
+    for (auto i = 0; i < connections; ++i)
+    {
+        // A subchannel pool of its own gives every channel a connection of its own.
+        auto arguments = grpc::ChannelArguments();
+        arguments.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+        if (session_cache != nullptr)
+        {
+            session_cache->Apply(&arguments);
+        }
+
+        const auto begin = std::chrono::steady_clock::now();
+        const auto channel = robl::CreateLocalChannel(target, credentials, arguments);
+        if (!channel->WaitForConnected(std::chrono::system_clock::now() + std::chrono::seconds(5)))
+        {
+            ++stats.failed;
+            continue;
+        }
+        const auto connect_us =
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
+
+        grpc::ClientContext context;
+        robl::api::GetSoftwareReleaseRequest request;
+        robl::api::GetSoftwareReleaseResponse response;
+        if (!robl::api::VersionService::NewStub(channel)->GetSoftwareRelease(&context, request, &response).ok())
+        {
+            ++stats.failed;
+            continue;
+        }
+        (robl::SessionReused(context) ? stats.resumed : stats.full).Record(connect_us);
+    }
+    stats.cpu_seconds = detail::CpuSeconds() - cpu_begin;
+    return stats;
+}
+
+inline void ReportHandshakes(std::ostream &out, const std::string &label, const HandshakeStats &stats)
+{
+    const auto report = [&out](const char *kind, const robl::HdrHistogram &latency) {
+        out << "[Handshakes] " << kind << ": " << latency.Count();
+        if (latency.Count() > 0)
+        {
+            out << ", connect p50 " << latency.ValueAtPercentile(50) << " us, p99 " << latency.ValueAtPercentile(99)
+                << " us";
+        }
+        out << std::endl;
+    };
+
+    out << "[Handshakes] " << label << std::endl;
+    report("full", stats.full);
+    report("resumed", stats.resumed);
+    const auto handshakes = stats.full.Count() + stats.resumed.Count();
+    out << "[Handshakes] failed: " << stats.failed << std::endl
+        << "[Handshakes] client cpu: " << std::fixed << std::setprecision(1)
+        << (handshakes > 0 ? stats.cpu_seconds * 1e6 / handshakes : 0.0) << " us per connection" << std::endl;
+}
+
+/*=========================================================================*/
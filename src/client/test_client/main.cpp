@@ -1,6 +1,7 @@
 // standard headers
 #include <chrono>
-#include <fstream>
+#include <cstdlib>
+#include <memory>
 #include <string>
 #include <thread>
 #include <vector>
@@ -9,20 +10,13 @@
 #include <grpcpp/grpcpp.h>
 
 // project headers
+#include "channel/tls_credentials.hpp"
+#include "geometry_client.hpp"
+#include "handshake_probe.hpp"
+#include "metrics/profiler.hpp"
+#include "point_cloud_client.hpp"
 #include "test_client.hpp"
-
-std::string ReadTextFile(const std::string &filename)
-{
-    std::ifstream file(filename.c_str(), std::ios::in);
-    std::stringstream ss;
-    if (file.is_open())
-    {
-        ss << file.rdbuf();
-        file.close();
-    }
-
-    return ss.str();
-}
+#include "version_client.hpp"
 
 int main(void)
 {
@@ -33,13 +27,32 @@ int main(void)
     auto use_ssl = true;
     if (use_ssl)
     {
-        auto ssl_opts = grpc::SslCredentialsOptions();
-        ssl_opts.pem_root_certs = ReadTextFile("../../../auth/ca.crt");
-        creds = grpc::SslCredentials(ssl_opts);
+        // The CA is read again when it changes, so it rotates without a restart.
+        creds = robl::ReloadingChannelCredentials("../../../auth/ca.crt");
     }
 
-    auto channel = grpc::CreateChannel(server_address, creds);
-    auto client = TestClient(channel);
+    // Every channel resumes the TLS sessions of the others, so reconnecting after a link flap takes no full handshake.
+    const auto session_cache = robl::TlsSessionCache();
+    auto pool_options = TestClient::ChannelPool::Options();
+    session_cache.Apply(&pool_options.arguments);
+
+    auto client = TestClient(server_address, creds, pool_options);
+    auto point_cloud_client =
+        PointCloudClient(grpc::CreateCustomChannel(server_address, creds, pool_options.arguments));
+    auto version_client = VersionClient(grpc::CreateCustomChannel(server_address, creds, pool_options.arguments));
+    // Transformed batches of a million points are about 12 MB.
+    auto geometry_arguments = pool_options.arguments;
+    geometry_arguments.SetMaxReceiveMessageSize(64 * 1024 * 1024);
+    auto geometry_client = GeometryClient(grpc::CreateCustomChannel(server_address, creds, geometry_arguments));
+
+    // The profiling zones are reported every $ROBL_PROFILE_INTERVAL seconds if it is set, and on request 6.
+    const auto *profile_interval = std::getenv("ROBL_PROFILE_INTERVAL");
+    auto profile_reporter = std::unique_ptr<robl::ProfileReporter>();
+    if (profile_interval != nullptr && std::atoi(profile_interval) > 0)
+    {
+        profile_reporter =
+            std::make_unique<robl::ProfileReporter>(std::chrono::seconds(std::atoi(profile_interval)), std::cout);
+    }
 
     auto threads = std::vector<std::thread>();
     threads.emplace_back([&client]() { client.HeartBeat(); });
@@ -67,9 +80,41 @@ int main(void)
             threads.emplace_back([&client]() { client.UploadFile("./LICENSE"); });
             break;
         case 3: {
-            threads.emplace_back([&client]() { client.GetMarker(); });
+            threads.emplace_back([&client]() { client.GetMarker(1); });
             break;
         }
+        case 4: {
+            threads.emplace_back([&client]() { client.IngestMarkers(500000, 1000); });
+            break;
+        }
+        case 5: {
+            threads.emplace_back([&point_cloud_client]() {
+                point_cloud_client.StreamPointCloud(1000000, 65536, robl::api::COLUMN_ENCODING_FIXED_DELTA, 0.001);
+            });
+            break;
+        }
+        case 6:
+            robl::Profiler::Report(std::cout, robl::Profiler::Instance().Totals());
+            break;
+        case 7:
+            threads.emplace_back([&version_client]() { version_client.GetSoftwareRelease("test_client", 0); });
+            break;
+        case 8:
+            threads.emplace_back([&client]() { client.ExportMarkers(0); });
+            break;
+        case 9:
+            threads.emplace_back([&server_address, &creds]() {
+                constexpr auto connections = 200;
+                ReportHandshakes(std::cout, "without session cache",
+                                 ProbeHandshakes(server_address, creds, nullptr, connections));
+                const auto probe_cache = robl::TlsSessionCache();
+                ReportHandshakes(std::cout, "with session cache",
+                                 ProbeHandshakes(server_address, creds, &probe_cache, connections));
+            });
+            break;
+        case 10:
+            threads.emplace_back([&geometry_client]() { geometry_client.TransformPointStream(10000000, 1000000); });
+            break;
         default:
             std::cout << "Invalid request" << std::endl;
             break;
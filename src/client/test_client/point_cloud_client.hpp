@@ -0,0 +1,94 @@
+#pragma once
+
+// standard headers
+#include <chrono>
+#include <iostream>
+#include <string>
+
+// grpc headers
+#include <robl/api/service.grpc.pb.h>
+
+// project headers
+#include "pointcloud/point_cloud_codec.hpp"
+
+/*=========================================================================*/
+
+using robl::api::ColumnEncoding;
+using robl::api::PointCloudChunk;
+using robl::api::PointCloudService;
+using robl::api::StreamPointCloudRequest;
+
+/*=========================================================================*/
+
+class PointCloudClient
+{
+public:
+    explicit PointCloudClient(std::shared_ptr<grpc::Channel> channel)
+        : stub_(PointCloudService::NewStub(channel))
+    {
+    }
+
+    // PointCloudService rpc methods
+    bool StreamPointCloud(std::uint32_t point_count, std::uint32_t chunk_size, ColumnEncoding encoding, double step);
+
+private:
+    std::unique_ptr<PointCloudService::Stub> stub_;
+};
+
+/*=========================================================================*/
+
+inline bool PointCloudClient::StreamPointCloud(std::uint32_t point_count, std::uint32_t chunk_size,
+                                               ColumnEncoding encoding, double step)
+{
+    grpc::ClientContext context;
+    StreamPointCloudRequest request;
+    request.set_point_count(point_count);
+    request.set_chunk_size(chunk_size);
+    request.mutable_format()->set_encoding(encoding);
+    request.mutable_format()->set_step(step);
+
+    std::unique_ptr<grpc::ClientReader<PointCloudChunk>> reader(stub_->StreamPointCloud(&context, request));
+
+    auto points = robl::pointcloud::PointColumns();
+    points.x.Reserve(point_count);
+    points.y.Reserve(point_count);
+    points.z.Reserve(point_count);
+
+    PointCloudChunk chunk;
+    auto chunks = std::size_t(0);
+    auto wire_bytes = std::size_t(0);
+    auto decode_time = std::chrono::steady_clock::duration::zero();
+    auto error = std::string();
+    while (reader->Read(&chunk))
+    {
+        ++chunks;
+        wire_bytes += chunk.ByteSizeLong();
+
+        const auto start = std::chrono::steady_clock::now();
+        if (!robl::pointcloud::DecodePointCloud(chunk, &points, &error))
+        {
+            std::cerr << "StreamPointCloud decode failed: " << error << std::endl;
+            context.TryCancel();
+            break;
+        }
+        decode_time += std::chrono::steady_clock::now() - start;
+    }
+
+    const auto status = reader->Finish();
+    if (!status.ok())
+    {
+        std::cerr << "StreamPointCloud rpc failed: " << status.error_code() << ": " << status.error_message()
+                  << std::endl;
+        return false;
+    }
+
+    const auto decode_ms = std::chrono::duration<double, std::milli>(decode_time).count();
+    std::cout << "[StreamPointCloud] points: " << points.size() << std::endl
+              << "[StreamPointCloud] chunks: " << chunks << std::endl
+              << "[StreamPointCloud] bytes per point: " << static_cast<double>(wire_bytes) / points.size() << std::endl
+              << "[StreamPointCloud] decode ms: " << decode_ms << std::endl;
+
+    return true;
+}
+
+/*=========================================================================*/
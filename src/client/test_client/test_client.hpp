@@ -1,22 +1,40 @@
 #pragma once
 
 // standard headers
+#include <algorithm>
+#include <cerrno>
+#include <filesystem>
 #include <future>
 #include <iostream>
+#include <optional>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 // grpc headers
 #include <robl/api/service.grpc.pb.h>
 
 // project headers
+#include "channel/channel_pool.hpp"
 #include "grpc_file_sender/grpc_file_sender.hpp"
+#include "metrics/profiler.hpp"
+#include "shm/descriptor_channel.hpp"
+#include "shm/shared_memory.hpp"
 #include "utils.h"
+#include "wire/data_chunk_stream.hpp"
 
 /*=========================================================================*/
 
 using namespace std::chrono_literals;
 
 using robl::api::ClientHeartBeat;
+using robl::api::DataChunk;
+using robl::api::ExportMarkersRequest;
 using robl::api::FileContent;
+using robl::api::IngestMarkersResponse;
 using robl::api::MarkerInfo;
 using robl::api::MarkerRequest;
 using robl::api::MarkerResponse;
@@ -31,8 +49,14 @@ using robl::api::TestService;
 class TestClient
 {
 public:
-    explicit TestClient(std::shared_ptr<grpc::Channel> channel)
-        : stub_(TestService::NewStub(channel))
+    using ChannelPool = robl::ChannelPool<TestService>;
+
+    // Every call leases the least busy connection of the pool, so the heartbeat stream and an upload do not queue
+    // behind each other on one connection.
+    TestClient(const std::string &target, std::shared_ptr<grpc::ChannelCredentials> credentials,
+               const ChannelPool::Options &options)
+        : target_(target)
+        , pool_(target, std::move(credentials), options)
         , session_id_(-1)
     {
     }
@@ -41,10 +65,27 @@ public:
     RegisterAccountResponse RegisterAccount(const RegisterAccountRequest &request);
     bool HeartBeat(void);
     bool UploadFile(const std::string &filename);
-    MarkerResponse GetMarker(void);
+    MarkerResponse GetMarker(std::uint32_t id);
+    IngestMarkersResponse IngestMarkers(std::uint32_t count, std::uint32_t frame_size);
+    std::uint32_t ExportMarkers(std::uint32_t chunk_size);
 
 private:
-    std::unique_ptr<TestService::Stub> stub_;
+    // A file passed to a same-host server, or a token of 0 if it could not be.
+    struct SharedFile
+    {
+        robl::UniqueFd fd;
+        std::uint64_t token;
+        std::uint64_t size;
+    };
+
+    static SharedFile ShareFile(const std::string &filename, robl::DescriptorClient &descriptors);
+
+    // Sends the file as regions for the server to copy, each of them acknowledged like a chunk of content.
+    static void SendSharedRegions(const std::string &filename, const SharedFile &shared,
+                                  grpc::ClientReaderWriter<FileContent, Status> &stream);
+
+    const std::string target_;
+    ChannelPool pool_;
     std::uint32_t session_id_;
 };
 
@@ -55,7 +96,7 @@ inline RegisterAccountResponse TestClient::RegisterAccount(const RegisterAccount
     grpc::ClientContext context;
     RegisterAccountResponse response;
 
-    const auto status = stub_->RegisterAccount(&context, request, &response);
+    const auto status = pool_.Acquire()->RegisterAccount(&context, request, &response);
 
     if (!status.ok())
     {
@@ -77,9 +118,12 @@ inline RegisterAccountResponse TestClient::RegisterAccount(const RegisterAccount
 inline bool TestClient::HeartBeat(void)
 {
     grpc::ClientContext context;
-    std::shared_ptr<grpc::ClientReaderWriter<ClientHeartBeat, ServerHeartBeat>> stream(stub_->HeartBeat(&context));
+    auto stub = pool_.Acquire();
+    std::shared_ptr<grpc::ClientReaderWriter<ClientHeartBeat, ServerHeartBeat>> stream(stub->HeartBeat(&context));
     ClientHeartBeat request;
     ServerHeartBeat response;
+    static const auto write_zone = robl::Profiler::Instance().Zone("HeartBeat.Write");
+    static const auto read_zone = robl::Profiler::Instance().Zone("HeartBeat.Read");
 
     while (true)
     {
@@ -87,9 +131,17 @@ inline bool TestClient::HeartBeat(void)
 
         request.set_session_id(session_id_);
         request.set_tick(System::GetSystemTickMillis());
-        stream->Write(request);
+        {
+            const auto profiled = robl::ProfileZone(write_zone);
+            stream->Write(request);
+        }
 
-        if (stream->Read(&response))
+        auto received = false;
+        {
+            const auto profiled = robl::ProfileZone(read_zone);
+            received = stream->Read(&response);
+        }
+        if (received)
         {
             std::cout << "[ServerHeartBeat] result: " << response.result() << std::endl
                       << "[ServerHeartBeat] session_id: " << response.session_id() << std::endl
@@ -114,15 +166,32 @@ inline bool TestClient::HeartBeat(void)
 inline bool TestClient::UploadFile(const std::string &filename)
 {
     grpc::ClientContext context;
-    std::unique_ptr<grpc::ClientReaderWriter<FileContent, Status>> stream(stub_->UploadFile(&context));
+    auto stub = pool_.Acquire();
+    std::unique_ptr<grpc::ClientReaderWriter<FileContent, Status>> stream(stub->UploadFile(&context));
 
     try
     {
-        auto file_sender = GrpcFileSender(filename, *stream);
+        // A server on the same host copies the file itself from a descriptor passed over its side channel, so the
+        // stream only carries the regions to copy. Any other server gets the content.
+        const auto same_host = robl::PickTransport(target_) != robl::Transport::Tcp;
+        auto descriptors = robl::DescriptorClient(same_host ? robl::DescriptorSocketPath(target_) : std::string());
+        const auto shared = ShareFile(filename, descriptors);
+        auto file_sender = std::optional<GrpcFileSender<grpc::ClientReaderWriter<FileContent, Status>>>();
+        if (shared.token == 0)
+        {
+            file_sender.emplace(filename, *stream);
+        }
 
         const auto chunk_size = 1 * KB; // Hardcoded to 1MB, which seems to be recommended from experience.
-        auto future = std::async([&stream, &file_sender, chunk_size] {
-            file_sender.Read(chunk_size);
+        auto future = std::async([&stream, &filename, &shared, &file_sender, chunk_size] {
+            if (file_sender.has_value())
+            {
+                file_sender->Read(chunk_size);
+            }
+            else
+            {
+                SendSharedRegions(filename, shared, *stream);
+            }
             stream->WritesDone();
         });
 
@@ -150,34 +219,190 @@ inline bool TestClient::UploadFile(const std::string &filename)
     return true;
 }
 
-inline MarkerResponse TestClient::GetMarker(void)
+inline TestClient::SharedFile TestClient::ShareFile(const std::string &filename, robl::DescriptorClient &descriptors)
+{
+    auto shared = SharedFile{ robl::UniqueFd(), 0, 0 };
+    if (!descriptors.Connected())
+    {
+        return shared;
+    }
+
+    shared.fd.Reset(open(filename.c_str(), O_RDONLY | O_CLOEXEC));
+    struct stat status;
+    if (!shared.fd.Valid() || fstat(shared.fd.Get(), &status) != 0)
+    {
+        return shared;
+    }
+
+    if (S_ISREG(status.st_mode))
+    {
+        shared.size = static_cast<std::uint64_t>(status.st_size);
+    }
+    else
+    {
+        // The server only copies from regular files and sealed memfds, so the content of a pipe or a device is read
+        // into a sealed memfd first.
+        auto content = std::string();
+        char buffer[64 * 1024];
+        for (auto result = ssize_t(0); (result = read(shared.fd.Get(), buffer, sizeof(buffer))) != 0;)
+        {
+            if (result < 0 && errno != EINTR)
+            {
+                throw std::system_error(errno, std::system_category(), "reading " + filename);
+            }
+            content.append(buffer, result > 0 ? result : 0);
+        }
+        shared.fd = robl::CreateSharedMemory(std::filesystem::path(filename).filename(), content);
+        shared.size = content.size();
+    }
+    shared.token = descriptors.Send(shared.fd.Get());
+    return shared;
+}
+
+inline void TestClient::SendSharedRegions(const std::string &filename, const SharedFile &shared,
+                                          grpc::ClientReaderWriter<FileContent, Status> &stream)
+{
+    // The regions bound how much one acknowledgement stands for, not what goes over the stream.
+    constexpr auto region_size = std::uint64_t(256 * MB);
+
+    auto content = FileContent();
+    content.set_name(std::filesystem::path(filename).filename());
+    content.mutable_shared()->set_token(shared.token);
+    static const auto write_zone = robl::Profiler::Instance().Zone("UploadFile.Write");
+    auto offset = std::uint64_t(0);
+    do
+    {
+        const auto length = std::min(region_size, shared.size - offset);
+        content.mutable_shared()->set_offset(offset);
+        content.mutable_shared()->set_length(length);
+
+        auto written = false;
+        {
+            const auto profiled = robl::ProfileZone(write_zone);
+            written = stream.Write(content);
+        }
+        if (!written)
+        {
+            throw std::system_error(std::make_error_code(std::errc::connection_aborted),
+                                    "The server aborted the connection.");
+        }
+        offset += length;
+    } while (offset < shared.size);
+}
+
+inline MarkerResponse TestClient::GetMarker(std::uint32_t id)
 {
     grpc::ClientContext context;
     MarkerResponse response;
     MarkerRequest request;
 
-    auto field_mask = std::make_unique<google::protobuf::FieldMask>();
-    field_mask->add_paths("markers");
-    request.set_allocated_mask(field_mask.release());
+    request.set_id(id);
+    request.mutable_mask()->add_paths("markers");
 
-    const auto status = stub_->GetMarker(&context, request, &response);
+    const auto status = pool_.Acquire()->GetMarker(&context, request, &response);
 
     if (!status.ok())
     {
-        std::cerr << "RegisterAccount rpc failed: " << status.error_code() << ": " << status.error_message() << std::endl;
+        std::cerr << "GetMarker rpc failed: " << status.error_code() << ": " << status.error_message() << std::endl;
         return MarkerResponse();
     }
 
-    std::cout << "[MarkerResponse] id: " << response.marker_info().markers(1).id() << std::endl
-              << "[MarkerResponse] name: " << response.marker_info().markers(1).name() << std::endl
-              << "[MarkerResponse] coordinate.latitude: " << response.marker_info().markers(1).coordinate().latitude()
-              << std::endl
-              << "[MarkerResponse] coordinate.longitude: " << response.marker_info().markers(1).coordinate().longitude()
-              << std::endl
-              << "[MarkerResponse] radius: " << response.marker_info().markers(1).radius() << std::endl
-              << "[MarkerResponse] description: " << response.marker_info().markers(1).description() << std::endl;
+    for (const auto &marker : response.marker_info().markers())
+    {
+        std::cout << "[MarkerResponse] id: " << marker.id() << std::endl
+                  << "[MarkerResponse] name: " << marker.name() << std::endl
+                  << "[MarkerResponse] coordinate.latitude: " << marker.coordinate().latitude() << std::endl
+                  << "[MarkerResponse] coordinate.longitude: " << marker.coordinate().longitude() << std::endl
+                  << "[MarkerResponse] radius: " << marker.radius() << std::endl
+                  << "[MarkerResponse] description: " << marker.description() << std::endl;
+    }
 
     return response;
 }
 
+inline IngestMarkersResponse TestClient::IngestMarkers(std::uint32_t count, std::uint32_t frame_size)
+{
+    grpc::ClientContext context;
+    IngestMarkersResponse response;
+    auto stub = pool_.Acquire();
+    std::unique_ptr<grpc::ClientWriter<MarkerInfo>> writer(stub->IngestMarkers(&context, &response));
+
+    MarkerInfo frame;
+    for (auto id = 0U; id < count; ++id)
+    {
+        auto *marker = frame.add_markers();
+        marker->set_id(id);
+        marker->set_name("marker-" + std::to_string(id));
+        marker->set_radius(10.0f + id % 100);
+        marker->mutable_coordinate()->set_latitude(-90.0 + 180.0 * (id % 10007) / 10007);
+        marker->mutable_coordinate()->set_longitude(-180.0 + 360.0 * (id % 10009) / 10009);
+
+        if (frame.markers_size() == static_cast<int>(frame_size) || id + 1 == count)
+        {
+            frame.set_total_count(count);
+            if (!writer->Write(frame))
+            {
+                break;
+            }
+            frame.Clear();
+        }
+    }
+    writer->WritesDone();
+
+    const auto status = writer->Finish();
+    if (!status.ok())
+    {
+        std::cerr << "IngestMarkers rpc failed: " << status.error_code() << ": " << status.error_message() << std::endl;
+        return IngestMarkersResponse();
+    }
+
+    std::cout << "[IngestMarkersResponse] ingested_count: " << response.ingested_count() << std::endl
+              << "[IngestMarkersResponse] rejected_count: " << response.rejected_count() << std::endl
+              << "[IngestMarkersResponse] markers_per_second: " << response.markers_per_second() << std::endl
+              << "[IngestMarkersResponse] store_version: " << response.store_version() << std::endl;
+    for (const auto &error : response.errors())
+    {
+        std::cout << "[IngestMarkersResponse] error: " << error << std::endl;
+    }
+
+    return response;
+}
+
+inline std::uint32_t TestClient::ExportMarkers(std::uint32_t chunk_size)
+{
+    // Far beyond any single message the channel accepts; only the chunks have to fit its limit.
+    constexpr auto max_size = std::uint64_t(1024) * 1024 * 1024;
+
+    grpc::ClientContext context;
+    ExportMarkersRequest request;
+    request.set_chunk_size(chunk_size);
+
+    const auto begin = std::chrono::steady_clock::now();
+    auto stub = pool_.Acquire();
+    std::unique_ptr<grpc::ClientReader<DataChunk>> reader(stub->ExportMarkers(&context, request));
+
+    MarkerInfo info;
+    auto error = std::string();
+    const auto received = robl::ReadChunked(reader.get(), &info, max_size, &error);
+    if (!received)
+    {
+        context.TryCancel();
+    }
+
+    const auto status = reader->Finish();
+    if (!status.ok() || !received)
+    {
+        std::cerr << "ExportMarkers rpc failed: " << status.error_code() << ": "
+                  << (status.ok() ? error : status.error_message()) << std::endl;
+        return 0;
+    }
+
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    std::cout << "[ExportMarkers] markers: " << info.markers_size() << " of " << info.total_count() << std::endl
+              << "[ExportMarkers] bytes: " << info.ByteSizeLong() << std::endl
+              << "[ExportMarkers] seconds: " << elapsed << std::endl;
+
+    return info.total_count();
+}
+
 /*=========================================================================*/
@@ -0,0 +1,90 @@
+#pragma once
+
+// standard headers
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+
+// grpc headers
+#include <google/protobuf/util/time_util.h>
+#include <robl/api/service.grpc.pb.h>
+
+/*=========================================================================*/
+
+using robl::api::GetSoftwareReleaseRequest;
+using robl::api::GetSoftwareReleaseResponse;
+using robl::api::VersionService;
+
+/*=========================================================================*/
+
+class VersionClient
+{
+public:
+    explicit VersionClient(std::shared_ptr<grpc::Channel> channel)
+        : stub_(VersionService::NewStub(channel))
+    {
+    }
+
+    // VersionService rpc methods
+    GetSoftwareReleaseResponse GetSoftwareRelease(const std::string &username, std::uint32_t session_id);
+
+private:
+    std::unique_ptr<VersionService::Stub> stub_;
+};
+
+/*=========================================================================*/
+
+inline GetSoftwareReleaseResponse VersionClient::GetSoftwareRelease(const std::string &username,
+                                                                    std::uint32_t session_id)
+{
+    using google::protobuf::util::TimeUtil;
+
+    // TimeUtil::GetCurrentTime() has whole seconds only.
+    const auto now = []() {
+        const auto since_epoch = std::chrono::system_clock::now().time_since_epoch();
+        return TimeUtil::NanosecondsToTimestamp(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(since_epoch).count());
+    };
+
+    grpc::ClientContext context;
+    GetSoftwareReleaseResponse response;
+    GetSoftwareReleaseRequest request;
+    request.mutable_header()->set_username(username);
+    request.mutable_header()->set_session_id(session_id);
+    *request.mutable_header()->mutable_request_timestamp() = now();
+
+    const auto status = stub_->GetSoftwareRelease(&context, request, &response);
+    const auto received = now();
+
+    if (!status.ok())
+    {
+        std::cerr << "GetSoftwareRelease rpc failed: " << status.error_code() << ": " << status.error_message()
+                  << std::endl;
+        return GetSoftwareReleaseResponse();
+    }
+
+    const auto &header = response.header();
+    auto echoed = GetSoftwareReleaseRequest();
+    const auto echo_matches = header.has_request() && header.request().UnpackTo(&echoed) &&
+                              echoed.SerializeAsString() == request.SerializeAsString();
+    const auto &version = response.version().version();
+    std::cout << "[GetSoftwareReleaseResponse] name: " << response.version().name() << std::endl
+              << "[GetSoftwareReleaseResponse] version: " << version.major_version() << "."
+              << version.minor_version() << "." << version.patch_level() << std::endl
+              << "[GetSoftwareReleaseResponse] build_information: " << response.version().build_information()
+              << std::endl
+              << "[GetSoftwareReleaseResponse] detail: " << response.detail() << std::endl
+              << "[GetSoftwareReleaseResponse] echoed username: " << header.request_header().username() << std::endl
+              << "[GetSoftwareReleaseResponse] echoed request: " << (echo_matches ? "matches" : "missing") << std::endl
+              << "[GetSoftwareReleaseResponse] server time: "
+              << TimeUtil::DurationToMicroseconds(header.response_timestamp() - header.request_received_timestamp())
+              << " us of "
+              << TimeUtil::DurationToMicroseconds(received - header.request_header().request_timestamp()) << " us"
+              << std::endl;
+
+    return response;
+}
+
+/*=========================================================================*/
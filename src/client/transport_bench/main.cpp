@@ -0,0 +1,312 @@
+// standard headers
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// grpc headers
+#include <grpcpp/grpcpp.h>
+#include <robl/api/service.grpc.pb.h>
+
+// project headers
+#include "channel/local_transport.hpp"
+#include "coro/client_call.hpp"
+#include "coro/executor.hpp"
+#include "coro/server_call.hpp"
+#include "coro/task.hpp"
+#include "metrics/hdr_histogram.hpp"
+
+using robl::api::FileContent;
+using robl::api::HelloRequest;
+using robl::api::HelloResponse;
+using robl::api::Status;
+using robl::api::TestService;
+
+using Clock = std::chrono::steady_clock;
+
+/*=========================================================================*/
+
+struct BenchOptions
+{
+    // The server listens on localhost:<port> and on the Unix domain socket of that address.
+    int port = 50071;
+    std::vector<int> concurrency = { 1, 32 };
+    std::chrono::seconds warmup = std::chrono::seconds(1);
+    std::chrono::seconds duration = std::chrono::seconds(3);
+    // UploadFile: the chunks per call and their size.
+    int chunks = 16;
+    std::size_t chunk_size = 64 * 1024;
+};
+
+// Serves SayHello and UploadFile without any work of their own, so the calls measure the transport. UploadFile
+// acknowledges every chunk and drops it.
+class BenchService final
+    : public TestService::WithCallbackMethod_SayHello<TestService::WithCallbackMethod_UploadFile<TestService::Service>>
+{
+private:
+    using UploadCall = robl::coro::ServerBidiCall<FileContent, Status>;
+
+    grpc::ServerUnaryReactor *SayHello(grpc::CallbackServerContext *context, const HelloRequest *request,
+                                       HelloResponse *reply) override
+    {
+        reply->set_message("Hello " + request->name());
+        auto *reactor = context->DefaultReactor();
+        reactor->Finish(grpc::Status::OK);
+        return reactor;
+    }
+
+    grpc::ServerBidiReactor<FileContent, Status> *UploadFile(grpc::CallbackServerContext *) override
+    {
+        return UploadCall::Start([](UploadCall &stream) -> robl::coro::Task<grpc::Status> {
+            auto ack = Status();
+            ack.set_code(0);
+            auto *chunk = co_await stream.Read();
+            while (chunk != nullptr)
+            {
+                if (!co_await stream.Write(ack))
+                {
+                    co_return grpc::Status::CANCELLED;
+                }
+                chunk = co_await stream.Read();
+            }
+            co_return grpc::Status::OK;
+        });
+    }
+};
+
+/*=========================================================================*/
+
+// What the calls of one run share. They all run on the loop, so they record without locks.
+struct BenchRun
+{
+    BenchRun(robl::coro::RunLoop &loop, TestService::Stub &stub, const BenchOptions &options)
+        : loop(loop)
+        , stub(stub)
+        , options(options)
+        , latency_us(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::minutes(1)).count(), 3)
+        , completed(0)
+        , errors(0)
+    {
+        chunk.set_name("transport_bench.bin");
+        chunk.set_content(std::string(options.chunk_size, 'x'));
+    }
+
+    robl::coro::RunLoop &loop;
+    TestService::Stub &stub;
+    const BenchOptions &options;
+    FileContent chunk;
+    Clock::time_point window_start;
+    Clock::time_point window_end;
+    robl::HdrHistogram latency_us;
+    std::uint64_t completed;
+    std::uint64_t errors;
+};
+
+using BenchCall = robl::coro::Task<grpc::Status> (*)(BenchRun &run);
+
+robl::coro::Task<grpc::Status> SayHello(BenchRun &run)
+{
+    grpc::ClientContext context;
+    auto request = HelloRequest();
+    auto response = HelloResponse();
+
+    request.set_name("bench");
+    co_return co_await robl::coro::Call(run.loop, run.stub.async(), &TestService::Stub::async::SayHello, &context,
+                                        &request, &response);
+}
+
+// Uploads the chunks one at a time, each waiting for its acknowledgement.
+robl::coro::Task<grpc::Status> UploadFile(BenchRun &run)
+{
+    grpc::ClientContext context;
+    robl::coro::BidiStream<FileContent, Status> stream(run.loop);
+
+    run.stub.async()->UploadFile(&context, &stream);
+    stream.StartCall();
+    for (auto i = 0; i < run.options.chunks; ++i)
+    {
+        if (!co_await stream.Write(run.chunk))
+        {
+            break;
+        }
+        if (co_await stream.Read() == nullptr)
+        {
+            break;
+        }
+    }
+
+    co_await stream.WritesDone();
+    const auto *ack = co_await stream.Read();
+    while (ack != nullptr)
+    {
+        ack = co_await stream.Read();
+    }
+    co_return co_await stream.Finish();
+}
+
+// A closed-loop worker: it starts a call as soon as the previous one ends, and records the calls which started
+// within the window.
+robl::coro::Task<void> RunWorker(BenchRun &run, BenchCall call)
+{
+    while (Clock::now() < run.window_end)
+    {
+        const auto start = Clock::now();
+        const auto status = co_await call(run);
+        if (start < run.window_start)
+        {
+            continue;
+        }
+
+        if (status.ok())
+        {
+            const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start);
+            run.latency_us.Record(latency.count());
+            ++run.completed;
+        }
+        else
+        {
+            ++run.errors;
+        }
+    }
+}
+
+robl::coro::Task<void> RunWorkers(BenchRun &run, BenchCall call, int concurrency)
+{
+    auto workers = std::vector<robl::coro::Task<void>>();
+    for (auto i = 0; i < concurrency; ++i)
+    {
+        workers.push_back(RunWorker(run, call));
+    }
+    co_await robl::coro::WhenAll(std::move(workers));
+}
+
+void Bench(const BenchOptions &options, const std::string &target, const char *scenario, BenchCall call,
+           robl::Transport transport, int concurrency)
+{
+    // A channel of its own, so no run inherits the connection or the flow control windows of another.
+    auto arguments = grpc::ChannelArguments();
+    arguments.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+    arguments.SetMaxReceiveMessageSize(-1);
+    const auto channel =
+        robl::CreateTransportChannel(target, transport, grpc::InsecureChannelCredentials(), arguments);
+    const auto stub = TestService::NewStub(channel);
+
+    robl::coro::RunLoop loop;
+    auto run = BenchRun(loop, *stub, options);
+    run.window_start = Clock::now() + options.warmup;
+    run.window_end = run.window_start + options.duration;
+    loop.Run(RunWorkers(run, call, concurrency));
+
+    const auto seconds = static_cast<double>(options.duration.count());
+    const auto calls_per_second = run.completed / seconds;
+    const auto bytes_per_call = call == &UploadFile ? options.chunks * options.chunk_size : std::size_t(0);
+    const auto megabytes_per_second = calls_per_second * bytes_per_call / (1024.0 * 1024.0);
+
+    std::cout << std::left << std::setw(12) << scenario << std::setw(11) << robl::TransportName(transport)
+              << std::right << std::setw(8) << concurrency << std::fixed << std::setprecision(0) << std::setw(12)
+              << calls_per_second << std::setprecision(1) << std::setw(10) << megabytes_per_second << std::setw(10)
+              << run.latency_us.ValueAtPercentile(50.0) << std::setw(10) << run.latency_us.ValueAtPercentile(99.0)
+              << std::setw(8) << run.errors << std::endl;
+}
+
+void PrintUsage(const char *program)
+{
+    std::cerr << "usage: " << program << " [options]\n"
+              << "  --port P          port of the benchmark server on localhost (50071)\n"
+              << "  --concurrency N   calls in flight, repeatable (1 and 32)\n"
+              << "  --warmup S        seconds before recording starts (1)\n"
+              << "  --seconds S       seconds to record per run (3)\n"
+              << "  --chunks N        UploadFile: chunks per call (16)\n"
+              << "  --chunk-size B    UploadFile: bytes per chunk (65536)" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    auto options = BenchOptions();
+    auto concurrency = std::vector<int>();
+    for (auto i = 1; i < argc; ++i)
+    {
+        const auto arg = std::string(argv[i]);
+        const auto has_value = i + 1 < argc;
+        if (arg == "--port" && has_value)
+        {
+            options.port = std::atoi(argv[++i]);
+        }
+        else if (arg == "--concurrency" && has_value)
+        {
+            concurrency.push_back(std::atoi(argv[++i]));
+        }
+        else if (arg == "--warmup" && has_value)
+        {
+            options.warmup = std::chrono::seconds(std::atoi(argv[++i]));
+        }
+        else if (arg == "--seconds" && has_value)
+        {
+            options.duration = std::chrono::seconds(std::atoi(argv[++i]));
+        }
+        else if (arg == "--chunks" && has_value)
+        {
+            options.chunks = std::atoi(argv[++i]);
+        }
+        else if (arg == "--chunk-size" && has_value)
+        {
+            options.chunk_size = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else
+        {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (!concurrency.empty())
+    {
+        options.concurrency = concurrency;
+    }
+
+    // One server for all the transports, so they all reach the same service.
+    const auto target = "localhost:" + std::to_string(options.port);
+    BenchService service;
+    grpc::ServerBuilder builder;
+    const auto unix_path = robl::AddListeningPorts(builder, target, grpc::InsecureServerCredentials());
+    builder.RegisterService(&service);
+    builder.SetMaxReceiveMessageSize(-1);
+    const auto server = builder.BuildAndStart();
+    if (server == nullptr || unix_path.empty())
+    {
+        std::cerr << "Could not listen on " << target << " and its Unix domain socket" << std::endl;
+        return 1;
+    }
+    robl::LocalServers::Instance().Add(target, server.get());
+
+    std::cout << "Server on " << target << " and unix:" << unix_path << ", clients would pick "
+              << robl::TransportName(robl::PickTransport(target)) << std::endl
+              << std::left << std::setw(12) << "call" << std::setw(11) << "transport" << std::right << std::setw(8)
+              << "flight" << std::setw(12) << "calls/s" << std::setw(10) << "MB/s" << std::setw(10) << "p50 us"
+              << std::setw(10) << "p99 us" << std::setw(8) << "errors" << std::endl;
+
+    const auto scenarios = std::vector<std::pair<const char *, BenchCall>>{
+        { "SayHello", &SayHello },
+        { "UploadFile", &UploadFile },
+    };
+    const auto transports = { robl::Transport::Tcp, robl::Transport::UnixSocket, robl::Transport::InProcess };
+    for (const auto &[scenario, call] : scenarios)
+    {
+        for (const auto flight : options.concurrency)
+        {
+            for (const auto transport : transports)
+            {
+                Bench(options, target, scenario, call, transport, flight);
+            }
+        }
+    }
+
+    robl::LocalServers::Instance().Remove(target);
+    server->Shutdown();
+    return 0;
+}
+
+/*=========================================================================*/
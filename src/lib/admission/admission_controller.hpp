@@ -0,0 +1,369 @@
+#pragma once
+
+// standard headers
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+// grpc headers
+#include <grpcpp/server_context.h>
+#include <grpcpp/support/status.h>
+
+// project headers
+#include "admission/concurrency_limiter.hpp"
+
+/*=========================================================================*/
+
+namespace robl
+{
+
+/**
+ * @class AdmissionTicket
+ * @brief The outcome of admitting one call. An admitted ticket holds a slot of its method until it is released or
+ * destroyed, and the time it was held is fed back into the method's limit.
+ */
+class AdmissionTicket
+{
+public:
+    AdmissionTicket(void)
+        : limiter_(nullptr)
+        , admitted_(false)
+    {
+    }
+
+    AdmissionTicket(ConcurrencyLimiter *limiter, bool admitted)
+        : limiter_(limiter)
+        , admitted_(admitted)
+        , start_(ConcurrencyLimiter::Clock::now())
+    {
+    }
+
+    AdmissionTicket(AdmissionTicket &&other) noexcept
+        : limiter_(other.limiter_)
+        , admitted_(other.admitted_)
+        , start_(other.start_)
+    {
+        other.limiter_ = nullptr;
+    }
+
+    AdmissionTicket &operator=(AdmissionTicket &&other) noexcept
+    {
+        if (this != &other)
+        {
+            Release(false);
+            limiter_ = other.limiter_;
+            admitted_ = other.admitted_;
+            start_ = other.start_;
+            other.limiter_ = nullptr;
+        }
+        return *this;
+    }
+
+    ~AdmissionTicket()
+    {
+        Release(false);
+    }
+
+    bool Admitted(void) const
+    {
+        return admitted_;
+    }
+
+    /**
+     * Gives the slot back.
+     *
+     * @param dropped true if the call failed from overload, e.g. with a deadline exceeded.
+     */
+    void Release(bool dropped)
+    {
+        if (admitted_ && limiter_ != nullptr)
+        {
+            limiter_->OnComplete(ConcurrencyLimiter::Clock::now() - start_, dropped);
+        }
+        limiter_ = nullptr;
+    }
+
+    /**
+     * Builds the status a rejected call ends with. The retry hint is added to the trailing metadata as
+     * "retry-after-ms" and to the message.
+     */
+    grpc::Status Reject(grpc::ServerContextBase *context) const;
+
+private:
+    friend class AdmittedCalls;
+
+    ConcurrencyLimiter *limiter_; // nullptr for calls which are always admitted
+    bool admitted_;
+    ConcurrencyLimiter::Clock::time_point start_;
+};
+
+/**
+ * @class AdmittedCalls
+ * @brief The calls of a server between their arrival and their completion, with the ticket each one was admitted with.
+ *
+ * The AdmissionInterceptor adds every call as it arrives and removes it once the call is over. A ticket handed to a
+ * call is held until then rather than until the handler returns, and counts from the arrival, so the limit sees the
+ * calls whose reactors are still running as well as the time a call waited for a thread.
+ */
+class AdmittedCalls
+{
+public:
+    static AdmittedCalls &Instance(void)
+    {
+        static AdmittedCalls instance;
+        return instance;
+    }
+
+    /**
+     * Adds a call which just arrived.
+     *
+     * @param call The call, i.e. its server context.
+     */
+    void Arrive(const void *call);
+
+    /**
+     * Hands an admitted ticket to a call, which holds it from the call's arrival to its completion.
+     *
+     * @return true if the call is tracked and took the ticket, false if the ticket stays with the caller.
+     */
+    bool Hold(const void *call, AdmissionTicket *ticket);
+
+    /**
+     * Removes a call which is over and releases its ticket.
+     *
+     * @param dropped true if the call failed from overload, e.g. with a deadline exceeded.
+     */
+    void Complete(const void *call, bool dropped);
+
+private:
+    struct Call
+    {
+        ConcurrencyLimiter::Clock::time_point arrival;
+        AdmissionTicket ticket;
+    };
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<const void *, Call> calls;
+    };
+
+    Shard &ShardOf(const void *call)
+    {
+        // Contexts are at least cache line aligned allocations, so the low bits say nothing.
+        return shards_[(reinterpret_cast<std::uintptr_t>(call) >> 6) % shards_.size()];
+    }
+
+    std::array<Shard, 16> shards_;
+};
+
+/**
+ * @class AdmissionController
+ * @brief Keeps one concurrency limiter per method and rejects calls over the limit before any work is done.
+ *
+ * Methods which keep the server reachable, like heartbeats and authentication, are always admitted, so an overloaded
+ * server still looks alive and clients can still log in to back off.
+ */
+class AdmissionController
+{
+public:
+    struct Options
+    {
+        // The limits of methods without their own entry.
+        ConcurrencyLimiter::Options default_limits;
+        std::unordered_map<std::string, ConcurrencyLimiter::Options> method_limits;
+        std::unordered_set<std::string> always_admitted = { "HeartBeat", "Heartbeat", "Login", "Logout",
+                                                            "RegisterAccount" };
+    };
+
+    explicit AdmissionController(const Options &options)
+        : options_(options)
+        , rejected_(0)
+    {
+    }
+
+    /**
+     * Returns the limits of a method with a fixed number of calls in flight, e.g. for long-lived streams whose
+     * duration says nothing about the load of the server.
+     */
+    static ConcurrencyLimiter::Options FixedLimit(int limit, ConcurrencyLimiter::Clock::duration retry_after);
+
+    /**
+     * Admits a call of a method if the method is under its limit.
+     *
+     * @param method The method name, e.g. "SayHello".
+     * @return The ticket of the call. A rejected call should end with ticket.Reject(context).
+     */
+    AdmissionTicket Admit(const std::string &method);
+
+    /**
+     * Admits a call like Admit(method), and hands an admitted ticket to the call when the server runs an
+     * AdmissionInterceptor, so the slot is held until the call completes instead of until the returned ticket goes
+     * away. Unary handlers which finish through a reactor should use this one.
+     *
+     * @param method The method name, e.g. "SayHello".
+     * @param context The context of the call.
+     * @return The ticket of the call. A rejected call should end with ticket.Reject(context).
+     */
+    AdmissionTicket Admit(const std::string &method, grpc::ServerContextBase *context);
+
+    std::uint64_t RejectedCount(void) const
+    {
+        return rejected_.load(std::memory_order_relaxed);
+    }
+
+private:
+    ConcurrencyLimiter *LimiterOf(const std::string &method);
+
+    const Options options_;
+    std::shared_mutex mutex_;
+    std::unordered_map<std::string, std::unique_ptr<ConcurrencyLimiter>> limiters_;
+    std::atomic<std::uint64_t> rejected_;
+};
+
+/**
+ * @class RejectedReactor
+ * @brief A callback reactor which ends its call right away, for streams rejected before they start.
+ *
+ * @tparam Reactor The reactor type of the method, e.g. grpc::ServerBidiReactor<Request, Response>.
+ */
+template <typename Reactor>
+class RejectedReactor final : public Reactor
+{
+public:
+    explicit RejectedReactor(const grpc::Status &status)
+    {
+        this->Finish(status);
+    }
+
+    void OnDone(void) override
+    {
+        delete this;
+    }
+};
+
+/*=========================================================================*/
+
+inline void AdmittedCalls::Arrive(const void *call)
+{
+    auto &shard = ShardOf(call);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.calls[call].arrival = ConcurrencyLimiter::Clock::now();
+}
+
+inline bool AdmittedCalls::Hold(const void *call, AdmissionTicket *ticket)
+{
+    auto &shard = ShardOf(call);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    const auto it = shard.calls.find(call);
+    if (it == shard.calls.end())
+    {
+        return false;
+    }
+
+    // The moved-from ticket stays admitted but has nothing left to release.
+    ticket->start_ = it->second.arrival;
+    it->second.ticket = std::move(*ticket);
+    return true;
+}
+
+inline void AdmittedCalls::Complete(const void *call, bool dropped)
+{
+    auto ticket = AdmissionTicket();
+    {
+        auto &shard = ShardOf(call);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        const auto it = shard.calls.find(call);
+        if (it == shard.calls.end())
+        {
+            return;
+        }
+        ticket = std::move(it->second.ticket);
+        shard.calls.erase(it);
+    }
+
+    // Outside of the shard, as the limiter takes its own lock.
+    ticket.Release(dropped);
+}
+
+inline grpc::Status AdmissionTicket::Reject(grpc::ServerContextBase *context) const
+{
+    const auto retry_after = limiter_ != nullptr ? limiter_->RetryAfter() : std::chrono::milliseconds(5);
+    const auto retry_after_ms = std::chrono::ceil<std::chrono::milliseconds>(retry_after).count();
+
+    context->AddTrailingMetadata("retry-after-ms", std::to_string(retry_after_ms));
+    return grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED,
+                        "server overloaded, retry after " + std::to_string(retry_after_ms) + " ms");
+}
+
+inline ConcurrencyLimiter::Options AdmissionController::FixedLimit(int limit,
+                                                                   ConcurrencyLimiter::Clock::duration retry_after)
+{
+    auto options = ConcurrencyLimiter::Options();
+    options.algorithm = LimitAlgorithm::Fixed;
+    options.initial_limit = limit;
+    options.min_limit = limit;
+    options.max_limit = limit;
+    options.min_retry_after = retry_after;
+    return options;
+}
+
+inline AdmissionTicket AdmissionController::Admit(const std::string &method)
+{
+    if (options_.always_admitted.count(method) > 0)
+    {
+        return AdmissionTicket(nullptr, true);
+    }
+
+    auto *limiter = LimiterOf(method);
+    if (limiter->TryAcquire())
+    {
+        return AdmissionTicket(limiter, true);
+    }
+
+    rejected_.fetch_add(1, std::memory_order_relaxed);
+    return AdmissionTicket(limiter, false);
+}
+
+inline AdmissionTicket AdmissionController::Admit(const std::string &method, grpc::ServerContextBase *context)
+{
+    auto ticket = Admit(method);
+    if (ticket.Admitted())
+    {
+        AdmittedCalls::Instance().Hold(context, &ticket);
+    }
+    return ticket;
+}
+
+inline ConcurrencyLimiter *AdmissionController::LimiterOf(const std::string &method)
+{
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        const auto it = limiters_.find(method);
+        if (it != limiters_.end())
+        {
+            return it->second.get();
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto &limiter = limiters_[method];
+    if (!limiter)
+    {
+        const auto limits = options_.method_limits.find(method);
+        limiter = std::make_unique<ConcurrencyLimiter>(limits != options_.method_limits.end() ? limits->second
+                                                                                            : options_.default_limits);
+    }
+    return limiter.get();
+}
+
+} // namespace robl
+
+/*=========================================================================*/
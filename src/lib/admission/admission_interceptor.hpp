@@ -0,0 +1,70 @@
+#pragma once
+
+// grpc headers
+#include <grpcpp/support/interceptor.h>
+#include <grpcpp/support/server_interceptor.h>
+
+// project headers
+#include "admission/admission_controller.hpp"
+
+/*=========================================================================*/
+
+namespace robl
+{
+
+/**
+ * @class AdmissionInterceptor
+ * @brief Tracks one call of a server in AdmittedCalls from its arrival until the call is torn down, which releases
+ * the ticket the handler admitted it with.
+ *
+ * A call torn down before its status went through the interceptor, or which ended with a deadline exceeded or a
+ * cancellation, counts as dropped.
+ */
+class AdmissionInterceptor final : public grpc::experimental::Interceptor
+{
+public:
+    explicit AdmissionInterceptor(const void *call)
+        : call_(call)
+        , dropped_(true)
+    {
+        AdmittedCalls::Instance().Arrive(call_);
+    }
+
+    ~AdmissionInterceptor() override
+    {
+        AdmittedCalls::Instance().Complete(call_, dropped_);
+    }
+
+    void Intercept(grpc::experimental::InterceptorBatchMethods *methods) override
+    {
+        if (methods->QueryInterceptionHookPoint(grpc::experimental::InterceptionHookPoints::PRE_SEND_STATUS))
+        {
+            const auto code = methods->GetSendStatus().error_code();
+            dropped_ = code == grpc::StatusCode::DEADLINE_EXCEEDED || code == grpc::StatusCode::CANCELLED;
+        }
+        methods->Proceed();
+    }
+
+private:
+    const void *const call_;
+    bool dropped_;
+};
+
+/**
+ * @class AdmissionServerInterceptorFactory
+ * @brief Adds an AdmissionInterceptor to every call of a server, so AdmissionController::Admit(method, context) can
+ * hold the slot of a call until the call completes. Put it first, so the arrival is stamped before other interceptors
+ * run.
+ */
+class AdmissionServerInterceptorFactory final : public grpc::experimental::ServerInterceptorFactoryInterface
+{
+public:
+    grpc::experimental::Interceptor *CreateServerInterceptor(grpc::experimental::ServerRpcInfo *info) override
+    {
+        return new AdmissionInterceptor(info->server_context());
+    }
+};
+
+} // namespace robl
+
+/*=========================================================================*/
@@ -0,0 +1,212 @@
+#pragma once
+
+// standard headers
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+
+/*=========================================================================*/
+
+namespace robl
+{
+
+/**
+ * How a ConcurrencyLimiter adapts its limit to the measured latency.
+ */
+enum class LimitAlgorithm
+{
+    Fixed,    // keep the initial limit, e.g. for long-lived streams
+    Aimd,     // grow by one per limit's worth of fast calls, shrink by a factor on slow or dropped calls
+    Gradient, // follow the ratio between the unloaded and the recent latency
+};
+
+/**
+ * @class ConcurrencyLimiter
+ * @brief Caps the number of calls in flight and adapts the cap to the latency of the calls.
+ *
+ * Admission is a single atomic increment, so rejected calls cost next to nothing. The limit is only recomputed when a
+ * call completes. With the gradient rule, the limit shrinks as soon as the recent latency rises above the unloaded
+ * one, i.e. when calls start to queue, and grows by about the square root of the limit while the latency is flat.
+ */
+class ConcurrencyLimiter
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Options
+    {
+        LimitAlgorithm algorithm = LimitAlgorithm::Gradient;
+        int initial_limit = 32;
+        int min_limit = 4;
+        int max_limit = 1024;
+        // Gradient: how much the recent latency may exceed the unloaded one before the limit shrinks.
+        double tolerance = 1.5;
+        // Gradient: the weight of a new limit estimate, per round trip.
+        double smoothing = 0.2;
+        // Aimd: the factor the limit is multiplied with on a slow or dropped call.
+        double backoff = 0.9;
+        // Aimd: a call slower than this counts as a drop.
+        Clock::duration latency_threshold = std::chrono::milliseconds(100);
+        // The shortest retry hint handed to rejected callers.
+        Clock::duration min_retry_after = std::chrono::milliseconds(5);
+    };
+
+    explicit ConcurrencyLimiter(const Options &options);
+
+    /**
+     * Admits a call if fewer calls than the limit are in flight. Every admitted call must be completed with
+     * OnComplete().
+     *
+     * @return true if the call is admitted, false otherwise.
+     */
+    bool TryAcquire(void);
+
+    /**
+     * Completes an admitted call and feeds its latency into the limit.
+     *
+     * @param latency The time from admission to completion.
+     * @param dropped true if the call failed from overload, e.g. with a deadline exceeded.
+     */
+    void OnComplete(Clock::duration latency, bool dropped);
+
+    int Limit(void) const;
+    int InFlight(void) const;
+
+    /**
+     * Returns how long a rejected caller should wait, about the time a slot takes to free up.
+     */
+    Clock::duration RetryAfter(void) const;
+
+private:
+    void UpdateGradient(int in_flight);
+    void UpdateAimd(double rtt, bool dropped, int in_flight);
+
+    const Options options_;
+    std::atomic<int> limit_;
+    std::atomic<int> in_flight_;
+
+    mutable std::mutex mutex_;
+    double estimated_limit_;
+    double short_rtt_;    // seconds, averaged over about 10 calls
+    double baseline_rtt_; // seconds, the latency without queueing
+};
+
+/*=========================================================================*/
+
+inline ConcurrencyLimiter::ConcurrencyLimiter(const Options &options)
+    : options_(options)
+    , limit_(options.initial_limit)
+    , in_flight_(0)
+    , estimated_limit_(options.initial_limit)
+    , short_rtt_(0.0)
+    , baseline_rtt_(0.0)
+{
+}
+
+inline bool ConcurrencyLimiter::TryAcquire(void)
+{
+    if (in_flight_.fetch_add(1, std::memory_order_relaxed) < limit_.load(std::memory_order_relaxed))
+    {
+        return true;
+    }
+
+    in_flight_.fetch_sub(1, std::memory_order_relaxed);
+    return false;
+}
+
+inline void ConcurrencyLimiter::OnComplete(Clock::duration latency, bool dropped)
+{
+    const auto in_flight = in_flight_.fetch_sub(1, std::memory_order_relaxed);
+    const auto rtt = std::chrono::duration<double>(latency).count();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (baseline_rtt_ == 0.0)
+    {
+        short_rtt_ = rtt;
+        baseline_rtt_ = rtt;
+    }
+    else
+    {
+        // The baseline follows the recent latency down right away, but not a single lucky call, which would make every
+        // ordinary call look queued. It only accepts that the method became slower while the limit is not what keeps
+        // the latency up, i.e. with few calls in flight or with the limit at its floor, so a sustained overload does
+        // not pass for the new normal.
+        short_rtt_ += (rtt - short_rtt_) / 10.0;
+        if (in_flight < estimated_limit_ / 2.0 || estimated_limit_ <= options_.min_limit)
+        {
+            baseline_rtt_ += (short_rtt_ - baseline_rtt_) / 2000.0;
+        }
+        baseline_rtt_ = std::min(baseline_rtt_, short_rtt_);
+    }
+
+    switch (options_.algorithm)
+    {
+    case LimitAlgorithm::Gradient:
+        UpdateGradient(in_flight);
+        break;
+    case LimitAlgorithm::Aimd:
+        UpdateAimd(rtt, dropped, in_flight);
+        break;
+    case LimitAlgorithm::Fixed:
+        return;
+    }
+
+    const auto limit = std::clamp(static_cast<int>(estimated_limit_), options_.min_limit, options_.max_limit);
+    limit_.store(limit, std::memory_order_relaxed);
+}
+
+inline void ConcurrencyLimiter::UpdateGradient(int in_flight)
+{
+    // Every call moves the limit by a share of the smoothing, so it moves by about the smoothing once per round trip
+    // no matter how many calls are in flight.
+    const auto gradient = std::clamp(options_.tolerance * baseline_rtt_ / short_rtt_, 0.5, 1.0);
+    const auto queue_size = std::sqrt(estimated_limit_);
+    const auto new_limit = estimated_limit_ * gradient + queue_size;
+
+    // A limit which is not used says nothing about whether a higher one would be safe, but a rising latency says the
+    // current one is too high however much of it is used.
+    if (new_limit > estimated_limit_ && in_flight < estimated_limit_ / 2.0)
+    {
+        return;
+    }
+
+    const auto weight = options_.smoothing / estimated_limit_;
+    estimated_limit_ = std::clamp(estimated_limit_ * (1.0 - weight) + new_limit * weight,
+                                  static_cast<double>(options_.min_limit), static_cast<double>(options_.max_limit));
+}
+
+inline void ConcurrencyLimiter::UpdateAimd(double rtt, bool dropped, int in_flight)
+{
+    const auto threshold = std::chrono::duration<double>(options_.latency_threshold).count();
+    if (dropped || rtt > threshold)
+    {
+        estimated_limit_ = std::max(estimated_limit_ * options_.backoff, static_cast<double>(options_.min_limit));
+    }
+    else if (in_flight >= estimated_limit_ / 2.0)
+    {
+        estimated_limit_ = std::min(estimated_limit_ + 1.0 / estimated_limit_, static_cast<double>(options_.max_limit));
+    }
+}
+
+inline int ConcurrencyLimiter::Limit(void) const
+{
+    return limit_.load(std::memory_order_relaxed);
+}
+
+inline int ConcurrencyLimiter::InFlight(void) const
+{
+    return in_flight_.load(std::memory_order_relaxed);
+}
+
+inline ConcurrencyLimiter::Clock::duration ConcurrencyLimiter::RetryAfter(void) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto rtt = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(short_rtt_));
+    return std::max(options_.min_retry_after, rtt);
+}
+
+} // namespace robl
+
+/*=========================================================================*/
@@ -0,0 +1,242 @@
+#pragma once
+
+// standard headers
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// grpc headers
+#include <google/protobuf/arena.h>
+#include <grpcpp/support/message_allocator.h>
+
+/*=========================================================================*/
+
+namespace robl
+{
+
+/**
+ * @class ArenaMessageAllocator
+ * @brief A grpc::MessageAllocator which places the request and the response of every call on a recycled arena.
+ *
+ * Each holder owns an arena together with a user-owned initial block, so Arena::Reset() keeps that block and a call
+ * whose messages fit in it does not touch the heap at all. Released holders are kept in per-thread-group free lists,
+ * which keeps the allocator off the global malloc lock and away from a single contended mutex.
+ *
+ * The initial block size follows the observed arena usage of the method. Holders whose block is no longer a good fit
+ * are dropped on release and replaced by holders of the tuned size.
+ *
+ * Register it with the generated SetMessageAllocatorFor_<Method>() before the server is started. The allocator must
+ * outlive the server.
+ */
+template <typename RequestT, typename ResponseT>
+class ArenaMessageAllocator final : public grpc::MessageAllocator<RequestT, ResponseT>
+{
+public:
+    struct Stats
+    {
+        std::uint64_t allocations; // AllocateMessages() calls
+        std::uint64_t arenas_created; // holders which had to be created from scratch
+        std::size_t block_size; // currently tuned initial block size
+    };
+
+    /**
+     * @param min_block_size The smallest initial block handed out.
+     * @param max_block_size The largest initial block handed out. Larger calls spill into heap blocks.
+     * @param max_idle_per_shard The maximum number of idle holders kept in each free list.
+     */
+    explicit ArenaMessageAllocator(std::size_t min_block_size = 1024, std::size_t max_block_size = 1024 * 1024,
+                                   std::size_t max_idle_per_shard = 64);
+    ~ArenaMessageAllocator() override = default;
+
+    grpc::MessageHolder<RequestT, ResponseT> *AllocateMessages() override;
+
+    /**
+     * Returns a snapshot of the allocator counters.
+     */
+    Stats GetStats(void) const;
+
+private:
+    class Holder final : public grpc::MessageHolder<RequestT, ResponseT>
+    {
+    public:
+        Holder(ArenaMessageAllocator *owner, std::size_t block_size)
+            : owner_(owner)
+            , block_size_(block_size)
+            , block_(new char[block_size])
+            , arena_(MakeOptions(block_.get(), block_size))
+        {
+        }
+
+        void Prepare(void)
+        {
+            this->set_request(google::protobuf::Arena::CreateMessage<RequestT>(&arena_));
+            this->set_response(google::protobuf::Arena::CreateMessage<ResponseT>(&arena_));
+        }
+
+        void Release(void) override
+        {
+            owner_->Recycle(this);
+        }
+
+        std::size_t BlockSize(void) const
+        {
+            return block_size_;
+        }
+
+        google::protobuf::Arena &GetArena(void)
+        {
+            return arena_;
+        }
+
+    private:
+        static google::protobuf::ArenaOptions MakeOptions(char *block, std::size_t block_size)
+        {
+            auto options = google::protobuf::ArenaOptions();
+            options.initial_block = block;
+            options.initial_block_size = block_size;
+            options.start_block_size = block_size;
+            return options;
+        }
+
+        ArenaMessageAllocator *owner_;
+        std::size_t block_size_;
+        std::unique_ptr<char[]> block_;
+        google::protobuf::Arena arena_;
+    };
+
+    struct alignas(64) Shard
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Holder>> idle;
+    };
+
+    Shard &LocalShard(void);
+    void Recycle(Holder *holder);
+    void Observe(std::uint64_t space_used);
+
+    std::size_t min_block_size_;
+    std::size_t max_block_size_;
+    std::size_t max_idle_per_shard_;
+    std::vector<Shard> shards_;
+
+    std::atomic<std::size_t> block_size_;
+    std::atomic<std::uint64_t> average_used_; // exponential moving average of the arena usage, in bytes
+    std::atomic<std::uint64_t> allocations_;
+    std::atomic<std::uint64_t> arenas_created_;
+};
+
+/*=========================================================================*/
+
+template <typename RequestT, typename ResponseT>
+ArenaMessageAllocator<RequestT, ResponseT>::ArenaMessageAllocator(std::size_t min_block_size,
+                                                                  std::size_t max_block_size,
+                                                                  std::size_t max_idle_per_shard)
+    : min_block_size_(min_block_size)
+    , max_block_size_(std::max(min_block_size, max_block_size))
+    , max_idle_per_shard_(max_idle_per_shard)
+    , shards_(std::max(1U, std::thread::hardware_concurrency()))
+    , block_size_(min_block_size)
+    , average_used_(0)
+    , allocations_(0)
+    , arenas_created_(0)
+{
+}
+
+template <typename RequestT, typename ResponseT>
+grpc::MessageHolder<RequestT, ResponseT> *ArenaMessageAllocator<RequestT, ResponseT>::AllocateMessages()
+{
+    allocations_.fetch_add(1, std::memory_order_relaxed);
+
+    auto holder = std::unique_ptr<Holder>();
+    auto &shard = LocalShard();
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (!shard.idle.empty())
+        {
+            holder = std::move(shard.idle.back());
+            shard.idle.pop_back();
+        }
+    }
+
+    if (!holder)
+    {
+        arenas_created_.fetch_add(1, std::memory_order_relaxed);
+        holder = std::make_unique<Holder>(this, block_size_.load(std::memory_order_relaxed));
+    }
+
+    holder->Prepare();
+    return holder.release();
+}
+
+template <typename RequestT, typename ResponseT>
+typename ArenaMessageAllocator<RequestT, ResponseT>::Stats ArenaMessageAllocator<RequestT, ResponseT>::GetStats(
+    void) const
+{
+    return Stats{ allocations_.load(std::memory_order_relaxed), arenas_created_.load(std::memory_order_relaxed),
+                  block_size_.load(std::memory_order_relaxed) };
+}
+
+template <typename RequestT, typename ResponseT>
+typename ArenaMessageAllocator<RequestT, ResponseT>::Shard &ArenaMessageAllocator<RequestT, ResponseT>::LocalShard(void)
+{
+    // Threads are spread over the shards once, so a gRPC thread keeps hitting the same free list.
+    static std::atomic<std::size_t> next_thread(0);
+    thread_local const auto thread_index = next_thread.fetch_add(1, std::memory_order_relaxed);
+
+    return shards_[thread_index % shards_.size()];
+}
+
+template <typename RequestT, typename ResponseT>
+void ArenaMessageAllocator<RequestT, ResponseT>::Recycle(Holder *holder)
+{
+    auto owned = std::unique_ptr<Holder>(holder);
+
+    Observe(owned->GetArena().SpaceUsed());
+    owned->GetArena().Reset();
+
+    // A block far away from the tuned size either wastes memory or keeps spilling into the heap.
+    const auto block_size = block_size_.load(std::memory_order_relaxed);
+    if (owned->BlockSize() != block_size)
+    {
+        return;
+    }
+
+    auto &shard = LocalShard();
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.idle.size() < max_idle_per_shard_)
+    {
+        shard.idle.push_back(std::move(owned));
+    }
+}
+
+template <typename RequestT, typename ResponseT>
+void ArenaMessageAllocator<RequestT, ResponseT>::Observe(std::uint64_t space_used)
+{
+    // average += (used - average) / 16. Lost updates between racing threads only slow down the adaptation.
+    const auto average = average_used_.load(std::memory_order_relaxed);
+    const auto updated = average + (static_cast<std::int64_t>(space_used) - static_cast<std::int64_t>(average)) / 16;
+    average_used_.store(updated, std::memory_order_relaxed);
+
+    // Leave twice the average as headroom and round up to a power of two, so the size does not flap.
+    auto target = min_block_size_;
+    while (target < 2 * updated && target < max_block_size_)
+    {
+        target *= 2;
+    }
+    target = std::min(target, max_block_size_);
+
+    // Shrink only when the block is four times too large, grow as soon as it is too small.
+    const auto current = block_size_.load(std::memory_order_relaxed);
+    if (target > current || target * 4 <= current)
+    {
+        block_size_.store(target, std::memory_order_relaxed);
+    }
+}
+
+} // namespace robl
+
+/*=========================================================================*/
@@ -0,0 +1,321 @@
+#pragma once
+
+// standard headers
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// grpc headers
+#include <grpcpp/channel.h>
+#include <grpcpp/create_channel.h>
+#include <grpcpp/security/credentials.h>
+#include <grpcpp/support/channel_arguments.h>
+
+// project headers
+#include "channel/local_transport.hpp"
+
+/*=========================================================================*/
+
+namespace robl
+{
+
+/**
+ * @class ChannelPool
+ * @brief Spreads the calls of a client over several connections to the same server.
+ *
+ * A single channel multiplexes every call onto one HTTP/2 connection, which is bound by the transport work one core
+ * can do and by the server's limit of concurrent streams. The pool opens K channels with their own subchannels, and
+ * every call leases the one with the fewest calls in flight. Channels which fail are only picked when all of them do.
+ * A thread of the pool checks the state of every channel periodically, so a failing channel is picked again once it
+ * is READY, and one which stays in TRANSIENT_FAILURE is replaced with a fresh one, which connects right away instead
+ * of waiting out the backoff of the old one. Every channel goes over the cheapest transport to the target,
+ * see PickTransport().
+ *
+ * Acquire() is thread-safe and takes no lock. A lease must be kept for as long as its call runs, including a
+ * stream's reads and writes, and must not outlive the pool.
+ */
+template <typename Service>
+class ChannelPool
+{
+public:
+    using Stub = typename Service::Stub;
+    using Clock = std::chrono::steady_clock;
+
+    struct Options
+    {
+        int size = 4;
+        grpc::ChannelArguments arguments;
+        // How long a channel may stay in TRANSIENT_FAILURE before it is replaced.
+        Clock::duration replace_after = std::chrono::seconds(1);
+        // How often the state of the channels is checked.
+        Clock::duration check_interval = std::chrono::milliseconds(100);
+    };
+
+    /**
+     * @class Lease
+     * @brief A stub of one of the pool's channels, counted as busy until the lease is destroyed.
+     */
+    class Lease
+    {
+    public:
+        Lease(Lease &&other) noexcept
+            : outstanding_(std::exchange(other.outstanding_, nullptr))
+            , connection_(std::move(other.connection_))
+            , index_(other.index_)
+        {
+        }
+
+        Lease(const Lease &) = delete;
+        Lease &operator=(const Lease &) = delete;
+        Lease &operator=(Lease &&) = delete;
+
+        ~Lease()
+        {
+            if (outstanding_ != nullptr)
+            {
+                outstanding_->fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+
+        Stub *operator->(void) const
+        {
+            return connection_->stub.get();
+        }
+
+        Stub &operator*(void) const
+        {
+            return *connection_->stub;
+        }
+
+        int Index(void) const
+        {
+            return index_;
+        }
+
+    private:
+        friend class ChannelPool;
+
+        Lease(std::atomic<int> *outstanding, std::shared_ptr<const typename ChannelPool::Connection> connection,
+              int index)
+            : outstanding_(outstanding)
+            , connection_(std::move(connection))
+            , index_(index)
+        {
+        }
+
+        std::atomic<int> *outstanding_;
+        std::shared_ptr<const typename ChannelPool::Connection> connection_;
+        int index_;
+    };
+
+    ChannelPool(const std::string &target, std::shared_ptr<grpc::ChannelCredentials> credentials,
+                const Options &options);
+    ~ChannelPool();
+
+    ChannelPool(const ChannelPool &) = delete;
+    ChannelPool &operator=(const ChannelPool &) = delete;
+
+    /**
+     * Leases the channel with the fewest calls in flight. Ties go round-robin.
+     */
+    Lease Acquire(void);
+
+    int Size(void) const
+    {
+        return static_cast<int>(slots_.size());
+    }
+
+    int Outstanding(int index) const
+    {
+        return slots_[index]->outstanding.load(std::memory_order_relaxed);
+    }
+
+    std::uint64_t Replacements(void) const
+    {
+        return replacements_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Connection
+    {
+        std::shared_ptr<grpc::Channel> channel;
+        std::unique_ptr<Stub> stub;
+    };
+
+    struct Slot
+    {
+        std::atomic<int> outstanding;
+        std::atomic_bool failing;
+        // Loaded and stored atomically. Leases keep a replaced connection alive until their calls end.
+        std::shared_ptr<const Connection> connection;
+        // Only used by the checker.
+        Clock::time_point failing_since;
+        int generation;
+    };
+
+    std::shared_ptr<const Connection> Connect(int index, int generation) const;
+    void Check(int index);
+    void RunChecker(void);
+
+    const std::string target_;
+    const std::shared_ptr<grpc::ChannelCredentials> credentials_;
+    const Options options_;
+    std::vector<std::unique_ptr<Slot>> slots_;
+    std::atomic<unsigned> next_;
+    std::atomic<std::uint64_t> replacements_;
+
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    bool stopping_;
+    std::thread checker_;
+};
+
+/*=========================================================================*/
+
+template <typename Service>
+ChannelPool<Service>::ChannelPool(const std::string &target, std::shared_ptr<grpc::ChannelCredentials> credentials,
+                                  const Options &options)
+    : target_(target)
+    , credentials_(std::move(credentials))
+    , options_(options)
+    , next_(0)
+    , replacements_(0)
+    , stopping_(false)
+{
+    for (auto i = 0; i < std::max(options.size, 1); ++i)
+    {
+        auto slot = std::make_unique<Slot>();
+        slot->outstanding = 0;
+        slot->failing = false;
+        slot->connection = Connect(i, 0);
+        slot->generation = 0;
+        slots_.push_back(std::move(slot));
+    }
+
+    checker_ = std::thread(&ChannelPool::RunChecker, this);
+}
+
+template <typename Service>
+ChannelPool<Service>::~ChannelPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wakeup_.notify_one();
+    checker_.join();
+}
+
+template <typename Service>
+typename ChannelPool<Service>::Lease ChannelPool<Service>::Acquire(void)
+{
+    // A failing channel weighs as if it were full, so it only gets calls when every channel fails.
+    const auto load = [this](std::size_t index) {
+        const auto &slot = *slots_[index];
+        const auto outstanding = slot.outstanding.load(std::memory_order_relaxed);
+        return slot.failing.load(std::memory_order_relaxed) ? outstanding + (std::numeric_limits<int>::max() / 2)
+                                                             : outstanding;
+    };
+
+    const auto start = next_.fetch_add(1, std::memory_order_relaxed) % slots_.size();
+    auto best = start;
+    auto best_load = load(start);
+    for (auto i = std::size_t(1); i < slots_.size() && best_load > 0; ++i)
+    {
+        const auto index = (start + i) % slots_.size();
+        const auto index_load = load(index);
+        if (index_load < best_load)
+        {
+            best = index;
+            best_load = index_load;
+        }
+    }
+
+    auto &slot = *slots_[best];
+    slot.outstanding.fetch_add(1, std::memory_order_relaxed);
+    return Lease(&slot.outstanding, std::atomic_load(&slot.connection), static_cast<int>(best));
+}
+
+template <typename Service>
+std::shared_ptr<const typename ChannelPool<Service>::Connection> ChannelPool<Service>::Connect(int index,
+                                                                                              int generation) const
+{
+    // Distinct arguments and a subchannel pool of its own keep the channels from sharing a connection, also with a
+    // replaced channel which is still shutting down.
+    auto arguments = options_.arguments;
+    arguments.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+    arguments.SetInt("robl.channel_pool_index", index);
+    arguments.SetInt("robl.channel_pool_generation", generation);
+
+    auto connection = std::make_shared<Connection>();
+    connection->channel = CreateLocalChannel(target_, credentials_, arguments);
+    connection->stub = Service::NewStub(connection->channel);
+    return connection;
+}
+
+template <typename Service>
+void ChannelPool<Service>::Check(int index)
+{
+    auto &slot = *slots_[index];
+    const auto current = std::atomic_load(&slot.connection);
+    const auto state = current->channel->GetState(false);
+    if (state == GRPC_CHANNEL_READY)
+    {
+        slot.failing = false;
+        return;
+    }
+    if (state != GRPC_CHANNEL_TRANSIENT_FAILURE && state != GRPC_CHANNEL_SHUTDOWN)
+    {
+        // An idle or connecting channel keeps the slot as it is: a failing slot recovers only once its channel has
+        // connected, which an idle one is asked to do.
+        if (slot.failing && state == GRPC_CHANNEL_IDLE)
+        {
+            current->channel->GetState(true);
+        }
+        return;
+    }
+
+    const auto now = Clock::now();
+    if (!slot.failing)
+    {
+        slot.failing = true;
+        slot.failing_since = now;
+    }
+    if (state == GRPC_CHANNEL_SHUTDOWN || now - slot.failing_since >= options_.replace_after)
+    {
+        // The slot stays failing until a later check finds the fresh channel READY.
+        auto connection = Connect(index, ++slot.generation);
+        connection->channel->GetState(true);
+        std::atomic_store(&slot.connection, std::move(connection));
+        slot.failing_since = now;
+        replacements_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+template <typename Service>
+void ChannelPool<Service>::RunChecker(void)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!wakeup_.wait_for(lock, options_.check_interval, [this] { return stopping_; }))
+    {
+        lock.unlock();
+        for (auto i = 0; i < Size(); ++i)
+        {
+            Check(i);
+        }
+        lock.lock();
+    }
+}
+
+} // namespace robl
+
+/*=========================================================================*/
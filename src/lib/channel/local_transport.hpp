@@ -0,0 +1,261 @@
+#pragma once
+
+// standard headers
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// grpc headers
+#include <grpcpp/channel.h>
+#include <grpcpp/create_channel.h>
+#include <grpcpp/security/credentials.h>
+#include <grpcpp/security/server_credentials.h>
+#include <grpcpp/server.h>
+#include <grpcpp/server_builder.h>
+#include <grpcpp/support/channel_arguments.h>
+
+/*=========================================================================*/
+
+namespace robl
+{
+
+enum class Transport
+{
+    Tcp,        // over the loopback interface or the network
+    UnixSocket, // over the Unix domain socket of a server on the same machine, without the TCP stack
+    InProcess,  // straight into a server of the same process, without a socket or HTTP/2 framing
+};
+
+const char *TransportName(Transport transport);
+
+/**
+ * @class LocalServers
+ * @brief The servers of this process by the address they listen on, so that clients linked into the same binary can
+ * call them in-process.
+ *
+ * A server is removed before it shuts down. In-process channels must not outlive their server.
+ */
+class LocalServers
+{
+public:
+    static LocalServers &Instance(void)
+    {
+        static LocalServers instance;
+        return instance;
+    }
+
+    void Add(const std::string &address, grpc::Server *server);
+    void Remove(const std::string &address);
+    bool Contains(const std::string &address) const;
+
+    /**
+     * An in-process channel to the server listening on the address, or null if there is none.
+     */
+    std::shared_ptr<grpc::Channel> Connect(const std::string &address, const grpc::ChannelArguments &arguments);
+
+private:
+    LocalServers(void) = default;
+
+    mutable std::mutex mutex_;
+    std::map<std::string, grpc::Server *> servers_;
+};
+
+/**
+ * The Unix domain socket which a server listening on the TCP address also listens on: $ROBL_UNIX_SOCKET if it is set,
+ * where an empty value turns the socket off, or else /tmp/robl-<port>.sock.
+ */
+std::string UnixSocketPath(const std::string &address);
+
+/**
+ * Listens on the address over TCP and on its Unix domain socket, both with the same credentials. Returns the path of
+ * the socket, or an empty string if it is turned off.
+ */
+std::string AddListeningPorts(grpc::ServerBuilder &builder, const std::string &address,
+                              const std::shared_ptr<grpc::ServerCredentials> &credentials);
+
+/**
+ * The cheapest way to reach the target: in-process if a server of this process listens on it, over its Unix domain
+ * socket if the target is on the loopback interface and the socket accepts connections, and over TCP otherwise.
+ * Targets with a scheme, such as unix:/path or dns:///host:port, always go over TCP, i.e. as they are.
+ */
+Transport PickTransport(const std::string &target);
+
+/**
+ * Creates a channel to the target over the given transport. An in-process channel falls back to TCP if the server
+ * went away meanwhile. Over the Unix domain socket, TLS still checks the certificate against the target's host.
+ */
+std::shared_ptr<grpc::Channel> CreateTransportChannel(const std::string &target, Transport transport,
+                                                      const std::shared_ptr<grpc::ChannelCredentials> &credentials,
+                                                      const grpc::ChannelArguments &arguments);
+
+inline std::shared_ptr<grpc::Channel> CreateLocalChannel(const std::string &target,
+                                                         const std::shared_ptr<grpc::ChannelCredentials> &credentials,
+                                                         const grpc::ChannelArguments &arguments)
+{
+    return CreateTransportChannel(target, PickTransport(target), credentials, arguments);
+}
+
+/*=========================================================================*/
+
+namespace detail
+{
+
+inline bool HasScheme(const std::string &target)
+{
+    for (const auto *scheme : { "unix:", "unix-abstract:", "dns:", "ipv4:", "ipv6:", "xds:" })
+    {
+        if (target.rfind(scheme, 0) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline std::string HostOf(const std::string &target)
+{
+    const auto colon = target.rfind(':');
+    return colon == std::string::npos ? target : target.substr(0, colon);
+}
+
+inline bool IsLoopback(const std::string &target)
+{
+    const auto host = HostOf(target);
+    return host == "localhost" || host == "127.0.0.1" || host == "[::1]";
+}
+
+// A socket file left behind by a server which did not shut down cleanly refuses connections.
+inline bool AcceptsConnections(const std::string &path)
+{
+    auto address = sockaddr_un();
+    if (path.empty() || path.size() >= sizeof(address.sun_path))
+    {
+        return false;
+    }
+
+    const auto fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return false;
+    }
+    address.sun_family = AF_UNIX;
+    path.copy(address.sun_path, path.size());
+    const auto accepted = connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == 0;
+    close(fd);
+    return accepted;
+}
+
+} // namespace detail
+
+/*=========================================================================*/
+
+inline const char *TransportName(Transport transport)
+{
+    switch (transport)
+    {
+    case Transport::Tcp:
+        return "tcp";
+    case Transport::UnixSocket:
+        return "unix";
+    case Transport::InProcess:
+        return "inprocess";
+    }
+    return "unknown";
+}
+
+inline void LocalServers::Add(const std::string &address, grpc::Server *server)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    servers_[address] = server;
+}
+
+inline void LocalServers::Remove(const std::string &address)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    servers_.erase(address);
+}
+
+inline bool LocalServers::Contains(const std::string &address) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return servers_.count(address) > 0;
+}
+
+inline std::shared_ptr<grpc::Channel> LocalServers::Connect(const std::string &address,
+                                                            const grpc::ChannelArguments &arguments)
+{
+    // Connects under the lock, so the server cannot be removed and shut down in between.
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = servers_.find(address);
+    return it != servers_.end() ? it->second->InProcessChannel(arguments) : nullptr;
+}
+
+inline std::string UnixSocketPath(const std::string &address)
+{
+    const auto *configured = std::getenv("ROBL_UNIX_SOCKET");
+    if (configured != nullptr)
+    {
+        return configured;
+    }
+
+    const auto colon = address.rfind(':');
+    return colon == std::string::npos ? std::string() : "/tmp/robl-" + address.substr(colon + 1) + ".sock";
+}
+
+inline std::string AddListeningPorts(grpc::ServerBuilder &builder, const std::string &address,
+                                     const std::shared_ptr<grpc::ServerCredentials> &credentials)
+{
+    // gRPC removes a socket file left behind by an earlier run before it binds, and its own one on shutdown.
+    const auto unix_path = UnixSocketPath(address);
+    builder.AddListeningPort(address, credentials);
+    if (!unix_path.empty())
+    {
+        builder.AddListeningPort("unix:" + unix_path, credentials);
+    }
+    return unix_path;
+}
+
+inline Transport PickTransport(const std::string &target)
+{
+    if (LocalServers::Instance().Contains(target))
+    {
+        return Transport::InProcess;
+    }
+    if (!detail::HasScheme(target) && detail::IsLoopback(target) &&
+        detail::AcceptsConnections(UnixSocketPath(target)))
+    {
+        return Transport::UnixSocket;
+    }
+    return Transport::Tcp;
+}
+
+inline std::shared_ptr<grpc::Channel> CreateTransportChannel(
+    const std::string &target, Transport transport, const std::shared_ptr<grpc::ChannelCredentials> &credentials,
+    const grpc::ChannelArguments &arguments)
+{
+    if (transport == Transport::InProcess)
+    {
+        auto channel = LocalServers::Instance().Connect(target, arguments);
+        if (channel != nullptr)
+        {
+            return channel;
+        }
+    }
+    else if (transport == Transport::UnixSocket)
+    {
+        auto unix_arguments = arguments;
+        unix_arguments.SetSslTargetNameOverride(detail::HostOf(target));
+        return grpc::CreateCustomChannel("unix:" + UnixSocketPath(target), credentials, unix_arguments);
+    }
+    return grpc::CreateCustomChannel(target, credentials, arguments);
+}
+
+} // namespace robl
+
+/*=========================================================================*/
@@ -0,0 +1,123 @@
+#pragma once
+
+// standard headers
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+// grpc headers
+#include <grpc/grpc_security.h>
+#include <grpc/grpc_security_constants.h>
+#include <grpcpp/client_context.h>
+#include <grpcpp/security/credentials.h>
+#include <grpcpp/security/server_credentials.h>
+#include <grpcpp/security/tls_certificate_provider.h>
+#include <grpcpp/security/tls_credentials_options.h>
+#include <grpcpp/support/channel_arguments.h>
+
+/*=========================================================================*/
+
+namespace robl
+{
+
+// How often the certificate files are checked for changes.
+constexpr auto kCertificateRefreshInterval = std::chrono::seconds(10);
+
+/**
+ * Server TLS credentials whose key and certificate chain are read from files, and read again whenever they change.
+ * Handshakes after a change present the new certificate; connections made before keep theirs, so rotating the
+ * certificates drops no stream.
+ */
+std::shared_ptr<grpc::ServerCredentials> ReloadingServerCredentials(
+    const std::string &private_key_path, const std::string &certificate_chain_path,
+    std::chrono::seconds refresh_interval = kCertificateRefreshInterval);
+
+/**
+ * Client TLS credentials which trust the root certificates of a file, read again whenever it changes, and check the
+ * host name of the server against its certificate.
+ */
+std::shared_ptr<grpc::ChannelCredentials> ReloadingChannelCredentials(
+    const std::string &root_certificates_path, std::chrono::seconds refresh_interval = kCertificateRefreshInterval);
+
+/**
+ * @class TlsSessionCache
+ * @brief Keeps the TLS sessions of a client, so that a reconnect resumes its session with a ticket instead of doing a
+ * full handshake: no certificate is sent or verified and no key exchange is signed.
+ *
+ * Every channel the cache is applied to shares it, and the cache lives as long as the last of them. Sessions are
+ * keyed by the server name, so one cache serves any number of servers.
+ */
+class TlsSessionCache
+{
+public:
+    explicit TlsSessionCache(std::size_t capacity = 256)
+        : cache_(grpc_ssl_session_cache_create_lru(capacity))
+    {
+    }
+
+    ~TlsSessionCache()
+    {
+        grpc_ssl_session_cache_destroy(cache_);
+    }
+
+    TlsSessionCache(const TlsSessionCache &) = delete;
+    TlsSessionCache &operator=(const TlsSessionCache &) = delete;
+
+    /**
+     * Makes the channels created with the arguments use the cache.
+     */
+    void Apply(grpc::ChannelArguments *arguments) const
+    {
+        const auto arg = grpc_ssl_session_cache_create_channel_arg(cache_);
+        arguments->SetPointerWithVtable(arg.key, arg.value.pointer.p, arg.value.pointer.vtable);
+    }
+
+private:
+    grpc_ssl_session_cache *const cache_;
+};
+
+/**
+ * Whether the connection of a finished call resumed an earlier TLS session rather than doing a full handshake.
+ */
+bool SessionReused(const grpc::ClientContext &context);
+
+/*=========================================================================*/
+
+inline std::shared_ptr<grpc::ServerCredentials> ReloadingServerCredentials(const std::string &private_key_path,
+                                                                          const std::string &certificate_chain_path,
+                                                                          std::chrono::seconds refresh_interval)
+{
+    auto provider = std::make_shared<grpc::experimental::FileWatcherCertificateProvider>(
+        private_key_path, certificate_chain_path, static_cast<unsigned int>(refresh_interval.count()));
+    auto options = grpc::experimental::TlsServerCredentialsOptions(provider);
+    options.watch_identity_key_cert_pairs();
+    options.set_cert_request_type(GRPC_SSL_DONT_REQUEST_CLIENT_CERTIFICATE);
+    return grpc::experimental::TlsServerCredentials(options);
+}
+
+inline std::shared_ptr<grpc::ChannelCredentials> ReloadingChannelCredentials(const std::string &root_certificates_path,
+                                                                            std::chrono::seconds refresh_interval)
+{
+    auto provider = std::make_shared<grpc::experimental::FileWatcherCertificateProvider>(
+        root_certificates_path, static_cast<unsigned int>(refresh_interval.count()));
+    auto options = grpc::experimental::TlsChannelCredentialsOptions();
+    options.set_certificate_provider(provider);
+    options.watch_root_certs();
+    return grpc::experimental::TlsCredentials(options);
+}
+
+inline bool SessionReused(const grpc::ClientContext &context)
+{
+    const auto auth_context = context.auth_context();
+    if (auth_context == nullptr)
+    {
+        return false;
+    }
+    const auto values = auth_context->FindPropertyValues(GRPC_SSL_SESSION_REUSED_PROPERTY);
+    return !values.empty() && values.front() == "true";
+}
+
+} // namespace robl
+
+/*=========================================================================*/
@@ -0,0 +1,245 @@
+#pragma once
+
+// standard headers
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <vector>
+
+// grpc headers
+#include <grpcpp/support/status.h>
+
+// project headers
+#include "metrics/hdr_histogram.hpp"
+
+/*=========================================================================*/
+
+namespace robl::coro
+{
+
+/**
+ * @class RetryBudget
+ * @brief Bounds the extra attempts of the calls sharing it, so that hedges and retries cannot multiply the load on a
+ * server which is slow or failing because it is overloaded.
+ *
+ * Every call deposits a fraction of a token and every extra attempt takes a whole one, so extra attempts stay below
+ * that fraction of the calls, plus a small allowance per second for clients which only make few calls.
+ */
+class RetryBudget
+{
+public:
+    struct Options
+    {
+        double ratio = 0.1;
+        double min_per_second = 10.0;
+        double max_tokens = 100.0;
+    };
+
+    explicit RetryBudget(const Options &options);
+
+    void Deposit(void);
+    bool TryWithdraw(void);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    const Options options_;
+    std::mutex mutex_;
+    double tokens_;
+    Clock::time_point refilled_;
+};
+
+/**
+ * @class UnaryPolicy
+ * @brief How the calls of one unary method are hedged and retried, with what they observed.
+ *
+ * Only idempotent methods get more than one attempt. Their calls start a hedge once an attempt took longer than the
+ * given percentile of the recent attempts, and retry an attempt which failed with a retryable code after a jittered
+ * backoff, as long as the budget and the call's deadline allow. The policy must outlive the calls using it.
+ */
+class UnaryPolicy
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Options
+    {
+        bool idempotent = false;
+        // All attempts of a call, hedges and retries included.
+        int max_attempts = 3;
+        bool hedge = true;
+        double hedge_percentile = 95.0;
+        // The hedge delay until enough attempts were seen, and the floor which keeps fast methods from hedging on
+        // every scheduling hiccup.
+        Clock::duration initial_hedge_delay = std::chrono::milliseconds(50);
+        Clock::duration min_hedge_delay = std::chrono::milliseconds(1);
+        // The attempts the percentile is computed over.
+        std::int64_t latency_window = 1000;
+        Clock::duration initial_backoff = std::chrono::milliseconds(25);
+        Clock::duration max_backoff = std::chrono::seconds(1);
+        double backoff_multiplier = 2.0;
+        std::vector<grpc::StatusCode> retryable_codes = {
+            grpc::StatusCode::UNAVAILABLE,
+            grpc::StatusCode::RESOURCE_EXHAUSTED,
+            grpc::StatusCode::ABORTED,
+        };
+    };
+
+    struct Counters
+    {
+        std::uint64_t calls;
+        std::uint64_t attempts;
+        std::uint64_t hedges;
+        // Calls answered by a hedge rather than by the attempt it hedged.
+        std::uint64_t hedge_wins;
+        std::uint64_t retries;
+        // Hedges and retries which the budget turned down.
+        std::uint64_t budget_exhausted;
+        std::uint64_t failures;
+    };
+
+    UnaryPolicy(const Options &options, RetryBudget &budget);
+
+    const Options &GetOptions(void) const
+    {
+        return options_;
+    }
+
+    RetryBudget &Budget(void)
+    {
+        return budget_;
+    }
+
+    bool MayHedge(void) const
+    {
+        return options_.idempotent && options_.hedge && options_.max_attempts > 1;
+    }
+
+    bool IsRetryable(const grpc::Status &status) const;
+
+    Clock::duration HedgeDelay(void) const;
+
+    // The backoff before the given retry, the first being 1, drawn uniformly below its exponential bound.
+    Clock::duration Backoff(int retry) const;
+
+    // Records how long a primary attempt took, i.e. one which is not a hedge, whether it won or not. An attempt
+    // cancelled before it ended is recorded with the time it ran, which bounds its latency from below.
+    void RecordLatency(Clock::duration latency);
+
+    Counters Snapshot(void) const;
+
+    std::atomic<std::uint64_t> calls;
+    std::atomic<std::uint64_t> attempts;
+    std::atomic<std::uint64_t> hedges;
+    std::atomic<std::uint64_t> hedge_wins;
+    std::atomic<std::uint64_t> retries;
+    std::atomic<std::uint64_t> budget_exhausted;
+    std::atomic<std::uint64_t> failures;
+
+private:
+    const Options options_;
+    RetryBudget &budget_;
+    std::mutex latency_mutex_;
+    robl::HdrHistogram latency_us_;
+    // The percentile of the last full window, or -1 before the first one.
+    std::atomic<std::int64_t> hedge_delay_us_;
+};
+
+/*=========================================================================*/
+
+inline RetryBudget::RetryBudget(const Options &options)
+    : options_(options)
+    , tokens_(options.max_tokens)
+    , refilled_(Clock::now())
+{
+}
+
+inline void RetryBudget::Deposit(void)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    tokens_ = std::min(options_.max_tokens, tokens_ + options_.ratio);
+}
+
+inline bool RetryBudget::TryWithdraw(void)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto now = Clock::now();
+    const auto elapsed = std::chrono::duration<double>(now - refilled_).count();
+    tokens_ = std::min(options_.max_tokens, tokens_ + elapsed * options_.min_per_second);
+    refilled_ = now;
+    if (tokens_ < 1.0)
+    {
+        return false;
+    }
+    tokens_ -= 1.0;
+    return true;
+}
+
+inline UnaryPolicy::UnaryPolicy(const Options &options, RetryBudget &budget)
+    : calls(0)
+    , attempts(0)
+    , hedges(0)
+    , hedge_wins(0)
+    , retries(0)
+    , budget_exhausted(0)
+    , failures(0)
+    , options_(options)
+    , budget_(budget)
+    , latency_us_(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::minutes(1)).count(), 2)
+    , hedge_delay_us_(-1)
+{
+}
+
+inline bool UnaryPolicy::IsRetryable(const grpc::Status &status) const
+{
+    const auto &codes = options_.retryable_codes;
+    return options_.idempotent && std::find(codes.begin(), codes.end(), status.error_code()) != codes.end();
+}
+
+inline UnaryPolicy::Clock::duration UnaryPolicy::HedgeDelay(void) const
+{
+    const auto delay_us = hedge_delay_us_.load(std::memory_order_relaxed);
+    if (delay_us < 0)
+    {
+        return options_.initial_hedge_delay;
+    }
+    return std::max<Clock::duration>(std::chrono::microseconds(delay_us), options_.min_hedge_delay);
+}
+
+inline UnaryPolicy::Clock::duration UnaryPolicy::Backoff(int retry) const
+{
+    thread_local auto random = std::mt19937_64(std::random_device()());
+
+    auto bound = std::chrono::duration<double>(options_.initial_backoff);
+    for (auto i = 1; i < retry && bound < options_.max_backoff; ++i)
+    {
+        bound *= options_.backoff_multiplier;
+    }
+    bound = std::min<std::chrono::duration<double>>(bound, options_.max_backoff);
+    const auto jitter = std::uniform_real_distribution<double>(0.0, 1.0)(random);
+    return std::chrono::duration_cast<Clock::duration>(bound * jitter);
+}
+
+inline void UnaryPolicy::RecordLatency(Clock::duration latency)
+{
+    std::lock_guard<std::mutex> lock(latency_mutex_);
+    latency_us_.Record(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+    if (latency_us_.Count() >= options_.latency_window)
+    {
+        hedge_delay_us_ = latency_us_.ValueAtPercentile(options_.hedge_percentile);
+        latency_us_.Reset();
+    }
+}
+
+inline UnaryPolicy::Counters UnaryPolicy::Snapshot(void) const
+{
+    return Counters{ calls.load(),   attempts.load(),         hedges.load(),  hedge_wins.load(),
+                     retries.load(), budget_exhausted.load(), failures.load() };
+}
+
+} // namespace robl::coro
+
+/*=========================================================================*/
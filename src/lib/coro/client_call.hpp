@@ -0,0 +1,428 @@
+#pragma once
+
+// standard headers
+#include <atomic>
+#include <coroutine>
+#include <functional>
+
+// grpc headers
+#include <grpcpp/client_context.h>
+#include <grpcpp/support/client_callback.h>
+#include <grpcpp/support/status.h>
+
+// project headers
+#include "coro/executor.hpp"
+
+/*=========================================================================*/
+
+namespace robl::coro
+{
+
+namespace detail
+{
+
+// Meets the end of a call from both sides without a lock: the coroutine asking for the status and OnDone() both flip
+// the flag, and whoever comes second goes on with the coroutine.
+class DoneLatch
+{
+public:
+    DoneLatch(void)
+        : arrived_(false)
+    {
+    }
+
+    // Called by the coroutine. Returns false if the call is already done and the coroutine must not suspend.
+    bool Wait(std::coroutine_handle<> handle)
+    {
+        handle_ = handle;
+        return !arrived_.exchange(true, std::memory_order_acq_rel);
+    }
+
+    // Called by OnDone() once the status is stored.
+    void Arrive(Executor &executor)
+    {
+        if (arrived_.exchange(true, std::memory_order_acq_rel))
+        {
+            executor.Resume(handle_);
+        }
+    }
+
+private:
+    std::atomic_bool arrived_;
+    std::coroutine_handle<> handle_;
+};
+
+} // namespace detail
+
+/**
+ * @class UnaryCall
+ * @brief Awaits a unary call started through a stub's async() interface, resuming with its status.
+ */
+template <typename AsyncStub, typename Request, typename Response>
+class UnaryCall
+{
+public:
+    using Method = void (AsyncStub::*)(grpc::ClientContext *, const Request *, Response *,
+                                       std::function<void(grpc::Status)>);
+
+    UnaryCall(Executor &executor, AsyncStub *stub, Method method, grpc::ClientContext *context,
+              const Request *request, Response *response)
+        : executor_(executor)
+        , stub_(stub)
+        , method_(method)
+        , context_(context)
+        , request_(request)
+        , response_(response)
+    {
+    }
+
+    bool await_ready(void) const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        handle_ = handle;
+        // The callback may run before this returns, so nothing of the awaiter is touched after the call starts.
+        (stub_->*method_)(context_, request_, response_, [this](grpc::Status status) {
+            status_ = std::move(status);
+            executor_.Resume(handle_);
+        });
+    }
+
+    grpc::Status await_resume(void)
+    {
+        return std::move(status_);
+    }
+
+private:
+    Executor &executor_;
+    AsyncStub *stub_;
+    Method method_;
+    grpc::ClientContext *context_;
+    const Request *request_;
+    Response *response_;
+    std::coroutine_handle<> handle_;
+    grpc::Status status_;
+};
+
+/**
+ * Starts a unary call and returns an awaitable for its status, e.g.
+ *
+ *     const auto status = co_await robl::coro::Call(loop, stub->async(), &TestService::Stub::async::SayHello,
+ *                                                   &context, &request, &response);
+ *
+ * The context, the request and the response must live until the call is done.
+ */
+template <typename AsyncStub, typename Request, typename Response>
+UnaryCall<AsyncStub, Request, Response> Call(Executor &executor, AsyncStub *stub,
+                                             void (AsyncStub::*method)(grpc::ClientContext *, const Request *,
+                                                                       Response *, std::function<void(grpc::Status)>),
+                                             grpc::ClientContext *context, const Request *request, Response *response)
+{
+    return UnaryCall<AsyncStub, Request, Response>(executor, stub, method, context, request, response);
+}
+
+/*=========================================================================*/
+
+/**
+ * @class ReadStream
+ * @brief A server stream read as an async generator.
+ *
+ * The stream is passed to the stub like any reactor and started with StartCall(). Then Next() is awaited until it
+ * returns nullptr, and Finish() must be awaited before the stream is destroyed:
+ *
+ *     robl::coro::ReadStream<Response> stream(loop);
+ *     stub->async()->Subscribe(&context, &request, &stream);
+ *     stream.StartCall();
+ *     while (const auto *response = co_await stream.Next()) { ... }
+ *     const auto status = co_await stream.Finish();
+ */
+template <typename Response>
+class ReadStream final : public grpc::ClientReadReactor<Response>
+{
+public:
+    explicit ReadStream(Executor &executor)
+        : executor_(executor)
+        , read_ok_(false)
+    {
+    }
+
+    /**
+     * Starts the call and holds it open until Finish() is awaited, so the coroutine may start its next operation after
+     * the previous one failed without gRPC tearing the call down in between.
+     */
+    void StartCall(void)
+    {
+        this->AddHold();
+        grpc::ClientReadReactor<Response>::StartCall();
+    }
+
+    /**
+     * Returns an awaitable for the next message, which yields nullptr once the stream has no more messages. The
+     * message is valid until the next call.
+     */
+    auto Next(void)
+    {
+        struct Awaiter
+        {
+            bool await_ready(void) const noexcept
+            {
+                return false;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                stream->read_handle_ = handle;
+                stream->StartRead(&stream->response_);
+            }
+
+            const Response *await_resume(void) const noexcept
+            {
+                return stream->read_ok_ ? &stream->response_ : nullptr;
+            }
+
+            ReadStream *stream;
+        };
+
+        return Awaiter{ this };
+    }
+
+    /**
+     * Returns an awaitable for the status of the call.
+     */
+    auto Finish(void)
+    {
+        struct Awaiter
+        {
+            bool await_ready(void) const noexcept
+            {
+                return false;
+            }
+
+            bool await_suspend(std::coroutine_handle<> handle)
+            {
+                // Releasing the hold of StartCall() lets the call finish, which may complete it right here.
+                stream->RemoveHold();
+                return stream->done_.Wait(handle);
+            }
+
+            grpc::Status await_resume(void) const
+            {
+                return stream->status_;
+            }
+
+            ReadStream *stream;
+        };
+
+        return Awaiter{ this };
+    }
+
+    void OnReadDone(bool ok) override
+    {
+        read_ok_ = ok;
+        executor_.Resume(read_handle_);
+    }
+
+    void OnDone(const grpc::Status &status) override
+    {
+        status_ = status;
+        done_.Arrive(executor_);
+    }
+
+private:
+    Executor &executor_;
+    Response response_;
+    bool read_ok_;
+    std::coroutine_handle<> read_handle_;
+    grpc::Status status_;
+    detail::DoneLatch done_;
+};
+
+/*=========================================================================*/
+
+/**
+ * @class BidiStream
+ * @brief A bidirectional stream used as a pair of channels.
+ *
+ * Reads and writes are awaited independently, so one coroutine may read while another one writes, but there is at
+ * most one read and one write in flight. Like ReadStream, it is started with StartCall() and Finish() must be awaited
+ * before it is destroyed.
+ */
+template <typename Request, typename Response>
+class BidiStream final : public grpc::ClientBidiReactor<Request, Response>
+{
+public:
+    explicit BidiStream(Executor &executor)
+        : executor_(executor)
+        , read_ok_(false)
+        , write_ok_(false)
+    {
+    }
+
+    // Holds the call open until Finish() is awaited, like ReadStream::StartCall().
+    void StartCall(void)
+    {
+        this->AddHold();
+        grpc::ClientBidiReactor<Request, Response>::StartCall();
+    }
+
+    /**
+     * Returns an awaitable for the next message, which yields nullptr once the server is done writing. The message
+     * is valid until the next call.
+     */
+    auto Read(void)
+    {
+        struct Awaiter
+        {
+            bool await_ready(void) const noexcept
+            {
+                return false;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                stream->read_handle_ = handle;
+                stream->StartRead(&stream->response_);
+            }
+
+            const Response *await_resume(void) const noexcept
+            {
+                return stream->read_ok_ ? &stream->response_ : nullptr;
+            }
+
+            BidiStream *stream;
+        };
+
+        return Awaiter{ this };
+    }
+
+    /**
+     * Returns an awaitable which writes a message and yields false if the stream is broken. The message must live
+     * until the write is done.
+     */
+    auto Write(const Request &request)
+    {
+        struct Awaiter
+        {
+            bool await_ready(void) const noexcept
+            {
+                return false;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                stream->write_handle_ = handle;
+                stream->StartWrite(request);
+            }
+
+            bool await_resume(void) const noexcept
+            {
+                return stream->write_ok_;
+            }
+
+            BidiStream *stream;
+            const Request *request;
+        };
+
+        return Awaiter{ this, &request };
+    }
+
+    /**
+     * Returns an awaitable which tells the server that no more messages follow.
+     */
+    auto WritesDone(void)
+    {
+        struct Awaiter
+        {
+            bool await_ready(void) const noexcept
+            {
+                return false;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                stream->write_handle_ = handle;
+                stream->StartWritesDone();
+            }
+
+            bool await_resume(void) const noexcept
+            {
+                return stream->write_ok_;
+            }
+
+            BidiStream *stream;
+        };
+
+        return Awaiter{ this };
+    }
+
+    /**
+     * Returns an awaitable for the status of the call.
+     */
+    auto Finish(void)
+    {
+        struct Awaiter
+        {
+            bool await_ready(void) const noexcept
+            {
+                return false;
+            }
+
+            bool await_suspend(std::coroutine_handle<> handle)
+            {
+                // Releasing the hold of StartCall() lets the call finish, which may complete it right here.
+                stream->RemoveHold();
+                return stream->done_.Wait(handle);
+            }
+
+            grpc::Status await_resume(void) const
+            {
+                return stream->status_;
+            }
+
+            BidiStream *stream;
+        };
+
+        return Awaiter{ this };
+    }
+
+    void OnReadDone(bool ok) override
+    {
+        read_ok_ = ok;
+        executor_.Resume(read_handle_);
+    }
+
+    void OnWriteDone(bool ok) override
+    {
+        write_ok_ = ok;
+        executor_.Resume(write_handle_);
+    }
+
+    void OnWritesDoneDone(bool ok) override
+    {
+        write_ok_ = ok;
+        executor_.Resume(write_handle_);
+    }
+
+    void OnDone(const grpc::Status &status) override
+    {
+        status_ = status;
+        done_.Arrive(executor_);
+    }
+
+private:
+    Executor &executor_;
+    Response response_;
+    bool read_ok_;
+    bool write_ok_;
+    std::coroutine_handle<> read_handle_;
+    std::coroutine_handle<> write_handle_;
+    grpc::Status status_;
+    detail::DoneLatch done_;
+};
+
+} // namespace robl::coro
+
+/*=========================================================================*/
@@ -0,0 +1,162 @@
+#pragma once
+
+// standard headers
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <mutex>
+
+// project headers
+#include "coro/task.hpp"
+
+/*=========================================================================*/
+
+namespace robl::coro
+{
+
+/**
+ * @class Executor
+ * @brief Decides on which thread a coroutine continues once the operation it awaits completes.
+ */
+class Executor
+{
+public:
+    virtual ~Executor() = default;
+
+    virtual void Resume(std::coroutine_handle<> handle) = 0;
+};
+
+/**
+ * @class InlineExecutor
+ * @brief Continues coroutines right on the thread which completed their operation, e.g. a gRPC callback thread, so
+ * there is no thread handoff at all. Coroutines must not block then, as they hold up the gRPC callbacks.
+ */
+class InlineExecutor final : public Executor
+{
+public:
+    static InlineExecutor &Instance(void)
+    {
+        static InlineExecutor instance;
+        return instance;
+    }
+
+    void Resume(std::coroutine_handle<> handle) override
+    {
+        handle.resume();
+    }
+};
+
+/**
+ * @class RunLoop
+ * @brief Continues coroutines on the one thread which runs the loop.
+ *
+ * Every completion costs one queue push and, only if the loop is idle, one wakeup. Coroutines on a loop never run
+ * concurrently with each other, so they can share state without locks.
+ */
+class RunLoop final : public Executor
+{
+public:
+    RunLoop(void)
+        : stopping_(false)
+    {
+    }
+
+    void Resume(std::coroutine_handle<> handle) override
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ready_.push_back(handle);
+        }
+        wakeup_.notify_one();
+    }
+
+    /**
+     * Returns an awaitable which moves the awaiting coroutine onto the loop.
+     */
+    auto Schedule(void)
+    {
+        struct Awaiter
+        {
+            bool await_ready(void) const noexcept
+            {
+                return false;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                loop->Resume(handle);
+            }
+
+            void await_resume(void) const noexcept
+            {
+            }
+
+            RunLoop *loop;
+        };
+
+        return Awaiter{ this };
+    }
+
+    /**
+     * Runs every coroutine resumed on the loop on the calling thread until Stop() is called.
+     */
+    void Run(void)
+    {
+        auto batch = std::deque<std::coroutine_handle<>>();
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wakeup_.wait(lock, [this]() { return stopping_ || !ready_.empty(); });
+                if (ready_.empty())
+                {
+                    stopping_ = false;
+                    return;
+                }
+                batch.swap(ready_);
+            }
+
+            // Run everything which became ready at once, so a busy loop takes the lock once per batch.
+            for (const auto handle : batch)
+            {
+                handle.resume();
+            }
+            batch.clear();
+        }
+    }
+
+    /**
+     * Runs the task on the calling thread, along with every coroutine resumed on the loop, until the task ends.
+     */
+    void Run(Task<void> task)
+    {
+        Spawn([](Task<void> task, RunLoop *loop) -> Task<void> {
+            co_await loop->Schedule();
+            co_await std::move(task);
+            loop->Stop();
+        }(std::move(task), this));
+        Run();
+    }
+
+    /**
+     * Makes Run() return once the coroutines which are ready have run.
+     */
+    void Stop(void)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wakeup_.notify_one();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::deque<std::coroutine_handle<>> ready_;
+    bool stopping_;
+};
+
+} // namespace robl::coro
+
+/*=========================================================================*/
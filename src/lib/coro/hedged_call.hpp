@@ -0,0 +1,394 @@
+#pragma once
+
+// standard headers
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+// grpc headers
+#include <grpcpp/alarm.h>
+#include <grpcpp/client_context.h>
+#include <grpcpp/support/status.h>
+
+// project headers
+#include "coro/call_policy.hpp"
+#include "coro/executor.hpp"
+
+/*=========================================================================*/
+
+namespace robl::coro
+{
+
+namespace detail
+{
+
+/**
+ * @class HedgedCallState
+ * @brief The attempts of one hedged call, shared with the callbacks of the attempts and of its timer, which all
+ * outlive the awaiting coroutine when an attempt loses.
+ */
+template <typename AsyncStub, typename Request, typename Response>
+class HedgedCallState : public std::enable_shared_from_this<HedgedCallState<AsyncStub, Request, Response>>
+{
+public:
+    using Method = void (AsyncStub::*)(grpc::ClientContext *, const Request *, Response *,
+                                       std::function<void(grpc::Status)>);
+
+    HedgedCallState(Executor &executor, AsyncStub *stub, Method method, UnaryPolicy &policy, const Request *request,
+                    Response *response, std::chrono::system_clock::time_point deadline);
+
+    void Start(std::coroutine_handle<> handle);
+
+    grpc::Status TakeStatus(void)
+    {
+        return std::move(status_);
+    }
+
+private:
+    using Clock = UnaryPolicy::Clock;
+
+    struct Attempt
+    {
+        grpc::ClientContext context;
+        Response response;
+        Clock::time_point start;
+        bool hedge = false;
+        bool done = false;
+    };
+
+    enum class Timer
+    {
+        Hedge,
+        Backoff,
+    };
+
+    // What a step decided, carried out once the lock is released, as gRPC may run the callbacks of an attempt on the
+    // thread which starts or cancels it.
+    struct Actions
+    {
+        std::vector<Attempt *> start;
+        std::vector<Attempt *> cancel;
+        // Destroying an alarm cancels it, so it is destroyed without the lock as well.
+        std::unique_ptr<grpc::Alarm> retired;
+        bool resume = false;
+    };
+
+    bool MayStartLocked(void) const;
+    void AddAttemptLocked(bool hedge, Actions &actions);
+    void ArmLocked(Timer timer, Clock::duration delay, Actions &actions);
+    void FinishLocked(Attempt *winner, grpc::Status status, Actions &actions);
+    void OnDone(Attempt *attempt, grpc::Status status);
+    void OnTimer(std::uint64_t generation, bool ok);
+    void Carry(Actions &actions);
+
+    Executor &executor_;
+    AsyncStub *stub_;
+    Method method_;
+    UnaryPolicy &policy_;
+    // A copy if the call may hedge, as a hedge may still be starting when another attempt has won and the caller has
+    // moved on.
+    std::optional<Request> request_copy_;
+    const Request *request_;
+    Response *response_;
+    const std::chrono::system_clock::time_point deadline_;
+    std::coroutine_handle<> handle_;
+
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Attempt>> attempts_;
+    int outstanding_ = 0;
+    int retries_ = 0;
+    bool finished_ = false;
+    Timer timer_ = Timer::Hedge;
+    // Tells the alarm which is armed from the ones which were replaced and fire cancelled or late.
+    std::uint64_t generation_ = 0;
+    std::unique_ptr<grpc::Alarm> alarm_;
+    grpc::Status last_status_;
+    grpc::Status status_;
+};
+
+} // namespace detail
+
+/**
+ * @class HedgedUnaryCall
+ * @brief Awaits a unary call made in as many attempts as its policy allows, resuming with the status of the attempt
+ * which answered it.
+ */
+template <typename AsyncStub, typename Request, typename Response>
+class HedgedUnaryCall
+{
+public:
+    using State = detail::HedgedCallState<AsyncStub, Request, Response>;
+
+    explicit HedgedUnaryCall(std::shared_ptr<State> state)
+        : state_(std::move(state))
+    {
+    }
+
+    bool await_ready(void) const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        // The call may be done and the awaiter gone before Start() returns.
+        const auto state = state_;
+        state->Start(handle);
+    }
+
+    grpc::Status await_resume(void)
+    {
+        return state_->TakeStatus();
+    }
+
+private:
+    std::shared_ptr<State> state_;
+};
+
+/**
+ * Starts a unary call under the policy of its method and returns an awaitable for its status, e.g.
+ *
+ *     const auto status = co_await robl::coro::HedgedCall(loop, stub->async(), &TestService::Stub::async::GetMarker,
+ *                                                         marker_policy, request, &response, deadline);
+ *
+ * The call makes its attempts with contexts of its own, all with the deadline, which bounds the whole call. Once an
+ * attempt succeeds or fails for good, the others are cancelled and its response is swapped into the response. The
+ * request and the response must live until the call is done.
+ */
+template <typename AsyncStub, typename Request, typename Response>
+HedgedUnaryCall<AsyncStub, Request, Response> HedgedCall(
+    Executor &executor, AsyncStub *stub,
+    void (AsyncStub::*method)(grpc::ClientContext *, const Request *, Response *, std::function<void(grpc::Status)>),
+    UnaryPolicy &policy, const Request &request, Response *response,
+    std::chrono::system_clock::time_point deadline = std::chrono::system_clock::time_point::max())
+{
+    using State = detail::HedgedCallState<AsyncStub, Request, Response>;
+    return HedgedUnaryCall<AsyncStub, Request, Response>(
+        std::make_shared<State>(executor, stub, method, policy, &request, response, deadline));
+}
+
+/*=========================================================================*/
+
+namespace detail
+{
+
+template <typename AsyncStub, typename Request, typename Response>
+HedgedCallState<AsyncStub, Request, Response>::HedgedCallState(Executor &executor, AsyncStub *stub, Method method,
+                                                               UnaryPolicy &policy, const Request *request,
+                                                               Response *response,
+                                                               std::chrono::system_clock::time_point deadline)
+    : executor_(executor)
+    , stub_(stub)
+    , method_(method)
+    , policy_(policy)
+    , request_(request)
+    , response_(response)
+    , deadline_(deadline)
+{
+    if (policy_.MayHedge())
+    {
+        request_copy_.emplace(*request);
+        request_ = &*request_copy_;
+    }
+}
+
+template <typename AsyncStub, typename Request, typename Response>
+void HedgedCallState<AsyncStub, Request, Response>::Start(std::coroutine_handle<> handle)
+{
+    handle_ = handle;
+    ++policy_.calls;
+    policy_.Budget().Deposit();
+
+    auto actions = Actions();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        AddAttemptLocked(false, actions);
+        if (policy_.MayHedge())
+        {
+            ArmLocked(Timer::Hedge, policy_.HedgeDelay(), actions);
+        }
+    }
+    Carry(actions);
+}
+
+template <typename AsyncStub, typename Request, typename Response>
+bool HedgedCallState<AsyncStub, Request, Response>::MayStartLocked(void) const
+{
+    return static_cast<int>(attempts_.size()) < policy_.GetOptions().max_attempts &&
+           std::chrono::system_clock::now() < deadline_;
+}
+
+template <typename AsyncStub, typename Request, typename Response>
+void HedgedCallState<AsyncStub, Request, Response>::AddAttemptLocked(bool hedge, Actions &actions)
+{
+    auto &attempt = attempts_.emplace_back(std::make_unique<Attempt>());
+    if (deadline_ != std::chrono::system_clock::time_point::max())
+    {
+        attempt->context.set_deadline(deadline_);
+    }
+    attempt->start = Clock::now();
+    attempt->hedge = hedge;
+    ++outstanding_;
+    ++policy_.attempts;
+    actions.start.push_back(attempt.get());
+}
+
+template <typename AsyncStub, typename Request, typename Response>
+void HedgedCallState<AsyncStub, Request, Response>::ArmLocked(Timer timer, Clock::duration delay, Actions &actions)
+{
+    actions.retired = std::move(alarm_);
+    timer_ = timer;
+    const auto generation = ++generation_;
+    const auto at =
+        std::chrono::system_clock::now() + std::chrono::duration_cast<std::chrono::system_clock::duration>(delay);
+    alarm_ = std::make_unique<grpc::Alarm>();
+    alarm_->Set(at, [self = this->shared_from_this(), generation](bool ok) { self->OnTimer(generation, ok); });
+}
+
+template <typename AsyncStub, typename Request, typename Response>
+void HedgedCallState<AsyncStub, Request, Response>::FinishLocked(Attempt *winner, grpc::Status status,
+                                                                 Actions &actions)
+{
+    finished_ = true;
+    status_ = std::move(status);
+    if (winner != nullptr)
+    {
+        response_->Swap(&winner->response);
+        policy_.hedge_wins += winner->hedge ? 1 : 0;
+    }
+    policy_.failures += status_.ok() ? 0 : 1;
+
+    // A primary attempt given up on took at least as long as it ran, and leaving it out would make the hedge delay
+    // a percentile of the attempts which were fast enough to win.
+    const auto now = Clock::now();
+    for (const auto &attempt : attempts_)
+    {
+        if (!attempt->done && attempt.get() != winner)
+        {
+            if (!attempt->hedge)
+            {
+                policy_.RecordLatency(now - attempt->start);
+            }
+            actions.cancel.push_back(attempt.get());
+        }
+    }
+    actions.retired = std::move(alarm_);
+    actions.resume = true;
+}
+
+template <typename AsyncStub, typename Request, typename Response>
+void HedgedCallState<AsyncStub, Request, Response>::OnDone(Attempt *attempt, grpc::Status status)
+{
+    auto actions = Actions();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        attempt->done = true;
+        --outstanding_;
+        if (finished_)
+        {
+            return;
+        }
+
+        // Hedges start late, and a retryable failure says nothing about how long an answer takes.
+        if (!attempt->hedge && !policy_.IsRetryable(status))
+        {
+            policy_.RecordLatency(Clock::now() - attempt->start);
+        }
+        if (status.ok() || !policy_.IsRetryable(status))
+        {
+            FinishLocked(attempt, std::move(status), actions);
+        }
+        else if (outstanding_ == 0)
+        {
+            // The last attempt out failed, so it is up to a retry.
+            last_status_ = std::move(status);
+            if (!MayStartLocked())
+            {
+                FinishLocked(nullptr, last_status_, actions);
+            }
+            else if (!policy_.Budget().TryWithdraw())
+            {
+                ++policy_.budget_exhausted;
+                FinishLocked(nullptr, last_status_, actions);
+            }
+            else
+            {
+                ++policy_.retries;
+                ArmLocked(Timer::Backoff, policy_.Backoff(++retries_), actions);
+            }
+        }
+        else
+        {
+            // Another attempt may still succeed, and the hedge timer may start one more.
+            last_status_ = std::move(status);
+        }
+    }
+    Carry(actions);
+}
+
+template <typename AsyncStub, typename Request, typename Response>
+void HedgedCallState<AsyncStub, Request, Response>::OnTimer(std::uint64_t generation, bool ok)
+{
+    auto actions = Actions();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!ok || finished_ || generation != generation_)
+        {
+            return;
+        }
+
+        if (!MayStartLocked())
+        {
+            // A hedge leaves the call to the attempts out, a backoff has none to leave it to.
+            if (timer_ == Timer::Backoff)
+            {
+                FinishLocked(nullptr, last_status_, actions);
+            }
+        }
+        else if (timer_ == Timer::Hedge && !policy_.Budget().TryWithdraw())
+        {
+            ++policy_.budget_exhausted;
+        }
+        else
+        {
+            policy_.hedges += timer_ == Timer::Hedge ? 1 : 0;
+            AddAttemptLocked(timer_ == Timer::Hedge, actions);
+            if (policy_.MayHedge() && MayStartLocked())
+            {
+                ArmLocked(Timer::Hedge, policy_.HedgeDelay(), actions);
+            }
+        }
+    }
+    Carry(actions);
+}
+
+template <typename AsyncStub, typename Request, typename Response>
+void HedgedCallState<AsyncStub, Request, Response>::Carry(Actions &actions)
+{
+    for (auto *attempt : actions.start)
+    {
+        (stub_->*method_)(&attempt->context, request_, &attempt->response,
+                          [self = this->shared_from_this(), attempt](grpc::Status status) {
+                              self->OnDone(attempt, std::move(status));
+                          });
+    }
+    for (auto *attempt : actions.cancel)
+    {
+        attempt->context.TryCancel();
+    }
+    if (actions.resume)
+    {
+        executor_.Resume(handle_);
+    }
+}
+
+} // namespace detail
+
+} // namespace robl::coro
+
+/*=========================================================================*/
@@ -0,0 +1,537 @@
+#pragma once
+
+// standard headers
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <memory>
+#include <mutex>
+
+// grpc headers
+#include <grpcpp/alarm.h>
+#include <grpcpp/support/server_callback.h>
+#include <grpcpp/support/status.h>
+
+// project headers
+#include "coro/task.hpp"
+
+/*=========================================================================*/
+
+namespace robl::coro
+{
+
+namespace detail
+{
+
+/**
+ * @class Signal
+ * @brief Wakes the one coroutine waiting on it, or the next one to wait if nobody waits yet. Notifications which
+ * arrive while one is pending are merged into it.
+ */
+class Signal
+{
+public:
+    Signal(void)
+        : state_(nullptr)
+    {
+    }
+
+    /**
+     * Returns the coroutine to wake, or nullptr if nobody waits. The caller resumes it.
+     */
+    std::coroutine_handle<> Notify(void)
+    {
+        auto *state = state_.load(std::memory_order_acquire);
+        while (state != Notified())
+        {
+            // Nobody waits: leave the notification for the next wait. Somebody waits: wake it and reset.
+            auto *const next = state == nullptr ? Notified() : nullptr;
+            if (state_.compare_exchange_weak(state, next, std::memory_order_acq_rel, std::memory_order_acquire))
+            {
+                return state != nullptr ? std::coroutine_handle<>::from_address(state) : nullptr;
+            }
+        }
+        return nullptr;
+    }
+
+    auto Wait(void)
+    {
+        struct Awaiter
+        {
+            bool await_ready(void) const noexcept
+            {
+                return false;
+            }
+
+            bool await_suspend(std::coroutine_handle<> handle)
+            {
+                auto *state = static_cast<void *>(nullptr);
+                if (signal->state_.compare_exchange_strong(state, handle.address(), std::memory_order_acq_rel))
+                {
+                    return true;
+                }
+
+                // Only the waiter takes a pending notification, so it is still there.
+                signal->state_.store(nullptr, std::memory_order_release);
+                return false;
+            }
+
+            void await_resume(void) const noexcept
+            {
+            }
+
+            Signal *signal;
+        };
+
+        return Awaiter{ this };
+    }
+
+private:
+    static void *Notified(void)
+    {
+        static char notified;
+        return &notified;
+    }
+
+    std::atomic<void *> state_;
+};
+
+/**
+ * @class ServerCallState
+ * @brief What the server calls share: the cancellation, the wakeups and the timer of the handler.
+ */
+class ServerCallState
+{
+public:
+    ServerCallState(void)
+        : cancelled_(false)
+        , finished_(false)
+        , owners_(2)
+        , sleep_ok_(false)
+    {
+    }
+
+    bool IsCancelled(void) const
+    {
+        return cancelled_.load(std::memory_order_acquire);
+    }
+
+    // Called from OnCancel() and on abort: ends the sleep and the wait of the handler.
+    void Cancel(void)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cancelled_.store(true, std::memory_order_release);
+            if (sleep_alarm_)
+            {
+                sleep_alarm_->Cancel();
+            }
+        }
+        Notify();
+    }
+
+    // Wakes the handler on a gRPC thread rather than on the caller's, which may hold locks the handler takes.
+    void Notify(void)
+    {
+        const auto handle = signal_.Notify();
+        if (!handle)
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        wake_alarm_ = std::make_unique<grpc::Alarm>();
+        wake_alarm_->Set(std::chrono::system_clock::now(), [handle](bool) { handle.resume(); });
+    }
+
+    auto Notified(void)
+    {
+        return signal_.Wait();
+    }
+
+    // Returns true for the first of the handler and an abort which gets to finish the call.
+    bool TryFinish(void)
+    {
+        return !finished_.exchange(true, std::memory_order_acq_rel);
+    }
+
+    // The call is owned by its handler and by gRPC until OnDone(). Returns true for the last one to let go.
+    bool Release(void)
+    {
+        return owners_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+
+    auto Sleep(std::chrono::steady_clock::duration duration)
+    {
+        struct Awaiter
+        {
+            bool await_ready(void) const noexcept
+            {
+                return false;
+            }
+
+            bool await_suspend(std::coroutine_handle<> handle)
+            {
+                std::lock_guard<std::mutex> lock(state->mutex_);
+                if (state->IsCancelled())
+                {
+                    state->sleep_ok_ = false;
+                    return false;
+                }
+
+                // The alarm which fired last may be the one running this, which its own reference keeps alive.
+                state->sleep_alarm_ = std::make_unique<grpc::Alarm>();
+                state->sleep_alarm_->Set(std::chrono::system_clock::now() + duration, [this, handle](bool ok) {
+                    state->sleep_ok_ = ok;
+                    handle.resume();
+                });
+                return true;
+            }
+
+            bool await_resume(void) const noexcept
+            {
+                return state->sleep_ok_;
+            }
+
+            ServerCallState *state;
+            std::chrono::steady_clock::duration duration;
+        };
+
+        return Awaiter{ this, duration };
+    }
+
+private:
+    std::atomic_bool cancelled_;
+    std::atomic_bool finished_;
+    std::atomic<int> owners_;
+    Signal signal_;
+    std::mutex mutex_;
+    std::unique_ptr<grpc::Alarm> sleep_alarm_;
+    std::unique_ptr<grpc::Alarm> wake_alarm_;
+    bool sleep_ok_;
+};
+
+} // namespace detail
+
+/*=========================================================================*/
+
+/**
+ * @class ServerWriteCall
+ * @brief Runs a server streaming handler written as a coroutine on top of a callback reactor.
+ *
+ * The handler is started when the call is, runs on the callback threads and is resumed by the reactor callbacks, so it
+ * must await instead of blocking. The status it returns finishes the call:
+ *
+ *     return robl::coro::ServerWriteCall<Response>::Start([](auto &stream) -> robl::coro::Task<grpc::Status> {
+ *         while (co_await stream.Sleep(std::chrono::seconds(1)))
+ *         {
+ *             if (!co_await stream.Write(response)) co_return grpc::Status::CANCELLED;
+ *         }
+ *         co_return grpc::Status::CANCELLED;
+ *     });
+ *
+ * Locals of the handler are destroyed before the call finishes. Notify() wakes a handler awaiting Notified(), e.g.
+ * when another thread has something new to write, and cancellation wakes both Notified() and Sleep(). The reactor
+ * lives until both the handler has ended and gRPC is done with it.
+ */
+template <typename Response>
+class ServerWriteCall final : public grpc::ServerWriteReactor<Response>
+{
+public:
+    /**
+     * Creates the reactor for a call and starts the handler on it. The handler is any callable which takes the call
+     * and returns a Task<grpc::Status>; it is kept, along with what it captures, until the handler has ended.
+     */
+    template <typename Handler>
+    static grpc::ServerWriteReactor<Response> *Start(Handler handler)
+    {
+        auto *call = new ServerWriteCall();
+        Spawn(Run(call, std::move(handler)));
+        return call;
+    }
+
+    bool IsCancelled(void) const
+    {
+        return state_.IsCancelled();
+    }
+
+    /**
+     * Returns an awaitable which writes a message and yields false if the call is broken. The message must live until
+     * the write is done.
+     */
+    auto Write(const Response &response)
+    {
+        struct Awaiter
+        {
+            bool await_ready(void) const noexcept
+            {
+                return false;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                call->write_handle_ = handle;
+                call->StartWrite(response);
+            }
+
+            bool await_resume(void) const noexcept
+            {
+                return call->write_ok_;
+            }
+
+            ServerWriteCall *call;
+            const Response *response;
+        };
+
+        return Awaiter{ this, &response };
+    }
+
+    /**
+     * Returns an awaitable which yields true after the duration, or false as soon as the call is cancelled.
+     */
+    auto Sleep(std::chrono::steady_clock::duration duration)
+    {
+        return state_.Sleep(duration);
+    }
+
+    /**
+     * Wakes the handler if it awaits Notified(), or makes its next Notified() return right away. Thread-safe, and the
+     * handler never runs on the calling thread, so it may be called under a lock.
+     */
+    void Notify(void)
+    {
+        state_.Notify();
+    }
+
+    auto Notified(void)
+    {
+        return state_.Notified();
+    }
+
+    /**
+     * Finishes the call right away with the status, e.g. to drop a slow consumer whose write does not complete. The
+     * pending operations fail, the handler is cancelled and what it returns is ignored. Thread-safe.
+     */
+    void Abort(const grpc::Status &status)
+    {
+        if (state_.TryFinish())
+        {
+            state_.Cancel();
+            this->Finish(status);
+        }
+    }
+
+    void OnWriteDone(bool ok) override
+    {
+        write_ok_ = ok;
+        write_handle_.resume();
+    }
+
+    void OnCancel(void) override
+    {
+        state_.Cancel();
+    }
+
+    void OnDone(void) override
+    {
+        if (state_.Release())
+        {
+            delete this;
+        }
+    }
+
+private:
+    ServerWriteCall(void)
+        : write_ok_(false)
+    {
+    }
+
+    template <typename Handler>
+    static Task<void> Run(ServerWriteCall *call, Handler handler)
+    {
+        // The handler's frame is gone at the end of this statement, before the call finishes.
+        const auto status = co_await handler(*call);
+        if (call->state_.TryFinish())
+        {
+            call->Finish(status);
+        }
+        if (call->state_.Release())
+        {
+            delete call;
+        }
+    }
+
+    detail::ServerCallState state_;
+    std::coroutine_handle<> write_handle_;
+    bool write_ok_;
+};
+
+/*=========================================================================*/
+
+/**
+ * @class ServerBidiCall
+ * @brief Runs a bidirectional streaming handler written as a coroutine on top of a callback reactor.
+ *
+ * Like ServerWriteCall, and Read() yields the next message or nullptr once the client is done writing. A reading side
+ * which runs next to the writing handler is started with Spawn(); as long as it only awaits Read(), it ends before the
+ * call is done, as gRPC fails the pending read when the call finishes.
+ */
+template <typename Request, typename Response>
+class ServerBidiCall final : public grpc::ServerBidiReactor<Request, Response>
+{
+public:
+    template <typename Handler>
+    static grpc::ServerBidiReactor<Request, Response> *Start(Handler handler)
+    {
+        auto *call = new ServerBidiCall();
+        Spawn(Run(call, std::move(handler)));
+        return call;
+    }
+
+    bool IsCancelled(void) const
+    {
+        return state_.IsCancelled();
+    }
+
+    /**
+     * Returns an awaitable for the next message, which yields nullptr once the client is done writing or the call is
+     * broken. The message is valid until the next call.
+     */
+    auto Read(void)
+    {
+        struct Awaiter
+        {
+            bool await_ready(void) const noexcept
+            {
+                return false;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                call->read_handle_ = handle;
+                call->StartRead(&call->request_);
+            }
+
+            Request *await_resume(void) const noexcept
+            {
+                return call->read_ok_ ? &call->request_ : nullptr;
+            }
+
+            ServerBidiCall *call;
+        };
+
+        return Awaiter{ this };
+    }
+
+    /**
+     * Returns an awaitable which writes a message and yields false if the call is broken. The message must live until
+     * the write is done.
+     */
+    auto Write(const Response &response)
+    {
+        struct Awaiter
+        {
+            bool await_ready(void) const noexcept
+            {
+                return false;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                call->write_handle_ = handle;
+                call->StartWrite(response);
+            }
+
+            bool await_resume(void) const noexcept
+            {
+                return call->write_ok_;
+            }
+
+            ServerBidiCall *call;
+            const Response *response;
+        };
+
+        return Awaiter{ this, &response };
+    }
+
+    auto Sleep(std::chrono::steady_clock::duration duration)
+    {
+        return state_.Sleep(duration);
+    }
+
+    void Notify(void)
+    {
+        state_.Notify();
+    }
+
+    auto Notified(void)
+    {
+        return state_.Notified();
+    }
+
+    void Abort(const grpc::Status &status)
+    {
+        if (state_.TryFinish())
+        {
+            state_.Cancel();
+            this->Finish(status);
+        }
+    }
+
+    void OnReadDone(bool ok) override
+    {
+        read_ok_ = ok;
+        read_handle_.resume();
+    }
+
+    void OnWriteDone(bool ok) override
+    {
+        write_ok_ = ok;
+        write_handle_.resume();
+    }
+
+    void OnCancel(void) override
+    {
+        state_.Cancel();
+    }
+
+    void OnDone(void) override
+    {
+        if (state_.Release())
+        {
+            delete this;
+        }
+    }
+
+private:
+    ServerBidiCall(void)
+        : read_ok_(false)
+        , write_ok_(false)
+    {
+    }
+
+    template <typename Handler>
+    static Task<void> Run(ServerBidiCall *call, Handler handler)
+    {
+        const auto status = co_await handler(*call);
+        if (call->state_.TryFinish())
+        {
+            call->Finish(status);
+        }
+        if (call->state_.Release())
+        {
+            delete call;
+        }
+    }
+
+    detail::ServerCallState state_;
+    Request request_;
+    std::coroutine_handle<> read_handle_;
+    std::coroutine_handle<> write_handle_;
+    bool read_ok_;
+    bool write_ok_;
+};
+
+} // namespace robl::coro
+
+/*=========================================================================*/
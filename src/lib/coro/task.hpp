@@ -0,0 +1,322 @@
+#pragma once
+
+// standard headers
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <optional>
+#include <utility>
+#include <vector>
+
+/*=========================================================================*/
+
+namespace robl::coro
+{
+
+template <typename T>
+class Task;
+
+namespace detail
+{
+
+// Resumes whoever awaits the task once it completes, by symmetric transfer, so a chain of tasks does not grow the
+// stack.
+struct FinalAwaiter
+{
+    bool await_ready(void) noexcept
+    {
+        return false;
+    }
+
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+    {
+        const auto continuation = handle.promise().continuation;
+        return continuation ? continuation : std::noop_coroutine();
+    }
+
+    void await_resume(void) noexcept
+    {
+    }
+};
+
+struct PromiseBase
+{
+    std::suspend_always initial_suspend(void) noexcept
+    {
+        return {};
+    }
+
+    FinalAwaiter final_suspend(void) noexcept
+    {
+        return {};
+    }
+
+    void unhandled_exception(void)
+    {
+        exception = std::current_exception();
+    }
+
+    std::coroutine_handle<> continuation;
+    std::exception_ptr exception;
+};
+
+} // namespace detail
+
+/**
+ * @class Task
+ * @brief A lazily started coroutine which produces a T once it is awaited.
+ *
+ * The task does not run until it is co_awaited, and it resumes its awaiter on whatever thread it completes on. A task
+ * which nobody awaits is started with Spawn().
+ */
+template <typename T>
+class Task
+{
+public:
+    struct promise_type : detail::PromiseBase
+    {
+        Task get_return_object(void)
+        {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        template <typename Value>
+        void return_value(Value &&value)
+        {
+            result.emplace(std::forward<Value>(value));
+        }
+
+        std::optional<T> result;
+    };
+
+    Task(Task &&other) noexcept
+        : handle_(std::exchange(other.handle_, nullptr))
+    {
+    }
+
+    Task &operator=(Task &&other) noexcept
+    {
+        if (this != &other)
+        {
+            if (handle_)
+            {
+                handle_.destroy();
+            }
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+
+    ~Task()
+    {
+        if (handle_)
+        {
+            handle_.destroy();
+        }
+    }
+
+    bool await_ready(void) const noexcept
+    {
+        return false;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+    {
+        handle_.promise().continuation = awaiter;
+        return handle_;
+    }
+
+    T await_resume(void)
+    {
+        auto &promise = handle_.promise();
+        if (promise.exception)
+        {
+            std::rethrow_exception(promise.exception);
+        }
+        return std::move(*promise.result);
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle)
+        : handle_(handle)
+    {
+    }
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+template <>
+class Task<void>
+{
+public:
+    struct promise_type : detail::PromiseBase
+    {
+        Task get_return_object(void)
+        {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        void return_void(void)
+        {
+        }
+    };
+
+    Task(Task &&other) noexcept
+        : handle_(std::exchange(other.handle_, nullptr))
+    {
+    }
+
+    Task &operator=(Task &&other) noexcept
+    {
+        if (this != &other)
+        {
+            if (handle_)
+            {
+                handle_.destroy();
+            }
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+
+    ~Task()
+    {
+        if (handle_)
+        {
+            handle_.destroy();
+        }
+    }
+
+    bool await_ready(void) const noexcept
+    {
+        return false;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+    {
+        handle_.promise().continuation = awaiter;
+        return handle_;
+    }
+
+    void await_resume(void)
+    {
+        if (handle_.promise().exception)
+        {
+            std::rethrow_exception(handle_.promise().exception);
+        }
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle)
+        : handle_(handle)
+    {
+    }
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+namespace detail
+{
+
+// A coroutine which starts right away and frees itself when it ends.
+struct DetachedTask
+{
+    struct promise_type
+    {
+        DetachedTask get_return_object(void) noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never initial_suspend(void) noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never final_suspend(void) noexcept
+        {
+            return {};
+        }
+
+        void return_void(void) noexcept
+        {
+        }
+
+        void unhandled_exception(void) noexcept
+        {
+            std::terminate();
+        }
+    };
+};
+
+} // namespace detail
+
+/**
+ * Starts a task on the calling thread and lets it run to completion on its own. The task must not throw.
+ */
+inline void Spawn(Task<void> task)
+{
+    [](Task<void> task) -> detail::DetachedTask { co_await std::move(task); }(std::move(task));
+}
+
+namespace detail
+{
+
+struct WhenAllState
+{
+    std::atomic<std::size_t> remaining;
+    std::coroutine_handle<> continuation;
+};
+
+inline DetachedTask RunCounted(Task<void> task, WhenAllState *state)
+{
+    co_await std::move(task);
+    if (state->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        state->continuation.resume();
+    }
+}
+
+} // namespace detail
+
+/**
+ * Starts all the tasks at once and completes when the last of them ends, on the thread it ends on. The tasks must not
+ * throw.
+ */
+inline Task<void> WhenAll(std::vector<Task<void>> tasks)
+{
+    struct Awaiter
+    {
+        bool await_ready(void) const noexcept
+        {
+            return tasks->empty();
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle)
+        {
+            // The extra count keeps the tasks which end right away from resuming the awaiter before it suspended.
+            state.continuation = handle;
+            state.remaining.store(tasks->size() + 1, std::memory_order_relaxed);
+            for (auto &task : *tasks)
+            {
+                detail::RunCounted(std::move(task), &state);
+            }
+            return state.remaining.fetch_sub(1, std::memory_order_acq_rel) != 1;
+        }
+
+        void await_resume(void) const noexcept
+        {
+        }
+
+        std::vector<Task<void>> *tasks;
+        detail::WhenAllState state;
+    };
+
+    co_await Awaiter{ &tasks, {} };
+}
+
+} // namespace robl::coro
+
+/*=========================================================================*/
@@ -0,0 +1,246 @@
+#pragma once
+
+// standard headers
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <unordered_set>
+
+/*=========================================================================*/
+
+namespace robl
+{
+
+/**
+ * @class Broadcaster
+ * @brief Fans every published value out to all of its subscribers, keeping only the latest one.
+ *
+ * The broadcaster does not queue values. A subscriber is told about every new value and is expected to keep only the
+ * newest one until it can deliver it, so a slow consumer skips intermediate values instead of building up a backlog.
+ * With Value = grpc::ByteBuffer, a message is serialized once and every subscriber takes a reference on the same
+ * slices.
+ */
+template <typename Value>
+class Broadcaster
+{
+public:
+    /**
+     * @class Subscriber
+     * @brief Receives the values of a broadcaster.
+     *
+     * The callbacks run on the publishing thread while the broadcaster is locked, so they must not block and must not
+     * call back into the broadcaster. A subscriber must be unsubscribed before it is destroyed.
+     */
+    class Subscriber
+    {
+    public:
+        virtual ~Subscriber() = default;
+
+        /**
+         * Called with every published value, and on Subscribe() with the latest one if there is any.
+         */
+        virtual void OnPublished(const Value &value) = 0;
+
+        /**
+         * Called once when the broadcaster is closed, after the last value.
+         */
+        virtual void OnClosed(void) = 0;
+    };
+
+    Broadcaster(void)
+        : has_value_(false)
+        , closed_(false)
+        , publish_count_(0)
+    {
+    }
+
+    /**
+     * Adds a subscriber and hands it the latest value, and the end of the stream if the broadcaster is closed.
+     */
+    void Subscribe(Subscriber *subscriber);
+
+    /**
+     * Removes a subscriber. Once this returns, no callback of the subscriber runs any more.
+     */
+    void Unsubscribe(Subscriber *subscriber);
+
+    /**
+     * Replaces the latest value and hands it to every subscriber. Values published after Close() are dropped.
+     */
+    void Publish(const Value &value);
+
+    /**
+     * Ends the stream. Subscribers are told after they got the last value.
+     */
+    void Close(void);
+
+    std::size_t SubscriberCount(void) const;
+    std::uint64_t PublishCount(void) const;
+
+private:
+    mutable std::mutex mutex_;
+    std::unordered_set<Subscriber *> subscribers_;
+    Value latest_;
+    bool has_value_;
+    bool closed_;
+    std::uint64_t publish_count_;
+};
+
+/**
+ * @class BlockingSubscription
+ * @brief Subscribes a synchronous handler thread to a broadcaster and lets it wait for the next value.
+ */
+template <typename Value>
+class BlockingSubscription final : public Broadcaster<Value>::Subscriber
+{
+public:
+    enum class WaitResult
+    {
+        Updated,
+        Closed,
+        Timeout,
+    };
+
+    explicit BlockingSubscription(Broadcaster<Value> &broadcaster)
+        : broadcaster_(broadcaster)
+        , pending_(false)
+        , closed_(false)
+    {
+        broadcaster_.Subscribe(this);
+    }
+
+    ~BlockingSubscription() override
+    {
+        broadcaster_.Unsubscribe(this);
+    }
+
+    /**
+     * Waits for a value which was not returned yet.
+     *
+     * @param timeout The maximum time to wait.
+     * @param value The latest value.
+     * @return Updated if a value was returned, Closed once every value was returned and the broadcaster is closed,
+     * Timeout otherwise.
+     */
+    WaitResult WaitFor(std::chrono::steady_clock::duration timeout, Value *value)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!ready_.wait_for(lock, timeout, [this]() { return pending_ || closed_; }))
+        {
+            return WaitResult::Timeout;
+        }
+        if (!pending_)
+        {
+            return WaitResult::Closed;
+        }
+
+        *value = latest_;
+        pending_ = false;
+        return WaitResult::Updated;
+    }
+
+    void OnPublished(const Value &value) override
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            latest_ = value;
+            pending_ = true;
+        }
+        ready_.notify_one();
+    }
+
+    void OnClosed(void) override
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        ready_.notify_one();
+    }
+
+private:
+    Broadcaster<Value> &broadcaster_;
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    Value latest_;
+    bool pending_;
+    bool closed_;
+};
+
+/*=========================================================================*/
+
+template <typename Value>
+void Broadcaster<Value>::Subscribe(Subscriber *subscriber)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    subscribers_.insert(subscriber);
+    if (has_value_)
+    {
+        subscriber->OnPublished(latest_);
+    }
+    if (closed_)
+    {
+        subscriber->OnClosed();
+    }
+}
+
+template <typename Value>
+void Broadcaster<Value>::Unsubscribe(Subscriber *subscriber)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    subscribers_.erase(subscriber);
+}
+
+template <typename Value>
+void Broadcaster<Value>::Publish(const Value &value)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_)
+    {
+        return;
+    }
+
+    latest_ = value;
+    has_value_ = true;
+    ++publish_count_;
+    for (auto *subscriber : subscribers_)
+    {
+        subscriber->OnPublished(latest_);
+    }
+}
+
+template <typename Value>
+void Broadcaster<Value>::Close(void)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_)
+    {
+        return;
+    }
+
+    closed_ = true;
+    for (auto *subscriber : subscribers_)
+    {
+        subscriber->OnClosed();
+    }
+}
+
+template <typename Value>
+std::size_t Broadcaster<Value>::SubscriberCount(void) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return subscribers_.size();
+}
+
+template <typename Value>
+std::uint64_t Broadcaster<Value>::PublishCount(void) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return publish_count_;
+}
+
+} // namespace robl
+
+/*=========================================================================*/
@@ -0,0 +1,221 @@
+#pragma once
+
+// standard headers
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+/*=========================================================================*/
+
+namespace robl
+{
+
+/**
+ * @class TimerService
+ * @brief Runs delayed and periodic tasks on a single timer thread.
+ *
+ * Tasks run one at a time on the timer thread, so they must be short and must not block. Long work should be handed
+ * off to another thread. One instance can drive any number of timers, e.g. every stream of a server, so a timer does
+ * not cost a thread.
+ */
+class TimerService
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using TaskId = std::uint64_t;
+
+    TimerService(void);
+    ~TimerService();
+
+    TimerService(const TimerService &) = delete;
+    TimerService &operator=(const TimerService &) = delete;
+
+    /**
+     * Returns the process-wide instance, started on first use.
+     */
+    static TimerService &Shared(void);
+
+    /**
+     * Runs the task once after the delay.
+     *
+     * @param delay The time to wait.
+     * @param task The task to be run on the timer thread.
+     * @return The id to cancel the task with.
+     */
+    TaskId Schedule(Clock::duration delay, std::function<void()> task);
+
+    /**
+     * Runs the task every period, first after one period. Runs are scheduled at a fixed rate, and runs missed while
+     * the timer thread was busy are skipped rather than run back to back.
+     *
+     * @param period The interval between the runs.
+     * @param task The task to be run on the timer thread.
+     * @return The id to cancel the task with.
+     */
+    TaskId ScheduleEvery(Clock::duration period, std::function<void()> task);
+
+    /**
+     * Cancels a task. If the task is running on the timer thread, this waits until the run ends, unless it is called
+     * from the task itself. The task does not run again once this returns.
+     *
+     * @param id The id of the task.
+     * @return true if the task was still scheduled, false otherwise.
+     */
+    bool Cancel(TaskId id);
+
+private:
+    struct Task
+    {
+        std::function<void()> run;
+        Clock::duration period; // zero for one-shot tasks
+        std::multimap<Clock::time_point, TaskId>::iterator deadline;
+    };
+
+    TaskId Add(Clock::duration delay, Clock::duration period, std::function<void()> task);
+    void Run(void);
+
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::condition_variable run_done_;
+    std::multimap<Clock::time_point, TaskId> deadlines_;
+    std::unordered_map<TaskId, Task> tasks_;
+    TaskId next_id_;
+    TaskId running_id_; // 0 when no task runs
+    bool stopping_;
+    std::thread thread_;
+};
+
+/*=========================================================================*/
+
+inline TimerService::TimerService(void)
+    : next_id_(1)
+    , running_id_(0)
+    , stopping_(false)
+{
+    thread_ = std::thread(&TimerService::Run, this);
+}
+
+inline TimerService::~TimerService()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wakeup_.notify_one();
+    thread_.join();
+}
+
+inline TimerService &TimerService::Shared(void)
+{
+    static TimerService shared;
+    return shared;
+}
+
+inline TimerService::TaskId TimerService::Schedule(Clock::duration delay, std::function<void()> task)
+{
+    return Add(delay, Clock::duration::zero(), std::move(task));
+}
+
+inline TimerService::TaskId TimerService::ScheduleEvery(Clock::duration period, std::function<void()> task)
+{
+    return Add(period, period, std::move(task));
+}
+
+inline TimerService::TaskId TimerService::Add(Clock::duration delay, Clock::duration period,
+                                              std::function<void()> task)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    const auto id = next_id_++;
+    const auto deadline = deadlines_.emplace(Clock::now() + delay, id);
+    tasks_.emplace(id, Task{ std::move(task), period, deadline });
+
+    // Only an earlier deadline changes how long the timer thread sleeps.
+    const auto is_earliest = deadline == deadlines_.begin();
+    lock.unlock();
+    if (is_earliest)
+    {
+        wakeup_.notify_one();
+    }
+    return id;
+}
+
+inline bool TimerService::Cancel(TaskId id)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    const auto it = tasks_.find(id);
+    const auto scheduled = it != tasks_.end();
+    if (scheduled)
+    {
+        deadlines_.erase(it->second.deadline);
+        tasks_.erase(it);
+    }
+
+    if (std::this_thread::get_id() != thread_.get_id())
+    {
+        run_done_.wait(lock, [this, id]() { return running_id_ != id; });
+    }
+    return scheduled;
+}
+
+inline void TimerService::Run(void)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (!stopping_)
+    {
+        if (deadlines_.empty())
+        {
+            wakeup_.wait(lock);
+            continue;
+        }
+
+        const auto next = deadlines_.begin();
+        const auto now = Clock::now();
+        if (next->first > now)
+        {
+            wakeup_.wait_until(lock, next->first);
+            continue;
+        }
+
+        const auto id = next->second;
+        const auto deadline = next->first;
+        deadlines_.erase(next);
+
+        auto task = tasks_.find(id);
+        auto run = std::function<void()>();
+        if (task->second.period > Clock::duration::zero())
+        {
+            // Keep the fixed rate, but skip the runs which are already overdue.
+            auto following = deadline + task->second.period;
+            if (following <= now)
+            {
+                following += ((now - following) / task->second.period + 1) * task->second.period;
+            }
+            task->second.deadline = deadlines_.emplace(following, id);
+            run = task->second.run;
+        }
+        else
+        {
+            run = std::move(task->second.run);
+            tasks_.erase(task);
+        }
+
+        running_id_ = id;
+        lock.unlock();
+        run();
+        lock.lock();
+        running_id_ = 0;
+        run_done_.notify_all();
+    }
+}
+
+} // namespace robl
+
+/*=========================================================================*/
@@ -0,0 +1,418 @@
+#pragma once
+
+// standard headers
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+// grpc headers
+#include <robl/api/geometry.pb.h>
+
+#if defined(ROBL_GEOMETRY_WITH_EIGEN)
+#include <Eigen/Core>
+#endif
+
+/*=========================================================================*/
+
+namespace robl::geometry
+{
+
+/**
+ * @class StridedSpan
+ * @brief A non-owning view of count elements placed stride elements apart.
+ *
+ * T may be const-qualified for read-only views.
+ */
+template <typename T>
+class StridedSpan
+{
+public:
+    StridedSpan(void)
+        : data_(nullptr)
+        , size_(0)
+        , stride_(1)
+    {
+    }
+
+    StridedSpan(T *data, std::size_t size, std::ptrdiff_t stride = 1)
+        : data_(data)
+        , size_(size)
+        , stride_(stride)
+    {
+    }
+
+    // A mutable span converts to a read-only one.
+    template <typename U, typename = std::enable_if_t<std::is_same_v<const U, T>>>
+    StridedSpan(const StridedSpan<U> &other)
+        : StridedSpan(other.data(), other.size(), other.stride())
+    {
+    }
+
+    T &operator[](std::size_t i) const
+    {
+        return data_[static_cast<std::ptrdiff_t>(i) * stride_];
+    }
+
+    T *data(void) const
+    {
+        return data_;
+    }
+
+    std::size_t size(void) const
+    {
+        return size_;
+    }
+
+    std::ptrdiff_t stride(void) const
+    {
+        return stride_;
+    }
+
+    bool empty(void) const
+    {
+        return size_ == 0;
+    }
+
+    bool IsContiguous(void) const
+    {
+        return stride_ == 1;
+    }
+
+private:
+    T *data_;
+    std::size_t size_;
+    std::ptrdiff_t stride_;
+};
+
+/**
+ * @class MatrixView
+ * @brief A non-owning view of a dense matrix with arbitrary row and column strides.
+ *
+ * Views of the geometry.proto matrices are row-major, i.e. row_stride == cols and col_stride == 1. Transposing or
+ * taking a block only changes the strides, so neither copies an element. T may be const-qualified for read-only
+ * views.
+ */
+template <typename T>
+class MatrixView
+{
+public:
+    MatrixView(void)
+        : data_(nullptr)
+        , rows_(0)
+        , cols_(0)
+        , row_stride_(0)
+        , col_stride_(1)
+    {
+    }
+
+    MatrixView(T *data, std::size_t rows, std::size_t cols, std::ptrdiff_t row_stride, std::ptrdiff_t col_stride = 1)
+        : data_(data)
+        , rows_(rows)
+        , cols_(cols)
+        , row_stride_(row_stride)
+        , col_stride_(col_stride)
+    {
+    }
+
+    // A mutable view converts to a read-only one.
+    template <typename U, typename = std::enable_if_t<std::is_same_v<const U, T>>>
+    MatrixView(const MatrixView<U> &other)
+        : MatrixView(other.data(), other.rows(), other.cols(), other.row_stride(), other.col_stride())
+    {
+    }
+
+    T &operator()(std::size_t row, std::size_t col) const
+    {
+        return data_[static_cast<std::ptrdiff_t>(row) * row_stride_ + static_cast<std::ptrdiff_t>(col) * col_stride_];
+    }
+
+    StridedSpan<T> Row(std::size_t row) const
+    {
+        return StridedSpan<T>(&(*this)(row, 0), cols_, col_stride_);
+    }
+
+    StridedSpan<T> Col(std::size_t col) const
+    {
+        return StridedSpan<T>(&(*this)(0, col), rows_, row_stride_);
+    }
+
+    MatrixView Transposed(void) const
+    {
+        return MatrixView(data_, cols_, rows_, col_stride_, row_stride_);
+    }
+
+    MatrixView Block(std::size_t row, std::size_t col, std::size_t rows, std::size_t cols) const
+    {
+        return MatrixView(&(*this)(row, col), rows, cols, row_stride_, col_stride_);
+    }
+
+    T *data(void) const
+    {
+        return data_;
+    }
+
+    std::size_t rows(void) const
+    {
+        return rows_;
+    }
+
+    std::size_t cols(void) const
+    {
+        return cols_;
+    }
+
+    std::size_t size(void) const
+    {
+        return rows_ * cols_;
+    }
+
+    std::ptrdiff_t row_stride(void) const
+    {
+        return row_stride_;
+    }
+
+    std::ptrdiff_t col_stride(void) const
+    {
+        return col_stride_;
+    }
+
+    /**
+     * Returns true if the elements are stored row by row without gaps, so data() can be used as a flat array.
+     */
+    bool IsContiguous(void) const
+    {
+        return col_stride_ == 1 && (rows_ <= 1 || row_stride_ == static_cast<std::ptrdiff_t>(cols_));
+    }
+
+private:
+    T *data_;
+    std::size_t rows_;
+    std::size_t cols_;
+    std::ptrdiff_t row_stride_;
+    std::ptrdiff_t col_stride_;
+};
+
+/*=========================================================================*/
+
+/**
+ * Maps a geometry.proto matrix message to its element type. Matrix, Matrixf, MatrixInt64 and MatrixInt32 are
+ * supported.
+ */
+template <typename MatrixT>
+struct MatrixTraits;
+
+template <>
+struct MatrixTraits<robl::api::Matrix>
+{
+    using Scalar = double;
+};
+
+template <>
+struct MatrixTraits<robl::api::Matrixf>
+{
+    using Scalar = float;
+};
+
+template <>
+struct MatrixTraits<robl::api::MatrixInt64>
+{
+    using Scalar = std::int64_t;
+};
+
+template <>
+struct MatrixTraits<robl::api::MatrixInt32>
+{
+    using Scalar = std::int32_t;
+};
+
+template <typename MatrixT>
+using MatrixScalar = typename MatrixTraits<MatrixT>::Scalar;
+
+namespace detail
+{
+
+template <typename MatrixT>
+bool HasValidShape(const MatrixT &matrix)
+{
+    return matrix.rows() >= 0 && matrix.cols() >= 0 &&
+           static_cast<std::int64_t>(matrix.rows()) * matrix.cols() == matrix.values_size();
+}
+
+} // namespace detail
+
+/**
+ * Views the values of a matrix message without copying them.
+ *
+ * @param matrix The matrix message.
+ * @param view The row-major view of the values. It stays valid as long as the values field is not modified.
+ * @return false if rows * cols does not match the number of the values, true otherwise.
+ */
+template <typename MatrixT>
+bool ViewMatrix(const MatrixT &matrix, MatrixView<const MatrixScalar<MatrixT>> *view)
+{
+    if (!detail::HasValidShape(matrix))
+    {
+        return false;
+    }
+
+    *view = MatrixView<const MatrixScalar<MatrixT>>(matrix.values().data(), matrix.rows(), matrix.cols(),
+                                                     matrix.cols());
+    return true;
+}
+
+/**
+ * Views the values of a matrix message for writing in place.
+ *
+ * @param matrix The matrix message.
+ * @param view The row-major view of the values. It stays valid as long as the values field is not resized.
+ * @return false if rows * cols does not match the number of the values, true otherwise.
+ */
+template <typename MatrixT>
+bool MutableViewMatrix(MatrixT *matrix, MatrixView<MatrixScalar<MatrixT>> *view)
+{
+    if (!detail::HasValidShape(*matrix))
+    {
+        return false;
+    }
+
+    *view = MatrixView<MatrixScalar<MatrixT>>(matrix->mutable_values()->mutable_data(), matrix->rows(),
+                                              matrix->cols(), matrix->cols());
+    return true;
+}
+
+/**
+ * Sets the shape of a matrix message and sizes its values to match, so the caller can fill the view in place. The
+ * values field keeps its capacity, so a message reused across calls of the same shape does not allocate. Values which
+ * were already there are kept, new ones are zero.
+ *
+ * @param matrix The matrix message.
+ * @param rows, cols The new shape.
+ * @param view The row-major view of the values.
+ * @return false if a dimension is negative or rows * cols is beyond the size of a repeated field, in which case the
+ * message is left as it was, true otherwise.
+ */
+template <typename MatrixT>
+bool ResizeMatrix(MatrixT *matrix, std::int32_t rows, std::int32_t cols, MatrixView<MatrixScalar<MatrixT>> *view)
+{
+    const auto size = static_cast<std::int64_t>(rows) * cols;
+    if (rows < 0 || cols < 0 || size > std::numeric_limits<int>::max())
+    {
+        return false;
+    }
+
+    auto *values = matrix->mutable_values();
+    if (values->size() > size)
+    {
+        values->Truncate(static_cast<int>(size));
+    }
+    else
+    {
+        values->Reserve(static_cast<int>(size));
+        values->Resize(static_cast<int>(size), MatrixScalar<MatrixT>());
+    }
+
+    matrix->set_rows(rows);
+    matrix->set_cols(cols);
+    *view = MatrixView<MatrixScalar<MatrixT>>(values->mutable_data(), rows, cols, cols);
+    return true;
+}
+
+/**
+ * Copies a view of any layout into a matrix message, e.g. a transposed view or a block of a bigger matrix.
+ *
+ * @param source The values to be copied.
+ * @param matrix The matrix message.
+ * @return false if the shape of the view does not fit a matrix message, true otherwise.
+ */
+template <typename MatrixT, typename T>
+bool AssignMatrix(const MatrixView<T> &source, MatrixT *matrix)
+{
+    constexpr auto max_dimension = static_cast<std::size_t>(std::numeric_limits<std::int32_t>::max());
+    auto target = MatrixView<MatrixScalar<MatrixT>>();
+    if (source.rows() > max_dimension || source.cols() > max_dimension ||
+        !ResizeMatrix(matrix, static_cast<std::int32_t>(source.rows()), static_cast<std::int32_t>(source.cols()),
+                      &target))
+    {
+        return false;
+    }
+
+    for (auto row = std::size_t(0); row < source.rows(); ++row)
+    {
+        for (auto col = std::size_t(0); col < source.cols(); ++col)
+        {
+            target(row, col) = static_cast<MatrixScalar<MatrixT>>(source(row, col));
+        }
+    }
+    return true;
+}
+
+/**
+ * Views the values of a Vector message without copying them.
+ */
+inline StridedSpan<const double> ViewVector(const robl::api::Vector &vector)
+{
+    return StridedSpan<const double>(vector.values().data(), vector.values_size());
+}
+
+/**
+ * Sizes the values of a Vector message, keeping their capacity, and views them for writing in place.
+ */
+inline StridedSpan<double> ResizeVector(robl::api::Vector *vector, std::size_t size)
+{
+    auto *values = vector->mutable_values();
+    if (values->size() > static_cast<int>(size))
+    {
+        values->Truncate(static_cast<int>(size));
+    }
+    else
+    {
+        values->Reserve(static_cast<int>(size));
+        values->Resize(static_cast<int>(size), 0.0);
+    }
+
+    return StridedSpan<double>(values->mutable_data(), size);
+}
+
+/*=========================================================================*/
+
+#if defined(ROBL_GEOMETRY_WITH_EIGEN)
+
+template <typename T>
+using EigenMatrixMap =
+    Eigen::Map<std::conditional_t<std::is_const_v<T>,
+                                  const Eigen::Matrix<std::remove_const_t<T>, Eigen::Dynamic, Eigen::Dynamic>,
+                                  Eigen::Matrix<std::remove_const_t<T>, Eigen::Dynamic, Eigen::Dynamic>>,
+               Eigen::Unaligned, Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>>;
+
+template <typename T>
+using EigenVectorMap =
+    Eigen::Map<std::conditional_t<std::is_const_v<T>, const Eigen::Matrix<std::remove_const_t<T>, Eigen::Dynamic, 1>,
+                                  Eigen::Matrix<std::remove_const_t<T>, Eigen::Dynamic, 1>>,
+               Eigen::Unaligned, Eigen::InnerStride<Eigen::Dynamic>>;
+
+/**
+ * Maps a view onto an Eigen matrix expression which shares its storage. The map is column-major with the strides
+ * swapped, which addresses the same elements as the row-major view.
+ */
+template <typename T>
+EigenMatrixMap<T> AsEigen(const MatrixView<T> &view)
+{
+    return EigenMatrixMap<T>(view.data(), view.rows(), view.cols(),
+                             Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>(view.col_stride(), view.row_stride()));
+}
+
+/**
+ * Maps a span onto an Eigen column vector expression which shares its storage.
+ */
+template <typename T>
+EigenVectorMap<T> AsEigen(const StridedSpan<T> &span)
+{
+    return EigenVectorMap<T>(span.data(), span.size(), Eigen::InnerStride<Eigen::Dynamic>(span.stride()));
+}
+
+#endif
+
+} // namespace robl::geometry
+
+/*=========================================================================*/
@@ -0,0 +1,232 @@
+// standard headers
+#include <algorithm>
+#include <cmath>
+
+// project headers
+#include "geometry/point_kernels.hpp"
+#include "geometry/simd_dispatch.hpp"
+#include "geometry/worker_pool.hpp"
+
+/*=========================================================================*/
+
+namespace robl::geometry
+{
+
+namespace
+{
+
+struct Affine3
+{
+    float r[3][3];
+    float t[3];
+};
+
+struct Affine2
+{
+    float c;
+    float s;
+    float tx;
+    float ty;
+};
+
+/**
+ * Runs fn(begin, end) over [0, count), split across the shared worker pool once the batch is large enough to amortize
+ * handing it over. Chunk boundaries are multiples of 16 points, so every chunk but the last runs full vectors only.
+ */
+template <typename Fn>
+void ParallelFor(std::size_t count, Fn &&fn)
+{
+    constexpr auto parallel_threshold = std::size_t(1) << 20;
+    constexpr auto chunk_size = std::size_t(1) << 18;
+
+    auto &pool = WorkerPool::Shared();
+    if (count < parallel_threshold || pool.Size() == 0)
+    {
+        fn(std::size_t(0), count);
+        return;
+    }
+
+    pool.ParallelFor(count, chunk_size, fn);
+}
+
+void Transform3Scalar(const Affine3 &a, const float *x, const float *y, const float *z, float *out_x, float *out_y,
+                      float *out_z, std::size_t begin, std::size_t end)
+{
+    for (auto i = begin; i < end; ++i)
+    {
+        const auto px = x[i], py = y[i], pz = z[i];
+        out_x[i] = a.r[0][0] * px + a.r[0][1] * py + a.r[0][2] * pz + a.t[0];
+        out_y[i] = a.r[1][0] * px + a.r[1][1] * py + a.r[1][2] * pz + a.t[1];
+        out_z[i] = a.r[2][0] * px + a.r[2][1] * py + a.r[2][2] * pz + a.t[2];
+    }
+}
+
+void Transform2Scalar(const Affine2 &a, const float *x, const float *y, float *out_x, float *out_y, std::size_t begin,
+                      std::size_t end)
+{
+    for (auto i = begin; i < end; ++i)
+    {
+        const auto px = x[i], py = y[i];
+        out_x[i] = a.c * px - a.s * py + a.tx;
+        out_y[i] = a.s * px + a.c * py + a.ty;
+    }
+}
+
+#if defined(ROBL_GEOMETRY_X86)
+
+__attribute__((target("sse2"))) void Transform3Sse2(const Affine3 &a, const float *x, const float *y, const float *z,
+                                                    float *out_x, float *out_y, float *out_z, std::size_t begin,
+                                                    std::size_t end)
+{
+    const auto r00 = _mm_set1_ps(a.r[0][0]), r01 = _mm_set1_ps(a.r[0][1]), r02 = _mm_set1_ps(a.r[0][2]);
+    const auto r10 = _mm_set1_ps(a.r[1][0]), r11 = _mm_set1_ps(a.r[1][1]), r12 = _mm_set1_ps(a.r[1][2]);
+    const auto r20 = _mm_set1_ps(a.r[2][0]), r21 = _mm_set1_ps(a.r[2][1]), r22 = _mm_set1_ps(a.r[2][2]);
+    const auto tx = _mm_set1_ps(a.t[0]), ty = _mm_set1_ps(a.t[1]), tz = _mm_set1_ps(a.t[2]);
+
+    auto i = begin;
+    for (; i + 4 <= end; i += 4)
+    {
+        const auto px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+        const auto ox = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r00, px), _mm_mul_ps(r01, py)),
+                                   _mm_add_ps(_mm_mul_ps(r02, pz), tx));
+        const auto oy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r10, px), _mm_mul_ps(r11, py)),
+                                   _mm_add_ps(_mm_mul_ps(r12, pz), ty));
+        const auto oz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r20, px), _mm_mul_ps(r21, py)),
+                                   _mm_add_ps(_mm_mul_ps(r22, pz), tz));
+        _mm_storeu_ps(out_x + i, ox);
+        _mm_storeu_ps(out_y + i, oy);
+        _mm_storeu_ps(out_z + i, oz);
+    }
+    Transform3Scalar(a, x, y, z, out_x, out_y, out_z, i, end);
+}
+
+__attribute__((target("avx2,fma"))) void Transform3Avx2(const Affine3 &a, const float *x, const float *y,
+                                                        const float *z, float *out_x, float *out_y, float *out_z,
+                                                        std::size_t begin, std::size_t end)
+{
+    const auto r00 = _mm256_set1_ps(a.r[0][0]), r01 = _mm256_set1_ps(a.r[0][1]), r02 = _mm256_set1_ps(a.r[0][2]);
+    const auto r10 = _mm256_set1_ps(a.r[1][0]), r11 = _mm256_set1_ps(a.r[1][1]), r12 = _mm256_set1_ps(a.r[1][2]);
+    const auto r20 = _mm256_set1_ps(a.r[2][0]), r21 = _mm256_set1_ps(a.r[2][1]), r22 = _mm256_set1_ps(a.r[2][2]);
+    const auto tx = _mm256_set1_ps(a.t[0]), ty = _mm256_set1_ps(a.t[1]), tz = _mm256_set1_ps(a.t[2]);
+
+    auto i = begin;
+    for (; i + 8 <= end; i += 8)
+    {
+        const auto px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+        const auto ox = _mm256_fmadd_ps(r00, px, _mm256_fmadd_ps(r01, py, _mm256_fmadd_ps(r02, pz, tx)));
+        const auto oy = _mm256_fmadd_ps(r10, px, _mm256_fmadd_ps(r11, py, _mm256_fmadd_ps(r12, pz, ty)));
+        const auto oz = _mm256_fmadd_ps(r20, px, _mm256_fmadd_ps(r21, py, _mm256_fmadd_ps(r22, pz, tz)));
+        _mm256_storeu_ps(out_x + i, ox);
+        _mm256_storeu_ps(out_y + i, oy);
+        _mm256_storeu_ps(out_z + i, oz);
+    }
+    Transform3Scalar(a, x, y, z, out_x, out_y, out_z, i, end);
+}
+
+__attribute__((target("sse2"))) void Transform2Sse2(const Affine2 &a, const float *x, const float *y, float *out_x,
+                                                    float *out_y, std::size_t begin, std::size_t end)
+{
+    const auto c = _mm_set1_ps(a.c), s = _mm_set1_ps(a.s);
+    const auto tx = _mm_set1_ps(a.tx), ty = _mm_set1_ps(a.ty);
+
+    auto i = begin;
+    for (; i + 4 <= end; i += 4)
+    {
+        const auto px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i);
+        _mm_storeu_ps(out_x + i, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(c, px), _mm_mul_ps(s, py)), tx));
+        _mm_storeu_ps(out_y + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(s, px), _mm_mul_ps(c, py)), ty));
+    }
+    Transform2Scalar(a, x, y, out_x, out_y, i, end);
+}
+
+__attribute__((target("avx2,fma"))) void Transform2Avx2(const Affine2 &a, const float *x, const float *y,
+                                                        float *out_x, float *out_y, std::size_t begin,
+                                                        std::size_t end)
+{
+    const auto c = _mm256_set1_ps(a.c), s = _mm256_set1_ps(a.s);
+    const auto tx = _mm256_set1_ps(a.tx), ty = _mm256_set1_ps(a.ty);
+
+    auto i = begin;
+    for (; i + 8 <= end; i += 8)
+    {
+        const auto px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i);
+        _mm256_storeu_ps(out_x + i, _mm256_fmadd_ps(c, px, _mm256_fnmadd_ps(s, py, tx)));
+        _mm256_storeu_ps(out_y + i, _mm256_fmadd_ps(s, px, _mm256_fmadd_ps(c, py, ty)));
+    }
+    Transform2Scalar(a, x, y, out_x, out_y, i, end);
+}
+
+#endif
+
+} // namespace
+
+/*=========================================================================*/
+
+void TransformPoints(const Pose3 &pose, const float *x, const float *y, const float *z, float *out_x, float *out_y,
+                     float *out_z, std::size_t count)
+{
+    const auto rotation = pose.RotationMatrix();
+    auto affine = Affine3();
+    std::copy(&rotation.m[0][0], &rotation.m[0][0] + 9, &affine.r[0][0]);
+    affine.t[0] = static_cast<float>(pose.tx);
+    affine.t[1] = static_cast<float>(pose.ty);
+    affine.t[2] = static_cast<float>(pose.tz);
+
+    switch (DetectSimdLevel())
+    {
+#if defined(ROBL_GEOMETRY_X86)
+    case SimdLevel::Avx2:
+        ParallelFor(count, [&](std::size_t begin, std::size_t end) {
+            Transform3Avx2(affine, x, y, z, out_x, out_y, out_z, begin, end);
+        });
+        return;
+    case SimdLevel::Sse2:
+        ParallelFor(count, [&](std::size_t begin, std::size_t end) {
+            Transform3Sse2(affine, x, y, z, out_x, out_y, out_z, begin, end);
+        });
+        return;
+#endif
+    default:
+        ParallelFor(count, [&](std::size_t begin, std::size_t end) {
+            Transform3Scalar(affine, x, y, z, out_x, out_y, out_z, begin, end);
+        });
+        return;
+    }
+}
+
+void TransformPoints(const Pose2 &pose, const float *x, const float *y, float *out_x, float *out_y,
+                     std::size_t count)
+{
+    const auto affine = Affine2{ static_cast<float>(std::cos(pose.angle)), static_cast<float>(std::sin(pose.angle)),
+                                 static_cast<float>(pose.x), static_cast<float>(pose.y) };
+
+    switch (DetectSimdLevel())
+    {
+#if defined(ROBL_GEOMETRY_X86)
+    case SimdLevel::Avx2:
+        ParallelFor(count, [&](std::size_t begin, std::size_t end) {
+            Transform2Avx2(affine, x, y, out_x, out_y, begin, end);
+        });
+        return;
+    case SimdLevel::Sse2:
+        ParallelFor(count, [&](std::size_t begin, std::size_t end) {
+            Transform2Sse2(affine, x, y, out_x, out_y, begin, end);
+        });
+        return;
+#endif
+    default:
+        ParallelFor(count, [&](std::size_t begin, std::size_t end) {
+            Transform2Scalar(affine, x, y, out_x, out_y, begin, end);
+        });
+        return;
+    }
+}
+
+const char *ActivePointKernel(void)
+{
+    return SimdLevelName(DetectSimdLevel());
+}
+
+} // namespace robl::geometry
+
+/*=========================================================================*/
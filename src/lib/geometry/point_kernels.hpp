@@ -0,0 +1,47 @@
+#pragma once
+
+// standard headers
+#include <cstddef>
+
+// project headers
+#include "geometry/pose.hpp"
+
+/*=========================================================================*/
+
+namespace robl::geometry
+{
+
+/**
+ * Transforms points stored as separate x, y and z columns. The output columns may alias the input columns.
+ *
+ * The kernel is picked once at runtime from the instruction sets of the CPU (AVX2 with FMA, SSE2 or plain C++), and
+ * batches of a million points or more are split across the shared WorkerPool.
+ *
+ * @param pose The transform to be applied.
+ * @param x, y, z The input columns.
+ * @param out_x, out_y, out_z The output columns.
+ * @param count The number of points.
+ */
+void TransformPoints(const Pose3 &pose, const float *x, const float *y, const float *z, float *out_x, float *out_y,
+                     float *out_z, std::size_t count);
+
+/**
+ * Transforms points of the XY plane stored as separate x and y columns. The output columns may alias the input
+ * columns.
+ *
+ * @param pose The transform to be applied.
+ * @param x, y The input columns.
+ * @param out_x, out_y The output columns.
+ * @param count The number of points.
+ */
+void TransformPoints(const Pose2 &pose, const float *x, const float *y, float *out_x, float *out_y,
+                     std::size_t count);
+
+/**
+ * Returns the name of the kernel picked for this CPU: "avx2", "sse2" or "scalar".
+ */
+const char *ActivePointKernel(void);
+
+} // namespace robl::geometry
+
+/*=========================================================================*/
@@ -0,0 +1,150 @@
+#pragma once
+
+// standard headers
+#include <cmath>
+
+// grpc headers
+#include <robl/api/geometry.pb.h>
+
+/*=========================================================================*/
+
+namespace robl::geometry
+{
+
+/**
+ * @struct Rotation3
+ * @brief A row-major 3x3 rotation matrix in single precision, the form the point kernels consume.
+ */
+struct Rotation3
+{
+    float m[3][3];
+};
+
+/**
+ * @struct Pose3
+ * @brief A rigid transform made of a unit quaternion and a translation, kept in double precision so long pose chains
+ * do not drift.
+ */
+struct Pose3
+{
+    double qx = 0.0;
+    double qy = 0.0;
+    double qz = 0.0;
+    double qw = 1.0;
+    double tx = 0.0;
+    double ty = 0.0;
+    double tz = 0.0;
+
+    /**
+     * Converts a SE3Pose message. An unset rotation is the identity.
+     *
+     * @param pose The pose message.
+     * @param out The converted pose.
+     * @return false if the rotation is set but cannot be normalized, true otherwise.
+     */
+    static bool FromProto(const robl::api::SE3Pose &pose, Pose3 *out)
+    {
+        out->tx = pose.position().x();
+        out->ty = pose.position().y();
+        out->tz = pose.position().z();
+        if (!pose.has_rotation())
+        {
+            out->qx = out->qy = out->qz = 0.0;
+            out->qw = 1.0;
+            return true;
+        }
+
+        const auto &q = pose.rotation();
+        const auto norm = std::sqrt(double(q.x()) * q.x() + double(q.y()) * q.y() + double(q.z()) * q.z() +
+                                    double(q.w()) * q.w());
+        if (!(norm > 1e-12) || !std::isfinite(norm))
+        {
+            return false;
+        }
+
+        out->qx = q.x() / norm;
+        out->qy = q.y() / norm;
+        out->qz = q.z() / norm;
+        out->qw = q.w() / norm;
+        return true;
+    }
+
+    void ToProto(robl::api::SE3Pose *pose) const
+    {
+        pose->mutable_position()->set_x(static_cast<float>(tx));
+        pose->mutable_position()->set_y(static_cast<float>(ty));
+        pose->mutable_position()->set_z(static_cast<float>(tz));
+        pose->mutable_rotation()->set_x(static_cast<float>(qx));
+        pose->mutable_rotation()->set_y(static_cast<float>(qy));
+        pose->mutable_rotation()->set_z(static_cast<float>(qz));
+        pose->mutable_rotation()->set_w(static_cast<float>(qw));
+    }
+
+    /**
+     * Returns this * rhs, i.e. a_tform_c for this = a_tform_b and rhs = b_tform_c.
+     */
+    Pose3 operator*(const Pose3 &rhs) const
+    {
+        auto out = Pose3();
+        out.qw = qw * rhs.qw - qx * rhs.qx - qy * rhs.qy - qz * rhs.qz;
+        out.qx = qw * rhs.qx + qx * rhs.qw + qy * rhs.qz - qz * rhs.qy;
+        out.qy = qw * rhs.qy - qx * rhs.qz + qy * rhs.qw + qz * rhs.qx;
+        out.qz = qw * rhs.qz + qx * rhs.qy - qy * rhs.qx + qz * rhs.qw;
+
+        Apply(rhs.tx, rhs.ty, rhs.tz, &out.tx, &out.ty, &out.tz);
+        return out;
+    }
+
+    /**
+     * Transforms a single point.
+     */
+    void Apply(double x, double y, double z, double *out_x, double *out_y, double *out_z) const
+    {
+        // t + v + 2w(q x v) + 2(q x (q x v))
+        const auto cx = 2.0 * (qy * z - qz * y);
+        const auto cy = 2.0 * (qz * x - qx * z);
+        const auto cz = 2.0 * (qx * y - qy * x);
+        *out_x = tx + x + qw * cx + (qy * cz - qz * cy);
+        *out_y = ty + y + qw * cy + (qz * cx - qx * cz);
+        *out_z = tz + z + qw * cz + (qx * cy - qy * cx);
+    }
+
+    Rotation3 RotationMatrix(void) const
+    {
+        const auto xx = qx * qx, yy = qy * qy, zz = qz * qz;
+        const auto xy = qx * qy, xz = qx * qz, yz = qy * qz;
+        const auto wx = qw * qx, wy = qw * qy, wz = qw * qz;
+
+        auto r = Rotation3();
+        r.m[0][0] = static_cast<float>(1.0 - 2.0 * (yy + zz));
+        r.m[0][1] = static_cast<float>(2.0 * (xy - wz));
+        r.m[0][2] = static_cast<float>(2.0 * (xz + wy));
+        r.m[1][0] = static_cast<float>(2.0 * (xy + wz));
+        r.m[1][1] = static_cast<float>(1.0 - 2.0 * (xx + zz));
+        r.m[1][2] = static_cast<float>(2.0 * (yz - wx));
+        r.m[2][0] = static_cast<float>(2.0 * (xz - wy));
+        r.m[2][1] = static_cast<float>(2.0 * (yz + wx));
+        r.m[2][2] = static_cast<float>(1.0 - 2.0 * (xx + yy));
+        return r;
+    }
+};
+
+/**
+ * @struct Pose2
+ * @brief A rigid transform within the XY plane.
+ */
+struct Pose2
+{
+    double x = 0.0;
+    double y = 0.0;
+    double angle = 0.0;
+
+    static Pose2 FromProto(const robl::api::SE2Pose &pose)
+    {
+        return Pose2{ pose.position().x(), pose.position().y(), pose.angle() };
+    }
+};
+
+} // namespace robl::geometry
+
+/*=========================================================================*/
@@ -0,0 +1,58 @@
+#pragma once
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ROBL_GEOMETRY_X86 1
+#endif
+
+/*=========================================================================*/
+
+namespace robl::geometry
+{
+
+enum class SimdLevel
+{
+    Scalar,
+    Sse2,
+    Avx2, // AVX2 together with FMA
+};
+
+/**
+ * Returns the widest instruction set the kernels of this library can use on this CPU. It is detected once.
+ */
+inline SimdLevel DetectSimdLevel(void)
+{
+    static const auto level = []() {
+#if defined(ROBL_GEOMETRY_X86)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        {
+            return SimdLevel::Avx2;
+        }
+        if (__builtin_cpu_supports("sse2"))
+        {
+            return SimdLevel::Sse2;
+        }
+#endif
+        return SimdLevel::Scalar;
+    }();
+
+    return level;
+}
+
+inline const char *SimdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::Avx2:
+        return "avx2";
+    case SimdLevel::Sse2:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
+
+} // namespace robl::geometry
+
+/*=========================================================================*/
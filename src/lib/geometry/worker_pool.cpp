@@ -0,0 +1,131 @@
+// standard headers
+#include <algorithm>
+#include <atomic>
+
+// project headers
+#include "geometry/worker_pool.hpp"
+
+/*=========================================================================*/
+
+namespace robl::geometry
+{
+
+struct WorkerPool::Batch
+{
+    Batch(std::size_t count, std::size_t chunk_size, const std::function<void(std::size_t, std::size_t)> &fn)
+        : fn(fn)
+        , count(count)
+        , chunk_size(chunk_size)
+        , chunks((count + chunk_size - 1) / chunk_size)
+        , next(0)
+        , done(0)
+    {
+    }
+
+    /**
+     * Runs chunks until none is left. fn is only called for a claimed chunk, so a copy of the batch still queued
+     * after its call returned never touches it.
+     */
+    void RunChunks(void)
+    {
+        for (auto chunk = next.fetch_add(1); chunk < chunks; chunk = next.fetch_add(1))
+        {
+            const auto begin = chunk * chunk_size;
+            fn(begin, std::min(count, begin + chunk_size));
+            if (done.fetch_add(1) + 1 == chunks)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished.notify_one();
+            }
+        }
+    }
+
+    const std::function<void(std::size_t, std::size_t)> &fn;
+    const std::size_t count;
+    const std::size_t chunk_size;
+    const std::size_t chunks;
+    std::atomic<std::size_t> next;
+    std::atomic<std::size_t> done;
+    std::mutex mutex;
+    std::condition_variable finished;
+};
+
+WorkerPool::WorkerPool(std::size_t threads)
+    : stopping_(false)
+{
+    workers_.reserve(threads);
+    for (auto i = std::size_t(0); i < threads; ++i)
+    {
+        workers_.emplace_back(&WorkerPool::Run, this);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wakeup_.notify_all();
+    for (auto &worker : workers_)
+    {
+        worker.join();
+    }
+}
+
+WorkerPool &WorkerPool::Shared(void)
+{
+    static WorkerPool shared(std::max(1U, std::thread::hardware_concurrency()) - 1);
+    return shared;
+}
+
+void WorkerPool::ParallelFor(std::size_t count, std::size_t chunk_size,
+                             const std::function<void(std::size_t, std::size_t)> &fn)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    const auto batch = std::make_shared<Batch>(count, chunk_size, fn);
+    const auto helpers = std::min(workers_.size(), batch->chunks - 1);
+    if (helpers > 0)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            batches_.insert(batches_.end(), helpers, batch);
+        }
+        for (auto i = std::size_t(0); i < helpers; ++i)
+        {
+            wakeup_.notify_one();
+        }
+    }
+
+    batch->RunChunks();
+
+    std::unique_lock<std::mutex> lock(batch->mutex);
+    batch->finished.wait(lock, [&batch]() { return batch->done.load() == batch->chunks; });
+}
+
+void WorkerPool::Run(void)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        wakeup_.wait(lock, [this]() { return stopping_ || !batches_.empty(); });
+        if (stopping_)
+        {
+            return;
+        }
+
+        const auto batch = std::move(batches_.front());
+        batches_.pop_front();
+        lock.unlock();
+        batch->RunChunks();
+        lock.lock();
+    }
+}
+
+} // namespace robl::geometry
+
+/*=========================================================================*/
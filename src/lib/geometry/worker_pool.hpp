@@ -0,0 +1,78 @@
+#pragma once
+
+// standard headers
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*=========================================================================*/
+
+namespace robl::geometry
+{
+
+/**
+ * @class WorkerPool
+ * @brief A fixed set of threads which run the chunks of batch kernels.
+ *
+ * The calling thread runs chunks too, and the workers only help it, so a batch finishes even while every worker is
+ * busy with other batches. Concurrent batches share the workers, so the number of threads stays the same whatever the
+ * number of calls in flight.
+ */
+class WorkerPool
+{
+public:
+    /**
+     * Starts the workers.
+     *
+     * @param threads The number of the workers.
+     */
+    explicit WorkerPool(std::size_t threads);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    /**
+     * Returns the process-wide pool, started on first use with one worker less than the hardware threads, as the
+     * calling thread makes up the last one.
+     */
+    static WorkerPool &Shared(void);
+
+    /**
+     * Runs fn(begin, end) over [0, count) in chunks of chunk_size items, and returns once every chunk has run.
+     *
+     * @param count The number of the items.
+     * @param chunk_size The number of the items of every chunk but the last one.
+     * @param fn The function to be run on every chunk, from any thread.
+     */
+    void ParallelFor(std::size_t count, std::size_t chunk_size,
+                     const std::function<void(std::size_t, std::size_t)> &fn);
+
+    /**
+     * Returns the number of the workers.
+     */
+    std::size_t Size(void) const
+    {
+        return workers_.size();
+    }
+
+private:
+    struct Batch;
+
+    void Run(void);
+
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::deque<std::shared_ptr<Batch>> batches_;
+    bool stopping_;
+    std::vector<std::thread> workers_;
+};
+
+} // namespace robl::geometry
+
+/*=========================================================================*/
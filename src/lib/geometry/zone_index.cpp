@@ -0,0 +1,365 @@
+// standard headers
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// project headers
+#include "geometry/simd_dispatch.hpp"
+#include "geometry/zone_index.hpp"
+
+/*=========================================================================*/
+
+namespace robl::geometry
+{
+
+namespace
+{
+
+constexpr auto edge_alignment = std::uint32_t(8);
+constexpr auto max_grid_side = std::uint32_t(1024);
+
+bool RingContainsScalar(const float *x0, const float *y0, const float *y1, const float *slope, std::uint32_t begin,
+                        std::uint32_t end, float x, float y)
+{
+    auto crossings = 0U;
+    for (auto i = begin; i < end; ++i)
+    {
+        if ((y0[i] > y) != (y1[i] > y) && x < x0[i] + (y - y0[i]) * slope[i])
+        {
+            ++crossings;
+        }
+    }
+    return (crossings & 1U) != 0;
+}
+
+#if defined(ROBL_GEOMETRY_X86)
+
+__attribute__((target("sse2"))) bool RingContainsSse2(const float *x0, const float *y0, const float *y1,
+                                                      const float *slope, std::uint32_t begin, std::uint32_t end,
+                                                      float x, float y)
+{
+    const auto px = _mm_set1_ps(x), py = _mm_set1_ps(y);
+
+    auto crossings = 0U;
+    for (auto i = begin; i < end; i += 4)
+    {
+        const auto ey0 = _mm_loadu_ps(y0 + i);
+        const auto straddles = _mm_xor_ps(_mm_cmpgt_ps(ey0, py), _mm_cmpgt_ps(_mm_loadu_ps(y1 + i), py));
+        const auto cross_x = _mm_add_ps(_mm_loadu_ps(x0 + i), _mm_mul_ps(_mm_sub_ps(py, ey0), _mm_loadu_ps(slope + i)));
+        const auto mask = _mm_movemask_ps(_mm_and_ps(straddles, _mm_cmplt_ps(px, cross_x)));
+        crossings += __builtin_popcount(static_cast<unsigned>(mask));
+    }
+    return (crossings & 1U) != 0;
+}
+
+__attribute__((target("avx2,fma"))) bool RingContainsAvx2(const float *x0, const float *y0, const float *y1,
+                                                          const float *slope, std::uint32_t begin, std::uint32_t end,
+                                                          float x, float y)
+{
+    const auto px = _mm256_set1_ps(x), py = _mm256_set1_ps(y);
+
+    auto crossings = 0U;
+    for (auto i = begin; i < end; i += 8)
+    {
+        const auto ey0 = _mm256_loadu_ps(y0 + i);
+        const auto straddles = _mm256_xor_ps(_mm256_cmp_ps(ey0, py, _CMP_GT_OQ),
+                                             _mm256_cmp_ps(_mm256_loadu_ps(y1 + i), py, _CMP_GT_OQ));
+        const auto cross_x =
+            _mm256_fmadd_ps(_mm256_sub_ps(py, ey0), _mm256_loadu_ps(slope + i), _mm256_loadu_ps(x0 + i));
+        const auto mask = _mm256_movemask_ps(_mm256_and_ps(straddles, _mm256_cmp_ps(px, cross_x, _CMP_LT_OQ)));
+        crossings += __builtin_popcount(static_cast<unsigned>(mask));
+    }
+    return (crossings & 1U) != 0;
+}
+
+#endif
+
+} // namespace
+
+/*=========================================================================*/
+
+ZoneIndex::ZoneIndex(void)
+    : grid_bounds_{ 0.0f, 0.0f, 0.0f, 0.0f }
+    , grid_cols_(0)
+    , grid_rows_(0)
+    , inv_cell_width_(0.0f)
+    , inv_cell_height_(0.0f)
+{
+}
+
+bool ZoneIndex::AddRing(const robl::api::Polygon &polygon, std::string *error)
+{
+    const auto vertex_count = static_cast<std::uint32_t>(polygon.vertices_size());
+    if (vertex_count < 3)
+    {
+        *error = "polygon has fewer than three vertices";
+        return false;
+    }
+
+    auto ring = Ring();
+    ring.bounds = Box{ std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+                       std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest() };
+    for (const auto &vertex : polygon.vertices())
+    {
+        if (!std::isfinite(vertex.x()) || !std::isfinite(vertex.y()))
+        {
+            *error = "polygon has a non-finite vertex";
+            return false;
+        }
+        ring.bounds.min_x = std::min(ring.bounds.min_x, vertex.x());
+        ring.bounds.min_y = std::min(ring.bounds.min_y, vertex.y());
+        ring.bounds.max_x = std::max(ring.bounds.max_x, vertex.x());
+        ring.bounds.max_y = std::max(ring.bounds.max_y, vertex.y());
+    }
+
+    ring.edge_begin = static_cast<std::uint32_t>(edge_x0_.size());
+    ring.edge_end = ring.edge_begin + (vertex_count + edge_alignment - 1) / edge_alignment * edge_alignment;
+
+    const auto nan = std::numeric_limits<float>::quiet_NaN();
+    edge_x0_.resize(ring.edge_end, nan);
+    edge_y0_.resize(ring.edge_end, nan);
+    edge_y1_.resize(ring.edge_end, nan);
+    edge_slope_.resize(ring.edge_end, nan);
+
+    for (auto i = std::uint32_t(0); i < vertex_count; ++i)
+    {
+        const auto &from = polygon.vertices(static_cast<int>(i));
+        const auto &to = polygon.vertices(static_cast<int>((i + 1) % vertex_count));
+        const auto edge = ring.edge_begin + i;
+        edge_x0_[edge] = from.x();
+        edge_y0_[edge] = from.y();
+        edge_y1_[edge] = to.y();
+        // Horizontal edges never straddle a line, so their slope is never used.
+        edge_slope_[edge] = from.y() != to.y() ? static_cast<float>((double(to.x()) - from.x()) /
+                                                                    (double(to.y()) - from.y()))
+                                               : 0.0f;
+    }
+
+    rings_.push_back(ring);
+    return true;
+}
+
+bool ZoneIndex::AddPolygon(std::uint32_t id, const robl::api::PolygonWithExclusions &region, std::string *error)
+{
+    const auto ring_count = rings_.size();
+    const auto edge_count = edge_x0_.size();
+    const auto rollback = [&]() {
+        rings_.resize(ring_count);
+        edge_x0_.resize(edge_count);
+        edge_y0_.resize(edge_count);
+        edge_y1_.resize(edge_count);
+        edge_slope_.resize(edge_count);
+        return false;
+    };
+
+    if (!AddRing(region.inclusion(), error))
+    {
+        return rollback();
+    }
+    for (const auto &exclusion : region.exclusions())
+    {
+        if (!AddRing(exclusion, error))
+        {
+            *error = "exclusion " + *error;
+            return rollback();
+        }
+    }
+
+    auto zone = Zone();
+    zone.id = id;
+    zone.bounds = rings_[ring_count].bounds;
+    zone.is_circle = false;
+    zone.ring_begin = static_cast<std::uint32_t>(ring_count);
+    zone.ring_end = static_cast<std::uint32_t>(rings_.size());
+    zones_.push_back(zone);
+    return true;
+}
+
+bool ZoneIndex::AddCircle(std::uint32_t id, const robl::api::Circle &circle, std::string *error)
+{
+    const auto cx = circle.center_pt().x(), cy = circle.center_pt().y(), radius = circle.radius();
+    if (!std::isfinite(cx) || !std::isfinite(cy) || !std::isfinite(radius) || radius < 0.0f)
+    {
+        *error = "circle is not finite or has a negative radius";
+        return false;
+    }
+
+    auto zone = Zone();
+    zone.id = id;
+    zone.bounds = Box{ cx - radius, cy - radius, cx + radius, cy + radius };
+    zone.is_circle = true;
+    zone.center_x = cx;
+    zone.center_y = cy;
+    zone.radius_sq = radius * radius;
+    zone.ring_begin = zone.ring_end = 0;
+    zones_.push_back(zone);
+    return true;
+}
+
+void ZoneIndex::Finalize(void)
+{
+    std::stable_sort(zones_.begin(), zones_.end(), [](const Zone &lhs, const Zone &rhs) { return lhs.id < rhs.id; });
+
+    grid_cols_ = grid_rows_ = 0;
+    cell_offsets_.assign(1, 0);
+    cell_zones_.clear();
+    if (zones_.empty())
+    {
+        return;
+    }
+
+    grid_bounds_ = zones_.front().bounds;
+    for (const auto &zone : zones_)
+    {
+        grid_bounds_.min_x = std::min(grid_bounds_.min_x, zone.bounds.min_x);
+        grid_bounds_.min_y = std::min(grid_bounds_.min_y, zone.bounds.min_y);
+        grid_bounds_.max_x = std::max(grid_bounds_.max_x, zone.bounds.max_x);
+        grid_bounds_.max_y = std::max(grid_bounds_.max_y, zone.bounds.max_y);
+    }
+
+    // Aim at about four cells per zone, shaped after the bounds, so a cell holds a handful of zones when the zones are
+    // spread out.
+    const auto width = double(grid_bounds_.max_x) - grid_bounds_.min_x;
+    const auto height = double(grid_bounds_.max_y) - grid_bounds_.min_y;
+    const auto cells = 4.0 * zones_.size();
+    const auto aspect = width > 0.0 && height > 0.0 ? width / height : 1.0;
+    const auto side = [](double value) {
+        return static_cast<std::uint32_t>(std::clamp(std::ceil(value), 1.0, double(max_grid_side)));
+    };
+    grid_cols_ = width > 0.0 ? side(std::sqrt(cells * aspect)) : 1;
+    grid_rows_ = height > 0.0 ? side(std::sqrt(cells / aspect)) : 1;
+    inv_cell_width_ = width > 0.0 ? static_cast<float>(grid_cols_ / width) : 0.0f;
+    inv_cell_height_ = height > 0.0 ? static_cast<float>(grid_rows_ / height) : 0.0f;
+
+    const auto cell_range = [this](const Box &box, std::uint32_t *col0, std::uint32_t *row0, std::uint32_t *col1,
+                                   std::uint32_t *row1) {
+        const auto col = [this](float x) {
+            const auto c = static_cast<std::int64_t>((x - grid_bounds_.min_x) * inv_cell_width_);
+            return static_cast<std::uint32_t>(std::clamp<std::int64_t>(c, 0, grid_cols_ - 1));
+        };
+        const auto row = [this](float y) {
+            const auto r = static_cast<std::int64_t>((y - grid_bounds_.min_y) * inv_cell_height_);
+            return static_cast<std::uint32_t>(std::clamp<std::int64_t>(r, 0, grid_rows_ - 1));
+        };
+        *col0 = col(box.min_x);
+        *col1 = col(box.max_x);
+        *row0 = row(box.min_y);
+        *row1 = row(box.max_y);
+    };
+
+    // Count the zones of every cell, then fill the cells in zone order, so each cell lists its zones by ascending id.
+    cell_offsets_.assign(std::size_t(grid_cols_) * grid_rows_ + 1, 0);
+    for (const auto &zone : zones_)
+    {
+        auto col0 = 0U, row0 = 0U, col1 = 0U, row1 = 0U;
+        cell_range(zone.bounds, &col0, &row0, &col1, &row1);
+        for (auto row = row0; row <= row1; ++row)
+        {
+            for (auto col = col0; col <= col1; ++col)
+            {
+                ++cell_offsets_[std::size_t(row) * grid_cols_ + col + 1];
+            }
+        }
+    }
+    for (auto i = std::size_t(1); i < cell_offsets_.size(); ++i)
+    {
+        cell_offsets_[i] += cell_offsets_[i - 1];
+    }
+
+    cell_zones_.resize(cell_offsets_.back());
+    auto fill = std::vector<std::uint32_t>(cell_offsets_.begin(), cell_offsets_.end() - 1);
+    for (auto z = std::uint32_t(0); z < zones_.size(); ++z)
+    {
+        auto col0 = 0U, row0 = 0U, col1 = 0U, row1 = 0U;
+        cell_range(zones_[z].bounds, &col0, &row0, &col1, &row1);
+        for (auto row = row0; row <= row1; ++row)
+        {
+            for (auto col = col0; col <= col1; ++col)
+            {
+                cell_zones_[fill[std::size_t(row) * grid_cols_ + col]++] = z;
+            }
+        }
+    }
+}
+
+bool ZoneIndex::ZoneContains(const Zone &zone, float x, float y, RingTest ring_test) const
+{
+    if (zone.is_circle)
+    {
+        const auto dx = x - zone.center_x, dy = y - zone.center_y;
+        return dx * dx + dy * dy <= zone.radius_sq;
+    }
+
+    const auto &inclusion = rings_[zone.ring_begin];
+    if (!ring_test(edge_x0_.data(), edge_y0_.data(), edge_y1_.data(), edge_slope_.data(), inclusion.edge_begin,
+                   inclusion.edge_end, x, y))
+    {
+        return false;
+    }
+
+    for (auto r = zone.ring_begin + 1; r < zone.ring_end; ++r)
+    {
+        const auto &exclusion = rings_[r];
+        if (exclusion.bounds.Contains(x, y) &&
+            ring_test(edge_x0_.data(), edge_y0_.data(), edge_y1_.data(), edge_slope_.data(), exclusion.edge_begin,
+                      exclusion.edge_end, x, y))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ZoneIndex::Query(const float *x, const float *y, std::size_t count,
+                      google::protobuf::RepeatedField<std::uint32_t> *match_counts,
+                      google::protobuf::RepeatedField<std::uint32_t> *zone_ids) const
+{
+    auto ring_test = RingTest(&RingContainsScalar);
+#if defined(ROBL_GEOMETRY_X86)
+    switch (DetectSimdLevel())
+    {
+    case SimdLevel::Avx2:
+        ring_test = &RingContainsAvx2;
+        break;
+    case SimdLevel::Sse2:
+        ring_test = &RingContainsSse2;
+        break;
+    default:
+        break;
+    }
+#endif
+
+    match_counts->Reserve(match_counts->size() + static_cast<int>(count));
+    for (auto i = std::size_t(0); i < count; ++i)
+    {
+        const auto px = x[i], py = y[i];
+        auto matches = 0U;
+        if (grid_cols_ > 0 && grid_bounds_.Contains(px, py))
+        {
+            const auto col = std::min<std::uint32_t>(
+                static_cast<std::uint32_t>((px - grid_bounds_.min_x) * inv_cell_width_), grid_cols_ - 1);
+            const auto row = std::min<std::uint32_t>(
+                static_cast<std::uint32_t>((py - grid_bounds_.min_y) * inv_cell_height_), grid_rows_ - 1);
+            const auto cell = std::size_t(row) * grid_cols_ + col;
+            for (auto c = cell_offsets_[cell]; c < cell_offsets_[cell + 1]; ++c)
+            {
+                const auto &zone = zones_[cell_zones_[c]];
+                if (zone.bounds.Contains(px, py) && ZoneContains(zone, px, py, ring_test))
+                {
+                    zone_ids->Add(zone.id);
+                    ++matches;
+                }
+            }
+        }
+        match_counts->AddAlreadyReserved(matches);
+    }
+}
+
+std::size_t ZoneIndex::Size(void) const
+{
+    return zones_.size();
+}
+
+} // namespace robl::geometry
+
+/*=========================================================================*/
@@ -0,0 +1,141 @@
+#pragma once
+
+// standard headers
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// grpc headers
+#include <google/protobuf/repeated_field.h>
+#include <robl/api/geometry.pb.h>
+
+/*=========================================================================*/
+
+namespace robl::geometry
+{
+
+/**
+ * @class ZoneIndex
+ * @brief An immutable index of geofence zones answering which zones contain a position.
+ *
+ * Zones are added one by one and the index is frozen by Finalize(). A query first looks up the grid cell of the
+ * position, which lists the zones whose bounding box overlaps the cell, then rejects zones by their bounding boxes and
+ * finally runs crossing-number tests on the remaining polygons. The edges of every ring are stored as columns padded
+ * to a multiple of eight, so the crossing test runs eight edges per step with AVX2 (four with SSE2).
+ *
+ * A finalized index is read-only, so it may be queried from any number of threads.
+ */
+class ZoneIndex
+{
+public:
+    ZoneIndex(void);
+
+    /**
+     * Adds a polygon zone. A position is inside the zone if it is inside the inclusion polygon and outside every
+     * exclusion polygon.
+     *
+     * @param id The id of the zone.
+     * @param region The polygon with its exclusions.
+     * @param error The reason of the failure.
+     * @return false if a polygon has fewer than three vertices or a non-finite vertex, true otherwise.
+     */
+    bool AddPolygon(std::uint32_t id, const robl::api::PolygonWithExclusions &region, std::string *error);
+
+    /**
+     * Adds a circular zone. The boundary belongs to the zone.
+     *
+     * @param id The id of the zone.
+     * @param circle The circle.
+     * @param error The reason of the failure.
+     * @return false if the circle is not finite or has a negative radius, true otherwise.
+     */
+    bool AddCircle(std::uint32_t id, const robl::api::Circle &circle, std::string *error);
+
+    /**
+     * Sorts the zones by id and builds the grid. No zone may be added afterwards.
+     */
+    void Finalize(void);
+
+    /**
+     * Finds the zones containing each position. The ids of the zones containing position i are appended to zone_ids
+     * in ascending order, and their number is appended to match_counts.
+     *
+     * @param x, y The position columns.
+     * @param count The number of positions.
+     * @param match_counts The number of the matches of every position.
+     * @param zone_ids The ids of the matched zones.
+     */
+    void Query(const float *x, const float *y, std::size_t count,
+               google::protobuf::RepeatedField<std::uint32_t> *match_counts,
+               google::protobuf::RepeatedField<std::uint32_t> *zone_ids) const;
+
+    /**
+     * Returns the number of the zones.
+     */
+    std::size_t Size(void) const;
+
+private:
+    struct Box
+    {
+        float min_x;
+        float min_y;
+        float max_x;
+        float max_y;
+
+        bool Contains(float x, float y) const
+        {
+            return x >= min_x && x <= max_x && y >= min_y && y <= max_y;
+        }
+    };
+
+    struct Ring
+    {
+        Box bounds;
+        std::uint32_t edge_begin; // multiple of 8
+        std::uint32_t edge_end;   // multiple of 8
+    };
+
+    struct Zone
+    {
+        std::uint32_t id;
+        Box bounds;
+        bool is_circle;
+        float center_x; // circle only
+        float center_y;
+        float radius_sq;
+        std::uint32_t ring_begin; // polygon only, the inclusion ring followed by the exclusion rings
+        std::uint32_t ring_end;
+    };
+
+    // Returns true if (x, y) is inside the ring whose edges are [begin, end) of the edge columns.
+    using RingTest = bool (*)(const float *x0, const float *y0, const float *y1, const float *slope,
+                              std::uint32_t begin, std::uint32_t end, float x, float y);
+
+    bool AddRing(const robl::api::Polygon &polygon, std::string *error);
+    bool ZoneContains(const Zone &zone, float x, float y, RingTest ring_test) const;
+
+    std::vector<Zone> zones_;
+    std::vector<Ring> rings_;
+
+    // Edge columns. An edge from (x0, y0) to (x1, y1) crosses the horizontal line through y at x0 + (y - y0) * slope.
+    // Padding edges have NaN ends and never cross.
+    std::vector<float> edge_x0_;
+    std::vector<float> edge_y0_;
+    std::vector<float> edge_y1_;
+    std::vector<float> edge_slope_;
+
+    // Uniform grid over the bounds of all zones. Cell c lists the zone indices
+    // cell_zones_[cell_offsets_[c], cell_offsets_[c + 1]).
+    Box grid_bounds_;
+    std::uint32_t grid_cols_;
+    std::uint32_t grid_rows_;
+    float inv_cell_width_;
+    float inv_cell_height_;
+    std::vector<std::uint32_t> cell_offsets_;
+    std::vector<std::uint32_t> cell_zones_;
+};
+
+} // namespace robl::geometry
+
+/*=========================================================================*/
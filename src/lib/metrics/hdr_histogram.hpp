@@ -0,0 +1,238 @@
+#pragma once
+
+// standard headers
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+/*=========================================================================*/
+
+namespace robl
+{
+
+/**
+ * @class HdrHistogram
+ * @brief Records values over a wide range at a fixed relative precision, e.g. latencies from a microsecond up to a
+ * minute within 0.1%.
+ *
+ * Values are counted in buckets which double in width: every power of two is split into as many sub-buckets as the
+ * requested significant digits need. Recording is an index computation and an increment, with no allocation, and
+ * histograms of the same layout are merged by adding their counts. A histogram is not thread-safe; give every thread
+ * its own and merge them when reporting. Values above the highest trackable one are counted as that one.
+ */
+class HdrHistogram
+{
+public:
+    HdrHistogram(std::int64_t highest_trackable_value, int significant_digits);
+
+    void Record(std::int64_t value);
+    void Record(std::int64_t value, std::int64_t count);
+
+    /**
+     * Adds the counts of a histogram created with the same arguments.
+     */
+    void Add(const HdrHistogram &other);
+
+    void Reset(void);
+
+    std::int64_t Count(void) const
+    {
+        return total_count_;
+    }
+
+    std::int64_t Min(void) const;
+    std::int64_t Max(void) const;
+    double Mean(void) const;
+
+    /**
+     * Returns the value below which the percentile of the recorded values falls, e.g. 99.9, at the precision of the
+     * histogram. Returns 0 for an empty histogram.
+     */
+    std::int64_t ValueAtPercentile(double percentile) const;
+
+private:
+    int BucketIndex(std::int64_t value) const;
+    int SubBucketIndex(std::int64_t value, int bucket_index) const;
+    std::size_t CountsIndex(std::int64_t value) const;
+    std::int64_t ValueFromIndex(std::size_t index) const;
+    std::int64_t HighestEquivalentValue(std::int64_t value) const;
+
+    std::int64_t highest_trackable_value_;
+    int sub_bucket_half_count_magnitude_;
+    std::int64_t sub_bucket_half_count_;
+    std::int64_t sub_bucket_mask_;
+    std::vector<std::int64_t> counts_;
+    std::int64_t total_count_;
+    std::int64_t min_;
+    std::int64_t max_;
+};
+
+/*=========================================================================*/
+
+inline HdrHistogram::HdrHistogram(std::int64_t highest_trackable_value, int significant_digits)
+    : highest_trackable_value_(highest_trackable_value)
+    , total_count_(0)
+    , min_(0)
+    , max_(0)
+{
+    if (significant_digits < 1 || significant_digits > 5 || highest_trackable_value < 2)
+    {
+        throw std::invalid_argument("HdrHistogram needs 1 to 5 significant digits and a highest value above 1");
+    }
+
+    // Enough sub-buckets per power of two that neighbours differ by less than the precision.
+    const auto largest_single_unit = 2 * static_cast<std::int64_t>(std::pow(10, significant_digits));
+    const auto sub_bucket_count_magnitude = static_cast<int>(std::ceil(std::log2(largest_single_unit)));
+    sub_bucket_half_count_magnitude_ = sub_bucket_count_magnitude - 1;
+    sub_bucket_half_count_ = std::int64_t(1) << sub_bucket_half_count_magnitude_;
+    sub_bucket_mask_ = (std::int64_t(1) << sub_bucket_count_magnitude) - 1;
+
+    auto bucket_count = 1;
+    for (auto smallest_untrackable = std::int64_t(1) << sub_bucket_count_magnitude;
+         smallest_untrackable <= highest_trackable_value && bucket_count < 62 - sub_bucket_count_magnitude;
+         smallest_untrackable <<= 1)
+    {
+        ++bucket_count;
+    }
+    counts_.assign((bucket_count + 1) * sub_bucket_half_count_, 0);
+}
+
+inline void HdrHistogram::Record(std::int64_t value)
+{
+    Record(value, 1);
+}
+
+inline void HdrHistogram::Record(std::int64_t value, std::int64_t count)
+{
+    value = std::clamp<std::int64_t>(value, 0, highest_trackable_value_);
+    counts_[CountsIndex(value)] += count;
+    min_ = total_count_ == 0 ? value : std::min(min_, value);
+    max_ = total_count_ == 0 ? value : std::max(max_, value);
+    total_count_ += count;
+}
+
+inline void HdrHistogram::Add(const HdrHistogram &other)
+{
+    if (other.counts_.size() != counts_.size() || other.sub_bucket_mask_ != sub_bucket_mask_)
+    {
+        throw std::invalid_argument("HdrHistogram layouts differ");
+    }
+    if (other.total_count_ == 0)
+    {
+        return;
+    }
+
+    for (auto i = std::size_t(0); i < counts_.size(); ++i)
+    {
+        counts_[i] += other.counts_[i];
+    }
+    min_ = total_count_ == 0 ? other.min_ : std::min(min_, other.min_);
+    max_ = total_count_ == 0 ? other.max_ : std::max(max_, other.max_);
+    total_count_ += other.total_count_;
+}
+
+inline void HdrHistogram::Reset(void)
+{
+    std::fill(counts_.begin(), counts_.end(), 0);
+    total_count_ = 0;
+    min_ = 0;
+    max_ = 0;
+}
+
+inline std::int64_t HdrHistogram::Min(void) const
+{
+    return min_;
+}
+
+inline std::int64_t HdrHistogram::Max(void) const
+{
+    return max_;
+}
+
+inline double HdrHistogram::Mean(void) const
+{
+    if (total_count_ == 0)
+    {
+        return 0.0;
+    }
+
+    // Every value counts as the middle of its sub-bucket.
+    auto sum = 0.0;
+    for (auto i = std::size_t(0); i < counts_.size(); ++i)
+    {
+        if (counts_[i] != 0)
+        {
+            const auto lowest = ValueFromIndex(i);
+            sum += counts_[i] * (lowest + HighestEquivalentValue(lowest)) / 2.0;
+        }
+    }
+    return sum / total_count_;
+}
+
+inline std::int64_t HdrHistogram::ValueAtPercentile(double percentile) const
+{
+    if (total_count_ == 0)
+    {
+        return 0;
+    }
+
+    const auto fraction = std::clamp(percentile, 0.0, 100.0) / 100.0;
+    const auto wanted = std::max<std::int64_t>(1, static_cast<std::int64_t>(std::ceil(fraction * total_count_)));
+    auto seen = std::int64_t(0);
+    for (auto i = std::size_t(0); i < counts_.size(); ++i)
+    {
+        seen += counts_[i];
+        if (seen >= wanted)
+        {
+            return std::min(HighestEquivalentValue(ValueFromIndex(i)), max_);
+        }
+    }
+    return max_;
+}
+
+inline int HdrHistogram::BucketIndex(std::int64_t value) const
+{
+    // The power of two above the value, counted from the one which spans the first full set of sub-buckets.
+    const auto pow2_ceiling = 64 - __builtin_clzll(static_cast<std::uint64_t>(value | sub_bucket_mask_));
+    return pow2_ceiling - (sub_bucket_half_count_magnitude_ + 1);
+}
+
+inline int HdrHistogram::SubBucketIndex(std::int64_t value, int bucket_index) const
+{
+    return static_cast<int>(value >> bucket_index);
+}
+
+inline std::size_t HdrHistogram::CountsIndex(std::int64_t value) const
+{
+    // Every bucket but the first only uses its upper half of sub-buckets; the lower half is the previous bucket.
+    const auto bucket_index = BucketIndex(value);
+    const auto sub_bucket_index = SubBucketIndex(value, bucket_index);
+    return ((static_cast<std::size_t>(bucket_index) + 1) << sub_bucket_half_count_magnitude_) +
+           (sub_bucket_index - sub_bucket_half_count_);
+}
+
+inline std::int64_t HdrHistogram::ValueFromIndex(std::size_t index) const
+{
+    auto bucket_index = static_cast<int>(index >> sub_bucket_half_count_magnitude_) - 1;
+    auto sub_bucket_index = static_cast<std::int64_t>(index & (sub_bucket_half_count_ - 1)) + sub_bucket_half_count_;
+    if (bucket_index < 0)
+    {
+        sub_bucket_index -= sub_bucket_half_count_;
+        bucket_index = 0;
+    }
+    return sub_bucket_index << bucket_index;
+}
+
+inline std::int64_t HdrHistogram::HighestEquivalentValue(std::int64_t value) const
+{
+    const auto bucket_index = BucketIndex(value);
+    const auto sub_bucket_index = SubBucketIndex(value, bucket_index);
+    const auto lowest = static_cast<std::int64_t>(sub_bucket_index) << bucket_index;
+    return lowest + (std::int64_t(1) << bucket_index) - 1;
+}
+
+} // namespace robl
+
+/*=========================================================================*/
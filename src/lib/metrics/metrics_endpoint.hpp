@@ -0,0 +1,265 @@
+#pragma once
+
+// standard headers
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include <netdb.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// project headers
+#include "metrics/rpc_metrics.hpp"
+#include "shm/unique_fd.hpp"
+#include "trace/tracer.hpp"
+
+/*=========================================================================*/
+
+namespace robl
+{
+
+/**
+ * The local address on which a server listening on the address serves its metrics: $ROBL_METRICS_ADDRESS if it is
+ * set, where an empty value turns the endpoint off, or else 127.0.0.1 on the server's port plus 1000.
+ */
+std::string MetricsAddress(const std::string &address);
+
+/**
+ * @class MetricsEndpoint
+ * @brief Serves RpcMetrics to Prometheus over plain HTTP: every GET of /metrics gets the text exposition format. A GET
+ * of /trace gets the events the Tracer holds, as a Chrome trace.
+ *
+ * Scrapes are answered one at a time on a thread of the endpoint, each bounded by a timeout, as there is one scraper
+ * at a time and the answer takes microseconds. The endpoint is meant for the loopback interface or a trusted network,
+ * as it has neither TLS nor authentication.
+ */
+class MetricsEndpoint
+{
+public:
+    static constexpr int kTimeoutMs = 1000;
+
+    /**
+     * Listens on the host:port, e.g. "127.0.0.1:51051", where port 0 picks a free one. Throws std::system_error if
+     * it cannot.
+     */
+    MetricsEndpoint(const std::string &address, RpcMetrics &metrics);
+    ~MetricsEndpoint();
+
+    MetricsEndpoint(const MetricsEndpoint &) = delete;
+    MetricsEndpoint &operator=(const MetricsEndpoint &) = delete;
+
+    int Port(void) const
+    {
+        return port_;
+    }
+
+private:
+    void Run(void);
+    void Serve(int connection);
+
+    RpcMetrics &metrics_;
+    UniqueFd listener_;
+    UniqueFd wakeup_;
+    int port_;
+    std::thread thread_;
+};
+
+/**
+ * Serves the metrics of a server listening on the address at its MetricsAddress(). Returns null if the endpoint is
+ * turned off or cannot listen, which it reports on stderr, as a server runs fine without it.
+ */
+std::unique_ptr<MetricsEndpoint> ServeMetrics(const std::string &address, RpcMetrics &metrics = RpcMetrics::Instance());
+
+/*=========================================================================*/
+
+inline std::string MetricsAddress(const std::string &address)
+{
+    const auto *configured = std::getenv("ROBL_METRICS_ADDRESS");
+    if (configured != nullptr)
+    {
+        return configured;
+    }
+
+    const auto colon = address.rfind(':');
+    const auto port = colon == std::string::npos ? 0 : std::atoi(address.c_str() + colon + 1);
+    return port > 0 && port + 1000 < 65536 ? "127.0.0.1:" + std::to_string(port + 1000) : std::string();
+}
+
+inline MetricsEndpoint::MetricsEndpoint(const std::string &address, RpcMetrics &metrics)
+    : metrics_(metrics)
+    , port_(0)
+{
+    const auto colon = address.rfind(':');
+    if (colon == std::string::npos)
+    {
+        throw std::system_error(std::make_error_code(std::errc::invalid_argument), address);
+    }
+    auto host = address.substr(0, colon);
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']')
+    {
+        host = host.substr(1, host.size() - 2);
+    }
+    const auto service = address.substr(colon + 1);
+
+    auto hints = addrinfo();
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+    addrinfo *resolved = nullptr;
+    const auto error = getaddrinfo(host.empty() ? nullptr : host.c_str(), service.c_str(), &hints, &resolved);
+    if (error != 0)
+    {
+        throw std::system_error(std::make_error_code(std::errc::invalid_argument),
+                                address + ": " + gai_strerror(error));
+    }
+    const auto resolved_holder = std::unique_ptr<addrinfo, decltype(&freeaddrinfo)>(resolved, &freeaddrinfo);
+
+    const auto one = 1;
+    listener_.Reset(socket(resolved->ai_family, resolved->ai_socktype | SOCK_CLOEXEC, resolved->ai_protocol));
+    wakeup_.Reset(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+    if (!listener_.Valid() || !wakeup_.Valid() ||
+        setsockopt(listener_.Get(), SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+        bind(listener_.Get(), resolved->ai_addr, resolved->ai_addrlen) != 0 || listen(listener_.Get(), 16) != 0)
+    {
+        throw std::system_error(errno, std::system_category(), "listening on " + address);
+    }
+
+    auto bound = sockaddr_storage();
+    auto bound_length = socklen_t(sizeof(bound));
+    getsockname(listener_.Get(), reinterpret_cast<sockaddr *>(&bound), &bound_length);
+    auto port_text = std::string(NI_MAXSERV, '\0');
+    if (getnameinfo(reinterpret_cast<const sockaddr *>(&bound), bound_length, nullptr, 0, port_text.data(),
+                    port_text.size(), NI_NUMERICSERV) == 0)
+    {
+        port_ = std::atoi(port_text.c_str());
+    }
+
+    thread_ = std::thread(&MetricsEndpoint::Run, this);
+}
+
+inline MetricsEndpoint::~MetricsEndpoint()
+{
+    const auto one = std::uint64_t(1);
+    [[maybe_unused]] const auto written = write(wakeup_.Get(), &one, sizeof(one));
+    thread_.join();
+}
+
+inline void MetricsEndpoint::Run(void)
+{
+    while (true)
+    {
+        pollfd polled[] = { { wakeup_.Get(), POLLIN, 0 }, { listener_.Get(), POLLIN, 0 } };
+        if (poll(polled, 2, -1) < 0 && errno != EINTR)
+        {
+            return;
+        }
+        if (polled[0].revents != 0)
+        {
+            return;
+        }
+        if (polled[1].revents & POLLIN)
+        {
+            const auto connection = UniqueFd(accept4(listener_.Get(), nullptr, nullptr, SOCK_CLOEXEC));
+            if (connection.Valid())
+            {
+                Serve(connection.Get());
+            }
+        }
+    }
+}
+
+inline void MetricsEndpoint::Serve(int connection)
+{
+    // Reads the request head; the body of a GET, if any, is of no interest.
+    auto request = std::string();
+    auto buffer = std::string(4096, '\0');
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < 16 * 1024)
+    {
+        auto polled = pollfd{ connection, POLLIN, 0 };
+        if (poll(&polled, 1, kTimeoutMs) <= 0)
+        {
+            return;
+        }
+        const auto received = recv(connection, buffer.data(), buffer.size(), 0);
+        if (received <= 0)
+        {
+            return;
+        }
+        request.append(buffer.data(), received);
+    }
+
+    const auto line_end = request.find("\r\n");
+    const auto line = request.substr(0, line_end);
+    auto status = std::string("200 OK");
+    auto content_type = std::string("text/plain; version=0.0.4; charset=utf-8");
+    auto body = std::ostringstream();
+    if (line.rfind("GET /metrics ", 0) == 0 || line.rfind("GET /metrics?", 0) == 0)
+    {
+        metrics_.WritePrometheus(body);
+    }
+    else if (line.rfind("GET /trace ", 0) == 0)
+    {
+        content_type = "application/json";
+        Tracer::Instance().WriteChromeJson(body);
+    }
+    else if (line.rfind("GET ", 0) == 0)
+    {
+        status = "404 Not Found";
+        body << "The metrics are at /metrics and the trace at /trace.\n";
+    }
+    else
+    {
+        status = "405 Method Not Allowed";
+    }
+
+    const auto content = body.str();
+    const auto response = "HTTP/1.1 " + status + "\r\nContent-Type: " + content_type +
+                          "\r\nContent-Length: " + std::to_string(content.size()) +
+                          "\r\nConnection: close\r\n\r\n" + content;
+    for (auto sent = std::size_t(0); sent < response.size();)
+    {
+        auto polled = pollfd{ connection, POLLOUT, 0 };
+        if (poll(&polled, 1, kTimeoutMs) <= 0)
+        {
+            return;
+        }
+        const auto result = send(connection, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (result < 0 && errno != EINTR && errno != EAGAIN)
+        {
+            return;
+        }
+        sent += result > 0 ? result : 0;
+    }
+}
+
+inline std::unique_ptr<MetricsEndpoint> ServeMetrics(const std::string &address, RpcMetrics &metrics)
+{
+    const auto metrics_address = MetricsAddress(address);
+    if (metrics_address.empty())
+    {
+        return nullptr;
+    }
+
+    try
+    {
+        return std::make_unique<MetricsEndpoint>(metrics_address, metrics);
+    }
+    catch (const std::system_error &ex)
+    {
+        std::cerr << "Metrics are off: " << ex.what() << std::endl;
+        return nullptr;
+    }
+}
+
+} // namespace robl
+
+/*=========================================================================*/
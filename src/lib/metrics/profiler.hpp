@@ -0,0 +1,339 @@
+#pragma once
+
+// standard headers
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// project headers
+#include "metrics/hdr_histogram.hpp"
+
+/*=========================================================================*/
+
+namespace robl
+{
+
+/**
+ * @class Profiler
+ * @brief Aggregates how long the zones of the hot paths take: per zone, how often it ran, for how long in total, at
+ * least and at most, and a histogram of its times for the percentiles.
+ *
+ * Every thread aggregates into a shard of its own, under a lock which only a collection ever contends for, so a zone
+ * costs two clock reads and a few increments. A collection moves the shards into the totals and returns what they
+ * held, i.e. what ran since the collection before. The shard of a thread which ended is handed to the next new thread.
+ */
+class Profiler
+{
+public:
+    // Times are recorded in nanoseconds up to a minute, within 10%.
+    static constexpr std::int64_t kHighestTrackableNs = 60'000'000'000;
+    static constexpr int kSignificantDigits = 1;
+
+    struct ZoneStats
+    {
+        std::string name;
+        std::int64_t total_ns = 0;
+        HdrHistogram histogram = HdrHistogram(kHighestTrackableNs, kSignificantDigits);
+
+        void Add(const ZoneStats &other);
+    };
+
+    Profiler(const Profiler &) = delete;
+    Profiler &operator=(const Profiler &) = delete;
+
+    /**
+     * The profiler of the process. It is never destroyed, so that threads ending during the exit may still use it.
+     */
+    static Profiler &Instance(void)
+    {
+        static auto *instance = new Profiler();
+        return *instance;
+    }
+
+    /**
+     * The id to record a zone by, the same for every call with the same name. Resolve it once per site, e.g. into a
+     * static.
+     */
+    int Zone(const std::string &name);
+
+    void Record(int zone, std::chrono::steady_clock::duration elapsed);
+
+    /**
+     * Moves what the threads recorded since the last collection into the totals and returns it, by zone. Zones which
+     * did not run are left out.
+     */
+    std::vector<ZoneStats> Collect(void);
+
+    /**
+     * Collects, then returns everything recorded so far, by zone.
+     */
+    std::vector<ZoneStats> Totals(void);
+
+    /**
+     * Writes a table of the zones, one line each: count, total, mean, minimum, percentiles and maximum.
+     */
+    static void Report(std::ostream &out, const std::vector<ZoneStats> &zones);
+
+private:
+    struct Shard
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ZoneStats>> zones;
+        bool in_use = false;
+    };
+
+    Profiler(void) = default;
+
+    Shard &LocalShard(void);
+    void ReturnShard(Shard *shard);
+
+    mutable std::mutex mutex_;
+    std::map<std::string, int> zone_ids_;
+    std::vector<std::string> zone_names_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::vector<ZoneStats> totals_;
+};
+
+/**
+ * @class ProfileZone
+ * @brief Times a scope as a zone of the Profiler, e.g.
+ *
+ *     static const auto zone = robl::Profiler::Instance().Zone("UploadFile.Write");
+ *     const auto profiled = robl::ProfileZone(zone);
+ */
+class ProfileZone
+{
+public:
+    explicit ProfileZone(int zone)
+        : zone_(zone)
+        , start_(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~ProfileZone()
+    {
+        Profiler::Instance().Record(zone_, std::chrono::steady_clock::now() - start_);
+    }
+
+    ProfileZone(const ProfileZone &) = delete;
+    ProfileZone &operator=(const ProfileZone &) = delete;
+
+private:
+    const int zone_;
+    const std::chrono::steady_clock::time_point start_;
+};
+
+/**
+ * @class ProfileReporter
+ * @brief Collects the profiler at an interval and reports the zones which ran in it, until it is destroyed.
+ */
+class ProfileReporter
+{
+public:
+    ProfileReporter(std::chrono::steady_clock::duration interval, std::ostream &out);
+    ~ProfileReporter();
+
+    ProfileReporter(const ProfileReporter &) = delete;
+    ProfileReporter &operator=(const ProfileReporter &) = delete;
+
+private:
+    void Run(void);
+
+    const std::chrono::steady_clock::duration interval_;
+    std::ostream &out_;
+    std::mutex mutex_;
+    std::condition_variable stopped_;
+    bool stopping_;
+    std::thread thread_;
+};
+
+/*=========================================================================*/
+
+inline void Profiler::ZoneStats::Add(const ZoneStats &other)
+{
+    total_ns += other.total_ns;
+    histogram.Add(other.histogram);
+}
+
+inline int Profiler::Zone(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto [it, added] = zone_ids_.emplace(name, static_cast<int>(zone_names_.size()));
+    if (added)
+    {
+        zone_names_.push_back(name);
+    }
+    return it->second;
+}
+
+inline void Profiler::Record(int zone, std::chrono::steady_clock::duration elapsed)
+{
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    auto &shard = LocalShard();
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (static_cast<std::size_t>(zone) >= shard.zones.size())
+    {
+        shard.zones.resize(zone + 1);
+    }
+    if (shard.zones[zone] == nullptr)
+    {
+        shard.zones[zone] = std::make_unique<ZoneStats>();
+    }
+    shard.zones[zone]->total_ns += ns;
+    shard.zones[zone]->histogram.Record(ns);
+}
+
+inline std::vector<Profiler::ZoneStats> Profiler::Collect(void)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto collected = std::vector<ZoneStats>(zone_names_.size());
+    for (const auto &shard : shards_)
+    {
+        std::lock_guard<std::mutex> shard_lock(shard->mutex);
+        for (auto i = std::size_t(0); i < shard->zones.size(); ++i)
+        {
+            if (shard->zones[i] != nullptr && shard->zones[i]->histogram.Count() != 0)
+            {
+                collected[i].Add(*shard->zones[i]);
+                shard->zones[i]->total_ns = 0;
+                shard->zones[i]->histogram.Reset();
+            }
+        }
+    }
+
+    totals_.resize(zone_names_.size());
+    auto ran = std::vector<ZoneStats>();
+    for (auto i = std::size_t(0); i < collected.size(); ++i)
+    {
+        totals_[i].name = zone_names_[i];
+        if (collected[i].histogram.Count() != 0)
+        {
+            totals_[i].Add(collected[i]);
+            collected[i].name = zone_names_[i];
+            ran.push_back(std::move(collected[i]));
+        }
+    }
+    return ran;
+}
+
+inline std::vector<Profiler::ZoneStats> Profiler::Totals(void)
+{
+    Collect();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto totals = std::vector<ZoneStats>();
+    for (const auto &zone : totals_)
+    {
+        if (zone.histogram.Count() != 0)
+        {
+            totals.push_back(zone);
+        }
+    }
+    return totals;
+}
+
+inline void Profiler::Report(std::ostream &out, const std::vector<ZoneStats> &zones)
+{
+    const auto us = [](double ns) { return ns / 1e3; };
+    out << std::fixed << std::setprecision(1) << std::left << std::setw(32) << "zone" << std::right << std::setw(10)
+        << "count" << std::setw(12) << "total ms" << std::setw(10) << "mean us" << std::setw(10) << "min us"
+        << std::setw(10) << "p50 us" << std::setw(10) << "p99 us" << std::setw(10) << "max us" << "\n";
+    for (const auto &zone : zones)
+    {
+        const auto &histogram = zone.histogram;
+        out << std::left << std::setw(32) << zone.name << std::right << std::setw(10) << histogram.Count()
+            << std::setw(12) << zone.total_ns / 1e6 << std::setw(10)
+            << us(static_cast<double>(zone.total_ns) / histogram.Count()) << std::setw(10) << us(histogram.Min())
+            << std::setw(10) << us(histogram.ValueAtPercentile(50)) << std::setw(10)
+            << us(histogram.ValueAtPercentile(99)) << std::setw(10) << us(histogram.Max()) << "\n";
+    }
+    out << std::flush;
+}
+
+inline Profiler::Shard &Profiler::LocalShard(void)
+{
+    // Gives the thread's shard back once it ends.
+    struct ThreadShard
+    {
+        ~ThreadShard()
+        {
+            if (shard != nullptr)
+            {
+                Profiler::Instance().ReturnShard(shard);
+            }
+        }
+
+        Shard *shard = nullptr;
+    };
+    thread_local auto thread_shard = ThreadShard();
+
+    if (thread_shard.shard == nullptr)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto &shard : shards_)
+        {
+            if (!shard->in_use)
+            {
+                thread_shard.shard = shard.get();
+                break;
+            }
+        }
+        if (thread_shard.shard == nullptr)
+        {
+            shards_.push_back(std::make_unique<Shard>());
+            thread_shard.shard = shards_.back().get();
+        }
+        thread_shard.shard->in_use = true;
+    }
+    return *thread_shard.shard;
+}
+
+inline void Profiler::ReturnShard(Shard *shard)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    shard->in_use = false;
+}
+
+inline ProfileReporter::ProfileReporter(std::chrono::steady_clock::duration interval, std::ostream &out)
+    : interval_(interval)
+    , out_(out)
+    , stopping_(false)
+    , thread_(&ProfileReporter::Run, this)
+{
+}
+
+inline ProfileReporter::~ProfileReporter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    stopped_.notify_one();
+    thread_.join();
+}
+
+inline void ProfileReporter::Run(void)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopped_.wait_for(lock, interval_, [this] { return stopping_; }))
+    {
+        const auto zones = Profiler::Instance().Collect();
+        if (!zones.empty())
+        {
+            Profiler::Report(out_, zones);
+        }
+    }
+}
+
+} // namespace robl
+
+/*=========================================================================*/
@@ -0,0 +1,69 @@
+#pragma once
+
+// standard headers
+#include <array>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+
+// project headers
+#include "metrics/rpc_metrics.hpp"
+
+/*=========================================================================*/
+
+namespace robl
+{
+
+/**
+ * @class RawMethods
+ * @brief The methods which this process serves, or calls, on ByteBuffers instead of the generated messages.
+ *
+ * A service marks each of its raw methods where it registers the raw handler, e.g. in the constructor of a service
+ * derived from WithRawCallbackMethod_GetMarker, and the metrics interceptors read the flag when a call starts.
+ */
+class RawMethods
+{
+public:
+    static RawMethods &Instance(void)
+    {
+        static RawMethods instance;
+        return instance;
+    }
+
+    /**
+     * Marks a method of a service raw on one side, e.g. Mark(Side::Server, TestService::service_full_name(),
+     * "GetMarker").
+     */
+    void Mark(RpcMetrics::Side side, const char *service, const char *method);
+
+    /**
+     * Whether the method is raw on the side, by its full name, e.g. "/robl.api.TestService/GetMarker".
+     */
+    bool Contains(RpcMetrics::Side side, const char *method) const;
+
+private:
+    RawMethods(void) = default;
+
+    mutable std::mutex mutex_;
+    std::array<std::set<std::string, std::less<>>, 2> methods_;
+};
+
+/*=========================================================================*/
+
+inline void RawMethods::Mark(RpcMetrics::Side side, const char *service, const char *method)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    methods_[static_cast<int>(side)].insert("/" + std::string(service) + "/" + method);
+}
+
+inline bool RawMethods::Contains(RpcMetrics::Side side, const char *method) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto &methods = methods_[static_cast<int>(side)];
+    return methods.find(method) != methods.end();
+}
+
+} // namespace robl
+
+/*=========================================================================*/
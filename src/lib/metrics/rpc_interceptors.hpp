@@ -0,0 +1,221 @@
+#pragma once
+
+// standard headers
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <random>
+#include <vector>
+
+// grpc headers
+#include <google/protobuf/message_lite.h>
+#include <grpcpp/support/byte_buffer.h>
+#include <grpcpp/support/client_interceptor.h>
+#include <grpcpp/support/interceptor.h>
+#include <grpcpp/support/server_interceptor.h>
+
+// project headers
+#include "metrics/raw_methods.hpp"
+#include "metrics/rpc_metrics.hpp"
+
+/*=========================================================================*/
+
+namespace robl
+{
+
+/**
+ * @class MetricsInterceptor
+ * @brief Records one call, on either side, into RpcMetrics.
+ *
+ * Sent messages are counted by their serialized size, which serializes them at the interception rather than right
+ * after it. Received messages arrive deserialized: the ByteBuffers of the methods marked in RawMethods are counted by
+ * their length, while sizing a generated message walks all of it, so only one in kTypedSizeSampling of them is sized,
+ * and counted for all of them.
+ */
+class MetricsInterceptor final : public grpc::experimental::Interceptor
+{
+public:
+    static constexpr auto kTypedSizeSampling = std::size_t(16);
+
+    MetricsInterceptor(RpcMetrics &metrics, RpcMetrics::Side side, const char *method, bool raw_messages);
+    ~MetricsInterceptor() override;
+
+    void Intercept(grpc::experimental::InterceptorBatchMethods *methods) override;
+
+private:
+    // A random start into the sampling of the generated messages, so that the messages a call samples do not depend
+    // on where they are in the call.
+    static std::size_t SamplingPhase(void);
+
+    // The bytes to count a received message for, 0 for a generated message which is not sampled.
+    std::size_t ReceivedSize(const void *message);
+
+    void Finish(grpc::StatusCode code);
+
+    RpcMetrics &metrics_;
+    const RpcMetrics::Side side_;
+    const int method_;
+    const bool raw_messages_;
+    std::size_t unsampled_;
+    const std::chrono::steady_clock::time_point start_;
+    bool finished_;
+};
+
+/**
+ * @class MetricsServerInterceptorFactory
+ * @brief Adds a MetricsInterceptor to every call of a server.
+ */
+class MetricsServerInterceptorFactory final : public grpc::experimental::ServerInterceptorFactoryInterface
+{
+public:
+    explicit MetricsServerInterceptorFactory(RpcMetrics &metrics)
+        : metrics_(metrics)
+    {
+    }
+
+    grpc::experimental::Interceptor *CreateServerInterceptor(grpc::experimental::ServerRpcInfo *info) override
+    {
+        return new MetricsInterceptor(metrics_, RpcMetrics::Side::Server, info->method(),
+                                      RawMethods::Instance().Contains(RpcMetrics::Side::Server, info->method()));
+    }
+
+private:
+    RpcMetrics &metrics_;
+};
+
+/**
+ * @class MetricsClientInterceptorFactory
+ * @brief Adds a MetricsInterceptor to every call of a channel.
+ */
+class MetricsClientInterceptorFactory final : public grpc::experimental::ClientInterceptorFactoryInterface
+{
+public:
+    explicit MetricsClientInterceptorFactory(RpcMetrics &metrics)
+        : metrics_(metrics)
+    {
+    }
+
+    grpc::experimental::Interceptor *CreateClientInterceptor(grpc::experimental::ClientRpcInfo *info) override
+    {
+        return new MetricsInterceptor(metrics_, RpcMetrics::Side::Client, info->method(),
+                                      RawMethods::Instance().Contains(RpcMetrics::Side::Client, info->method()));
+    }
+
+private:
+    RpcMetrics &metrics_;
+};
+
+/**
+ * The interceptors to build a server with, e.g. builder.experimental().SetInterceptorCreators(...).
+ */
+std::vector<std::unique_ptr<grpc::experimental::ServerInterceptorFactoryInterface>> ServerMetricsInterceptors(
+    RpcMetrics &metrics = RpcMetrics::Instance());
+
+/**
+ * The interceptors to create a channel with, e.g. grpc::experimental::CreateCustomChannelWithInterceptors().
+ */
+std::vector<std::unique_ptr<grpc::experimental::ClientInterceptorFactoryInterface>> ClientMetricsInterceptors(
+    RpcMetrics &metrics = RpcMetrics::Instance());
+
+/*=========================================================================*/
+
+inline MetricsInterceptor::MetricsInterceptor(RpcMetrics &metrics, RpcMetrics::Side side, const char *method,
+                                              bool raw_messages)
+    : metrics_(metrics)
+    , side_(side)
+    , method_(metrics.MethodId(side, method))
+    , raw_messages_(raw_messages)
+    , unsampled_(SamplingPhase())
+    , start_(std::chrono::steady_clock::now())
+    , finished_(false)
+{
+    metrics_.RecordStarted(method_);
+}
+
+inline MetricsInterceptor::~MetricsInterceptor()
+{
+    // A call torn down before its status went through the interceptor, e.g. one cancelled by the peer.
+    if (!finished_)
+    {
+        Finish(grpc::StatusCode::CANCELLED);
+    }
+}
+
+inline void MetricsInterceptor::Intercept(grpc::experimental::InterceptorBatchMethods *methods)
+{
+    using grpc::experimental::InterceptionHookPoints;
+
+    if (methods->QueryInterceptionHookPoint(InterceptionHookPoints::PRE_SEND_MESSAGE))
+    {
+        const auto *buffer = methods->GetSerializedSendMessage();
+        metrics_.RecordSent(method_, buffer != nullptr ? buffer->Length() : 0);
+    }
+    if (methods->QueryInterceptionHookPoint(InterceptionHookPoints::POST_RECV_MESSAGE))
+    {
+        // Null if the read failed, i.e. the peer has no more messages.
+        const auto *message = methods->GetRecvMessage();
+        if (message != nullptr)
+        {
+            metrics_.RecordReceived(method_, ReceivedSize(message));
+        }
+    }
+    if (side_ == RpcMetrics::Side::Server &&
+        methods->QueryInterceptionHookPoint(InterceptionHookPoints::PRE_SEND_STATUS))
+    {
+        Finish(methods->GetSendStatus().error_code());
+    }
+    if (side_ == RpcMetrics::Side::Client &&
+        methods->QueryInterceptionHookPoint(InterceptionHookPoints::POST_RECV_STATUS))
+    {
+        Finish(methods->GetRecvStatus()->error_code());
+    }
+    methods->Proceed();
+}
+
+inline std::size_t MetricsInterceptor::SamplingPhase(void)
+{
+    thread_local auto random = std::minstd_rand(std::random_device()());
+    return random() % kTypedSizeSampling;
+}
+
+inline std::size_t MetricsInterceptor::ReceivedSize(const void *message)
+{
+    if (raw_messages_)
+    {
+        return static_cast<const grpc::ByteBuffer *>(message)->Length();
+    }
+    if (unsampled_ > 0)
+    {
+        --unsampled_;
+        return 0;
+    }
+    unsampled_ = kTypedSizeSampling - 1;
+    // gRPC hands over the address of the generated message, whose MessageLite base is at its start.
+    return static_cast<const google::protobuf::MessageLite *>(message)->ByteSizeLong() * kTypedSizeSampling;
+}
+
+inline void MetricsInterceptor::Finish(grpc::StatusCode code)
+{
+    finished_ = true;
+    metrics_.RecordFinished(method_, code, std::chrono::steady_clock::now() - start_);
+}
+
+inline std::vector<std::unique_ptr<grpc::experimental::ServerInterceptorFactoryInterface>> ServerMetricsInterceptors(
+    RpcMetrics &metrics)
+{
+    auto interceptors = std::vector<std::unique_ptr<grpc::experimental::ServerInterceptorFactoryInterface>>();
+    interceptors.push_back(std::make_unique<MetricsServerInterceptorFactory>(metrics));
+    return interceptors;
+}
+
+inline std::vector<std::unique_ptr<grpc::experimental::ClientInterceptorFactoryInterface>> ClientMetricsInterceptors(
+    RpcMetrics &metrics)
+{
+    auto interceptors = std::vector<std::unique_ptr<grpc::experimental::ClientInterceptorFactoryInterface>>();
+    interceptors.push_back(std::make_unique<MetricsClientInterceptorFactory>(metrics));
+    return interceptors;
+}
+
+} // namespace robl
+
+/*=========================================================================*/
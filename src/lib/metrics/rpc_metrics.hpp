@@ -0,0 +1,442 @@
+#pragma once
+
+// standard headers
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// grpc headers
+#include <grpcpp/support/status.h>
+
+/*=========================================================================*/
+
+namespace robl
+{
+
+/**
+ * The name of a status code as Prometheus labels and reports spell it, e.g. "DEADLINE_EXCEEDED".
+ */
+const char *StatusCodeName(grpc::StatusCode code);
+
+/**
+ * @class RpcMetrics
+ * @brief Counts the calls of every method, by the side of the call: how many started, are in flight and ended with
+ * which code, how long they took, and the messages and bytes they sent and received.
+ *
+ * Every thread records into a shard of its own, under a lock which only a scrape ever contends for, so recording
+ * costs nanoseconds. A scrape merges the shards. The shard of a thread which ended is handed to the next new thread,
+ * so a server whose thread pool comes and goes does not pile up shards.
+ */
+class RpcMetrics
+{
+public:
+    enum class Side
+    {
+        Server,
+        Client,
+    };
+
+    // The upper bounds of the latency buckets, in microseconds, from 100 us to 10 s.
+    static constexpr std::array<std::int64_t, 16> kLatencyBoundsUs = {
+        100,    250,    500,     1000,    2500,    5000,    10000,   25000,
+        50000,  100000, 250000,  500000,  1000000, 2500000, 5000000, 10000000,
+    };
+
+    RpcMetrics(void);
+
+    RpcMetrics(const RpcMetrics &) = delete;
+    RpcMetrics &operator=(const RpcMetrics &) = delete;
+
+    /**
+     * The metrics which the interceptors of this process record into unless they are given others.
+     */
+    static RpcMetrics &Instance(void)
+    {
+        static RpcMetrics instance;
+        return instance;
+    }
+
+    /**
+     * The id to record the calls of a method by, e.g. "/robl.api.TestService/SayHello". Resolved once per call, in a
+     * cache of the thread's shard.
+     */
+    int MethodId(Side side, const char *method);
+
+    void RecordStarted(int method);
+    void RecordSent(int method, std::size_t bytes);
+    void RecordReceived(int method, std::size_t bytes);
+    void RecordFinished(int method, grpc::StatusCode code, std::chrono::steady_clock::duration latency);
+
+    /**
+     * Writes all the methods seen so far in the Prometheus text exposition format.
+     */
+    void WritePrometheus(std::ostream &out) const;
+
+private:
+    struct MethodCounters
+    {
+        std::int64_t started = 0;
+        std::int64_t finished = 0;
+        std::array<std::uint64_t, 17> codes = {};
+        // The last bucket counts the calls above the highest bound.
+        std::array<std::uint64_t, kLatencyBoundsUs.size() + 1> latency_buckets = {};
+        std::int64_t latency_sum_us = 0;
+        std::uint64_t sent_messages = 0;
+        std::uint64_t sent_bytes = 0;
+        std::uint64_t received_messages = 0;
+        std::uint64_t received_bytes = 0;
+
+        void Add(const MethodCounters &other);
+    };
+
+    struct CachedId
+    {
+        std::string method;
+        int id;
+    };
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::vector<MethodCounters> methods;
+        // By the address of the method name, which gRPC takes from the generated code, checked against the name in
+        // case the address was reused for another one.
+        std::array<std::unordered_map<const char *, CachedId>, 2> ids;
+        bool in_use = false;
+    };
+
+    // Outlives the metrics for as long as a thread holds one of its shards, so that a thread ending after the
+    // metrics were destroyed finds out instead of touching them.
+    struct Shards
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Shard>> all;
+    };
+
+    struct Method
+    {
+        Side side;
+        std::string service;
+        std::string name;
+    };
+
+    // Locks the thread's shard and makes room for the method in it.
+    MethodCounters &LockCounters(int method, std::unique_lock<std::mutex> &lock);
+    Shard &LocalShard(void);
+    int RegisterMethod(Side side, const char *method);
+
+    std::shared_ptr<Shards> shards_;
+    mutable std::mutex methods_mutex_;
+    std::map<std::pair<Side, std::string>, int> method_ids_;
+    std::vector<Method> methods_;
+};
+
+/*=========================================================================*/
+
+inline const char *StatusCodeName(grpc::StatusCode code)
+{
+    switch (code)
+    {
+    case grpc::StatusCode::OK:
+        return "OK";
+    case grpc::StatusCode::CANCELLED:
+        return "CANCELLED";
+    case grpc::StatusCode::UNKNOWN:
+        return "UNKNOWN";
+    case grpc::StatusCode::INVALID_ARGUMENT:
+        return "INVALID_ARGUMENT";
+    case grpc::StatusCode::DEADLINE_EXCEEDED:
+        return "DEADLINE_EXCEEDED";
+    case grpc::StatusCode::NOT_FOUND:
+        return "NOT_FOUND";
+    case grpc::StatusCode::ALREADY_EXISTS:
+        return "ALREADY_EXISTS";
+    case grpc::StatusCode::PERMISSION_DENIED:
+        return "PERMISSION_DENIED";
+    case grpc::StatusCode::RESOURCE_EXHAUSTED:
+        return "RESOURCE_EXHAUSTED";
+    case grpc::StatusCode::FAILED_PRECONDITION:
+        return "FAILED_PRECONDITION";
+    case grpc::StatusCode::ABORTED:
+        return "ABORTED";
+    case grpc::StatusCode::OUT_OF_RANGE:
+        return "OUT_OF_RANGE";
+    case grpc::StatusCode::UNIMPLEMENTED:
+        return "UNIMPLEMENTED";
+    case grpc::StatusCode::INTERNAL:
+        return "INTERNAL";
+    case grpc::StatusCode::UNAVAILABLE:
+        return "UNAVAILABLE";
+    case grpc::StatusCode::DATA_LOSS:
+        return "DATA_LOSS";
+    case grpc::StatusCode::UNAUTHENTICATED:
+        return "UNAUTHENTICATED";
+    default:
+        return "UNRECOGNIZED";
+    }
+}
+
+inline void RpcMetrics::MethodCounters::Add(const MethodCounters &other)
+{
+    started += other.started;
+    finished += other.finished;
+    for (auto i = std::size_t(0); i < codes.size(); ++i)
+    {
+        codes[i] += other.codes[i];
+    }
+    for (auto i = std::size_t(0); i < latency_buckets.size(); ++i)
+    {
+        latency_buckets[i] += other.latency_buckets[i];
+    }
+    latency_sum_us += other.latency_sum_us;
+    sent_messages += other.sent_messages;
+    sent_bytes += other.sent_bytes;
+    received_messages += other.received_messages;
+    received_bytes += other.received_bytes;
+}
+
+inline RpcMetrics::RpcMetrics(void)
+    : shards_(std::make_shared<Shards>())
+{
+}
+
+inline int RpcMetrics::MethodId(Side side, const char *method)
+{
+    auto &shard = LocalShard();
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto &ids = shard.ids[static_cast<int>(side)];
+        const auto it = ids.find(method);
+        if (it != ids.end() && it->second.method == method)
+        {
+            return it->second.id;
+        }
+    }
+
+    const auto id = RegisterMethod(side, method);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.ids[static_cast<int>(side)][method] = CachedId{ method, id };
+    return id;
+}
+
+inline void RpcMetrics::RecordStarted(int method)
+{
+    auto lock = std::unique_lock<std::mutex>();
+    ++LockCounters(method, lock).started;
+}
+
+inline void RpcMetrics::RecordSent(int method, std::size_t bytes)
+{
+    auto lock = std::unique_lock<std::mutex>();
+    auto &counters = LockCounters(method, lock);
+    ++counters.sent_messages;
+    counters.sent_bytes += bytes;
+}
+
+inline void RpcMetrics::RecordReceived(int method, std::size_t bytes)
+{
+    auto lock = std::unique_lock<std::mutex>();
+    auto &counters = LockCounters(method, lock);
+    ++counters.received_messages;
+    counters.received_bytes += bytes;
+}
+
+inline void RpcMetrics::RecordFinished(int method, grpc::StatusCode code, std::chrono::steady_clock::duration latency)
+{
+    const auto latency_us = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+    const auto bucket = std::lower_bound(kLatencyBoundsUs.begin(), kLatencyBoundsUs.end(), latency_us) -
+                        kLatencyBoundsUs.begin();
+
+    auto lock = std::unique_lock<std::mutex>();
+    auto &counters = LockCounters(method, lock);
+    ++counters.finished;
+    ++counters.codes[std::min<std::size_t>(static_cast<std::size_t>(code), counters.codes.size() - 1)];
+    ++counters.latency_buckets[bucket];
+    counters.latency_sum_us += latency_us;
+}
+
+inline void RpcMetrics::WritePrometheus(std::ostream &out) const
+{
+    auto methods = std::vector<Method>();
+    {
+        std::lock_guard<std::mutex> lock(methods_mutex_);
+        methods = methods_;
+    }
+
+    auto totals = std::vector<MethodCounters>(methods.size());
+    {
+        std::lock_guard<std::mutex> shards_lock(shards_->mutex);
+        for (const auto &shard : shards_->all)
+        {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            for (auto i = std::size_t(0); i < shard->methods.size() && i < totals.size(); ++i)
+            {
+                totals[i].Add(shard->methods[i]);
+            }
+        }
+    }
+
+    const auto labels = [&methods](std::size_t i) {
+        return std::string("side=\"") + (methods[i].side == Side::Server ? "server" : "client") + "\",service=\"" +
+               methods[i].service + "\",method=\"" + methods[i].name + "\"";
+    };
+    const auto counter = [&](const char *name, const char *type, const char *help, auto value) {
+        out << "# HELP " << name << " " << help << "\n# TYPE " << name << " " << type << "\n";
+        for (auto i = std::size_t(0); i < totals.size(); ++i)
+        {
+            out << name << "{" << labels(i) << "} " << value(totals[i]) << "\n";
+        }
+    };
+
+    out << std::fixed << std::setprecision(6);
+    counter("robl_rpc_started_total", "counter", "Calls started.", [](const auto &c) { return c.started; });
+    counter("robl_rpc_in_flight", "gauge", "Calls started and not ended yet.",
+            [](const auto &c) { return c.started - c.finished; });
+
+    out << "# HELP robl_rpc_handled_total Calls ended, by status code.\n# TYPE robl_rpc_handled_total counter\n";
+    for (auto i = std::size_t(0); i < totals.size(); ++i)
+    {
+        for (auto code = std::size_t(0); code < totals[i].codes.size(); ++code)
+        {
+            if (totals[i].codes[code] != 0)
+            {
+                out << "robl_rpc_handled_total{" << labels(i) << ",code=\""
+                    << StatusCodeName(static_cast<grpc::StatusCode>(code)) << "\"} " << totals[i].codes[code] << "\n";
+            }
+        }
+    }
+
+    out << "# HELP robl_rpc_latency_seconds How long calls took, from start to status.\n"
+        << "# TYPE robl_rpc_latency_seconds histogram\n";
+    for (auto i = std::size_t(0); i < totals.size(); ++i)
+    {
+        auto cumulative = std::uint64_t(0);
+        for (auto bucket = std::size_t(0); bucket < totals[i].latency_buckets.size(); ++bucket)
+        {
+            cumulative += totals[i].latency_buckets[bucket];
+            out << "robl_rpc_latency_seconds_bucket{" << labels(i) << ",le=\"";
+            if (bucket < kLatencyBoundsUs.size())
+            {
+                out << kLatencyBoundsUs[bucket] / 1e6;
+            }
+            else
+            {
+                out << "+Inf";
+            }
+            out << "\"} " << cumulative << "\n";
+        }
+        out << "robl_rpc_latency_seconds_sum{" << labels(i) << "} " << totals[i].latency_sum_us / 1e6 << "\n"
+            << "robl_rpc_latency_seconds_count{" << labels(i) << "} " << cumulative << "\n";
+    }
+
+    counter("robl_rpc_sent_messages_total", "counter", "Messages sent.",
+            [](const auto &c) { return c.sent_messages; });
+    counter("robl_rpc_sent_bytes_total", "counter", "Bytes of the messages sent, serialized.",
+            [](const auto &c) { return c.sent_bytes; });
+    counter("robl_rpc_received_messages_total", "counter", "Messages received.",
+            [](const auto &c) { return c.received_messages; });
+    counter("robl_rpc_received_bytes_total", "counter",
+            "Bytes of the messages received, serialized, estimated from a sample of the generated ones.",
+            [](const auto &c) { return c.received_bytes; });
+}
+
+inline RpcMetrics::MethodCounters &RpcMetrics::LockCounters(int method, std::unique_lock<std::mutex> &lock)
+{
+    auto &shard = LocalShard();
+    lock = std::unique_lock<std::mutex>(shard.mutex);
+    if (static_cast<std::size_t>(method) >= shard.methods.size())
+    {
+        shard.methods.resize(method + 1);
+    }
+    return shard.methods[method];
+}
+
+inline RpcMetrics::Shard &RpcMetrics::LocalShard(void)
+{
+    struct Held
+    {
+        const Shards *key;
+        std::weak_ptr<Shards> shards;
+        Shard *shard;
+    };
+
+    // Gives the thread's shards back once it ends.
+    struct ThreadShards
+    {
+        ~ThreadShards()
+        {
+            for (const auto &held : all)
+            {
+                if (const auto shards = held.shards.lock())
+                {
+                    std::lock_guard<std::mutex> lock(shards->mutex);
+                    held.shard->in_use = false;
+                }
+            }
+        }
+
+        std::vector<Held> all;
+    };
+    thread_local auto thread_shards = ThreadShards();
+
+    // Metrics destroyed and others created at the same address leave an entry which has expired.
+    for (const auto &held : thread_shards.all)
+    {
+        if (held.key == shards_.get() && !held.shards.expired())
+        {
+            return *held.shard;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(shards_->mutex);
+    auto &all = shards_->all;
+    auto it = std::find_if(all.begin(), all.end(), [](const auto &shard) { return !shard->in_use; });
+    if (it == all.end())
+    {
+        it = all.insert(all.end(), std::make_unique<Shard>());
+    }
+    (*it)->in_use = true;
+    thread_shards.all.push_back(Held{ shards_.get(), shards_, it->get() });
+    return **it;
+}
+
+inline int RpcMetrics::RegisterMethod(Side side, const char *method)
+{
+    std::lock_guard<std::mutex> lock(methods_mutex_);
+    const auto key = std::make_pair(side, std::string(method));
+    const auto it = method_ids_.find(key);
+    if (it != method_ids_.end())
+    {
+        return it->second;
+    }
+
+    // "/package.Service/Method"
+    const auto &full_name = key.second;
+    const auto slash = full_name.rfind('/');
+    const auto begin = full_name.empty() || full_name[0] != '/' ? 0 : 1;
+    auto entry = Method{ side, std::string(), full_name };
+    if (slash != std::string::npos && slash > std::size_t(begin))
+    {
+        entry.service = full_name.substr(begin, slash - begin);
+        entry.name = full_name.substr(slash + 1);
+    }
+
+    const auto id = static_cast<int>(methods_.size());
+    methods_.push_back(std::move(entry));
+    method_ids_.emplace(key, id);
+    return id;
+}
+
+} // namespace robl
+
+/*=========================================================================*/
@@ -0,0 +1,146 @@
+#pragma once
+
+// standard headers
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/*=========================================================================*/
+
+namespace robl::pointcloud
+{
+
+/**
+ * @class AlignedBuffer
+ * @brief A growable array of trivially copyable values whose storage is aligned for vector loads.
+ *
+ * Unlike std::vector, growing the buffer leaves the new values uninitialized, since a decoder overwrites them anyway.
+ */
+template <typename T, std::size_t Alignment = 64>
+class AlignedBuffer
+{
+    static_assert(std::is_trivially_copyable_v<T>, "AlignedBuffer holds trivially copyable values only");
+
+public:
+    AlignedBuffer(void)
+        : data_(nullptr)
+        , size_(0)
+        , capacity_(0)
+    {
+    }
+
+    AlignedBuffer(AlignedBuffer &&other) noexcept
+        : data_(std::exchange(other.data_, nullptr))
+        , size_(std::exchange(other.size_, 0))
+        , capacity_(std::exchange(other.capacity_, 0))
+    {
+    }
+
+    AlignedBuffer &operator=(AlignedBuffer &&other) noexcept
+    {
+        if (this != &other)
+        {
+            Deallocate(data_);
+            data_ = std::exchange(other.data_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+            capacity_ = std::exchange(other.capacity_, 0);
+        }
+        return *this;
+    }
+
+    AlignedBuffer(const AlignedBuffer &) = delete;
+    AlignedBuffer &operator=(const AlignedBuffer &) = delete;
+
+    ~AlignedBuffer()
+    {
+        Deallocate(data_);
+    }
+
+    /**
+     * Makes room for at least capacity values, keeping the current ones.
+     */
+    void Reserve(std::size_t capacity)
+    {
+        if (capacity <= capacity_)
+        {
+            return;
+        }
+
+        auto *data = static_cast<T *>(::operator new(capacity * sizeof(T), std::align_val_t(Alignment)));
+        if (size_ > 0)
+        {
+            std::memcpy(data, data_, size_ * sizeof(T));
+        }
+        Deallocate(data_);
+        data_ = data;
+        capacity_ = capacity;
+    }
+
+    /**
+     * Sets the number of the values. Values beyond the old size are uninitialized. The capacity grows geometrically,
+     * so appending chunk by chunk reallocates a logarithmic number of times.
+     */
+    void Resize(std::size_t size)
+    {
+        if (size > capacity_)
+        {
+            Reserve(std::max(size, capacity_ * 2));
+        }
+        size_ = size;
+    }
+
+    void Clear(void)
+    {
+        size_ = 0;
+    }
+
+    T *data(void)
+    {
+        return data_;
+    }
+
+    const T *data(void) const
+    {
+        return data_;
+    }
+
+    std::size_t size(void) const
+    {
+        return size_;
+    }
+
+    std::size_t capacity(void) const
+    {
+        return capacity_;
+    }
+
+    T &operator[](std::size_t i)
+    {
+        return data_[i];
+    }
+
+    const T &operator[](std::size_t i) const
+    {
+        return data_[i];
+    }
+
+private:
+    static void Deallocate(T *data)
+    {
+        if (data != nullptr)
+        {
+            ::operator delete(data, std::align_val_t(Alignment));
+        }
+    }
+
+    T *data_;
+    std::size_t size_;
+    std::size_t capacity_;
+};
+
+} // namespace robl::pointcloud
+
+/*=========================================================================*/
@@ -0,0 +1,174 @@
+// standard headers
+#include <cmath>
+#include <string>
+
+// grpc headers
+#include <benchmark/benchmark.h>
+
+// project headers
+#include "pointcloud/point_cloud_codec.hpp"
+
+/*=========================================================================*/
+
+namespace
+{
+
+constexpr auto point_count = std::size_t(100000);
+
+/**
+ * Builds a scan like the ones of a spinning lidar: rings of points ordered by azimuth, so neighbouring points are
+ * close to each other.
+ */
+const robl::pointcloud::PointColumns &Scan(void)
+{
+    static const auto scan = []() {
+        auto points = robl::pointcloud::PointColumns();
+        points.Resize(point_count);
+
+        constexpr auto rings = 32;
+        const auto per_ring = point_count / rings;
+        for (auto i = std::size_t(0); i < point_count; ++i)
+        {
+            const auto ring = static_cast<double>(i / per_ring);
+            const auto azimuth = 2.0 * M_PI * static_cast<double>(i % per_ring) / per_ring;
+            const auto range = 10.0 + 2.0 * std::sin(azimuth * 7.0) + 0.3 * ring;
+            const auto elevation = (ring - rings / 2) * 0.02;
+            points.x[i] = static_cast<float>(range * std::cos(elevation) * std::cos(azimuth));
+            points.y[i] = static_cast<float>(range * std::cos(elevation) * std::sin(azimuth));
+            points.z[i] = static_cast<float>(range * std::sin(elevation));
+        }
+        return points;
+    }();
+
+    return scan;
+}
+
+robl::api::ColumnFormat Format(std::int64_t encoding)
+{
+    auto format = robl::api::ColumnFormat();
+    format.set_encoding(static_cast<robl::api::ColumnEncoding>(encoding));
+    format.set_step(0.001); // mm
+    return format;
+}
+
+void BM_EncodePointList(benchmark::State &state)
+{
+    const auto &scan = Scan();
+    auto list = robl::api::PointList();
+    auto wire = std::string();
+
+    for (auto _ : state)
+    {
+        list.Clear();
+        for (auto i = std::size_t(0); i < point_count; ++i)
+        {
+            auto *point = list.add_points();
+            point->set_x(scan.x[i]);
+            point->set_y(scan.y[i]);
+            point->set_z(scan.z[i]);
+        }
+        list.SerializeToString(&wire);
+        benchmark::DoNotOptimize(wire.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * point_count);
+    state.counters["bytes_per_point"] = static_cast<double>(wire.size()) / point_count;
+}
+
+void BM_DecodePointList(benchmark::State &state)
+{
+    const auto &scan = Scan();
+    auto list = robl::api::PointList();
+    for (auto i = std::size_t(0); i < point_count; ++i)
+    {
+        auto *point = list.add_points();
+        point->set_x(scan.x[i]);
+        point->set_y(scan.y[i]);
+        point->set_z(scan.z[i]);
+    }
+    const auto wire = list.SerializeAsString();
+
+    auto points = robl::pointcloud::PointColumns();
+    for (auto _ : state)
+    {
+        list.ParseFromString(wire);
+        points.Resize(list.points_size());
+        for (auto i = 0; i < list.points_size(); ++i)
+        {
+            points.x[i] = list.points(i).x();
+            points.y[i] = list.points(i).y();
+            points.z[i] = list.points(i).z();
+        }
+        benchmark::DoNotOptimize(points.x.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * point_count);
+    state.counters["bytes_per_point"] = static_cast<double>(wire.size()) / point_count;
+}
+
+void BM_EncodeColumnar(benchmark::State &state)
+{
+    const auto &scan = Scan();
+    const auto format = Format(state.range(0));
+    auto chunk = robl::api::PointCloudChunk();
+    auto wire = std::string();
+    auto error = std::string();
+
+    for (auto _ : state)
+    {
+        if (!robl::pointcloud::EncodePointCloud(scan, 0, point_count, format, &chunk, &error))
+        {
+            state.SkipWithError(error.c_str());
+            return;
+        }
+        chunk.SerializeToString(&wire);
+        benchmark::DoNotOptimize(wire.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * point_count);
+    state.counters["bytes_per_point"] = static_cast<double>(wire.size()) / point_count;
+}
+
+void BM_DecodeColumnar(benchmark::State &state)
+{
+    const auto &scan = Scan();
+    auto chunk = robl::api::PointCloudChunk();
+    auto error = std::string();
+    robl::pointcloud::EncodePointCloud(scan, 0, point_count, Format(state.range(0)), &chunk, &error);
+    const auto wire = chunk.SerializeAsString();
+
+    auto points = robl::pointcloud::PointColumns();
+    for (auto _ : state)
+    {
+        points.Resize(0);
+        chunk.ParseFromString(wire);
+        if (!robl::pointcloud::DecodePointCloud(chunk, &points, &error))
+        {
+            state.SkipWithError(error.c_str());
+            return;
+        }
+        benchmark::DoNotOptimize(points.x.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * point_count);
+    state.counters["bytes_per_point"] = static_cast<double>(wire.size()) / point_count;
+}
+
+} // namespace
+
+BENCHMARK(BM_EncodePointList);
+BENCHMARK(BM_DecodePointList);
+BENCHMARK(BM_EncodeColumnar)
+    ->ArgName("encoding")
+    ->Arg(robl::api::COLUMN_ENCODING_FLOAT32)
+    ->Arg(robl::api::COLUMN_ENCODING_FIXED)
+    ->Arg(robl::api::COLUMN_ENCODING_FIXED_DELTA);
+BENCHMARK(BM_DecodeColumnar)
+    ->ArgName("encoding")
+    ->Arg(robl::api::COLUMN_ENCODING_FLOAT32)
+    ->Arg(robl::api::COLUMN_ENCODING_FIXED)
+    ->Arg(robl::api::COLUMN_ENCODING_FIXED_DELTA);
+
+BENCHMARK_MAIN();
+
+/*=========================================================================*/
@@ -0,0 +1,301 @@
+// standard headers
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+
+// project headers
+#include "pointcloud/point_cloud_codec.hpp"
+
+/*=========================================================================*/
+
+namespace robl::pointcloud
+{
+
+namespace
+{
+
+// Fixed point values are kept within 30 bits, so the difference of two of them fits an int32.
+constexpr auto max_fixed_value = double(1 << 30);
+constexpr auto max_varint_bytes = std::size_t(5);
+
+std::uint32_t ZigZag(std::int32_t value)
+{
+    return (static_cast<std::uint32_t>(value) << 1) ^ static_cast<std::uint32_t>(value >> 31);
+}
+
+std::int32_t UnZigZag(std::uint32_t value)
+{
+    return static_cast<std::int32_t>((value >> 1) ^ (~(value & 1) + 1));
+}
+
+bool EncodeFixed(const float *values, std::size_t count, double step, bool delta, std::string *data,
+                 std::string *error)
+{
+    data->resize(count * max_varint_bytes);
+    auto *out = reinterpret_cast<std::uint8_t *>(&(*data)[0]);
+
+    const auto inv_step = 1.0 / step;
+    auto previous = std::int32_t(0);
+    for (auto i = std::size_t(0); i < count; ++i)
+    {
+        const auto scaled = std::nearbyint(double(values[i]) * inv_step);
+        if (!(std::fabs(scaled) < max_fixed_value))
+        {
+            *error = "value " + std::to_string(values[i]) + " does not fit the fixed point range";
+            return false;
+        }
+
+        const auto fixed = static_cast<std::int32_t>(scaled);
+        auto encoded = ZigZag(delta ? fixed - previous : fixed);
+        previous = fixed;
+
+        while (encoded >= 0x80)
+        {
+            *out++ = static_cast<std::uint8_t>(encoded | 0x80);
+            encoded >>= 7;
+        }
+        *out++ = static_cast<std::uint8_t>(encoded);
+    }
+
+    data->resize(out - reinterpret_cast<std::uint8_t *>(&(*data)[0]));
+    return true;
+}
+
+bool DecodeFixed(const std::string &data, std::size_t count, double step, bool delta, float *out, std::string *error)
+{
+    const auto *in = reinterpret_cast<const std::uint8_t *>(data.data());
+    const auto *end = in + data.size();
+
+    auto previous = std::int32_t(0);
+    for (auto i = std::size_t(0); i < count; ++i)
+    {
+        auto encoded = std::uint32_t(0);
+        auto shift = 0;
+        while (true)
+        {
+            if (in == end || shift > 28)
+            {
+                *error = "column data is truncated or malformed";
+                return false;
+            }
+            const auto byte = *in++;
+            encoded |= static_cast<std::uint32_t>(byte & 0x7f) << shift;
+            if (byte < 0x80)
+            {
+                break;
+            }
+            shift += 7;
+        }
+
+        auto fixed = UnZigZag(encoded);
+        if (delta)
+        {
+            fixed = static_cast<std::int32_t>(static_cast<std::uint32_t>(previous) + static_cast<std::uint32_t>(fixed));
+            previous = fixed;
+        }
+        out[i] = static_cast<float>(fixed * step);
+    }
+
+    if (in != end)
+    {
+        *error = "column holds more values than expected";
+        return false;
+    }
+    return true;
+}
+
+void EncodeFloat32(const float *values, std::size_t count, std::string *data)
+{
+    data->resize(count * sizeof(float));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    std::memcpy(&(*data)[0], values, count * sizeof(float));
+#else
+    for (auto i = std::size_t(0); i < count; ++i)
+    {
+        auto bits = std::uint32_t(0);
+        std::memcpy(&bits, &values[i], sizeof(bits));
+        bits = __builtin_bswap32(bits);
+        std::memcpy(&(*data)[i * sizeof(float)], &bits, sizeof(bits));
+    }
+#endif
+}
+
+void DecodeFloat32(const std::string &data, std::size_t count, float *out)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    std::memcpy(out, data.data(), count * sizeof(float));
+#else
+    for (auto i = std::size_t(0); i < count; ++i)
+    {
+        auto bits = std::uint32_t(0);
+        std::memcpy(&bits, data.data() + i * sizeof(float), sizeof(bits));
+        bits = __builtin_bswap32(bits);
+        std::memcpy(&out[i], &bits, sizeof(bits));
+    }
+#endif
+}
+
+/**
+ * Checks that the data of a column can hold count values before any buffer is sized for them: a float column holds
+ * exactly four bytes per value, a fixed point column one to five.
+ */
+bool CheckColumnSize(const robl::api::Column &column, std::size_t count, std::string *error)
+{
+    const auto size = column.data().size();
+    switch (column.encoding())
+    {
+    case robl::api::COLUMN_ENCODING_FLOAT32:
+        if (size / sizeof(float) != count || size % sizeof(float) != 0)
+        {
+            *error = "column size does not match the value count";
+            return false;
+        }
+        return true;
+    case robl::api::COLUMN_ENCODING_FIXED:
+    case robl::api::COLUMN_ENCODING_FIXED_DELTA:
+        if (size < count || size / max_varint_bytes > count)
+        {
+            *error = "column size does not match the value count";
+            return false;
+        }
+        return true;
+    default:
+        *error = "unknown column encoding";
+        return false;
+    }
+}
+
+} // namespace
+
+/*=========================================================================*/
+
+bool EncodeColumn(const float *values, std::size_t count, const robl::api::ColumnFormat &format,
+                  robl::api::Column *column, std::string *error)
+{
+    column->set_encoding(format.encoding());
+    column->set_step(format.step());
+
+    switch (format.encoding())
+    {
+    case robl::api::COLUMN_ENCODING_FLOAT32:
+        column->set_step(0.0);
+        EncodeFloat32(values, count, column->mutable_data());
+        return true;
+    case robl::api::COLUMN_ENCODING_FIXED:
+    case robl::api::COLUMN_ENCODING_FIXED_DELTA:
+        if (!(format.step() > 0.0) || !std::isfinite(format.step()))
+        {
+            *error = "fixed point step must be positive";
+            return false;
+        }
+        return EncodeFixed(values, count, format.step(), format.encoding() == robl::api::COLUMN_ENCODING_FIXED_DELTA,
+                           column->mutable_data(), error);
+    default:
+        *error = "unknown column encoding";
+        return false;
+    }
+}
+
+bool DecodeColumn(const robl::api::Column &column, std::size_t count, float *out, std::string *error)
+{
+    switch (column.encoding())
+    {
+    case robl::api::COLUMN_ENCODING_FLOAT32:
+        if (column.data().size() != count * sizeof(float))
+        {
+            *error = "column size does not match the value count";
+            return false;
+        }
+        DecodeFloat32(column.data(), count, out);
+        return true;
+    case robl::api::COLUMN_ENCODING_FIXED:
+    case robl::api::COLUMN_ENCODING_FIXED_DELTA:
+        if (!(column.step() > 0.0) || !std::isfinite(column.step()))
+        {
+            *error = "fixed point step must be positive";
+            return false;
+        }
+        return DecodeFixed(column.data(), count, column.step(),
+                           column.encoding() == robl::api::COLUMN_ENCODING_FIXED_DELTA, out, error);
+    default:
+        *error = "unknown column encoding";
+        return false;
+    }
+}
+
+bool EncodePointCloud(const PointColumns &points, std::size_t begin, std::size_t count,
+                      const robl::api::ColumnFormat &format, robl::api::PointCloudChunk *chunk, std::string *error)
+{
+    chunk->set_point_count(static_cast<std::uint32_t>(count));
+    return EncodeColumn(points.x.data() + begin, count, format, chunk->mutable_x(), error) &&
+           EncodeColumn(points.y.data() + begin, count, format, chunk->mutable_y(), error) &&
+           EncodeColumn(points.z.data() + begin, count, format, chunk->mutable_z(), error);
+}
+
+bool DecodePointCloud(const robl::api::PointCloudChunk &chunk, PointColumns *points, std::string *error)
+{
+    const auto offset = points->size();
+    const auto count = std::size_t(chunk.point_count());
+    if (!CheckColumnSize(chunk.x(), count, error) || !CheckColumnSize(chunk.y(), count, error) ||
+        !CheckColumnSize(chunk.z(), count, error))
+    {
+        return false;
+    }
+    points->Resize(offset + count);
+
+    if (!DecodeColumn(chunk.x(), count, points->x.data() + offset, error) ||
+        !DecodeColumn(chunk.y(), count, points->y.data() + offset, error) ||
+        !DecodeColumn(chunk.z(), count, points->z.data() + offset, error))
+    {
+        points->Resize(offset);
+        return false;
+    }
+    return true;
+}
+
+bool EncodePoses(const PoseColumns &poses, std::size_t begin, std::size_t count,
+                 const robl::api::ColumnFormat &position_format, const robl::api::ColumnFormat &rotation_format,
+                 robl::api::PoseChunk *chunk, std::string *error)
+{
+    chunk->set_pose_count(static_cast<std::uint32_t>(count));
+    return EncodeColumn(poses.tx.data() + begin, count, position_format, chunk->mutable_tx(), error) &&
+           EncodeColumn(poses.ty.data() + begin, count, position_format, chunk->mutable_ty(), error) &&
+           EncodeColumn(poses.tz.data() + begin, count, position_format, chunk->mutable_tz(), error) &&
+           EncodeColumn(poses.qx.data() + begin, count, rotation_format, chunk->mutable_qx(), error) &&
+           EncodeColumn(poses.qy.data() + begin, count, rotation_format, chunk->mutable_qy(), error) &&
+           EncodeColumn(poses.qz.data() + begin, count, rotation_format, chunk->mutable_qz(), error) &&
+           EncodeColumn(poses.qw.data() + begin, count, rotation_format, chunk->mutable_qw(), error);
+}
+
+bool DecodePoses(const robl::api::PoseChunk &chunk, PoseColumns *poses, std::string *error)
+{
+    const auto offset = poses->size();
+    const auto count = std::size_t(chunk.pose_count());
+    for (const auto *column : { &chunk.tx(), &chunk.ty(), &chunk.tz(), &chunk.qx(), &chunk.qy(), &chunk.qz(),
+                                &chunk.qw() })
+    {
+        if (!CheckColumnSize(*column, count, error))
+        {
+            return false;
+        }
+    }
+    poses->Resize(offset + count);
+
+    if (!DecodeColumn(chunk.tx(), count, poses->tx.data() + offset, error) ||
+        !DecodeColumn(chunk.ty(), count, poses->ty.data() + offset, error) ||
+        !DecodeColumn(chunk.tz(), count, poses->tz.data() + offset, error) ||
+        !DecodeColumn(chunk.qx(), count, poses->qx.data() + offset, error) ||
+        !DecodeColumn(chunk.qy(), count, poses->qy.data() + offset, error) ||
+        !DecodeColumn(chunk.qz(), count, poses->qz.data() + offset, error) ||
+        !DecodeColumn(chunk.qw(), count, poses->qw.data() + offset, error))
+    {
+        poses->Resize(offset);
+        return false;
+    }
+    return true;
+}
+
+} // namespace robl::pointcloud
+
+/*=========================================================================*/
@@ -0,0 +1,123 @@
+#pragma once
+
+// standard headers
+#include <cstddef>
+#include <initializer_list>
+#include <string>
+
+// grpc headers
+#include <robl/api/point_cloud.pb.h>
+
+// project headers
+#include "pointcloud/aligned_buffer.hpp"
+
+/*=========================================================================*/
+
+namespace robl::pointcloud
+{
+
+/**
+ * @struct PointColumns
+ * @brief A point cloud in structure-of-arrays layout.
+ */
+struct PointColumns
+{
+    AlignedBuffer<float> x;
+    AlignedBuffer<float> y;
+    AlignedBuffer<float> z;
+
+    std::size_t size(void) const
+    {
+        return x.size();
+    }
+
+    void Resize(std::size_t size)
+    {
+        x.Resize(size);
+        y.Resize(size);
+        z.Resize(size);
+    }
+};
+
+/**
+ * @struct PoseColumns
+ * @brief A sequence of poses in structure-of-arrays layout, a translation and a quaternion per pose.
+ */
+struct PoseColumns
+{
+    AlignedBuffer<float> tx;
+    AlignedBuffer<float> ty;
+    AlignedBuffer<float> tz;
+    AlignedBuffer<float> qx;
+    AlignedBuffer<float> qy;
+    AlignedBuffer<float> qz;
+    AlignedBuffer<float> qw;
+
+    std::size_t size(void) const
+    {
+        return tx.size();
+    }
+
+    void Resize(std::size_t size)
+    {
+        for (auto *column : { &tx, &ty, &tz, &qx, &qy, &qz, &qw })
+        {
+            column->Resize(size);
+        }
+    }
+};
+
+/**
+ * Encodes values into a column. The data of the column is overwritten but keeps its capacity, so a column reused for
+ * every chunk of a stream does not allocate.
+ *
+ * @param values The values to be encoded.
+ * @param count The number of the values.
+ * @param format The encoding and the quantization step.
+ * @param column The column to be filled in.
+ * @param error The reason of the failure.
+ * @return false if the step of a fixed point format is not positive or a value does not fit the fixed point range,
+ * true otherwise.
+ */
+bool EncodeColumn(const float *values, std::size_t count, const robl::api::ColumnFormat &format,
+                  robl::api::Column *column, std::string *error);
+
+/**
+ * Decodes a column.
+ *
+ * @param column The column to be decoded.
+ * @param count The number of the values the column must hold.
+ * @param out The buffer of at least count values to be filled in.
+ * @param error The reason of the failure.
+ * @return false if the column is malformed or does not hold exactly count values, true otherwise.
+ */
+bool DecodeColumn(const robl::api::Column &column, std::size_t count, float *out, std::string *error);
+
+/**
+ * Encodes points [begin, begin + count) into a chunk.
+ */
+bool EncodePointCloud(const PointColumns &points, std::size_t begin, std::size_t count,
+                      const robl::api::ColumnFormat &format, robl::api::PointCloudChunk *chunk, std::string *error);
+
+/**
+ * Decodes a chunk and appends its points to the columns. The point count of the chunk is checked against the size of
+ * every column before the columns grow, so a chunk claiming more points than it holds allocates nothing.
+ */
+bool DecodePointCloud(const robl::api::PointCloudChunk &chunk, PointColumns *points, std::string *error);
+
+/**
+ * Encodes poses [begin, begin + count) into a chunk. Positions and rotations usually want different steps.
+ */
+bool EncodePoses(const PoseColumns &poses, std::size_t begin, std::size_t count,
+                 const robl::api::ColumnFormat &position_format, const robl::api::ColumnFormat &rotation_format,
+                 robl::api::PoseChunk *chunk, std::string *error);
+
+/**
+ * Decodes a chunk and appends its poses to the columns. Like DecodePointCloud(), the pose count is checked against
+ * the columns first.
+ */
+bool DecodePoses(const robl::api::PoseChunk &chunk, PoseColumns *poses, std::string *error);
+
+} // namespace robl::pointcloud
+
+/*=========================================================================*/
@@ -0,0 +1,361 @@
+#pragma once
+
+// standard headers
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// project headers
+#include "channel/local_transport.hpp"
+#include "shm/unique_fd.hpp"
+
+/*=========================================================================*/
+
+namespace robl
+{
+
+/**
+ * The socket over which a server listening on the TCP address takes file descriptors from clients on the same host:
+ * its Unix domain socket with ".fd" appended, or an empty string if that socket is turned off.
+ */
+std::string DescriptorSocketPath(const std::string &address);
+
+/**
+ * @class DescriptorServer
+ * @brief Takes file descriptors which clients on the same host pass over a Unix domain socket, so that calls can
+ * name data in files or shared memory instead of carrying it.
+ *
+ * Every descriptor is answered with a random token, which calls use to name it. A descriptor stays valid for as long
+ * as the connection which passed it is open, so a client passes a file once and refers to it in any number of calls.
+ * Tokens of one connection are useless to another one only as far as they cannot be guessed, so every token is drawn
+ * from the kernel's random pool on its own, and seeing some tokens tells nothing about the others. The socket's file
+ * permissions decide who may connect at all.
+ */
+class DescriptorServer
+{
+public:
+    // Bounds the descriptors one connection holds open in the server.
+    static constexpr std::size_t kMaxDescriptorsPerConnection = 64;
+
+    /**
+     * Listens on the path, replacing a socket file left behind by an earlier run. Throws std::system_error if it
+     * cannot.
+     */
+    explicit DescriptorServer(const std::string &path);
+    ~DescriptorServer();
+
+    DescriptorServer(const DescriptorServer &) = delete;
+    DescriptorServer &operator=(const DescriptorServer &) = delete;
+
+    const std::string &Path(void) const
+    {
+        return path_;
+    }
+
+    /**
+     * A duplicate of the descriptor passed under the token, or an invalid one if the token is unknown or its
+     * connection is closed.
+     */
+    UniqueFd Duplicate(std::uint64_t token) const;
+
+private:
+    struct Passed
+    {
+        UniqueFd fd;
+        int connection;
+    };
+
+    void Run(void);
+    void Receive(std::size_t index);
+    void Drop(int connection);
+
+    const std::string path_;
+    UniqueFd listener_;
+    UniqueFd wakeup_;
+    // Touched by the thread only.
+    std::vector<UniqueFd> connections_;
+    mutable std::mutex mutex_;
+    std::map<std::uint64_t, Passed> descriptors_;
+    std::thread thread_;
+};
+
+/**
+ * @class DescriptorClient
+ * @brief Passes file descriptors to a DescriptorServer on the same host. The descriptors stay valid in the server
+ * until the client is destroyed.
+ */
+class DescriptorClient
+{
+public:
+    // Not connected if there is no server on the path.
+    explicit DescriptorClient(const std::string &path);
+
+    bool Connected(void) const
+    {
+        return socket_.Valid();
+    }
+
+    /**
+     * Passes the descriptor and returns the token to name it by, or 0 if the server refused it. Blocks until the
+     * server answers, which takes a round trip on the local socket.
+     */
+    std::uint64_t Send(int fd);
+
+private:
+    UniqueFd socket_;
+};
+
+/*=========================================================================*/
+
+namespace detail
+{
+
+inline bool ToSocketAddress(const std::string &path, sockaddr_un *address)
+{
+    *address = sockaddr_un();
+    if (path.empty() || path.size() >= sizeof(address->sun_path))
+    {
+        return false;
+    }
+    address->sun_family = AF_UNIX;
+    path.copy(address->sun_path, path.size());
+    return true;
+}
+
+// A token from the kernel's random pool, or 0 if none could be drawn.
+inline std::uint64_t RandomToken(void)
+{
+    auto token = std::uint64_t(0);
+    auto *bytes = reinterpret_cast<unsigned char *>(&token);
+    auto filled = std::size_t(0);
+    while (filled < sizeof(token))
+    {
+        const auto drawn = getrandom(bytes + filled, sizeof(token) - filled, 0);
+        if (drawn < 0 && errno != EINTR)
+        {
+            return 0;
+        }
+        filled += drawn > 0 ? static_cast<std::size_t>(drawn) : 0;
+    }
+    return token;
+}
+
+} // namespace detail
+
+/*=========================================================================*/
+
+inline std::string DescriptorSocketPath(const std::string &address)
+{
+    const auto unix_path = UnixSocketPath(address);
+    return unix_path.empty() ? unix_path : unix_path + ".fd";
+}
+
+inline DescriptorServer::DescriptorServer(const std::string &path)
+    : path_(path)
+{
+    auto address = sockaddr_un();
+    if (!detail::ToSocketAddress(path, &address))
+    {
+        throw std::system_error(std::make_error_code(std::errc::filename_too_long), path);
+    }
+
+    // Sequenced packets keep every descriptor together with the byte it comes with.
+    listener_.Reset(socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0));
+    wakeup_.Reset(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+    unlink(path.c_str());
+    if (!listener_.Valid() || !wakeup_.Valid() ||
+        bind(listener_.Get(), reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0 ||
+        listen(listener_.Get(), 64) != 0)
+    {
+        throw std::system_error(errno, std::system_category(), "listening on " + path);
+    }
+
+    thread_ = std::thread(&DescriptorServer::Run, this);
+}
+
+inline DescriptorServer::~DescriptorServer()
+{
+    const auto one = std::uint64_t(1);
+    [[maybe_unused]] const auto written = write(wakeup_.Get(), &one, sizeof(one));
+    thread_.join();
+    unlink(path_.c_str());
+}
+
+inline UniqueFd DescriptorServer::Duplicate(std::uint64_t token) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = descriptors_.find(token);
+    return it != descriptors_.end() ? UniqueFd(fcntl(it->second.fd.Get(), F_DUPFD_CLOEXEC, 0)) : UniqueFd();
+}
+
+inline void DescriptorServer::Run(void)
+{
+    auto polled = std::vector<pollfd>();
+    while (true)
+    {
+        polled.assign({ { wakeup_.Get(), POLLIN, 0 }, { listener_.Get(), POLLIN, 0 } });
+        for (const auto &connection : connections_)
+        {
+            polled.push_back({ connection.Get(), POLLIN, 0 });
+        }
+        if (poll(polled.data(), polled.size(), -1) < 0 && errno != EINTR)
+        {
+            return;
+        }
+
+        if (polled[0].revents != 0)
+        {
+            return;
+        }
+        if (polled[1].revents & POLLIN)
+        {
+            auto connection = UniqueFd(accept4(listener_.Get(), nullptr, nullptr, SOCK_CLOEXEC));
+            if (connection.Valid())
+            {
+                connections_.push_back(std::move(connection));
+            }
+        }
+
+        // Backwards, so that dropping a connection does not move the ones still to look at.
+        for (auto i = polled.size(); i-- > 2;)
+        {
+            if (polled[i].revents != 0)
+            {
+                Receive(i - 2);
+            }
+        }
+    }
+}
+
+inline void DescriptorServer::Receive(std::size_t index)
+{
+    const auto connection = connections_[index].Get();
+
+    auto byte = char(0);
+    auto data = iovec{ &byte, 1 };
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    auto message = msghdr();
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    const auto received = recvmsg(connection, &message, MSG_CMSG_CLOEXEC | MSG_DONTWAIT);
+    if (received <= 0)
+    {
+        if (received < 0 && (errno == EAGAIN || errno == EINTR))
+        {
+            return;
+        }
+        Drop(connection);
+        connections_.erase(connections_.begin() + index);
+        return;
+    }
+
+    auto passed = UniqueFd();
+    const auto *header = CMSG_FIRSTHDR(&message);
+    if (header != nullptr && header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS &&
+        header->cmsg_len == CMSG_LEN(sizeof(int)))
+    {
+        auto fd = -1;
+        std::memcpy(&fd, CMSG_DATA(header), sizeof(fd));
+        passed.Reset(fd);
+    }
+
+    auto token = std::uint64_t(0);
+    if (passed.Valid() && (message.msg_flags & MSG_CTRUNC) == 0)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto held = std::size_t(0);
+        for (const auto &descriptor : descriptors_)
+        {
+            held += descriptor.second.connection == connection ? 1 : 0;
+        }
+        // A token which could not be drawn, or which is taken already, refuses the descriptor.
+        token = held < kMaxDescriptorsPerConnection ? detail::RandomToken() : 0;
+        if (token != 0 && descriptors_.count(token) == 0)
+        {
+            descriptors_.emplace(token, Passed{ std::move(passed), connection });
+        }
+        else
+        {
+            token = 0;
+        }
+    }
+    // A client which does not wait for its answer loses the descriptor's token, not the server's time.
+    [[maybe_unused]] const auto sent = send(connection, &token, sizeof(token), MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+inline void DescriptorServer::Drop(int connection)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = descriptors_.begin(); it != descriptors_.end();)
+    {
+        it = it->second.connection == connection ? descriptors_.erase(it) : std::next(it);
+    }
+}
+
+inline DescriptorClient::DescriptorClient(const std::string &path)
+{
+    auto address = sockaddr_un();
+    if (!detail::ToSocketAddress(path, &address))
+    {
+        return;
+    }
+
+    socket_.Reset(socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0));
+    if (socket_.Valid() && connect(socket_.Get(), reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0)
+    {
+        socket_.Reset();
+    }
+}
+
+inline std::uint64_t DescriptorClient::Send(int fd)
+{
+    if (!Connected())
+    {
+        return 0;
+    }
+
+    auto byte = char('F');
+    auto data = iovec{ &byte, 1 };
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    auto message = msghdr();
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    auto *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(header), &fd, sizeof(fd));
+
+    auto token = std::uint64_t(0);
+    if (sendmsg(socket_.Get(), &message, MSG_NOSIGNAL) != 1 ||
+        recv(socket_.Get(), &token, sizeof(token), 0) != static_cast<ssize_t>(sizeof(token)))
+    {
+        socket_.Reset();
+        return 0;
+    }
+    return token;
+}
+
+} // namespace robl
+
+/*=========================================================================*/
@@ -0,0 +1,169 @@
+#pragma once
+
+// standard headers
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// project headers
+#include "shm/unique_fd.hpp"
+
+/*=========================================================================*/
+
+namespace robl
+{
+
+/**
+ * Creates an anonymous shared memory file holding the data, to pass to a same-host server instead of sending the
+ * data. The file is sealed, so the server can rely on its content not changing while it copies from it. Throws
+ * std::system_error on failure.
+ */
+UniqueFd CreateSharedMemory(const std::string &name, std::string_view data);
+
+/**
+ * Checks that a descriptor from another process is safe to copy from: a regular file, where a memfd has to be sealed
+ * against writes and shrinking, as its owner could change it during the copy otherwise. Pipes, sockets and devices
+ * would block or never end.
+ */
+bool IsCopySource(int source);
+
+/**
+ * Copies a region of the source file to the current position of the destination, in the kernel: with
+ * copy_file_range() where the file systems allow it, which shares the blocks on file systems with reflinks, with
+ * sendfile() otherwise, e.g. from shared memory to disk, and with plain reads and writes as a last resort. Returns the
+ * number of bytes copied, which is short only if the source ends before the region does. Throws std::system_error on
+ * failure.
+ */
+std::uint64_t CopyFileRange(int source, std::uint64_t offset, std::uint64_t length, int destination);
+
+/*=========================================================================*/
+
+inline UniqueFd CreateSharedMemory(const std::string &name, std::string_view data)
+{
+    auto fd = UniqueFd(memfd_create(name.c_str(), MFD_CLOEXEC | MFD_ALLOW_SEALING));
+    if (!fd.Valid())
+    {
+        throw std::system_error(errno, std::system_category(), "memfd_create");
+    }
+
+    auto written = std::size_t(0);
+    while (written < data.size())
+    {
+        const auto result = pwrite(fd.Get(), data.data() + written, data.size() - written, written);
+        if (result < 0 && errno != EINTR)
+        {
+            throw std::system_error(errno, std::system_category(), "writing the shared memory");
+        }
+        written += result > 0 ? result : 0;
+    }
+
+    if (fcntl(fd.Get(), F_ADD_SEALS, F_SEAL_SEAL | F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE) != 0)
+    {
+        throw std::system_error(errno, std::system_category(), "sealing the shared memory");
+    }
+    return fd;
+}
+
+inline bool IsCopySource(int source)
+{
+    struct stat status;
+    if (fstat(source, &status) != 0 || !S_ISREG(status.st_mode))
+    {
+        return false;
+    }
+
+    // A memfd is a regular file too, and only its link in /proc tells it from one on a file system.
+    char link[64];
+    const auto path = "/proc/self/fd/" + std::to_string(source);
+    const auto length = readlink(path.c_str(), link, sizeof(link));
+    if (length < 0 || std::string_view(link, static_cast<std::size_t>(length)).rfind("/memfd:", 0) != 0)
+    {
+        return true;
+    }
+
+    constexpr auto required = F_SEAL_WRITE | F_SEAL_SHRINK;
+    const auto seals = fcntl(source, F_GET_SEALS);
+    return seals >= 0 && (seals & required) == required;
+}
+
+inline std::uint64_t CopyFileRange(int source, std::uint64_t offset, std::uint64_t length, int destination)
+{
+    auto source_offset = static_cast<off_t>(offset);
+    auto copied = std::uint64_t(0);
+
+    // The ways to copy, from the cheapest. A way which the files do not support falls through to the next one.
+    const auto unsupported = [](int error) {
+        return error == EXDEV || error == EINVAL || error == ENOSYS || error == EOPNOTSUPP || error == EBADF;
+    };
+    auto use_copy_file_range = true;
+    auto use_sendfile = true;
+    auto buffer = std::vector<char>();
+
+    while (copied < length)
+    {
+        const auto remaining = length - copied;
+        auto result = ssize_t(-1);
+        if (use_copy_file_range)
+        {
+            result = copy_file_range(source, &source_offset, destination, nullptr, remaining, 0);
+            if (result < 0 && unsupported(errno) && copied == 0)
+            {
+                use_copy_file_range = false;
+                continue;
+            }
+        }
+        else if (use_sendfile)
+        {
+            result = sendfile(destination, source, &source_offset, remaining);
+            if (result < 0 && unsupported(errno) && copied == 0)
+            {
+                use_sendfile = false;
+                continue;
+            }
+        }
+        else
+        {
+            buffer.resize(std::min<std::uint64_t>(remaining, 1024 * 1024));
+            result = pread(source, buffer.data(), buffer.size(), source_offset);
+            for (auto written = ssize_t(0); result > 0 && written < result;)
+            {
+                const auto write_result = write(destination, buffer.data() + written, result - written);
+                if (write_result < 0 && errno != EINTR)
+                {
+                    throw std::system_error(errno, std::system_category(), "writing the copy");
+                }
+                written += write_result > 0 ? write_result : 0;
+            }
+            source_offset += result > 0 ? result : 0;
+        }
+
+        if (result < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            throw std::system_error(errno, std::system_category(), "copying the shared region");
+        }
+        if (result == 0)
+        {
+            break;
+        }
+        copied += result;
+    }
+    return copied;
+}
+
+} // namespace robl
+
+/*=========================================================================*/
@@ -0,0 +1,74 @@
+#pragma once
+
+// standard headers
+#include <utility>
+
+#include <unistd.h>
+
+/*=========================================================================*/
+
+namespace robl
+{
+
+/**
+ * @class UniqueFd
+ * @brief Owns a file descriptor and closes it when destroyed.
+ */
+class UniqueFd
+{
+public:
+    UniqueFd(void)
+        : fd_(-1)
+    {
+    }
+
+    explicit UniqueFd(int fd)
+        : fd_(fd)
+    {
+    }
+
+    UniqueFd(UniqueFd &&other) noexcept
+        : fd_(std::exchange(other.fd_, -1))
+    {
+    }
+
+    UniqueFd &operator=(UniqueFd &&other) noexcept
+    {
+        Reset(std::exchange(other.fd_, -1));
+        return *this;
+    }
+
+    UniqueFd(const UniqueFd &) = delete;
+    UniqueFd &operator=(const UniqueFd &) = delete;
+
+    ~UniqueFd()
+    {
+        Reset();
+    }
+
+    int Get(void) const
+    {
+        return fd_;
+    }
+
+    bool Valid(void) const
+    {
+        return fd_ >= 0;
+    }
+
+    void Reset(int fd = -1)
+    {
+        if (fd_ >= 0)
+        {
+            close(fd_);
+        }
+        fd_ = fd;
+    }
+
+private:
+    int fd_;
+};
+
+} // namespace robl
+
+/*=========================================================================*/
@@ -0,0 +1,199 @@
+#pragma once
+
+// standard headers
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+// project headers
+#include "shm/unique_fd.hpp"
+#include "trace/tracer.hpp"
+
+/*=========================================================================*/
+
+namespace robl
+{
+
+/**
+ * @class TraceDumper
+ * @brief Dumps the trace of the process on SIGUSR1, into robl-trace-<pid>-<n>.json of a directory, and turns tracing
+ * on and off on SIGUSR2, e.g. kill -USR2 <pid> before reproducing a stall and kill -USR1 <pid> after it.
+ *
+ * The handlers only wake a thread of the dumper, which does the work outside of the signal. There is one dumper per
+ * process, as the signals are.
+ */
+class TraceDumper
+{
+public:
+    /**
+     * Installs the handlers. Throws std::system_error if it cannot, or if there is a dumper already.
+     */
+    explicit TraceDumper(std::filesystem::path directory);
+    ~TraceDumper();
+
+    TraceDumper(const TraceDumper &) = delete;
+    TraceDumper &operator=(const TraceDumper &) = delete;
+
+    /**
+     * Dumps the trace now. Returns the path of the file, which is empty if it could not be written.
+     */
+    std::filesystem::path Dump(void);
+
+private:
+    static void OnSignal(int signal);
+    void Run(void);
+
+    inline static std::atomic<int> signal_fd_{ -1 };
+
+    const std::filesystem::path directory_;
+    UniqueFd read_end_;
+    UniqueFd write_end_;
+    std::atomic<int> dumps_;
+    struct sigaction previous_dump_;
+    struct sigaction previous_toggle_;
+    std::thread thread_;
+};
+
+/**
+ * Dumps traces on signals into $ROBL_TRACE_DIR, or the working directory, and starts tracing if $ROBL_TRACE is 1.
+ * Returns null if the dumper cannot be installed, which it reports on stderr, as a server runs fine without it.
+ */
+std::unique_ptr<TraceDumper> DumpTracesOnSignal(void);
+
+/*=========================================================================*/
+
+inline TraceDumper::TraceDumper(std::filesystem::path directory)
+    : directory_(std::move(directory))
+    , dumps_(0)
+{
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC | O_NONBLOCK) != 0)
+    {
+        throw std::system_error(errno, std::system_category(), "creating the trace signal pipe");
+    }
+    read_end_.Reset(fds[0]);
+    write_end_.Reset(fds[1]);
+
+    auto expected = -1;
+    if (!signal_fd_.compare_exchange_strong(expected, write_end_.Get()))
+    {
+        throw std::system_error(std::make_error_code(std::errc::device_or_resource_busy), "a trace dumper exists");
+    }
+
+    struct sigaction action = {};
+    action.sa_handler = &TraceDumper::OnSignal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGUSR1, &action, &previous_dump_) != 0 || sigaction(SIGUSR2, &action, &previous_toggle_) != 0)
+    {
+        const auto error = errno;
+        sigaction(SIGUSR1, &previous_dump_, nullptr);
+        signal_fd_.store(-1);
+        throw std::system_error(error, std::system_category(), "installing the trace signal handlers");
+    }
+
+    thread_ = std::thread(&TraceDumper::Run, this);
+}
+
+inline TraceDumper::~TraceDumper()
+{
+    sigaction(SIGUSR1, &previous_dump_, nullptr);
+    sigaction(SIGUSR2, &previous_toggle_, nullptr);
+    signal_fd_.store(-1);
+
+    // Closing the write end wakes the thread with the end of the pipe.
+    write_end_.Reset();
+    thread_.join();
+}
+
+inline std::filesystem::path TraceDumper::Dump(void)
+{
+    const auto dump = dumps_.fetch_add(1) + 1;
+    const auto path =
+        directory_ / ("robl-trace-" + std::to_string(getpid()) + "-" + std::to_string(dump) + ".json");
+    auto out = std::ofstream(path);
+    Tracer::Instance().WriteChromeJson(out);
+    out.close();
+    return out ? path : std::filesystem::path();
+}
+
+inline void TraceDumper::OnSignal(int signal)
+{
+    const auto saved_errno = errno;
+    const auto fd = signal_fd_.load();
+    if (fd >= 0)
+    {
+        const auto command = signal == SIGUSR1 ? 'd' : 't';
+        [[maybe_unused]] const auto written = write(fd, &command, 1);
+    }
+    errno = saved_errno;
+}
+
+inline void TraceDumper::Run(void)
+{
+    while (true)
+    {
+        auto polled = pollfd{ read_end_.Get(), POLLIN, 0 };
+        if (poll(&polled, 1, -1) < 0 && errno != EINTR)
+        {
+            return;
+        }
+
+        char commands[64];
+        const auto received = read(read_end_.Get(), commands, sizeof(commands));
+        if (received == 0)
+        {
+            return;
+        }
+        for (auto i = 0; i < received; ++i)
+        {
+            if (commands[i] == 't')
+            {
+                Tracer::Enable(!Tracer::Enabled());
+                std::cout << "Tracing " << (Tracer::Enabled() ? "on" : "off") << std::endl;
+            }
+            else
+            {
+                const auto path = Dump();
+                std::cout << (path.empty() ? "Could not dump the trace" : "Trace dumped to " + path.string())
+                          << std::endl;
+            }
+        }
+    }
+}
+
+inline std::unique_ptr<TraceDumper> DumpTracesOnSignal(void)
+{
+    const auto *enabled = std::getenv("ROBL_TRACE");
+    if (enabled != nullptr && std::string(enabled) == "1")
+    {
+        Tracer::Enable(true);
+    }
+
+    const auto *directory = std::getenv("ROBL_TRACE_DIR");
+    try
+    {
+        return std::make_unique<TraceDumper>(directory != nullptr ? directory : std::filesystem::current_path());
+    }
+    catch (const std::exception &ex)
+    {
+        std::cerr << "Trace dumps are off: " << ex.what() << std::endl;
+        return nullptr;
+    }
+}
+
+} // namespace robl
+
+/*=========================================================================*/
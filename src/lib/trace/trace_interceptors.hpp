@@ -0,0 +1,96 @@
+#pragma once
+
+// standard headers
+#include <cstdint>
+
+// grpc headers
+#include <grpcpp/support/byte_buffer.h>
+#include <grpcpp/support/interceptor.h>
+#include <grpcpp/support/server_interceptor.h>
+
+// project headers
+#include "trace/tracer.hpp"
+
+/*=========================================================================*/
+
+namespace robl
+{
+
+/**
+ * @class TraceInterceptor
+ * @brief Traces one call of a server as a span from its start to its status, with an instant for every message it
+ * received and sent, so the time between them shows which side the call waited for.
+ */
+class TraceInterceptor final : public grpc::experimental::Interceptor
+{
+public:
+    explicit TraceInterceptor(const char *method);
+    ~TraceInterceptor() override;
+
+    void Intercept(grpc::experimental::InterceptorBatchMethods *methods) override;
+
+private:
+    const char *const method_;
+    const std::uint64_t id_;
+    bool finished_;
+};
+
+/**
+ * @class TraceServerInterceptorFactory
+ * @brief Adds a TraceInterceptor to the calls of a server which start while tracing is on. The others are not
+ * intercepted at all.
+ */
+class TraceServerInterceptorFactory final : public grpc::experimental::ServerInterceptorFactoryInterface
+{
+public:
+    grpc::experimental::Interceptor *CreateServerInterceptor(grpc::experimental::ServerRpcInfo *info) override
+    {
+        return Tracer::Enabled() ? new TraceInterceptor(info->method()) : nullptr;
+    }
+};
+
+/*=========================================================================*/
+
+inline TraceInterceptor::TraceInterceptor(const char *method)
+    : method_(method)
+    , id_(Tracer::Instance().NextId())
+    , finished_(false)
+{
+    Tracer::Instance().AsyncBegin("rpc", method_, id_);
+}
+
+inline TraceInterceptor::~TraceInterceptor()
+{
+    if (!finished_)
+    {
+        Tracer::Instance().AsyncEnd("rpc", method_, id_, grpc::StatusCode::CANCELLED);
+    }
+}
+
+inline void TraceInterceptor::Intercept(grpc::experimental::InterceptorBatchMethods *methods)
+{
+    using grpc::experimental::InterceptionHookPoints;
+
+    auto &tracer = Tracer::Instance();
+    if (methods->QueryInterceptionHookPoint(InterceptionHookPoints::POST_RECV_MESSAGE) &&
+        methods->GetRecvMessage() != nullptr)
+    {
+        tracer.AsyncInstant("rpc", "received", id_);
+    }
+    if (methods->QueryInterceptionHookPoint(InterceptionHookPoints::PRE_SEND_MESSAGE))
+    {
+        const auto *buffer = methods->GetSerializedSendMessage();
+        tracer.AsyncInstant("rpc", "sending", id_, buffer != nullptr ? buffer->Length() : 0);
+    }
+    if (methods->QueryInterceptionHookPoint(InterceptionHookPoints::PRE_SEND_STATUS))
+    {
+        // The value is the status code.
+        finished_ = true;
+        tracer.AsyncEnd("rpc", method_, id_, methods->GetSendStatus().error_code());
+    }
+    methods->Proceed();
+}
+
+} // namespace robl
+
+/*=========================================================================*/
@@ -0,0 +1,462 @@
+#pragma once
+
+// standard headers
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*=========================================================================*/
+
+namespace robl
+{
+
+/**
+ * @class Tracer
+ * @brief Records begin and end events of the zones of the hot paths and of the phases of calls, for a Chrome or
+ * Perfetto trace of where the time of a slow call went.
+ *
+ * Every thread records into a ring buffer of its own, without locks, so an event costs a clock read and a few
+ * stores, and a dump copies the buffers while they are written. A ring keeps the latest events of its thread. The ring
+ * of a thread which ended is handed to the next new thread, which goes on after the events of the ended one, so a
+ * thread pool which comes and goes does not pile up rings.
+ *
+ * While tracing is off, which it is by default, a zone costs a branch on a flag.
+ */
+class Tracer
+{
+public:
+    // The events a thread keeps, 1.5 MiB of them.
+    static constexpr std::size_t kEventsPerThread = 32 * 1024;
+
+    Tracer(const Tracer &) = delete;
+    Tracer &operator=(const Tracer &) = delete;
+
+    /**
+     * The tracer of the process. It is never destroyed, so that threads ending during the exit may still use it.
+     */
+    static Tracer &Instance(void)
+    {
+        static auto *instance = new Tracer();
+        return *instance;
+    }
+
+    /**
+     * Whether the tracer of the process records. One relaxed load, for a branch which is predicted right.
+     */
+    static bool Enabled(void)
+    {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Turns the recording on or off. The events recorded so far are kept either way.
+     */
+    static void Enable(bool enabled)
+    {
+        enabled_.store(enabled, std::memory_order_relaxed);
+    }
+
+    /**
+     * Records the beginning and the end of a zone of the calling thread. Zones nest, and the end closes the latest
+     * zone which began. Names and categories are not copied, so they have to outlive the tracer, e.g. as literals.
+     * The value is shown as an argument of the zone, e.g. the bytes it wrote, unless it is 0.
+     */
+    void Begin(const char *category, const char *name);
+    void End(const char *category, const char *name, std::uint64_t value = 0);
+
+    /**
+     * Records the beginning, an instant and the end of a span which is not bound to a thread, such as a call, by an id
+     * from NextId(). The events of a span share its category and id.
+     */
+    void AsyncBegin(const char *category, const char *name, std::uint64_t id);
+    void AsyncInstant(const char *category, const char *name, std::uint64_t id, std::uint64_t value = 0);
+    void AsyncEnd(const char *category, const char *name, std::uint64_t id, std::uint64_t value = 0);
+
+    std::uint64_t NextId(void)
+    {
+        return next_id_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Writes the events of all threads as a Chrome trace, which chrome://tracing and ui.perfetto.dev open.
+     */
+    void WriteChromeJson(std::ostream &out) const;
+
+private:
+    // Fields are atomic so that a dump may read a slot while its thread writes it. Relaxed, they compile to plain
+    // moves.
+    struct Event
+    {
+        std::atomic<const char *> category{ nullptr };
+        std::atomic<const char *> name{ nullptr };
+        std::atomic<std::int64_t> timestamp_ns{ 0 };
+        std::atomic<std::uint64_t> id{ 0 };
+        std::atomic<std::uint64_t> value{ 0 };
+        std::atomic<char> phase{ 0 };
+    };
+
+    struct EventCopy
+    {
+        const char *category;
+        const char *name;
+        std::int64_t timestamp_ns;
+        std::uint64_t id;
+        std::uint64_t value;
+        char phase;
+    };
+
+    // A thread which wrote to a ring, from the index of its first event on.
+    struct Owner
+    {
+        std::uint64_t first;
+        long thread_id;
+        std::string thread_name;
+    };
+
+    // Written by one thread at a time. An event is claimed before its slot is written and published after, so a
+    // dump knows which of the slots it copied may have been overwritten meanwhile.
+    struct Ring
+    {
+        explicit Ring(std::size_t capacity)
+            : events(new Event[capacity])
+            , mask(capacity - 1)
+        {
+        }
+
+        std::unique_ptr<Event[]> events;
+        const std::uint64_t mask;
+        std::atomic<std::uint64_t> claimed{ 0 };
+        std::atomic<std::uint64_t> published{ 0 };
+        // The owners whose events the ring may still hold, the current one last.
+        std::vector<Owner> owners;
+        bool in_use = false;
+    };
+
+    Tracer(void);
+
+    void Record(char phase, const char *category, const char *name, std::uint64_t id, std::uint64_t value);
+    Ring &LocalRing(void);
+    Ring *TakeRing(void);
+    void ReturnRing(Ring *ring);
+
+    inline static std::atomic<bool> enabled_{ false };
+
+    const std::chrono::steady_clock::time_point start_;
+    std::atomic<std::uint64_t> next_id_;
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Ring>> rings_;
+};
+
+/**
+ * @class TraceZone
+ * @brief Traces a scope of the calling thread as a zone, e.g. const auto zone = TraceZone("upload", "write");
+ *
+ * A zone has to end on the thread it began on, so it must not span a co_await.
+ */
+class TraceZone
+{
+public:
+    TraceZone(const char *category, const char *name)
+        : category_(category)
+        , name_(name)
+        , value_(0)
+        , active_(Tracer::Enabled())
+    {
+        if (active_)
+        {
+            Tracer::Instance().Begin(category_, name_);
+        }
+    }
+
+    ~TraceZone()
+    {
+        if (active_)
+        {
+            Tracer::Instance().End(category_, name_, value_);
+        }
+    }
+
+    TraceZone(const TraceZone &) = delete;
+    TraceZone &operator=(const TraceZone &) = delete;
+
+    /**
+     * Sets the value the zone ends with, e.g. the bytes it wrote.
+     */
+    void SetValue(std::uint64_t value)
+    {
+        value_ = value;
+    }
+
+private:
+    const char *const category_;
+    const char *const name_;
+    std::uint64_t value_;
+    const bool active_;
+};
+
+/*=========================================================================*/
+
+namespace detail
+{
+
+inline void WriteJsonString(std::ostream &out, const char *text)
+{
+    out << '"';
+    for (const auto *c = text; c != nullptr && *c != '\0'; ++c)
+    {
+        if (*c == '"' || *c == '\\')
+        {
+            out << '\\' << *c;
+        }
+        else if (static_cast<unsigned char>(*c) < 0x20)
+        {
+            out << ' ';
+        }
+        else
+        {
+            out << *c;
+        }
+    }
+    out << '"';
+}
+
+} // namespace detail
+
+inline Tracer::Tracer(void)
+    : start_(std::chrono::steady_clock::now())
+    , next_id_(1)
+{
+}
+
+inline void Tracer::Begin(const char *category, const char *name)
+{
+    Record('B', category, name, 0, 0);
+}
+
+inline void Tracer::End(const char *category, const char *name, std::uint64_t value)
+{
+    Record('E', category, name, 0, value);
+}
+
+inline void Tracer::AsyncBegin(const char *category, const char *name, std::uint64_t id)
+{
+    Record('b', category, name, id, 0);
+}
+
+inline void Tracer::AsyncInstant(const char *category, const char *name, std::uint64_t id, std::uint64_t value)
+{
+    Record('n', category, name, id, value);
+}
+
+inline void Tracer::AsyncEnd(const char *category, const char *name, std::uint64_t id, std::uint64_t value)
+{
+    Record('e', category, name, id, value);
+}
+
+inline void Tracer::Record(char phase, const char *category, const char *name, std::uint64_t id, std::uint64_t value)
+{
+    auto &ring = LocalRing();
+    const auto index = ring.claimed.load(std::memory_order_relaxed);
+    ring.claimed.store(index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    auto &event = ring.events[index & ring.mask];
+    event.category.store(category, std::memory_order_relaxed);
+    event.name.store(name, std::memory_order_relaxed);
+    event.timestamp_ns.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                 std::chrono::steady_clock::now().time_since_epoch())
+                                 .count(),
+                             std::memory_order_relaxed);
+    event.id.store(id, std::memory_order_relaxed);
+    event.value.store(value, std::memory_order_relaxed);
+    event.phase.store(phase, std::memory_order_relaxed);
+    ring.published.store(index + 1, std::memory_order_release);
+}
+
+inline void Tracer::WriteChromeJson(std::ostream &out) const
+{
+    struct ThreadEvents
+    {
+        long thread_id;
+        std::string thread_name;
+        std::vector<EventCopy> events;
+    };
+
+    // Copies every ring, drops the events which its thread may have overwritten during the copy, and splits the rest
+    // by the thread which recorded them.
+    auto threads = std::vector<ThreadEvents>();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto &ring : rings_)
+        {
+            const auto capacity = ring->mask + 1;
+            const auto end = ring->published.load(std::memory_order_acquire);
+            const auto begin = end > capacity ? end - capacity : 0;
+
+            auto events = std::vector<EventCopy>();
+            events.reserve(end - begin);
+            for (auto index = begin; index < end; ++index)
+            {
+                const auto &event = ring->events[index & ring->mask];
+                events.push_back(EventCopy{
+                    event.category.load(std::memory_order_relaxed), event.name.load(std::memory_order_relaxed),
+                    event.timestamp_ns.load(std::memory_order_relaxed), event.id.load(std::memory_order_relaxed),
+                    event.value.load(std::memory_order_relaxed), event.phase.load(std::memory_order_relaxed) });
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const auto claimed = ring->claimed.load(std::memory_order_relaxed);
+            const auto valid = std::max(begin, claimed > capacity ? claimed - capacity : 0);
+            for (auto i = std::size_t(0); i < ring->owners.size(); ++i)
+            {
+                const auto &owner = ring->owners[i];
+                const auto from = std::max(owner.first, valid);
+                const auto to = i + 1 < ring->owners.size() ? std::min(ring->owners[i + 1].first, end) : end;
+                if (from < to)
+                {
+                    threads.push_back(ThreadEvents{
+                        owner.thread_id, owner.thread_name,
+                        { events.begin() + (from - begin), events.begin() + (to - begin) } });
+                }
+            }
+        }
+    }
+
+    const auto pid = getpid();
+    const auto start_ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(start_.time_since_epoch()).count();
+    auto first = true;
+    const auto separate = [&out, &first]() {
+        out << (first ? "\n" : ",\n");
+        first = false;
+    };
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[" << std::fixed << std::setprecision(3);
+    for (const auto &thread : threads)
+    {
+        separate();
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << thread.thread_id
+            << ",\"args\":{\"name\":";
+        detail::WriteJsonString(out, thread.thread_name.c_str());
+        out << "}}";
+
+        // An end whose beginning was overwritten would close a zone which is not there.
+        auto depth = 0;
+        for (const auto &event : thread.events)
+        {
+            if (event.phase == 'B')
+            {
+                ++depth;
+            }
+            else if (event.phase == 'E')
+            {
+                if (depth == 0)
+                {
+                    continue;
+                }
+                --depth;
+            }
+
+            separate();
+            out << "{\"ph\":\"" << event.phase << "\",\"cat\":";
+            detail::WriteJsonString(out, event.category);
+            out << ",\"name\":";
+            detail::WriteJsonString(out, event.name);
+            out << ",\"ts\":" << (event.timestamp_ns - start_ns) / 1e3 << ",\"pid\":" << pid
+                << ",\"tid\":" << thread.thread_id;
+            if (event.phase == 'b' || event.phase == 'n' || event.phase == 'e')
+            {
+                out << ",\"id\":\"0x" << std::hex << event.id << std::dec << "\"";
+            }
+            if (event.value != 0)
+            {
+                out << ",\"args\":{\"value\":" << event.value << "}";
+            }
+            out << "}";
+        }
+    }
+    out << "\n]}\n";
+}
+
+inline Tracer::Ring &Tracer::LocalRing(void)
+{
+    // Gives the thread's ring back once it ends.
+    struct ThreadRing
+    {
+        ~ThreadRing()
+        {
+            if (ring != nullptr)
+            {
+                Tracer::Instance().ReturnRing(ring);
+            }
+        }
+
+        Ring *ring = nullptr;
+    };
+    thread_local auto thread_ring = ThreadRing();
+
+    if (thread_ring.ring == nullptr)
+    {
+        thread_ring.ring = Instance().TakeRing();
+    }
+    return *thread_ring.ring;
+}
+
+inline Tracer::Ring *Tracer::TakeRing(void)
+{
+    auto name = std::string(16, '\0');
+    if (pthread_getname_np(pthread_self(), name.data(), name.size()) != 0)
+    {
+        name.clear();
+    }
+    name.resize(name.find('\0'));
+    const auto thread_id = static_cast<long>(syscall(SYS_gettid));
+
+    // A dump holds the lock while it copies, so the owners of a ring do not change under it.
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto *ring = static_cast<Ring *>(nullptr);
+    for (const auto &candidate : rings_)
+    {
+        if (!candidate->in_use)
+        {
+            ring = candidate.get();
+            break;
+        }
+    }
+    if (ring == nullptr)
+    {
+        rings_.push_back(std::make_unique<Ring>(kEventsPerThread));
+        ring = rings_.back().get();
+    }
+
+    // The thread goes on after the events of the previous owners, which are kept until it overwrites them.
+    const auto first = ring->claimed.load(std::memory_order_relaxed);
+    while (ring->owners.size() > 1 && ring->owners[1].first + ring->mask + 1 <= first)
+    {
+        ring->owners.erase(ring->owners.begin());
+    }
+    ring->owners.push_back(Owner{ first, thread_id, name.empty() ? "thread " + std::to_string(thread_id) : name });
+    ring->in_use = true;
+    return ring;
+}
+
+inline void Tracer::ReturnRing(Ring *ring)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ring->in_use = false;
+}
+
+} // namespace robl
+
+/*=========================================================================*/
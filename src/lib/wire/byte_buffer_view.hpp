@@ -0,0 +1,225 @@
+#pragma once
+
+// standard headers
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// grpc headers
+#include <grpcpp/support/byte_buffer.h>
+#include <grpcpp/support/slice.h>
+
+/*=========================================================================*/
+
+namespace robl
+{
+
+/**
+ * @class ByteBufferView
+ * @brief The bytes of a grpc::ByteBuffer, e.g. of a serialized message, held by reference to its slices.
+ *
+ * The view scans the top-level fields of the message without parsing it, and hands out ranges of it as slices which
+ * reference the ones of the buffer, so a response can carry parts of a request without copying them.
+ */
+class ByteBufferView
+{
+public:
+    /**
+     * The bytes [begin, end) of the view.
+     */
+    struct Range
+    {
+        std::size_t begin;
+        std::size_t end;
+
+        std::size_t Size(void) const
+        {
+            return end - begin;
+        }
+    };
+
+    ByteBufferView(void);
+    explicit ByteBufferView(const grpc::ByteBuffer &buffer);
+
+    std::size_t Size(void) const
+    {
+        return size_;
+    }
+
+    /**
+     * Finds the payloads of every occurrence of a length-delimited top-level field, e.g. of a message field, in the
+     * order of the wire. A message parsed from them merges them, as the parser does. Returns false if the bytes are
+     * not a well-formed message.
+     */
+    bool FindField(int number, std::vector<Range> *ranges) const;
+
+    /**
+     * Appends the slices of a range, which reference the ones of the buffer.
+     */
+    void Splice(const Range &range, std::vector<grpc::Slice> *slices) const;
+
+private:
+    // A position in the slices.
+    struct Cursor
+    {
+        std::size_t slice = 0;
+        std::size_t offset = 0;
+        std::size_t position = 0;
+    };
+
+    bool ReadVarint(Cursor *cursor, std::uint64_t *value) const;
+    bool Skip(Cursor *cursor, std::uint64_t count) const;
+
+    std::vector<grpc::Slice> slices_;
+    std::size_t size_;
+};
+
+/*=========================================================================*/
+
+inline ByteBufferView::ByteBufferView(void)
+    : size_(0)
+{
+}
+
+inline ByteBufferView::ByteBufferView(const grpc::ByteBuffer &buffer)
+    : size_(0)
+{
+    // Dumping takes a reference to every slice; the bytes stay where they are.
+    (void)buffer.Dump(&slices_);
+    for (const auto &slice : slices_)
+    {
+        size_ += slice.size();
+    }
+}
+
+inline bool ByteBufferView::FindField(int number, std::vector<Range> *ranges) const
+{
+    auto cursor = Cursor();
+    while (cursor.position < size_)
+    {
+        auto tag = std::uint64_t(0);
+        if (!ReadVarint(&cursor, &tag))
+        {
+            return false;
+        }
+
+        auto length = std::uint64_t(0);
+        switch (tag & 7)
+        {
+        case 0: // varint
+            if (!ReadVarint(&cursor, &length))
+            {
+                return false;
+            }
+            break;
+        case 1: // fixed64
+            if (!Skip(&cursor, 8))
+            {
+                return false;
+            }
+            break;
+        case 2: // length-delimited
+            if (!ReadVarint(&cursor, &length))
+            {
+                return false;
+            }
+            if ((tag >> 3) == static_cast<std::uint64_t>(number) && length <= size_ - cursor.position)
+            {
+                ranges->push_back(Range{ cursor.position, cursor.position + static_cast<std::size_t>(length) });
+            }
+            if (!Skip(&cursor, length))
+            {
+                return false;
+            }
+            break;
+        case 5: // fixed32
+            if (!Skip(&cursor, 4))
+            {
+                return false;
+            }
+            break;
+        default: // groups, which proto3 does not have
+            return false;
+        }
+    }
+    return true;
+}
+
+inline void ByteBufferView::Splice(const Range &range, std::vector<grpc::Slice> *slices) const
+{
+    if (range.Size() == 0)
+    {
+        return;
+    }
+
+    auto start = std::size_t(0);
+    for (const auto &slice : slices_)
+    {
+        const auto end = start + slice.size();
+        if (end > range.begin && start < range.end)
+        {
+            const auto begin = range.begin > start ? range.begin - start : 0;
+            const auto stop = range.end < end ? range.end - start : slice.size();
+            slices->push_back(begin == 0 && stop == slice.size() ? slice : slice.sub(begin, stop));
+        }
+        if (end >= range.end)
+        {
+            break;
+        }
+        start = end;
+    }
+}
+
+inline bool ByteBufferView::ReadVarint(Cursor *cursor, std::uint64_t *value) const
+{
+    *value = 0;
+    for (auto shift = 0; shift < 64; shift += 7)
+    {
+        while (cursor->slice < slices_.size() && cursor->offset == slices_[cursor->slice].size())
+        {
+            ++cursor->slice;
+            cursor->offset = 0;
+        }
+        if (cursor->slice == slices_.size())
+        {
+            return false;
+        }
+
+        const auto byte = slices_[cursor->slice].begin()[cursor->offset];
+        ++cursor->offset;
+        ++cursor->position;
+        *value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool ByteBufferView::Skip(Cursor *cursor, std::uint64_t count) const
+{
+    if (count > size_ - cursor->position)
+    {
+        return false;
+    }
+
+    cursor->position += static_cast<std::size_t>(count);
+    while (count > 0)
+    {
+        const auto left = slices_[cursor->slice].size() - cursor->offset;
+        if (count < left)
+        {
+            cursor->offset += static_cast<std::size_t>(count);
+            break;
+        }
+        count -= left;
+        ++cursor->slice;
+        cursor->offset = 0;
+    }
+    return true;
+}
+
+} // namespace robl
+
+/*=========================================================================*/
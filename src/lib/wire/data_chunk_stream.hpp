@@ -0,0 +1,342 @@
+#pragma once
+
+// standard headers
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// grpc headers
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream.h>
+#include <google/protobuf/message_lite.h>
+#include <robl/api/data_chunk.pb.h>
+
+/*=========================================================================*/
+
+namespace robl
+{
+
+// Large enough that the per-message cost of a stream is negligible, small enough to stay far below the message size
+// limits.
+constexpr std::size_t kDefaultChunkSize = 1024 * 1024;
+
+/**
+ * @class DataChunkOutputStream
+ * @brief Serializes into robl::api::DataChunk messages of a stream, e.g. a grpc::ServerWriter<DataChunk>, so that a
+ * message of any size can be sent below the message size limit.
+ *
+ * The serializer writes straight into the data of the chunk, which is written to the stream whenever it is full and
+ * then reused, so sending takes the memory of a chunk and of its copy in the stream, whatever the size of the message.
+ * Every chunk carries the total size of the message.
+ */
+template <typename WriterT>
+class DataChunkOutputStream final : public google::protobuf::io::ZeroCopyOutputStream
+{
+public:
+    DataChunkOutputStream(WriterT *writer, std::uint64_t total_size, std::size_t chunk_size = kDefaultChunkSize);
+
+    bool Next(void **data, int *size) override;
+    void BackUp(int count) override;
+    std::int64_t ByteCount(void) const override;
+
+    /**
+     * Writes the chunk in progress, the last one. Returns false if a write to the stream failed.
+     */
+    bool Flush(void);
+
+private:
+    bool WriteChunk(void);
+
+    WriterT *const writer_;
+    robl::api::DataChunk chunk_;
+    const std::size_t chunk_size_;
+    std::size_t used_;
+    std::int64_t written_;
+    bool failed_;
+};
+
+/**
+ * @class DataChunkInputStream
+ * @brief Reads a message back from the robl::api::DataChunk messages of a stream, e.g. a
+ * grpc::ClientReader<DataChunk>, without concatenating them.
+ *
+ * The parser pulls the chunks from the stream as it goes, one at a time, until it has the total size of the message.
+ * The stream may carry several messages one after the other. The total size of the first chunk is checked against a
+ * limit before anything else is read.
+ */
+template <typename ReaderT>
+class DataChunkInputStream final : public google::protobuf::io::ZeroCopyInputStream
+{
+public:
+    DataChunkInputStream(ReaderT *reader, std::uint64_t max_size);
+
+    bool Next(const void **data, int *size) override;
+    void BackUp(int count) override;
+    bool Skip(int count) override;
+    std::int64_t ByteCount(void) const override;
+
+    /**
+     * The total size of the message, which is 0 until the first chunk is read.
+     */
+    std::uint64_t TotalSize(void) const
+    {
+        return total_size_;
+    }
+
+    /**
+     * Whether every byte of the message was read.
+     */
+    bool Complete(void) const
+    {
+        return started_ && received_ == total_size_ && position_ == chunk_.data().size();
+    }
+
+    /**
+     * Why the chunks ended before the message did, or empty if they did not.
+     */
+    const std::string &Error(void) const
+    {
+        return error_;
+    }
+
+private:
+    bool ReadChunk(void);
+
+    ReaderT *const reader_;
+    robl::api::DataChunk chunk_;
+    const std::uint64_t max_size_;
+    std::uint64_t total_size_;
+    std::uint64_t received_;
+    std::size_t position_;
+    bool started_;
+    std::string error_;
+};
+
+/**
+ * Sends the message as a stream of chunks of at most chunk_size bytes. Returns false if a write to the stream failed,
+ * or if the message is beyond the 2 GiB which protobuf serializes.
+ */
+template <typename WriterT>
+bool WriteChunked(const google::protobuf::MessageLite &message, WriterT *writer,
+                  std::size_t chunk_size = kDefaultChunkSize);
+
+/**
+ * Receives a message sent by WriteChunked(), parsing it as its chunks arrive. A message of more than max_size bytes is
+ * refused as soon as its first chunk is read. On failure, the reason is written to the error string.
+ */
+template <typename ReaderT>
+bool ReadChunked(ReaderT *reader, google::protobuf::MessageLite *message, std::uint64_t max_size, std::string *error);
+
+/*=========================================================================*/
+
+template <typename WriterT>
+DataChunkOutputStream<WriterT>::DataChunkOutputStream(WriterT *writer, std::uint64_t total_size,
+                                                      std::size_t chunk_size)
+    : writer_(writer)
+    , chunk_size_(static_cast<std::size_t>(std::max<std::uint64_t>(1, std::min<std::uint64_t>(total_size, chunk_size))))
+    , used_(0)
+    , written_(0)
+    , failed_(false)
+{
+    chunk_.set_total_size(total_size);
+    chunk_.mutable_data()->resize(chunk_size_);
+}
+
+template <typename WriterT>
+bool DataChunkOutputStream<WriterT>::Next(void **data, int *size)
+{
+    if (used_ == chunk_size_ && !WriteChunk())
+    {
+        return false;
+    }
+
+    *data = &(*chunk_.mutable_data())[used_];
+    *size = static_cast<int>(chunk_size_ - used_);
+    used_ = chunk_size_;
+    return true;
+}
+
+template <typename WriterT>
+void DataChunkOutputStream<WriterT>::BackUp(int count)
+{
+    used_ -= static_cast<std::size_t>(count);
+}
+
+template <typename WriterT>
+std::int64_t DataChunkOutputStream<WriterT>::ByteCount(void) const
+{
+    return written_ + static_cast<std::int64_t>(used_);
+}
+
+template <typename WriterT>
+bool DataChunkOutputStream<WriterT>::Flush(void)
+{
+    // An empty message is still sent as a chunk, so that the receiver gets its total size of 0.
+    return (used_ == 0 && written_ != 0) || WriteChunk();
+}
+
+template <typename WriterT>
+bool DataChunkOutputStream<WriterT>::WriteChunk(void)
+{
+    if (failed_)
+    {
+        return false;
+    }
+
+    // Only the last chunk is shorter; the writer copies the chunk, so its capacity is reused for the next one.
+    if (used_ != chunk_size_)
+    {
+        chunk_.mutable_data()->resize(used_);
+    }
+    failed_ = !writer_->Write(chunk_);
+    written_ += static_cast<std::int64_t>(used_);
+    used_ = 0;
+    return !failed_;
+}
+
+template <typename ReaderT>
+DataChunkInputStream<ReaderT>::DataChunkInputStream(ReaderT *reader, std::uint64_t max_size)
+    : reader_(reader)
+    , max_size_(max_size)
+    , total_size_(0)
+    , received_(0)
+    , position_(0)
+    , started_(false)
+{
+}
+
+template <typename ReaderT>
+bool DataChunkInputStream<ReaderT>::Next(const void **data, int *size)
+{
+    while (position_ == chunk_.data().size())
+    {
+        if ((started_ && received_ == total_size_) || !error_.empty() || !ReadChunk())
+        {
+            return false;
+        }
+    }
+
+    *data = chunk_.data().data() + position_;
+    *size = static_cast<int>(chunk_.data().size() - position_);
+    position_ = chunk_.data().size();
+    return true;
+}
+
+template <typename ReaderT>
+void DataChunkInputStream<ReaderT>::BackUp(int count)
+{
+    position_ -= static_cast<std::size_t>(count);
+}
+
+template <typename ReaderT>
+bool DataChunkInputStream<ReaderT>::Skip(int count)
+{
+    const void *data = nullptr;
+    auto size = 0;
+    while (count > 0)
+    {
+        if (!Next(&data, &size))
+        {
+            return false;
+        }
+        if (size > count)
+        {
+            BackUp(size - count);
+            return true;
+        }
+        count -= size;
+    }
+    return true;
+}
+
+template <typename ReaderT>
+std::int64_t DataChunkInputStream<ReaderT>::ByteCount(void) const
+{
+    return static_cast<std::int64_t>(received_ - (chunk_.data().size() - position_));
+}
+
+template <typename ReaderT>
+bool DataChunkInputStream<ReaderT>::ReadChunk(void)
+{
+    if (!reader_->Read(&chunk_))
+    {
+        chunk_.clear_data();
+        error_ = started_ ? "the stream ended after " + std::to_string(received_) + " of " +
+                                std::to_string(total_size_) + " bytes"
+                          : "the stream ended before the first chunk";
+        return false;
+    }
+    position_ = 0;
+
+    if (!started_)
+    {
+        started_ = true;
+        total_size_ = chunk_.total_size();
+        if (total_size_ > max_size_)
+        {
+            error_ = "a message of " + std::to_string(total_size_) + " bytes exceeds the limit of " +
+                     std::to_string(max_size_);
+            return false;
+        }
+    }
+    else if (chunk_.total_size() != total_size_)
+    {
+        error_ = "a chunk of a message of " + std::to_string(chunk_.total_size()) + " bytes in one of " +
+                 std::to_string(total_size_);
+        return false;
+    }
+
+    received_ += chunk_.data().size();
+    if (received_ > total_size_)
+    {
+        error_ = "the chunks exceed the total size of " + std::to_string(total_size_) + " bytes";
+        return false;
+    }
+    return true;
+}
+
+template <typename WriterT>
+bool WriteChunked(const google::protobuf::MessageLite &message, WriterT *writer, std::size_t chunk_size)
+{
+    const auto total_size = message.ByteSizeLong();
+    if (total_size > INT_MAX)
+    {
+        return false;
+    }
+
+    auto stream = DataChunkOutputStream<WriterT>(writer, total_size, chunk_size);
+    {
+        // The coded stream gives back what it did not use when it is destroyed.
+        google::protobuf::io::CodedOutputStream output(&stream);
+        message.SerializeWithCachedSizes(&output);
+        if (output.HadError())
+        {
+            return false;
+        }
+    }
+    return stream.Flush() && static_cast<std::uint64_t>(stream.ByteCount()) == total_size;
+}
+
+template <typename ReaderT>
+bool ReadChunked(ReaderT *reader, google::protobuf::MessageLite *message, std::uint64_t max_size, std::string *error)
+{
+    auto stream = DataChunkInputStream<ReaderT>(reader, max_size);
+    const auto parsed = message->ParseFromZeroCopyStream(&stream);
+    if (!stream.Error().empty())
+    {
+        *error = stream.Error();
+        return false;
+    }
+    if (!parsed || !stream.Complete())
+    {
+        *error = "the chunks are not a valid " + message->GetTypeName();
+        return false;
+    }
+    return true;
+}
+
+} // namespace robl
+
+/*=========================================================================*/
@@ -0,0 +1,214 @@
+#pragma once
+
+// standard headers
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// grpc headers
+#include <google/protobuf/descriptor.h>
+#include <grpcpp/support/byte_buffer.h>
+#include <grpcpp/support/slice.h>
+#include <grpcpp/support/status.h>
+
+// project headers
+#include "wire/byte_buffer_view.hpp"
+#include "wire/serialize.hpp"
+
+/*=========================================================================*/
+
+namespace robl
+{
+
+/**
+ * @class RequestEcho
+ * @brief Echoes a request in the robl.api.ResponseHeader of its response without parsing or serializing it again.
+ *
+ * The echo captures the serialized request as it is received, by reference to the slices of its buffer, and finds
+ * where its RequestHeader lies. The response is assembled from slices: a few bytes of its own for the tags, the
+ * lengths and the timestamps, the RequestHeader and, if echoed, the whole request as the value of the Any, both
+ * spliced from the request, then the serialized rest of the response. Whatever the size of the request, nothing of it
+ * is copied, parsed or held apart from the references.
+ */
+class RequestEcho
+{
+public:
+    // The field of the requests and responses of the API which holds their header.
+    static constexpr int kHeaderField = 1;
+
+    /**
+     * Captures a request of the type and the time it was received at, which is now.
+     */
+    RequestEcho(const grpc::ByteBuffer &request, const google::protobuf::Descriptor *type);
+
+    /**
+     * Whether the request is a well-formed message, as a handler which does not parse it must check.
+     */
+    bool Valid(void) const
+    {
+        return valid_;
+    }
+
+    /**
+     * Assembles the response from its body, i.e. the serialized response without its header, which it references.
+     * If echo_request is set, the header holds the whole request too.
+     */
+    grpc::ByteBuffer Respond(const grpc::ByteBuffer &body, bool echo_request) const;
+
+    /**
+     * Serializes the body, a response whose header is not set, and assembles the response from it.
+     */
+    template <typename MessageT>
+    grpc::Status Respond(const MessageT &body, bool echo_request, grpc::ByteBuffer *response) const;
+
+private:
+    static std::string EncodeTimestamp(std::chrono::system_clock::time_point time);
+
+    ByteBufferView request_;
+    std::vector<ByteBufferView::Range> request_header_;
+    bool valid_;
+    std::string type_url_;
+    std::string received_;
+};
+
+/*=========================================================================*/
+
+namespace detail
+{
+
+inline std::size_t VarintSize(std::uint64_t value)
+{
+    auto size = std::size_t(1);
+    while (value >= 0x80)
+    {
+        value >>= 7;
+        ++size;
+    }
+    return size;
+}
+
+inline void AppendVarint(std::uint64_t value, std::string *out)
+{
+    while (value >= 0x80)
+    {
+        out->push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out->push_back(static_cast<char>(value));
+}
+
+// The key of a length-delimited field: its tag and the length of its payload.
+inline void AppendKey(int number, std::size_t length, std::string *out)
+{
+    AppendVarint(static_cast<std::uint64_t>(number) << 3 | 2, out);
+    AppendVarint(length, out);
+}
+
+// The size of a length-delimited field.
+inline std::size_t FieldSize(int number, std::size_t length)
+{
+    return VarintSize(static_cast<std::uint64_t>(number) << 3 | 2) + VarintSize(length) + length;
+}
+
+} // namespace detail
+
+inline RequestEcho::RequestEcho(const grpc::ByteBuffer &request, const google::protobuf::Descriptor *type)
+    : request_(request)
+    , type_url_("type.googleapis.com/" + type->full_name())
+    , received_(EncodeTimestamp(std::chrono::system_clock::now()))
+{
+    valid_ = request_.FindField(kHeaderField, &request_header_);
+}
+
+inline grpc::ByteBuffer RequestEcho::Respond(const grpc::ByteBuffer &body, bool echo_request) const
+{
+    // ResponseHeader { request_header = 1; request_received_timestamp = 2; response_timestamp = 3; request = 4; }
+    // Any { type_url = 1; value = 2; }
+    const auto sent = EncodeTimestamp(std::chrono::system_clock::now());
+    auto request_header_size = std::size_t(0);
+    for (const auto &range : request_header_)
+    {
+        request_header_size += range.Size();
+    }
+    const auto any_size = detail::FieldSize(1, type_url_.size()) + detail::FieldSize(2, request_.Size());
+    const auto header_size = (request_header_.empty() ? 0 : detail::FieldSize(1, request_header_size)) +
+                             detail::FieldSize(2, received_.size()) + detail::FieldSize(3, sent.size()) +
+                             (echo_request ? detail::FieldSize(4, any_size) : 0);
+
+    auto slices = std::vector<grpc::Slice>();
+    auto own = std::string();
+    detail::AppendKey(kHeaderField, header_size, &own);
+    if (!request_header_.empty())
+    {
+        detail::AppendKey(1, request_header_size, &own);
+        slices.emplace_back(own);
+        own.clear();
+        for (const auto &range : request_header_)
+        {
+            request_.Splice(range, &slices);
+        }
+    }
+
+    detail::AppendKey(2, received_.size(), &own);
+    own += received_;
+    detail::AppendKey(3, sent.size(), &own);
+    own += sent;
+    if (echo_request)
+    {
+        detail::AppendKey(4, any_size, &own);
+        detail::AppendKey(1, type_url_.size(), &own);
+        own += type_url_;
+        detail::AppendKey(2, request_.Size(), &own);
+    }
+    slices.emplace_back(own);
+    if (echo_request)
+    {
+        request_.Splice(ByteBufferView::Range{ 0, request_.Size() }, &slices);
+    }
+
+    auto body_slices = std::vector<grpc::Slice>();
+    (void)body.Dump(&body_slices);
+    slices.insert(slices.end(), body_slices.begin(), body_slices.end());
+
+    // The buffer takes a reference to every slice.
+    return grpc::ByteBuffer(slices.data(), slices.size());
+}
+
+template <typename MessageT>
+grpc::Status RequestEcho::Respond(const MessageT &body, bool echo_request, grpc::ByteBuffer *response) const
+{
+    auto serialized = grpc::ByteBuffer();
+    const auto status = SerializeToByteBuffer(body, &serialized);
+    if (status.ok())
+    {
+        *response = Respond(serialized, echo_request);
+    }
+    return status;
+}
+
+inline std::string RequestEcho::EncodeTimestamp(std::chrono::system_clock::time_point time)
+{
+    // google.protobuf.Timestamp { int64 seconds = 1; int32 nanos = 2; }, without the fields which are 0.
+    const auto since_epoch = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+    const auto seconds = since_epoch / 1'000'000'000;
+    const auto nanos = since_epoch % 1'000'000'000;
+
+    auto encoded = std::string();
+    if (seconds != 0)
+    {
+        encoded.push_back(1 << 3);
+        detail::AppendVarint(static_cast<std::uint64_t>(seconds), &encoded);
+    }
+    if (nanos != 0)
+    {
+        encoded.push_back(2 << 3);
+        detail::AppendVarint(static_cast<std::uint64_t>(nanos), &encoded);
+    }
+    return encoded;
+}
+
+} // namespace robl
+
+/*=========================================================================*/
@@ -0,0 +1,29 @@
+#pragma once
+
+// grpc headers
+#include <grpcpp/impl/codegen/proto_utils.h>
+#include <grpcpp/support/byte_buffer.h>
+#include <grpcpp/support/status.h>
+
+/*=========================================================================*/
+
+namespace robl
+{
+
+/**
+ * Serializes a message into a grpc::ByteBuffer, e.g. to hand it once to many streams or to answer a raw method.
+ *
+ * @param message The message.
+ * @param buffer The buffer to be filled in.
+ * @return The status of the serialization, which fails if the message is beyond the 2 GiB protobuf serializes.
+ */
+template <typename MessageT>
+grpc::Status SerializeToByteBuffer(const MessageT &message, grpc::ByteBuffer *buffer)
+{
+    auto own_buffer = false;
+    return grpc::SerializationTraits<MessageT>::Serialize(message, buffer, &own_buffer);
+}
+
+} // namespace robl
+
+/*=========================================================================*/
@@ -0,0 +1,390 @@
+// standard headers
+#include <csignal>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+// grpc headers
+#include <grpcpp/alarm.h>
+#include <grpcpp/ext/proto_server_reflection_plugin.h>
+#include <grpcpp/grpcpp.h>
+#include <grpcpp/health_check_service_interface.h>
+#include <robl/api/service.grpc.pb.h>
+
+// project headers
+#include "channel/local_transport.hpp"
+#include "metrics/metrics_endpoint.hpp"
+#include "metrics/rpc_interceptors.hpp"
+#include "trace/trace_dumper.hpp"
+#include "trace/trace_interceptors.hpp"
+
+using robl::api::ChatRequest;
+using robl::api::ChatResponse;
+using robl::api::HelloRequest;
+using robl::api::HelloResponse;
+using robl::api::TestService;
+
+// SayHello and Chat are served from the completion queues; the other methods fall back to the synchronous
+// UNIMPLEMENTED defaults instead of waiting forever for a request nobody asks for.
+using AsyncTestService = TestService::WithAsyncMethod_SayHello<TestService::WithAsyncMethod_Chat<TestService::Service>>;
+
+/*=========================================================================*/
+
+// A call slot of a completion queue. Its address is the tag of every operation it starts, and once a call is
+// finished, the slot is re-armed for the next call instead of being deleted, unless the queue is stopping.
+class CallData
+{
+public:
+    virtual ~CallData() = default;
+
+    // Asks for the next call of the method.
+    virtual void Start(void) = 0;
+
+    // Advances the call after the operation tagged with this slot completed.
+    virtual void Proceed(bool ok) = 0;
+};
+
+class SayHelloCall final : public CallData
+{
+public:
+    SayHelloCall(AsyncTestService *service, grpc::ServerCompletionQueue *cq, const bool *stopping)
+        : service_(service)
+        , cq_(cq)
+        , stopping_(stopping)
+        , finishing_(false)
+    {
+    }
+
+    void Start(void) override
+    {
+        // A ServerContext serves a single call, so it is rebuilt in place; the messages keep their capacity.
+        responder_.reset();
+        context_.emplace();
+        responder_.emplace(&*context_);
+        request_.Clear();
+        reply_.Clear();
+        finishing_ = false;
+        service_->RequestSayHello(&*context_, &request_, &*responder_, cq_, cq_, this);
+    }
+
+    void Proceed(bool ok) override
+    {
+        if (finishing_)
+        {
+            if (!*stopping_)
+            {
+                Start();
+            }
+            return;
+        }
+        if (!ok)
+        {
+            // The server is shutting down.
+            return;
+        }
+
+        reply_.set_message("Hello " + request_.name());
+        finishing_ = true;
+        responder_->Finish(reply_, grpc::Status::OK, this);
+    }
+
+private:
+    AsyncTestService *service_;
+    grpc::ServerCompletionQueue *cq_;
+    const bool *stopping_;
+    std::optional<grpc::ServerContext> context_;
+    std::optional<grpc::ServerAsyncResponseWriter<HelloResponse>> responder_;
+    HelloRequest request_;
+    HelloResponse reply_;
+    bool finishing_;
+};
+
+class ChatCall final : public CallData
+{
+public:
+    ChatCall(AsyncTestService *service, grpc::ServerCompletionQueue *cq, const bool *stopping)
+        : service_(service)
+        , cq_(cq)
+        , stopping_(stopping)
+        , state_(State::Requested)
+    {
+    }
+
+    void Start(void) override
+    {
+        stream_.reset();
+        context_.emplace();
+        stream_.emplace(&*context_);
+        state_ = State::Requested;
+        service_->RequestChat(&*context_, &*stream_, cq_, cq_, this);
+    }
+
+    void Proceed(bool ok) override
+    {
+        switch (state_)
+        {
+        case State::Requested:
+            if (!ok)
+            {
+                return;
+            }
+            Read();
+            break;
+        case State::Reading:
+            if (!ok)
+            {
+                Finish(grpc::Status::OK);
+                return;
+            }
+            response_.set_message("You said: " + request_.message());
+            state_ = State::Writing;
+            stream_->Write(response_, this);
+            break;
+        case State::Writing:
+            if (!ok)
+            {
+                Finish(grpc::Status::CANCELLED);
+                return;
+            }
+            Read();
+            break;
+        case State::Finishing:
+            if (!*stopping_)
+            {
+                Start();
+            }
+            break;
+        }
+    }
+
+private:
+    enum class State
+    {
+        Requested,
+        Reading,
+        Writing,
+        Finishing,
+    };
+
+    void Read(void)
+    {
+        state_ = State::Reading;
+        stream_->Read(&request_, this);
+    }
+
+    void Finish(const grpc::Status &status)
+    {
+        state_ = State::Finishing;
+        stream_->Finish(status, this);
+    }
+
+    AsyncTestService *service_;
+    grpc::ServerCompletionQueue *cq_;
+    const bool *stopping_;
+    std::optional<grpc::ServerContext> context_;
+    std::optional<grpc::ServerAsyncReaderWriter<ChatResponse, ChatRequest>> stream_;
+    ChatRequest request_;
+    ChatResponse response_;
+    State state_;
+};
+
+/*=========================================================================*/
+
+// A completion queue with its own pool of call slots, polled by one thread pinned to one core. Calls never move
+// between shards, so a call is served start to finish by the core which accepted it.
+class ServerShard
+{
+public:
+    ServerShard(AsyncTestService *service, std::unique_ptr<grpc::ServerCompletionQueue> cq, int cpu,
+                std::size_t unary_calls, std::size_t stream_calls)
+        : cq_(std::move(cq))
+        , cpu_(cpu)
+        , stopping_(false)
+    {
+        for (auto i = std::size_t(0); i < unary_calls; ++i)
+        {
+            say_hello_calls_.emplace_back(service, cq_.get(), &stopping_);
+        }
+        for (auto i = std::size_t(0); i < stream_calls; ++i)
+        {
+            chat_calls_.emplace_back(service, cq_.get(), &stopping_);
+        }
+    }
+
+    void Start(void)
+    {
+        for (auto &call : say_hello_calls_)
+        {
+            call.Start();
+        }
+        for (auto &call : chat_calls_)
+        {
+            call.Start();
+        }
+        thread_ = std::thread(&ServerShard::Run, this);
+    }
+
+    // Must be called after the server is shut down. The queue is shut down from its own thread, so no call slot
+    // can be re-armed on it afterwards.
+    void Shutdown(void)
+    {
+        shutdown_alarm_.Set(cq_.get(), gpr_now(GPR_CLOCK_MONOTONIC), &shutdown_alarm_);
+        thread_.join();
+    }
+
+private:
+    void Run(void)
+    {
+        auto cpus = cpu_set_t();
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu_, &cpus);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+        {
+            std::cerr << "Could not pin the completion queue thread to cpu " << cpu_ << std::endl;
+        }
+
+        void *tag = nullptr;
+        auto ok = false;
+        while (cq_->Next(&tag, &ok))
+        {
+            if (tag == &shutdown_alarm_)
+            {
+                stopping_ = true;
+                cq_->Shutdown();
+                continue;
+            }
+            static_cast<CallData *>(tag)->Proceed(ok);
+        }
+    }
+
+    std::unique_ptr<grpc::ServerCompletionQueue> cq_;
+    int cpu_;
+    bool stopping_; // only used by the queue's thread
+    grpc::Alarm shutdown_alarm_;
+    // A deque never moves its elements, so the tags stay valid while the pool is filled.
+    std::deque<SayHelloCall> say_hello_calls_;
+    std::deque<ChatCall> chat_calls_;
+    std::thread thread_;
+};
+
+/*=========================================================================*/
+
+// The cores this process may run on, e.g. as restricted by taskset.
+std::vector<int> AllowedCpus(void)
+{
+    auto allowed = cpu_set_t();
+    auto cpus = std::vector<int>();
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+    {
+        for (auto cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (CPU_ISSET(cpu, &allowed))
+            {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    if (cpus.empty())
+    {
+        cpus.push_back(0);
+    }
+    return cpus;
+}
+
+void RunServer(std::size_t shard_count)
+{
+    constexpr auto unary_calls_per_shard = std::size_t(256);
+    constexpr auto stream_calls_per_shard = std::size_t(32);
+
+    const auto &server_address = std::string("localhost:50051");
+    const auto cpus = AllowedCpus();
+    if (shard_count == 0)
+    {
+        shard_count = cpus.size();
+    }
+
+    // SIGINT and SIGTERM are blocked before any thread starts, so that every thread inherits the mask and only the
+    // stopper below takes them.
+    auto stop_signals = sigset_t();
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, nullptr);
+
+    AsyncTestService service;
+
+    grpc::EnableDefaultHealthCheckService(true);
+    grpc::reflection::InitProtoReflectionServerBuilderPlugin();
+
+    grpc::ServerBuilder builder;
+    const auto unix_path = robl::AddListeningPorts(builder, server_address, grpc::InsecureServerCredentials());
+    builder.RegisterService(&service);
+
+    auto queues = std::vector<std::unique_ptr<grpc::ServerCompletionQueue>>();
+    for (auto i = std::size_t(0); i < shard_count; ++i)
+    {
+        queues.push_back(builder.AddCompletionQueue());
+    }
+
+    // Counts every call by method, and traces it while tracing is on.
+    auto interceptors = robl::ServerMetricsInterceptors();
+    interceptors.push_back(std::make_unique<robl::TraceServerInterceptorFactory>());
+    builder.experimental().SetInterceptorCreators(std::move(interceptors));
+
+    std::unique_ptr<grpc::Server> server(builder.BuildAndStart());
+    robl::LocalServers::Instance().Add(server_address, server.get());
+    const auto metrics = robl::ServeMetrics(server_address);
+    const auto traces = robl::DumpTracesOnSignal();
+
+    auto shards = std::vector<std::unique_ptr<ServerShard>>();
+    for (auto i = std::size_t(0); i < shard_count; ++i)
+    {
+        shards.push_back(std::make_unique<ServerShard>(&service, std::move(queues[i]), cpus[i % cpus.size()],
+                                                       unary_calls_per_shard, stream_calls_per_shard));
+        shards.back()->Start();
+    }
+
+    std::cout << "Server listening on " << server_address << (unix_path.empty() ? "" : " and unix:" + unix_path)
+              << " with " << shard_count << " completion queues" << std::endl;
+    if (metrics != nullptr)
+    {
+        std::cout << "Metrics at http://" << robl::MetricsAddress(server_address) << "/metrics" << std::endl;
+    }
+    if (traces != nullptr)
+    {
+        std::cout << "Traces dump on SIGUSR1, and tracing turns on and off on SIGUSR2" << std::endl;
+    }
+
+    // Shutting the server down completes the calls in flight, which needs the queues still polled, and fails the
+    // pending requests, so no slot is re-armed past it. Only then are the queues shut down.
+    auto stopper = std::thread([&server, &stop_signals]() {
+        auto signal = 0;
+        sigwait(&stop_signals, &signal);
+        std::cout << "Shutting down" << std::endl;
+        server->Shutdown();
+    });
+    server->Wait();
+    stopper.join();
+    robl::LocalServers::Instance().Remove(server_address);
+
+    for (auto &shard : shards)
+    {
+        shard->Shutdown();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    // The number of completion queues, one per allowed core by default.
+    const auto shard_count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 0;
+    RunServer(shard_count);
+    return 0;
+}
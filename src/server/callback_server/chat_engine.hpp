@@ -0,0 +1,297 @@
+#pragma once
+
+// standard headers
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+// grpc headers
+#include <grpcpp/support/byte_buffer.h>
+#include <robl/api/test.pb.h>
+
+// project headers
+#include "event/broadcaster.hpp"
+#include "event/timer_service.hpp"
+#include "trace/tracer.hpp"
+#include "wire/serialize.hpp"
+
+/*=========================================================================*/
+
+/**
+ * What a stream does with a new message when its outbound queue is full.
+ */
+enum class SlowConsumerPolicy
+{
+    DropOldest, // drop the oldest queued message
+    Coalesce,   // replace every queued message with the new one
+    Disconnect, // end the stream with RESOURCE_EXHAUSTED
+};
+
+/**
+ * @class OutboundQueue
+ * @brief A bounded queue of serialized messages waiting to be written to one stream.
+ */
+class OutboundQueue
+{
+public:
+    enum class PushResult
+    {
+        Queued,
+        Dropped,  // queued after older messages were dropped
+        Overflow, // not queued, the stream is to be disconnected
+    };
+
+    OutboundQueue(std::size_t max_size, SlowConsumerPolicy policy)
+        : max_size_(max_size)
+        , policy_(policy)
+    {
+    }
+
+    /**
+     * Queues a message, applying the slow consumer policy if the queue is full.
+     *
+     * @param message The serialized message. Only a reference on its slices is taken.
+     * @param dropped The number of the messages dropped to make room.
+     * @return The outcome of the push.
+     */
+    PushResult Push(const grpc::ByteBuffer &message, std::size_t *dropped)
+    {
+        *dropped = 0;
+        if (messages_.size() < max_size_)
+        {
+            messages_.push_back(message);
+            return PushResult::Queued;
+        }
+
+        switch (policy_)
+        {
+        case SlowConsumerPolicy::DropOldest:
+            messages_.pop_front();
+            messages_.push_back(message);
+            *dropped = 1;
+            return PushResult::Dropped;
+        case SlowConsumerPolicy::Coalesce:
+            *dropped = messages_.size();
+            messages_.clear();
+            messages_.push_back(message);
+            return PushResult::Dropped;
+        default:
+            return PushResult::Overflow;
+        }
+    }
+
+    /**
+     * Moves the oldest message out of the queue.
+     *
+     * @return false if the queue is empty, true otherwise.
+     */
+    bool Pop(grpc::ByteBuffer *message)
+    {
+        if (messages_.empty())
+        {
+            return false;
+        }
+
+        *message = std::move(messages_.front());
+        messages_.pop_front();
+        return true;
+    }
+
+private:
+    std::size_t max_size_;
+    SlowConsumerPolicy policy_;
+    std::deque<grpc::ByteBuffer> messages_;
+};
+
+/*=========================================================================*/
+
+/**
+ * @class ChatEngine
+ * @brief Chat rooms whose messages are serialized once and handed to every member of the room.
+ *
+ * Members are told about messages while the engine is read-locked and must only queue them, e.g. in an OutboundQueue
+ * drained from OnWriteDone. A shared timer posts the server time to every room, so streams need no threads of their
+ * own.
+ */
+class ChatEngine
+{
+public:
+    struct Options
+    {
+        std::size_t max_queue_size = 64;
+        SlowConsumerPolicy policy = SlowConsumerPolicy::DropOldest;
+        std::chrono::steady_clock::duration tick_period = std::chrono::seconds(1);
+    };
+
+    struct Stats
+    {
+        std::uint64_t posted;
+        std::uint64_t dropped;
+        std::uint64_t disconnected;
+        std::size_t rooms;
+        std::size_t members;
+    };
+
+    class Member
+    {
+    public:
+        virtual ~Member() = default;
+
+        /**
+         * Called with every message of the room. It must not block and must not call back into the engine.
+         */
+        virtual void Deliver(const grpc::ByteBuffer &message) = 0;
+    };
+
+    ChatEngine(robl::TimerService &timer_service, const Options &options);
+    ~ChatEngine();
+
+    const Options &GetOptions(void) const
+    {
+        return options_;
+    }
+
+    void Join(const std::string &room, Member *member);
+    void Leave(const std::string &room, Member *member);
+
+    /**
+     * Serializes the message once and hands it to every member of the room.
+     */
+    void Post(const std::string &room, const robl::api::ChatResponse &message);
+
+    /**
+     * Records messages a member dropped under the slow consumer policy.
+     */
+    void RecordDropped(std::size_t count)
+    {
+        dropped_.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    /**
+     * Records a member disconnected under the slow consumer policy.
+     */
+    void RecordDisconnected(void)
+    {
+        disconnected_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Stats GetStats(void) const;
+
+private:
+    void Tick(void);
+
+    robl::TimerService &timer_service_;
+    Options options_;
+    robl::TimerService::TaskId tick_task_;
+
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<std::string, std::unordered_set<Member *>> rooms_;
+    std::size_t member_count_;
+
+    std::atomic<std::uint64_t> posted_;
+    std::atomic<std::uint64_t> dropped_;
+    std::atomic<std::uint64_t> disconnected_;
+};
+
+/*=========================================================================*/
+
+inline ChatEngine::ChatEngine(robl::TimerService &timer_service, const Options &options)
+    : timer_service_(timer_service)
+    , options_(options)
+    , member_count_(0)
+    , posted_(0)
+    , dropped_(0)
+    , disconnected_(0)
+{
+    tick_task_ = timer_service_.ScheduleEvery(options_.tick_period, [this]() { Tick(); });
+}
+
+inline ChatEngine::~ChatEngine()
+{
+    timer_service_.Cancel(tick_task_);
+}
+
+inline void ChatEngine::Join(const std::string &room, Member *member)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (rooms_[room].insert(member).second)
+    {
+        ++member_count_;
+    }
+}
+
+inline void ChatEngine::Leave(const std::string &room, Member *member)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+
+    const auto it = rooms_.find(room);
+    if (it == rooms_.end() || it->second.erase(member) == 0)
+    {
+        return;
+    }
+
+    --member_count_;
+    if (it->second.empty())
+    {
+        rooms_.erase(it);
+    }
+}
+
+inline void ChatEngine::Post(const std::string &room, const robl::api::ChatResponse &message)
+{
+    const auto zone = robl::TraceZone("Chat", "post");
+    auto buffer = grpc::ByteBuffer();
+    if (!robl::SerializeToByteBuffer(message, &buffer).ok())
+    {
+        return;
+    }
+
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    const auto it = rooms_.find(room);
+    if (it == rooms_.end())
+    {
+        return;
+    }
+
+    posted_.fetch_add(1, std::memory_order_relaxed);
+    for (auto *member : it->second)
+    {
+        member->Deliver(buffer);
+    }
+}
+
+inline void ChatEngine::Tick(void)
+{
+    auto message = robl::api::ChatResponse();
+    message.set_message("Server: " + std::to_string(std::time(nullptr)));
+    auto buffer = grpc::ByteBuffer();
+    if (!robl::SerializeToByteBuffer(message, &buffer).ok())
+    {
+        return;
+    }
+
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    for (const auto &[name, members] : rooms_)
+    {
+        for (auto *member : members)
+        {
+            member->Deliver(buffer);
+        }
+    }
+}
+
+inline ChatEngine::Stats ChatEngine::GetStats(void) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return Stats{ posted_.load(std::memory_order_relaxed), dropped_.load(std::memory_order_relaxed),
+                  disconnected_.load(std::memory_order_relaxed), rooms_.size(), member_count_ };
+}
+
+/*=========================================================================*/
@@ -1,9 +1,10 @@
 // standard headers
+#include <atomic>
 #include <chrono>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <string>
-#include <thread>
 
 // grpc headers
 #include <grpcpp/ext/proto_server_reflection_plugin.h>
@@ -11,157 +12,402 @@
 #include <grpcpp/health_check_service_interface.h>
 #include <robl/api/service.grpc.pb.h>
 
+// project headers
+#include "admission/admission_controller.hpp"
+#include "admission/admission_interceptor.hpp"
+#include "arena/arena_message_allocator.hpp"
+#include "channel/local_transport.hpp"
+#include "chat_engine.hpp"
+#include "coro/server_call.hpp"
+#include "coro/task.hpp"
+#include "event/broadcaster.hpp"
+#include "event/timer_service.hpp"
+#include "metrics/metrics_endpoint.hpp"
+#include "metrics/raw_methods.hpp"
+#include "metrics/rpc_interceptors.hpp"
+#include "trace/trace_dumper.hpp"
+#include "trace/trace_interceptors.hpp"
+#include "wire/serialize.hpp"
+
 using robl::api::ChatRequest;
 using robl::api::ChatResponse;
 using robl::api::HelloRequest;
 using robl::api::HelloResponse;
-using robl::api::SubscribeProgressRequest;
 using robl::api::SubscribeProgressResponse;
 using robl::api::TestService;
 
-// Logic and data behind the server's behavior.
-class TestServiceImpl final : public TestService::CallbackService
+// Simulates a job which reports its progress once a second. Every step is serialized once and broadcast to all the
+// subscribers; when the job completes, its broadcaster is closed and the next job starts.
+class ProgressPublisher
 {
-    grpc::ServerUnaryReactor *SayHello(grpc::CallbackServerContext *context, const HelloRequest *request,
-                                       HelloResponse *reply) override
+public:
+    explicit ProgressPublisher(robl::TimerService &timer_service)
+        : timer_service_(timer_service)
+        , broadcaster_(std::make_shared<robl::Broadcaster<grpc::ByteBuffer>>())
+        , total_steps_(19)
+        , current_step_(0)
     {
-        auto *reactor = context->DefaultReactor();
+        task_ = timer_service_.ScheduleEvery(std::chrono::seconds(1), [this]() { Step(); });
+    }
 
-        reply->set_message("Hello " + request->name());
-        reactor->Finish(grpc::Status::OK);
+    ~ProgressPublisher()
+    {
+        timer_service_.Cancel(task_);
+    }
 
-        return reactor;
+    std::shared_ptr<robl::Broadcaster<grpc::ByteBuffer>> Current(void) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return broadcaster_;
     }
 
-    grpc::ServerWriteReactor<SubscribeProgressResponse> *SubscribeProgress(grpc::CallbackServerContext *context,
-                                                                           const SubscribeProgressRequest *request) override
+private:
+    void Step(void)
     {
-        class SubscribeProgressReactor final : public grpc::ServerWriteReactor<SubscribeProgressResponse>
+        const auto broadcaster = Current();
+
+        response_.set_progress(100.0 * current_step_ / total_steps_);
+        auto buffer = grpc::ByteBuffer();
+        const auto status = robl::SerializeToByteBuffer(response_, &buffer);
+        if (status.ok())
         {
-        public:
-            SubscribeProgressReactor(const grpc::CallbackServerContext *context, const SubscribeProgressRequest *request)
-                : context_(context)
-                , request_(request)
-                , total_steps_(19)
-                , current_step_(0)
-            {
-                NextWrite();
-            }
-            ~SubscribeProgressReactor()
-            {
-                std::cout << "SubscribeProgressReactor deleted" << std::endl;
-            }
+            broadcaster->Publish(buffer);
+        }
+        else
+        {
+            std::cerr << "SubscribeProgress step not sent: " << status.error_message() << std::endl;
+        }
+        if (++current_step_ <= total_steps_)
+        {
+            return;
+        }
 
-            void OnDone(void) override
-            {
-                delete this;
-            }
+        broadcaster->Close();
+        current_step_ = 0;
+        std::lock_guard<std::mutex> lock(mutex_);
+        broadcaster_ = std::make_shared<robl::Broadcaster<grpc::ByteBuffer>>();
+    }
 
-            void OnWriteDone(bool ok) override
-            {
-                NextWrite();
-            }
+    robl::TimerService &timer_service_;
+    robl::TimerService::TaskId task_;
+    mutable std::mutex mutex_;
+    std::shared_ptr<robl::Broadcaster<grpc::ByteBuffer>> broadcaster_;
+    SubscribeProgressResponse response_;
+    int total_steps_;
+    int current_step_;
+};
 
-        private:
-            void NextWrite(void)
-            {
-                if (context_->IsCancelled())
-                {
-                    Finish(grpc::Status::CANCELLED);
-                    return;
-                }
+using ProgressCall = robl::coro::ServerWriteCall<grpc::ByteBuffer>;
+using ChatCall = robl::coro::ServerBidiCall<grpc::ByteBuffer, grpc::ByteBuffer>;
 
-                if (current_step_ <= total_steps_)
-                {
-                    std::this_thread::sleep_for(std::chrono::seconds(1));
+// Keeps the latest progress of a broadcaster for a SubscribeProgress handler and wakes it on every update. While the
+// handler writes, newer updates replace each other, so a slow client gets the newest progress next instead of a
+// backlog.
+class ProgressMailbox final : public robl::Broadcaster<grpc::ByteBuffer>::Subscriber
+{
+public:
+    ProgressMailbox(std::shared_ptr<robl::Broadcaster<grpc::ByteBuffer>> broadcaster, ProgressCall &stream)
+        : broadcaster_(std::move(broadcaster))
+        , stream_(stream)
+        , pending_(false)
+        , closed_(false)
+    {
+        broadcaster_->Subscribe(this);
+    }
 
-                    response_.set_progress(100.0 * current_step_++ / total_steps_);
-                    StartWrite(&response_);
-                    return;
-                }
+    ~ProgressMailbox()
+    {
+        broadcaster_->Unsubscribe(this);
+    }
 
-                Finish(grpc::Status::OK);
-            }
+    void OnPublished(const grpc::ByteBuffer &progress) override
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            latest_ = progress;
+            pending_ = true;
+        }
+        stream_.Notify();
+    }
 
-            const grpc::CallbackServerContext *context_;
-            const SubscribeProgressRequest *request_;
-            SubscribeProgressResponse response_;
+    void OnClosed(void) override
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        stream_.Notify();
+    }
 
-            int total_steps_;
-            int current_step_;
-        };
+    // Returns false if there is no progress newer than the one taken last.
+    bool TakeLatest(grpc::ByteBuffer *progress)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!pending_)
+        {
+            return false;
+        }
 
-        return new SubscribeProgressReactor(context, request);
+        // Copying a ByteBuffer only takes a reference on its slices.
+        *progress = latest_;
+        pending_ = false;
+        return true;
     }
 
-    grpc::ServerBidiReactor<ChatRequest, ChatResponse> *Chat(grpc::CallbackServerContext *context) override
+    bool IsClosed(void)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return closed_;
+    }
+
+private:
+    std::shared_ptr<robl::Broadcaster<grpc::ByteBuffer>> broadcaster_;
+    ProgressCall &stream_;
+    std::mutex mutex_;
+    grpc::ByteBuffer latest_;
+    bool pending_;
+    bool closed_;
+};
+
+// Membership of a Chat handler in its room. The messages of the room wait in a bounded queue until the handler writes
+// them; a consumer which overflows it under the Disconnect policy is dropped right away, even with a write in flight.
+class ChatMailbox final : public ChatEngine::Member
+{
+public:
+    ChatMailbox(ChatEngine &engine, const std::string &room, ChatCall &stream)
+        : engine_(engine)
+        , room_(room)
+        , stream_(stream)
+        , queue_(engine.GetOptions().max_queue_size, engine.GetOptions().policy)
+        , disconnected_(false)
+    {
+        engine_.Join(room_, this);
+    }
+
+    ~ChatMailbox()
+    {
+        engine_.Leave(room_, this);
+    }
+
+    void Deliver(const grpc::ByteBuffer &message) override
     {
-        class ChatReactor final : public grpc::ServerBidiReactor<ChatRequest, ChatResponse>
         {
-        public:
-            ChatReactor(const grpc::CallbackServerContext *context)
-                : context_(context)
-                , done_(false)
-            {
-                StartRead(&request_);
-                sender_ = std::thread(&ChatReactor::SendEverySecond, this);
-            }
-            ~ChatReactor()
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (disconnected_)
             {
-                std::cout << "ChatReactor deleted" << std::endl;
+                return;
             }
 
-            void OnDone() override
+            auto dropped = std::size_t(0);
+            switch (queue_.Push(message, &dropped))
             {
-                std::cout << "ChatReactor::OnDone" << std::endl;
-                done_ = true;
-                sender_.join();
-                delete this;
+            case OutboundQueue::PushResult::Overflow:
+                disconnected_ = true;
+                engine_.RecordDisconnected();
+                stream_.Abort(grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED, "slow consumer"));
+                return;
+            case OutboundQueue::PushResult::Dropped:
+                engine_.RecordDropped(dropped);
+                break;
+            default:
+                break;
             }
+        }
+        stream_.Notify();
+    }
+
+    bool Pop(grpc::ByteBuffer *message)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return queue_.Pop(message);
+    }
 
-            void OnReadDone(bool ok) override
+private:
+    ChatEngine &engine_;
+    const std::string room_;
+    ChatCall &stream_;
+    std::mutex mutex_;
+    OutboundQueue queue_;
+    bool disconnected_;
+};
+
+// What the reading side of a Chat call tells its handler.
+struct ChatReadState
+{
+    std::atomic_bool done = false;
+    std::atomic_bool malformed = false;
+};
+
+// Streams only hold memory while they wait on the callback executor, so their fixed limits are generous while SayHello
+// adapts its limit to its latency.
+robl::AdmissionController::Options AdmissionOptions(void)
+{
+    auto options = robl::AdmissionController::Options();
+    options.method_limits["SubscribeProgress"] = robl::AdmissionController::FixedLimit(16384, std::chrono::seconds(1));
+    options.method_limits["Chat"] = robl::AdmissionController::FixedLimit(4096, std::chrono::seconds(1));
+    return options;
+}
+
+// TestService::CallbackService with the raw streams, spelled out as the typed and raw Chat handlers share a signature.
+using TestServiceBase = TestService::WithCallbackMethod_RegisterAccount<
+    TestService::WithCallbackMethod_HeartBeat<TestService::WithCallbackMethod_UploadFile<
+        TestService::WithCallbackMethod_GetMarker<TestService::WithCallbackMethod_IngestMarkers<
+            TestService::WithCallbackMethod_SayHello<TestService::WithRawCallbackMethod_SubscribeProgress<
+                TestService::WithRawCallbackMethod_Chat<TestService::Service>>>>>>>>;
+
+// Logic and data behind the server's behavior.
+class TestServiceImpl final : public TestServiceBase
+{
+public:
+    TestServiceImpl(void)
+        : progress_publisher_(robl::TimerService::Shared())
+        , chat_engine_(robl::TimerService::Shared(), ChatEngine::Options())
+        , next_member_id_(1)
+        , admission_(AdmissionOptions())
+    {
+        SetMessageAllocatorFor_SayHello(&say_hello_allocator_);
+        robl::RawMethods::Instance().Mark(robl::RpcMetrics::Side::Server, TestService::service_full_name(),
+                                          "SubscribeProgress");
+        robl::RawMethods::Instance().Mark(robl::RpcMetrics::Side::Server, TestService::service_full_name(), "Chat");
+    }
+
+private:
+    grpc::ServerUnaryReactor *SayHello(grpc::CallbackServerContext *context, const HelloRequest *request,
+                                       HelloResponse *reply) override
+    {
+        auto *reactor = context->DefaultReactor();
+
+        const auto ticket = admission_.Admit("SayHello", context);
+        if (!ticket.Admitted())
+        {
+            reactor->Finish(ticket.Reject(context));
+            return reactor;
+        }
+
+        reply->set_message("Hello " + request->name());
+        reactor->Finish(grpc::Status::OK);
+
+        return reactor;
+    }
+
+    grpc::ServerWriteReactor<grpc::ByteBuffer> *SubscribeProgress(grpc::CallbackServerContext *context,
+                                                                  const grpc::ByteBuffer *) override
+    {
+        auto ticket = admission_.Admit("SubscribeProgress");
+        if (!ticket.Admitted())
+        {
+            return new robl::RejectedReactor<grpc::ServerWriteReactor<grpc::ByteBuffer>>(ticket.Reject(context));
+        }
+
+        // Writes the latest progress whenever there is a new one, until the job completes.
+        const auto broadcaster = progress_publisher_.Current();
+        return ProgressCall::Start([broadcaster, ticket = std::move(ticket)](
+                                       ProgressCall &stream) -> robl::coro::Task<grpc::Status> {
+            ProgressMailbox mailbox(broadcaster, stream);
+            auto progress = grpc::ByteBuffer();
+            while (!stream.IsCancelled())
             {
-                if (ok)
+                if (mailbox.TakeLatest(&progress))
                 {
-                    response_.set_message("You said: " + request_.message());
-                    StartWrite(&response_);
-                    StartRead(&request_);
+                    if (!co_await stream.Write(progress))
+                    {
+                        co_return grpc::Status::CANCELLED;
+                    }
+                    continue;
                 }
-                else
+
+                if (mailbox.IsClosed())
                 {
-                    Finish(grpc::Status::OK);
+                    co_return grpc::Status::OK;
                 }
+                co_await stream.Notified();
             }
+            co_return grpc::Status::CANCELLED;
+        });
+    }
 
-            void OnWriteDone(bool ok) override
-            {
-            }
+    grpc::ServerBidiReactor<grpc::ByteBuffer, grpc::ByteBuffer> *Chat(grpc::CallbackServerContext *context) override
+    {
+        auto ticket = admission_.Admit("Chat");
+        if (!ticket.Admitted())
+        {
+            return new robl::RejectedReactor<grpc::ServerBidiReactor<grpc::ByteBuffer, grpc::ByteBuffer>>(
+                ticket.Reject(context));
+        }
+
+        // A member of the chat room named by the "chat-room" metadata, "lobby" by default. The reading side posts every
+        // message of the client to the room, while the handler writes the messages of the room one at a time.
+        const auto name = "member-" + std::to_string(next_member_id_.fetch_add(1, std::memory_order_relaxed));
+        return ChatCall::Start([this, room = RoomOf(context), name,
+                                ticket = std::move(ticket)](ChatCall &stream) -> robl::coro::Task<grpc::Status> {
+            ChatMailbox mailbox(chat_engine_, room, stream);
+            const auto reading = std::make_shared<ChatReadState>();
+            robl::coro::Spawn(ReadChat(stream, chat_engine_, room, name, reading));
 
-            void SendEverySecond()
+            auto message = grpc::ByteBuffer();
+            while (!stream.IsCancelled())
             {
-                while (!done_)
+                if (mailbox.Pop(&message))
                 {
-                    std::this_thread::sleep_for(std::chrono::seconds(1));
-
-                    time_response_.set_message("Server: " + std::to_string(std::time(nullptr)));
-                    if (!done_) // Check for cancellation before writing
+                    if (!co_await stream.Write(message))
                     {
-                        StartWrite(&time_response_);
+                        co_return grpc::Status::CANCELLED;
                     }
+                    continue;
+                }
+
+                if (reading->malformed)
+                {
+                    co_return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "malformed ChatRequest");
                 }
+                if (reading->done)
+                {
+                    // The client is done sending and the queued messages are written.
+                    co_return grpc::Status::OK;
+                }
+                co_await stream.Notified();
+            }
+            co_return grpc::Status::CANCELLED;
+        });
+    }
+
+    // Posts every message of the client to the room. It only awaits Read(), so it ends before the call is done, and it
+    // holds what it shares with the handler on its own.
+    static robl::coro::Task<void> ReadChat(ChatCall &stream, ChatEngine &engine, std::string room, std::string name,
+                                           std::shared_ptr<ChatReadState> reading)
+    {
+        while (auto *buffer = co_await stream.Read())
+        {
+            // Between two awaits, so the zone begins and ends on the same thread.
+            const auto zone = robl::TraceZone("Chat", "read");
+            auto request = ChatRequest();
+            if (!grpc::SerializationTraits<ChatRequest>::Deserialize(buffer, &request).ok())
+            {
+                reading->malformed = true;
+                break;
             }
 
-        private:
-            const grpc::CallbackServerContext *context_;
-            ChatRequest request_;
-            ChatResponse response_;
-            ChatResponse time_response_;
-            std::thread sender_;
-            std::atomic_bool done_;
-        };
+            auto response = ChatResponse();
+            response.set_message(name + ": " + request.message());
+            engine.Post(room, response);
+        }
+
+        reading->done = true;
+        stream.Notify();
+    }
 
-        return new ChatReactor(context);
+    static std::string RoomOf(const grpc::CallbackServerContext *context)
+    {
+        const auto &metadata = context->client_metadata();
+        const auto it = metadata.find("chat-room");
+        return it != metadata.end() ? std::string(it->second.data(), it->second.size()) : "lobby";
     }
+
+    robl::ArenaMessageAllocator<HelloRequest, HelloResponse> say_hello_allocator_;
+    ProgressPublisher progress_publisher_;
+    ChatEngine chat_engine_;
+    std::atomic<std::uint64_t> next_member_id_;
+    robl::AdmissionController admission_;
 };
 
 void RunServer(void)
@@ -172,13 +418,38 @@ void RunServer(void)
     grpc::EnableDefaultHealthCheckService(true);
     grpc::reflection::InitProtoReflectionServerBuilderPlugin();
 
+    // Bounds the memory of the calls, so a burst is turned away instead of queueing up.
+    grpc::ResourceQuota quota("callback_server");
+    quota.Resize(512 * 1024 * 1024);
+
     grpc::ServerBuilder builder;
-    builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
+    const auto unix_path = robl::AddListeningPorts(builder, server_address, grpc::InsecureServerCredentials());
     builder.RegisterService(&service);
+    builder.SetResourceQuota(quota);
+
+    // Holds the admission of every call until it completes, counts every call by method, and traces it while tracing
+    // is on.
+    auto interceptors = robl::ServerMetricsInterceptors();
+    interceptors.insert(interceptors.begin(), std::make_unique<robl::AdmissionServerInterceptorFactory>());
+    interceptors.push_back(std::make_unique<robl::TraceServerInterceptorFactory>());
+    builder.experimental().SetInterceptorCreators(std::move(interceptors));
 
     std::unique_ptr<grpc::Server> server(builder.BuildAndStart());
-    std::cout << "Server listening on " << server_address << std::endl;
+    robl::LocalServers::Instance().Add(server_address, server.get());
+    const auto metrics = robl::ServeMetrics(server_address);
+    const auto traces = robl::DumpTracesOnSignal();
+    std::cout << "Server listening on " << server_address << (unix_path.empty() ? "" : " and unix:" + unix_path)
+              << std::endl;
+    if (metrics != nullptr)
+    {
+        std::cout << "Metrics at http://" << robl::MetricsAddress(server_address) << "/metrics" << std::endl;
+    }
+    if (traces != nullptr)
+    {
+        std::cout << "Traces dump on SIGUSR1, and tracing turns on and off on SIGUSR2" << std::endl;
+    }
     server->Wait();
+    robl::LocalServers::Instance().Remove(server_address);
 }
 
 int main(void)
@@ -2,8 +2,8 @@
 #include <chrono>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <string>
-#include <thread>
 
 // grpc headers
 #include <grpcpp/ext/proto_server_reflection_plugin.h>
@@ -11,6 +11,17 @@
 #include <grpcpp/health_check_service_interface.h>
 #include <robl/api/service.grpc.pb.h>
 
+// project headers
+#include "admission/admission_controller.hpp"
+#include "admission/admission_interceptor.hpp"
+#include "channel/local_transport.hpp"
+#include "event/broadcaster.hpp"
+#include "event/timer_service.hpp"
+#include "metrics/metrics_endpoint.hpp"
+#include "metrics/rpc_interceptors.hpp"
+#include "trace/trace_dumper.hpp"
+#include "trace/trace_interceptors.hpp"
+
 using robl::api::ChatRequest;
 using robl::api::ChatResponse;
 using robl::api::HelloRequest;
@@ -19,11 +30,88 @@ using robl::api::SubscribeProgressRequest;
 using robl::api::SubscribeProgressResponse;
 using robl::api::TestService;
 
+// Simulates a job which reports its progress once a second to all the subscribers; when the job completes, its
+// broadcaster is closed and the next job starts. The synchronous API serializes every write on its own, so the
+// progress is broadcast as a message rather than as a serialized buffer.
+class ProgressPublisher
+{
+public:
+    explicit ProgressPublisher(robl::TimerService &timer_service)
+        : timer_service_(timer_service)
+        , broadcaster_(std::make_shared<robl::Broadcaster<SubscribeProgressResponse>>())
+        , total_steps_(19)
+        , current_step_(0)
+    {
+        task_ = timer_service_.ScheduleEvery(std::chrono::seconds(1), [this]() { Step(); });
+    }
+
+    ~ProgressPublisher()
+    {
+        timer_service_.Cancel(task_);
+    }
+
+    std::shared_ptr<robl::Broadcaster<SubscribeProgressResponse>> Current(void) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return broadcaster_;
+    }
+
+private:
+    void Step(void)
+    {
+        const auto broadcaster = Current();
+
+        auto response = SubscribeProgressResponse();
+        response.set_progress(100.0 * current_step_ / total_steps_);
+        broadcaster->Publish(response);
+        if (++current_step_ <= total_steps_)
+        {
+            return;
+        }
+
+        broadcaster->Close();
+        current_step_ = 0;
+        std::lock_guard<std::mutex> lock(mutex_);
+        broadcaster_ = std::make_shared<robl::Broadcaster<SubscribeProgressResponse>>();
+    }
+
+    robl::TimerService &timer_service_;
+    robl::TimerService::TaskId task_;
+    mutable std::mutex mutex_;
+    std::shared_ptr<robl::Broadcaster<SubscribeProgressResponse>> broadcaster_;
+    int total_steps_;
+    int current_step_;
+};
+
+// Every stream holds a handler thread for its whole life, so streams get fixed limits below the thread quota while
+// SayHello adapts its limit to its latency.
+robl::AdmissionController::Options AdmissionOptions(void)
+{
+    auto options = robl::AdmissionController::Options();
+    options.method_limits["SubscribeProgress"] = robl::AdmissionController::FixedLimit(512, std::chrono::seconds(1));
+    options.method_limits["Chat"] = robl::AdmissionController::FixedLimit(256, std::chrono::seconds(1));
+    return options;
+}
+
 // Logic and data behind the server's behavior.
 class TestServiceImpl final : public TestService::Service
 {
+public:
+    TestServiceImpl(void)
+        : progress_publisher_(robl::TimerService::Shared())
+        , admission_(AdmissionOptions())
+    {
+    }
+
+private:
     grpc::Status SayHello(grpc::ServerContext *context, const HelloRequest *request, HelloResponse *reply) override
     {
+        const auto ticket = admission_.Admit("SayHello", context);
+        if (!ticket.Admitted())
+        {
+            return ticket.Reject(context);
+        }
+
         std::string prefix("Hello ");
         reply->set_message(prefix + request->name());
         return grpc::Status::OK;
@@ -32,20 +120,46 @@ class TestServiceImpl final : public TestService::Service
     grpc::Status SubscribeProgress(grpc::ServerContext *context, const SubscribeProgressRequest *request,
                                    grpc::ServerWriter<SubscribeProgressResponse> *writer) override
     {
-        SubscribeProgressResponse response;
-        const int total_steps = 19;
-        for (int i = 0; i <= total_steps; ++i)
+        const auto ticket = admission_.Admit("SubscribeProgress");
+        if (!ticket.Admitted())
         {
-            std::this_thread::sleep_for(std::chrono::seconds(1));
+            return ticket.Reject(context);
+        }
+
+        // The handler thread waits for the latest progress of the shared job; updates which arrive during a write
+        // replace each other.
+        const auto broadcaster = progress_publisher_.Current();
+        auto subscription = robl::BlockingSubscription<SubscribeProgressResponse>(*broadcaster);
 
-            response.set_progress(100.0 * i / total_steps);
-            writer->Write(response);
+        auto response = SubscribeProgressResponse();
+        while (!context->IsCancelled())
+        {
+            using WaitResult = robl::BlockingSubscription<SubscribeProgressResponse>::WaitResult;
+            switch (subscription.WaitFor(std::chrono::milliseconds(200), &response))
+            {
+            case WaitResult::Updated:
+                if (!writer->Write(response))
+                {
+                    return grpc::Status::CANCELLED;
+                }
+                break;
+            case WaitResult::Closed:
+                return grpc::Status::OK;
+            case WaitResult::Timeout:
+                break;
+            }
         }
-        return grpc::Status::OK;
+        return grpc::Status::CANCELLED;
     }
 
     grpc::Status Chat(grpc::ServerContext *context, grpc::ServerReaderWriter<ChatResponse, ChatRequest> *stream) override
     {
+        const auto ticket = admission_.Admit("Chat");
+        if (!ticket.Admitted())
+        {
+            return ticket.Reject(context);
+        }
+
         ChatRequest request;
         ChatResponse response;
         while (stream->Read(&request))
@@ -55,6 +169,9 @@ class TestServiceImpl final : public TestService::Service
         }
         return grpc::Status::OK;
     }
+
+    ProgressPublisher progress_publisher_;
+    robl::AdmissionController admission_;
 };
 
 void RunServer(void)
@@ -65,13 +182,39 @@ void RunServer(void)
     grpc::EnableDefaultHealthCheckService(true);
     grpc::reflection::InitProtoReflectionServerBuilderPlugin();
 
+    // Bounds the handler threads and the memory of the calls, so a burst is turned away instead of queueing up.
+    grpc::ResourceQuota quota("sync_server");
+    quota.SetMaxThreads(1024);
+    quota.Resize(512 * 1024 * 1024);
+
     grpc::ServerBuilder builder;
-    builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
+    const auto unix_path = robl::AddListeningPorts(builder, server_address, grpc::InsecureServerCredentials());
     builder.RegisterService(service.get());
+    builder.SetResourceQuota(quota);
+
+    // Holds the admission of every call until it completes, counts every call by method, and traces it while tracing
+    // is on.
+    auto interceptors = robl::ServerMetricsInterceptors();
+    interceptors.insert(interceptors.begin(), std::make_unique<robl::AdmissionServerInterceptorFactory>());
+    interceptors.push_back(std::make_unique<robl::TraceServerInterceptorFactory>());
+    builder.experimental().SetInterceptorCreators(std::move(interceptors));
 
     auto server(builder.BuildAndStart());
-    std::cout << "Server listening on " << server_address << std::endl;
+    robl::LocalServers::Instance().Add(server_address, server.get());
+    const auto metrics = robl::ServeMetrics(server_address);
+    const auto traces = robl::DumpTracesOnSignal();
+    std::cout << "Server listening on " << server_address << (unix_path.empty() ? "" : " and unix:" + unix_path)
+              << std::endl;
+    if (metrics != nullptr)
+    {
+        std::cout << "Metrics at http://" << robl::MetricsAddress(server_address) << "/metrics" << std::endl;
+    }
+    if (traces != nullptr)
+    {
+        std::cout << "Traces dump on SIGUSR1, and tracing turns on and off on SIGUSR2" << std::endl;
+    }
     server->Wait();
+    robl::LocalServers::Instance().Remove(server_address);
 }
 
 int main(void)
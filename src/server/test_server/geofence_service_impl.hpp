@@ -0,0 +1,153 @@
+#pragma once
+
+// standard headers
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// grpc headers
+#include <robl/api/service.grpc.pb.h>
+
+// project headers
+#include "arena/arena_message_allocator.hpp"
+#include "geometry/zone_index.hpp"
+
+/*=========================================================================*/
+
+using robl::api::GeofenceService;
+using robl::api::GeofenceZone;
+using robl::api::LoadZonesRequest;
+using robl::api::LoadZonesResponse;
+using robl::api::QueryZonesRequest;
+using robl::api::QueryZonesResponse;
+
+/*=========================================================================*/
+
+/**
+ * @class GeofenceServiceImpl
+ * @brief Answers which of the loaded zones contain a batch of positions.
+ *
+ * Every load builds a new robl::geometry::ZoneIndex beside the current one and publishes it with a single pointer swap,
+ * so queries never wait for a load and always see a complete zone set.
+ */
+class GeofenceServiceImpl final : public GeofenceService::CallbackService
+{
+public:
+    GeofenceServiceImpl(void)
+        : index_(std::make_shared<robl::geometry::ZoneIndex>())
+        , version_(0)
+        , query_zones_allocator_(64 * 1024, 16 * 1024 * 1024)
+    {
+        SetMessageAllocatorFor_LoadZones(&load_zones_allocator_);
+        SetMessageAllocatorFor_QueryZones(&query_zones_allocator_);
+    }
+
+    // GeofenceService rpc methods
+    grpc::ServerUnaryReactor *LoadZones(grpc::CallbackServerContext *context, const LoadZonesRequest *request,
+                                        LoadZonesResponse *response) override;
+    grpc::ServerUnaryReactor *QueryZones(grpc::CallbackServerContext *context, const QueryZonesRequest *request,
+                                         QueryZonesResponse *response) override;
+
+private:
+    struct IndexSnapshot
+    {
+        std::shared_ptr<const robl::geometry::ZoneIndex> index;
+        std::uint64_t version;
+    };
+
+    IndexSnapshot Snapshot(void) const
+    {
+        std::lock_guard<std::mutex> lock(index_mutex_);
+        return IndexSnapshot{ index_, version_ };
+    }
+
+    std::mutex load_mutex_; // serializes loads
+    std::map<std::uint32_t, GeofenceZone> zones_;
+
+    mutable std::mutex index_mutex_; // guards the published index only
+    std::shared_ptr<const robl::geometry::ZoneIndex> index_;
+    std::uint64_t version_;
+
+    robl::ArenaMessageAllocator<LoadZonesRequest, LoadZonesResponse> load_zones_allocator_;
+    robl::ArenaMessageAllocator<QueryZonesRequest, QueryZonesResponse> query_zones_allocator_;
+};
+
+/*=========================================================================*/
+
+inline grpc::ServerUnaryReactor *GeofenceServiceImpl::LoadZones(grpc::CallbackServerContext *context,
+                                                                const LoadZonesRequest *request,
+                                                                LoadZonesResponse *response)
+{
+    auto *reactor = context->DefaultReactor();
+
+    std::lock_guard<std::mutex> load_lock(load_mutex_);
+
+    auto zones = request->replace() ? std::map<std::uint32_t, GeofenceZone>() : zones_;
+    for (const auto &zone : request->zones())
+    {
+        zones[zone.id()] = zone;
+    }
+
+    auto index = std::make_shared<robl::geometry::ZoneIndex>();
+    for (const auto &[id, zone] : zones)
+    {
+        auto error = std::string();
+        auto added = false;
+        switch (zone.geometry_case())
+        {
+        case GeofenceZone::kPolygon:
+            added = index->AddPolygon(id, zone.polygon(), &error);
+            break;
+        case GeofenceZone::kCircle:
+            added = index->AddCircle(id, zone.circle(), &error);
+            break;
+        default:
+            error = "geometry is missing";
+            break;
+        }
+
+        if (!added)
+        {
+            const auto message = "zone " + std::to_string(id) + ": " + error;
+            reactor->Finish(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, message));
+            return reactor;
+        }
+    }
+    index->Finalize();
+
+    zones_ = std::move(zones);
+    {
+        std::lock_guard<std::mutex> lock(index_mutex_);
+        index_ = std::move(index);
+        response->set_version(++version_);
+    }
+    response->set_zone_count(static_cast<std::uint32_t>(zones_.size()));
+
+    reactor->Finish(grpc::Status::OK);
+    return reactor;
+}
+
+inline grpc::ServerUnaryReactor *GeofenceServiceImpl::QueryZones(grpc::CallbackServerContext *context,
+                                                                 const QueryZonesRequest *request,
+                                                                 QueryZonesResponse *response)
+{
+    auto *reactor = context->DefaultReactor();
+
+    if (request->x_size() != request->y_size())
+    {
+        reactor->Finish(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "position columns differ in length"));
+        return reactor;
+    }
+
+    const auto snapshot = Snapshot();
+    snapshot.index->Query(request->x().data(), request->y().data(), static_cast<std::size_t>(request->x_size()),
+                          response->mutable_match_counts(), response->mutable_zone_ids());
+    response->set_version(snapshot.version);
+
+    reactor->Finish(grpc::Status::OK);
+    return reactor;
+}
+
+/*=========================================================================*/
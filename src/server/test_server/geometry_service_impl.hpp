@@ -0,0 +1,338 @@
+#pragma once
+
+// standard headers
+#include <array>
+#include <string>
+#include <vector>
+
+// grpc headers
+#include <robl/api/service.grpc.pb.h>
+
+// project headers
+#include "arena/arena_message_allocator.hpp"
+#include "geometry/matrix_view.hpp"
+#include "geometry/point_kernels.hpp"
+#include "geometry/pose.hpp"
+
+/*=========================================================================*/
+
+using robl::api::ComposePosesRequest;
+using robl::api::ComposePosesResponse;
+using robl::api::GeometryService;
+using robl::api::TransformBoxesRequest;
+using robl::api::TransformBoxesResponse;
+using robl::api::TransformPointsRequest;
+using robl::api::TransformPointsResponse;
+using robl::api::TransformPolygonsRequest;
+using robl::api::TransformPolygonsResponse;
+
+/*=========================================================================*/
+
+/**
+ * @class GeometryServiceImpl
+ * @brief Batch geometry transforms served through the callback API.
+ *
+ * Points travel as packed float columns, so the columns of a parsed request are used as is by the SIMD kernels and
+ * the results are written straight into the columns of the response. Poses are composed in double precision.
+ *
+ * A TransformPoints batch holds at most kMaxTransformPoints points, so that it fits the receive limit of the server.
+ * Larger point sets are streamed through TransformPointStream, one batch at a time, with the next batch read only
+ * once the last one is written, so a stream holds a single batch in memory.
+ */
+class GeometryServiceImpl final : public GeometryService::CallbackService
+{
+public:
+    // 48 MB of float columns, below the 64 MB receive limit of test_server.
+    static constexpr int kMaxTransformPoints = 4 * 1024 * 1024;
+
+    GeometryServiceImpl(void)
+        : transform_points_allocator_(64 * 1024, 64 * 1024 * 1024)
+    {
+        SetMessageAllocatorFor_TransformPoints(&transform_points_allocator_);
+        SetMessageAllocatorFor_ComposePoses(&compose_poses_allocator_);
+        SetMessageAllocatorFor_TransformBoxes(&transform_boxes_allocator_);
+        SetMessageAllocatorFor_TransformPolygons(&transform_polygons_allocator_);
+    }
+
+    // GeometryService rpc methods
+    grpc::ServerUnaryReactor *TransformPoints(grpc::CallbackServerContext *context,
+                                              const TransformPointsRequest *request,
+                                              TransformPointsResponse *response) override;
+    grpc::ServerBidiReactor<TransformPointsRequest, TransformPointsResponse> *TransformPointStream(
+        grpc::CallbackServerContext *) override;
+    grpc::ServerUnaryReactor *ComposePoses(grpc::CallbackServerContext *context, const ComposePosesRequest *request,
+                                           ComposePosesResponse *response) override;
+    grpc::ServerUnaryReactor *TransformBoxes(grpc::CallbackServerContext *context,
+                                             const TransformBoxesRequest *request,
+                                             TransformBoxesResponse *response) override;
+    grpc::ServerUnaryReactor *TransformPolygons(grpc::CallbackServerContext *context,
+                                                const TransformPolygonsRequest *request,
+                                                TransformPolygonsResponse *response) override;
+
+private:
+    class TransformPointStreamReactor;
+
+    /**
+     * Transforms the points of a batch with the pose, into the columns of the response.
+     */
+    static grpc::Status TransformBatch(const robl::geometry::Pose3 &pose, const robl::api::PointBatch &points,
+                                       TransformPointsResponse *response);
+
+    robl::ArenaMessageAllocator<TransformPointsRequest, TransformPointsResponse> transform_points_allocator_;
+    robl::ArenaMessageAllocator<ComposePosesRequest, ComposePosesResponse> compose_poses_allocator_;
+    robl::ArenaMessageAllocator<TransformBoxesRequest, TransformBoxesResponse> transform_boxes_allocator_;
+    robl::ArenaMessageAllocator<TransformPolygonsRequest, TransformPolygonsResponse> transform_polygons_allocator_;
+};
+
+/*=========================================================================*/
+
+inline grpc::ServerUnaryReactor *GeometryServiceImpl::TransformPoints(grpc::CallbackServerContext *context,
+                                                                      const TransformPointsRequest *request,
+                                                                      TransformPointsResponse *response)
+{
+    auto *reactor = context->DefaultReactor();
+
+    auto pose = robl::geometry::Pose3();
+    if (!robl::geometry::Pose3::FromProto(request->target_tform_source(), &pose))
+    {
+        reactor->Finish(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "target_tform_source has no valid rotation"));
+        return reactor;
+    }
+
+    reactor->Finish(TransformBatch(pose, request->points(), response));
+    return reactor;
+}
+
+/**
+ * @class GeometryServiceImpl::TransformPointStreamReactor
+ * @brief Transforms the batches of a stream one by one: a batch is read, transformed and written before the next one
+ * is read.
+ */
+class GeometryServiceImpl::TransformPointStreamReactor final
+    : public grpc::ServerBidiReactor<TransformPointsRequest, TransformPointsResponse>
+{
+public:
+    TransformPointStreamReactor(void)
+        : has_pose_(false)
+    {
+        StartRead(&request_);
+    }
+
+    void OnReadDone(bool ok) override
+    {
+        if (!ok)
+        {
+            Finish(grpc::Status::OK);
+            return;
+        }
+
+        if (request_.has_target_tform_source())
+        {
+            if (!robl::geometry::Pose3::FromProto(request_.target_tform_source(), &pose_))
+            {
+                Finish(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "target_tform_source has no valid rotation"));
+                return;
+            }
+            has_pose_ = true;
+        }
+        else if (!has_pose_)
+        {
+            Finish(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "the first batch has no target_tform_source"));
+            return;
+        }
+
+        const auto status = TransformBatch(pose_, request_.points(), &response_);
+        if (!status.ok())
+        {
+            Finish(status);
+            return;
+        }
+        StartWrite(&response_);
+    }
+
+    void OnWriteDone(bool ok) override
+    {
+        if (!ok)
+        {
+            Finish(grpc::Status(grpc::StatusCode::UNAVAILABLE, "the stream is broken"));
+            return;
+        }
+        StartRead(&request_);
+    }
+
+    void OnDone(void) override
+    {
+        delete this;
+    }
+
+private:
+    TransformPointsRequest request_;
+    TransformPointsResponse response_;
+    robl::geometry::Pose3 pose_;
+    bool has_pose_;
+};
+
+inline grpc::ServerBidiReactor<TransformPointsRequest, TransformPointsResponse> *GeometryServiceImpl::
+    TransformPointStream(grpc::CallbackServerContext *)
+{
+    return new TransformPointStreamReactor();
+}
+
+inline grpc::Status GeometryServiceImpl::TransformBatch(const robl::geometry::Pose3 &pose,
+                                                        const robl::api::PointBatch &points,
+                                                        TransformPointsResponse *response)
+{
+    const auto count = points.x_size();
+    if (points.y_size() != count || points.z_size() != count)
+    {
+        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "point columns differ in length");
+    }
+    if (count > kMaxTransformPoints)
+    {
+        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                            "a batch holds at most " + std::to_string(kMaxTransformPoints) + " points");
+    }
+
+    auto *out = response->mutable_points();
+    out->mutable_x()->Resize(count, 0.0f);
+    out->mutable_y()->Resize(count, 0.0f);
+    out->mutable_z()->Resize(count, 0.0f);
+    robl::geometry::TransformPoints(pose, points.x().data(), points.y().data(), points.z().data(),
+                                    out->mutable_x()->mutable_data(), out->mutable_y()->mutable_data(),
+                                    out->mutable_z()->mutable_data(), static_cast<std::size_t>(count));
+    return grpc::Status::OK;
+}
+
+inline grpc::ServerUnaryReactor *GeometryServiceImpl::ComposePoses(grpc::CallbackServerContext *context,
+                                                                   const ComposePosesRequest *request,
+                                                                   ComposePosesResponse *response)
+{
+    auto *reactor = context->DefaultReactor();
+
+    if (request->return_prefixes())
+    {
+        response->mutable_prefixes()->Reserve(request->poses_size());
+    }
+
+    auto composed = robl::geometry::Pose3();
+    for (const auto &pose_msg : request->poses())
+    {
+        auto pose = robl::geometry::Pose3();
+        if (!robl::geometry::Pose3::FromProto(pose_msg, &pose))
+        {
+            reactor->Finish(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "a pose has no valid rotation"));
+            return reactor;
+        }
+
+        composed = composed * pose;
+        if (request->return_prefixes())
+        {
+            composed.ToProto(response->add_prefixes());
+        }
+    }
+    composed.ToProto(response->mutable_composed());
+
+    if (request->return_matrix())
+    {
+        // The columns of the rotation are the images of the axes under the rotation alone, in double precision.
+        auto rotation = composed;
+        rotation.tx = rotation.ty = rotation.tz = 0.0;
+        auto matrix = robl::geometry::MatrixView<double>();
+        robl::geometry::ResizeMatrix(response->mutable_composed_matrix(), 4, 4, &matrix);
+        for (auto col = std::size_t(0); col < 3; ++col)
+        {
+            auto axis = std::array<double, 3>();
+            axis[col] = 1.0;
+            rotation.Apply(axis[0], axis[1], axis[2], &matrix(0, col), &matrix(1, col), &matrix(2, col));
+        }
+        matrix(0, 3) = composed.tx;
+        matrix(1, 3) = composed.ty;
+        matrix(2, 3) = composed.tz;
+        matrix(3, 3) = 1.0;
+    }
+
+    reactor->Finish(grpc::Status::OK);
+    return reactor;
+}
+
+inline grpc::ServerUnaryReactor *GeometryServiceImpl::TransformBoxes(grpc::CallbackServerContext *context,
+                                                                     const TransformBoxesRequest *request,
+                                                                     TransformBoxesResponse *response)
+{
+    auto *reactor = context->DefaultReactor();
+
+    auto target_tform_source = robl::geometry::Pose3();
+    if (!robl::geometry::Pose3::FromProto(request->target_tform_source(), &target_tform_source))
+    {
+        reactor->Finish(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "target_tform_source has no valid rotation"));
+        return reactor;
+    }
+
+    response->mutable_boxes()->Reserve(request->boxes_size());
+    for (const auto &box : request->boxes())
+    {
+        auto source_tform_box = robl::geometry::Pose3();
+        if (!robl::geometry::Pose3::FromProto(box.frame_name_tform_box(), &source_tform_box))
+        {
+            reactor->Finish(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "a box has no valid rotation"));
+            return reactor;
+        }
+
+        auto *out = response->add_boxes();
+        *out->mutable_box() = box.box();
+        out->set_frame_name(request->target_frame_name());
+        (target_tform_source * source_tform_box).ToProto(out->mutable_frame_name_tform_box());
+    }
+
+    reactor->Finish(grpc::Status::OK);
+    return reactor;
+}
+
+inline grpc::ServerUnaryReactor *GeometryServiceImpl::TransformPolygons(grpc::CallbackServerContext *context,
+                                                                        const TransformPolygonsRequest *request,
+                                                                        TransformPolygonsResponse *response)
+{
+    auto *reactor = context->DefaultReactor();
+
+    // Pack the vertices of every polygon into two columns, so the whole request runs through the kernel at once.
+    auto vertex_count = std::size_t(0);
+    for (const auto &polygon : request->polygons())
+    {
+        vertex_count += polygon.vertices_size();
+    }
+
+    auto x = std::vector<float>(vertex_count);
+    auto y = std::vector<float>(vertex_count);
+    auto i = std::size_t(0);
+    for (const auto &polygon : request->polygons())
+    {
+        for (const auto &vertex : polygon.vertices())
+        {
+            x[i] = vertex.x();
+            y[i] = vertex.y();
+            ++i;
+        }
+    }
+
+    const auto pose = robl::geometry::Pose2::FromProto(request->target_tform_source());
+    robl::geometry::TransformPoints(pose, x.data(), y.data(), x.data(), y.data(), vertex_count);
+
+    i = 0;
+    response->mutable_polygons()->Reserve(request->polygons_size());
+    for (const auto &polygon : request->polygons())
+    {
+        auto *out = response->add_polygons();
+        out->mutable_vertices()->Reserve(polygon.vertices_size());
+        for (auto j = 0; j < polygon.vertices_size(); ++j, ++i)
+        {
+            auto *vertex = out->add_vertices();
+            vertex->set_x(x[i]);
+            vertex->set_y(y[i]);
+        }
+    }
+
+    reactor->Finish(grpc::Status::OK);
+    return reactor;
+}
+
+/*=========================================================================*/
@@ -1,5 +1,4 @@
 // standard headers
-#include <fstream>
 #include <iostream>
 #include <memory>
 #include <string>
@@ -9,46 +8,83 @@
 #include <grpcpp/grpcpp.h>
 
 // project headers
+#include "admission/admission_interceptor.hpp"
+#include "channel/local_transport.hpp"
+#include "channel/tls_credentials.hpp"
+#include "geofence_service_impl.hpp"
+#include "geometry_service_impl.hpp"
+#include "metrics/metrics_endpoint.hpp"
+#include "metrics/rpc_interceptors.hpp"
+#include "point_cloud_service_impl.hpp"
 #include "test_service_impl.hpp"
+#include "trace/trace_dumper.hpp"
+#include "trace/trace_interceptors.hpp"
+#include "version_service_impl.hpp"
 
 using grpc::Server;
 using grpc::ServerBuilder;
 
-std::string ReadTextFile(const std::string &filename)
-{
-    std::ifstream file(filename.c_str(), std::ios::in);
-    std::stringstream ss;
-    if (file.is_open())
-    {
-        ss << file.rdbuf();
-        file.close();
-    }
-
-    return ss.str();
-}
-
 void RunServer()
 {
     const auto &server_address = std::string("localhost:50051");
     auto test_service = std::make_shared<TestServiceImpl>();
+    auto geometry_service = std::make_shared<GeometryServiceImpl>();
+    auto geofence_service = std::make_shared<GeofenceServiceImpl>();
+    auto point_cloud_service = std::make_shared<PointCloudServiceImpl>();
+    auto version_service = std::make_shared<VersionServiceImpl>();
 
     auto creds = grpc::InsecureServerCredentials();
     auto use_ssl = true;
     if (use_ssl)
     {
-        auto ssl_opts = grpc::SslServerCredentialsOptions();
-        ssl_opts.pem_key_cert_pairs.push_back(
-            { ReadTextFile("../../../auth/server.key"), ReadTextFile("../../../auth/server.crt") });
-        creds = grpc::SslServerCredentials(ssl_opts);
+        // The key and the certificate are read again when they change, so they rotate without a restart.
+        creds = robl::ReloadingServerCredentials("../../../auth/server.key", "../../../auth/server.crt");
     }
 
+    // Bounds the handler threads of the streams and the memory of the calls, so a burst is turned away instead of
+    // queueing up.
+    grpc::ResourceQuota quota("test_server");
+    quota.SetMaxThreads(512);
+    quota.Resize(1024 * 1024 * 1024);
+
     ServerBuilder builder;
-    builder.AddListeningPort(server_address, creds);
+    const auto unix_path = robl::AddListeningPorts(builder, server_address, creds);
+    if (!unix_path.empty())
+    {
+        test_service->AcceptDescriptors(robl::DescriptorSocketPath(server_address));
+    }
+    builder.SetResourceQuota(quota);
     builder.RegisterService(test_service.get());
+    builder.RegisterService(geometry_service.get());
+    builder.RegisterService(geofence_service.get());
+    builder.RegisterService(point_cloud_service.get());
+    builder.RegisterService(version_service.get());
+    // Point batches of a million points are about 12 MB on the wire.
+    builder.SetMaxReceiveMessageSize(64 * 1024 * 1024);
+
+    // Holds the admission of every call until it completes, counts every call by method, and traces it while tracing
+    // is on.
+    auto interceptors = robl::ServerMetricsInterceptors();
+    interceptors.insert(interceptors.begin(), std::make_unique<robl::AdmissionServerInterceptorFactory>());
+    interceptors.push_back(std::make_unique<robl::TraceServerInterceptorFactory>());
+    builder.experimental().SetInterceptorCreators(std::move(interceptors));
 
     auto server = builder.BuildAndStart();
-    std::cout << "Server listening on " << server_address << std::endl;
+    robl::LocalServers::Instance().Add(server_address, server.get());
+    const auto metrics = robl::ServeMetrics(server_address);
+    const auto traces = robl::DumpTracesOnSignal();
+    std::cout << "Server listening on " << server_address << (unix_path.empty() ? "" : " and unix:" + unix_path)
+              << std::endl;
+    if (metrics != nullptr)
+    {
+        std::cout << "Metrics at http://" << robl::MetricsAddress(server_address) << "/metrics" << std::endl;
+    }
+    if (traces != nullptr)
+    {
+        std::cout << "Traces dump on SIGUSR1, and tracing turns on and off on SIGUSR2" << std::endl;
+    }
     server->Wait();
+    robl::LocalServers::Instance().Remove(server_address);
 }
 
 int main()
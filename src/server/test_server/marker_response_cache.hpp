@@ -0,0 +1,238 @@
+#pragma once
+
+// standard headers
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// grpc headers
+#include <grpcpp/support/byte_buffer.h>
+
+/*=========================================================================*/
+
+/**
+ * @class MarkerResponseCache
+ * @brief A sharded LRU cache of serialized GetMarker responses.
+ *
+ * Entries are keyed by the marker id, the canonical form of the request mask and the marker store version, and hold
+ * the response as a grpc::ByteBuffer. Handing a cached response out only takes a reference on its slices, so a hit is
+ * neither serialized nor copied again.
+ *
+ * The memory budget is split evenly across the shards, and every shard evicts its least recently used entries to stay
+ * under its share.
+ */
+class MarkerResponseCache
+{
+public:
+    struct Key
+    {
+        std::uint32_t id;
+        std::string mask; // canonical form, empty if the request has no mask
+        std::uint64_t version;
+
+        bool operator==(const Key &other) const
+        {
+            return id == other.id && version == other.version && mask == other.mask;
+        }
+    };
+
+    struct Stats
+    {
+        std::uint64_t hits;
+        std::uint64_t misses;
+        std::uint64_t evictions;
+        std::size_t entries;
+        std::size_t bytes;
+        std::size_t capacity_bytes;
+
+        double HitRatio(void) const
+        {
+            const auto lookups = hits + misses;
+            return lookups > 0 ? static_cast<double>(hits) / lookups : 0.0;
+        }
+    };
+
+    /**
+     * @param capacity_bytes The memory budget of the whole cache, including the keys.
+     * @param shard_count The number of independently locked shards.
+     */
+    explicit MarkerResponseCache(std::size_t capacity_bytes = 64 * 1024 * 1024, std::size_t shard_count = 16)
+        : capacity_bytes_(capacity_bytes)
+        , shards_(shard_count)
+        , hits_(0)
+        , misses_(0)
+        , evictions_(0)
+    {
+    }
+
+    /**
+     * Looks up a response. On a hit, the response buffer shares the slices of the cached one.
+     *
+     * @param key The cache key.
+     * @param response The buffer to be filled in.
+     * @return true on a hit, false otherwise.
+     */
+    bool Lookup(const Key &key, grpc::ByteBuffer *response);
+
+    /**
+     * Inserts a response, evicting the least recently used entries of the shard if it is over budget. Responses larger
+     * than the budget of a shard are not cached.
+     *
+     * @param key The cache key.
+     * @param response The serialized response.
+     */
+    void Insert(Key key, const grpc::ByteBuffer &response);
+
+    /**
+     * Drops every entry which was built from a marker store older than the given version.
+     *
+     * @param version The current marker store version.
+     */
+    void Invalidate(std::uint64_t version);
+
+    /**
+     * Returns a snapshot of the cache counters.
+     */
+    Stats GetStats(void) const;
+
+private:
+    struct KeyHash
+    {
+        std::size_t operator()(const Key &key) const
+        {
+            auto seed = std::hash<std::string>()(key.mask);
+            seed ^= std::hash<std::uint64_t>()((static_cast<std::uint64_t>(key.id) << 32) ^ key.version) + 0x9e3779b9 +
+                    (seed << 6) + (seed >> 2);
+            return seed;
+        }
+    };
+
+    struct Entry
+    {
+        Key key;
+        grpc::ByteBuffer response;
+        std::size_t bytes;
+    };
+
+    struct alignas(64) Shard
+    {
+        mutable std::mutex mutex;
+        std::list<Entry> lru; // most recently used first
+        std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+        std::size_t bytes = 0;
+    };
+
+    Shard &ShardOf(const Key &key)
+    {
+        const auto hash = KeyHash()(key);
+        return shards_[hash % shards_.size()];
+    }
+
+    static std::size_t EntryBytes(const Key &key, const grpc::ByteBuffer &response)
+    {
+        // The key is stored twice, in the list and in the map. The nodes are charged as a flat overhead.
+        return response.Length() + 2 * key.mask.size() + 128;
+    }
+
+    std::size_t capacity_bytes_;
+    std::vector<Shard> shards_;
+    std::atomic<std::uint64_t> hits_;
+    std::atomic<std::uint64_t> misses_;
+    std::atomic<std::uint64_t> evictions_;
+};
+
+/*=========================================================================*/
+
+inline bool MarkerResponseCache::Lookup(const Key &key, grpc::ByteBuffer *response)
+{
+    auto &shard = ShardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    const auto it = shard.index.find(key);
+    if (it == shard.index.end())
+    {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    *response = it->second->response;
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+inline void MarkerResponseCache::Insert(Key key, const grpc::ByteBuffer &response)
+{
+    const auto bytes = EntryBytes(key, response);
+    const auto shard_capacity = capacity_bytes_ / shards_.size();
+    if (bytes > shard_capacity)
+    {
+        return;
+    }
+
+    auto &shard = ShardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    if (shard.index.count(key) > 0)
+    {
+        return;
+    }
+
+    while (!shard.lru.empty() && shard.bytes + bytes > shard_capacity)
+    {
+        shard.bytes -= shard.lru.back().bytes;
+        shard.index.erase(shard.lru.back().key);
+        shard.lru.pop_back();
+        evictions_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    shard.lru.push_front(Entry{ std::move(key), response, bytes });
+    shard.index.emplace(shard.lru.front().key, shard.lru.begin());
+    shard.bytes += bytes;
+}
+
+inline void MarkerResponseCache::Invalidate(std::uint64_t version)
+{
+    for (auto &shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto it = shard.lru.begin(); it != shard.lru.end();)
+        {
+            if (it->key.version >= version)
+            {
+                ++it;
+                continue;
+            }
+
+            shard.bytes -= it->bytes;
+            shard.index.erase(it->key);
+            it = shard.lru.erase(it);
+        }
+    }
+}
+
+inline MarkerResponseCache::Stats MarkerResponseCache::GetStats(void) const
+{
+    auto stats = Stats{ hits_.load(std::memory_order_relaxed),
+                        misses_.load(std::memory_order_relaxed),
+                        evictions_.load(std::memory_order_relaxed),
+                        0,
+                        0,
+                        capacity_bytes_ };
+
+    for (const auto &shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        stats.entries += shard.lru.size();
+        stats.bytes += shard.bytes;
+    }
+
+    return stats;
+}
+
+/*=========================================================================*/
@@ -0,0 +1,258 @@
+#pragma once
+
+// standard headers
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+// grpc headers
+#include <robl/api/test.pb.h>
+
+/*=========================================================================*/
+
+/**
+ * @class MarkerStore
+ * @brief An in-memory marker table indexed by marker id.
+ *
+ * Markers are kept in a single vector sorted by id, so a lookup is a binary search and a bulk update is one merge of
+ * the sorted batch into the table. Every applied batch bumps the store version.
+ */
+class MarkerStore
+{
+public:
+    MarkerStore(void)
+        : version_(0)
+    {
+    }
+
+    /**
+     * Checks whether the marker can be stored. On failure, the reason is written to the error string.
+     *
+     * @param marker The marker to be validated.
+     * @param error The reason of the failure.
+     * @return true if the marker is valid, false otherwise.
+     */
+    static bool Validate(const robl::api::Marker &marker, std::string *error);
+
+    /**
+     * Merges the batch into the store with a single pass over the table. Markers whose id already exists replace the
+     * stored ones; if the batch contains the same id more than once, the last one wins. The markers are copied, so the
+     * batch may point into an arena that is reset right after this call.
+     *
+     * @param batch The validated markers to be applied. The vector is reordered by this method.
+     * @return The store version after the batch is applied.
+     */
+    std::uint64_t ApplyBatch(std::vector<const robl::api::Marker *> &batch);
+
+    /**
+     * Looks up a marker by id.
+     *
+     * @param id The id of the marker.
+     * @param marker The marker to be filled in.
+     * @param version If not null, the store version the marker was read at.
+     * @return true if the marker exists, false otherwise.
+     */
+    bool Find(std::uint32_t id, robl::api::Marker *marker, std::uint64_t *version = nullptr) const;
+
+    /**
+     * Copies every stored marker, in id order, and their count into the marker info.
+     *
+     * @param info The marker info to be filled in.
+     * @return The store version the markers were read at.
+     */
+    std::uint64_t Export(robl::api::MarkerInfo *info) const;
+
+    /**
+     * Returns the number of the stored markers.
+     */
+    std::size_t Size(void) const;
+
+    /**
+     * Returns the version of the store, which increases whenever a batch is applied.
+     */
+    std::uint64_t Version(void) const;
+
+    /**
+     * Sets the function called with the new store version after every applied batch, e.g. to invalidate caches
+     * built from older versions. It must be set before the store is shared between threads.
+     *
+     * @param listener The function to be called.
+     */
+    void SetUpdateListener(std::function<void(std::uint64_t)> listener);
+
+private:
+    std::function<void(std::uint64_t)> update_listener_;
+    mutable std::shared_mutex mutex_;
+    std::vector<robl::api::Marker> markers_;
+    std::uint64_t version_;
+};
+
+/*=========================================================================*/
+
+inline bool MarkerStore::Validate(const robl::api::Marker &marker, std::string *error)
+{
+    if (!marker.has_id())
+    {
+        *error = "id is missing";
+        return false;
+    }
+
+    const auto &coordinate = marker.coordinate();
+    if (!(coordinate.latitude() >= -90.0 && coordinate.latitude() <= 90.0))
+    {
+        *error = "latitude is out of range";
+        return false;
+    }
+    if (!(coordinate.longitude() >= -180.0 && coordinate.longitude() <= 180.0))
+    {
+        *error = "longitude is out of range";
+        return false;
+    }
+    if (!std::isfinite(marker.radius()) || marker.radius() < 0.0f)
+    {
+        *error = "radius is negative or not finite";
+        return false;
+    }
+
+    return true;
+}
+
+inline std::uint64_t MarkerStore::ApplyBatch(std::vector<const robl::api::Marker *> &batch)
+{
+    const auto by_id = [](const robl::api::Marker *lhs, const robl::api::Marker *rhs) { return lhs->id() < rhs->id(); };
+
+    // Sort the batch and keep only the last occurrence of each id.
+    std::stable_sort(batch.begin(), batch.end(), by_id);
+    auto unique_end = batch.begin();
+    for (auto it = batch.begin(); it != batch.end(); ++it)
+    {
+        if (unique_end != batch.begin() && (*(unique_end - 1))->id() == (*it)->id())
+        {
+            *(unique_end - 1) = *it;
+        }
+        else
+        {
+            *unique_end++ = *it;
+        }
+    }
+    batch.erase(unique_end, batch.end());
+
+    auto lock = std::unique_lock<std::shared_mutex>(mutex_);
+
+    // Count the ids which are not in the table yet, so the table grows exactly once.
+    auto added = std::size_t(0);
+    auto stored = markers_.cbegin();
+    for (const auto *marker : batch)
+    {
+        while (stored != markers_.cend() && stored->id() < marker->id())
+        {
+            ++stored;
+        }
+        if (stored == markers_.cend() || stored->id() != marker->id())
+        {
+            ++added;
+        }
+    }
+
+    // Merge backwards in place, so every stored marker is moved at most once.
+    auto read = markers_.size();
+    auto write = markers_.size() + added;
+    markers_.resize(write);
+
+    auto next = batch.size();
+    while (next > 0)
+    {
+        if (write == read)
+        {
+            // No new ids are left, so the rest of the batch only replaces markers which are already in place.
+            for (auto i = std::size_t(0); i < next; ++i)
+            {
+                const auto it = std::lower_bound(
+                    markers_.begin(), markers_.begin() + read, batch[i]->id(),
+                    [](const robl::api::Marker &lhs, std::uint32_t id) { return lhs.id() < id; });
+                it->CopyFrom(*batch[i]);
+            }
+            break;
+        }
+
+        const auto *marker = batch[next - 1];
+        if (read > 0 && markers_[read - 1].id() > marker->id())
+        {
+            markers_[--write] = std::move(markers_[--read]);
+            continue;
+        }
+        if (read > 0 && markers_[read - 1].id() == marker->id())
+        {
+            --read;
+        }
+        markers_[--write].CopyFrom(*marker);
+        --next;
+    }
+
+    const auto version = ++version_;
+    lock.unlock();
+
+    if (update_listener_)
+    {
+        update_listener_(version);
+    }
+    return version;
+}
+
+inline bool MarkerStore::Find(std::uint32_t id, robl::api::Marker *marker, std::uint64_t *version) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+
+    if (version != nullptr)
+    {
+        *version = version_;
+    }
+
+    const auto it = std::lower_bound(markers_.cbegin(), markers_.cend(), id,
+                                     [](const robl::api::Marker &lhs, std::uint32_t id) { return lhs.id() < id; });
+    if (it == markers_.cend() || it->id() != id)
+    {
+        return false;
+    }
+
+    marker->CopyFrom(*it);
+    return true;
+}
+
+inline std::uint64_t MarkerStore::Export(robl::api::MarkerInfo *info) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+
+    auto *markers = info->mutable_markers();
+    markers->Reserve(static_cast<int>(markers_.size()));
+    for (const auto &marker : markers_)
+    {
+        markers->Add()->CopyFrom(marker);
+    }
+    info->set_total_count(static_cast<std::uint32_t>(markers_.size()));
+    return version_;
+}
+
+inline std::size_t MarkerStore::Size(void) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return markers_.size();
+}
+
+inline std::uint64_t MarkerStore::Version(void) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return version_;
+}
+
+inline void MarkerStore::SetUpdateListener(std::function<void(std::uint64_t)> listener)
+{
+    update_listener_ = std::move(listener);
+}
+
+/*=========================================================================*/
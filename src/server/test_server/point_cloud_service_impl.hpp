@@ -0,0 +1,176 @@
+#pragma once
+
+// standard headers
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+// grpc headers
+#include <robl/api/service.grpc.pb.h>
+
+// project headers
+#include "admission/admission_controller.hpp"
+#include "pointcloud/point_cloud_codec.hpp"
+
+/*=========================================================================*/
+
+using robl::api::PointCloudChunk;
+using robl::api::PointCloudService;
+using robl::api::PoseChunk;
+using robl::api::StreamPointCloudRequest;
+using robl::api::StreamPosesRequest;
+
+/*=========================================================================*/
+
+/**
+ * @class PointCloudServiceImpl
+ * @brief Streams synthetic point clouds and trajectories as columnar chunks.
+ *
+ * The data is generated once per call into aligned columns, and every chunk is encoded straight from them into a
+ * single chunk message which is reused for the whole stream. A call holds its whole data set, so the counts a client
+ * may ask for are capped and only two calls of each method run at once, which bounds the columns of all the calls in
+ * flight to about 300 MB.
+ */
+class PointCloudServiceImpl final : public PointCloudService::Service
+{
+public:
+    // 96 MB of point columns and 56 MB of pose columns.
+    static constexpr std::uint32_t kMaxPointCount = 8 * 1024 * 1024;
+    static constexpr std::uint32_t kMaxPoseCount = 2 * 1024 * 1024;
+
+    PointCloudServiceImpl(void)
+        : admission_(AdmissionOptions())
+    {
+    }
+
+    // PointCloudService rpc methods
+    grpc::Status StreamPointCloud(grpc::ServerContext *context, const StreamPointCloudRequest *request,
+                                  grpc::ServerWriter<PointCloudChunk> *writer) override;
+    grpc::Status StreamPoses(grpc::ServerContext *context, const StreamPosesRequest *request,
+                             grpc::ServerWriter<PoseChunk> *writer) override;
+
+private:
+    static robl::AdmissionController::Options AdmissionOptions(void);
+
+    static constexpr auto default_chunk_size = std::uint32_t(65536);
+
+    robl::AdmissionController admission_;
+};
+
+/*=========================================================================*/
+
+inline robl::AdmissionController::Options PointCloudServiceImpl::AdmissionOptions(void)
+{
+    auto options = robl::AdmissionController::Options();
+    options.method_limits["StreamPointCloud"] = robl::AdmissionController::FixedLimit(2, std::chrono::seconds(1));
+    options.method_limits["StreamPoses"] = robl::AdmissionController::FixedLimit(2, std::chrono::seconds(1));
+    return options;
+}
+
+inline grpc::Status PointCloudServiceImpl::StreamPointCloud(grpc::ServerContext *context,
+                                                            const StreamPointCloudRequest *request,
+                                                            grpc::ServerWriter<PointCloudChunk> *writer)
+{
+    if (request->point_count() > kMaxPointCount)
+    {
+        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                            "point_count is above " + std::to_string(kMaxPointCount));
+    }
+
+    const auto ticket = admission_.Admit("StreamPointCloud");
+    if (!ticket.Admitted())
+    {
+        return ticket.Reject(context);
+    }
+
+    // A spinning lidar scan: rings of points ordered by azimuth.
+    constexpr auto rings = std::size_t(32);
+    const auto count = std::size_t(request->point_count());
+    const auto per_ring = std::max<std::size_t>(1, count / rings);
+
+    auto points = robl::pointcloud::PointColumns();
+    points.Resize(count);
+    for (auto i = std::size_t(0); i < count; ++i)
+    {
+        const auto ring = static_cast<double>(i / per_ring);
+        const auto azimuth = 2.0 * M_PI * static_cast<double>(i % per_ring) / per_ring;
+        const auto range = 10.0 + 2.0 * std::sin(azimuth * 7.0) + 0.3 * ring;
+        const auto elevation = (ring - rings / 2) * 0.02;
+        points.x[i] = static_cast<float>(range * std::cos(elevation) * std::cos(azimuth));
+        points.y[i] = static_cast<float>(range * std::cos(elevation) * std::sin(azimuth));
+        points.z[i] = static_cast<float>(range * std::sin(elevation));
+    }
+
+    const auto chunk_size = std::size_t(request->chunk_size() > 0 ? request->chunk_size() : default_chunk_size);
+    auto chunk = PointCloudChunk();
+    auto error = std::string();
+    for (auto begin = std::size_t(0); begin < count && !context->IsCancelled(); begin += chunk_size)
+    {
+        const auto size = std::min(chunk_size, count - begin);
+        if (!robl::pointcloud::EncodePointCloud(points, begin, size, request->format(), &chunk, &error))
+        {
+            return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, error);
+        }
+        if (!writer->Write(chunk))
+        {
+            break;
+        }
+    }
+
+    return grpc::Status::OK;
+}
+
+inline grpc::Status PointCloudServiceImpl::StreamPoses(grpc::ServerContext *context, const StreamPosesRequest *request,
+                                                       grpc::ServerWriter<PoseChunk> *writer)
+{
+    if (request->pose_count() > kMaxPoseCount)
+    {
+        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "pose_count is above " + std::to_string(kMaxPoseCount));
+    }
+
+    const auto ticket = admission_.Admit("StreamPoses");
+    if (!ticket.Admitted())
+    {
+        return ticket.Reject(context);
+    }
+
+    // A trajectory driving around a circle at 100 Hz and 1 m/s.
+    const auto count = std::size_t(request->pose_count());
+
+    auto poses = robl::pointcloud::PoseColumns();
+    poses.Resize(count);
+    for (auto i = std::size_t(0); i < count; ++i)
+    {
+        const auto yaw = 0.0005 * static_cast<double>(i);
+        poses.tx[i] = static_cast<float>(20.0 * std::sin(yaw));
+        poses.ty[i] = static_cast<float>(20.0 * (1.0 - std::cos(yaw)));
+        poses.tz[i] = 0.0f;
+        poses.qx[i] = 0.0f;
+        poses.qy[i] = 0.0f;
+        poses.qz[i] = static_cast<float>(std::sin(yaw / 2.0));
+        poses.qw[i] = static_cast<float>(std::cos(yaw / 2.0));
+    }
+
+    const auto chunk_size = std::size_t(request->chunk_size() > 0 ? request->chunk_size() : default_chunk_size);
+    auto chunk = PoseChunk();
+    auto error = std::string();
+    for (auto begin = std::size_t(0); begin < count && !context->IsCancelled(); begin += chunk_size)
+    {
+        const auto size = std::min(chunk_size, count - begin);
+        if (!robl::pointcloud::EncodePoses(poses, begin, size, request->position_format(), request->rotation_format(),
+                                           &chunk, &error))
+        {
+            return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, error);
+        }
+        if (!writer->Write(chunk))
+        {
+            break;
+        }
+    }
+
+    return grpc::Status::OK;
+}
+
+/*=========================================================================*/
@@ -2,11 +2,21 @@
 
 // standard headers
 #include <cassert>
+#include <cerrno>
+#include <cstdint>
 #include <cstdio>
 #include <filesystem>
-#include <fstream>
 #include <sstream>
 #include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// project headers
+#include "shm/shared_memory.hpp"
+#include "shm/unique_fd.hpp"
+#include "trace/tracer.hpp"
 
 /*=========================================================================*/
 
@@ -28,28 +38,29 @@ public:
      */
     void OpenIfNecessary(const std::filesystem::path &name)
     {
-        if (ofs_.is_open())
+        if (fd_.Valid())
         {
             return;
         }
 
-        std::ofstream ofs;
-        ofs.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        name_ = name;
+        no_space_ = false;
+        permission_error_ = false;
 
         try
         {
             std::filesystem::create_directories(name.parent_path());
-            ofs.open(name, std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
         }
         catch (const std::system_error &ex)
         {
             RaiseError("opening", ex);
         }
 
-        ofs_ = std::move(ofs);
-        name_ = name;
-        no_space_ = false;
-        permission_error_ = false;
+        fd_.Reset(open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644));
+        if (!fd_.Valid())
+        {
+            RaiseError("opening", std::system_error(errno, std::system_category()));
+        }
         return;
     }
 
@@ -61,24 +72,57 @@ public:
      */
     void Write(std::string &data)
     {
-        try
-        {
-            ofs_ << data;
-        }
-        catch (const std::system_error &ex)
+        auto zone = robl::TraceZone("file", "write");
+        zone.SetValue(data.size());
+
+        auto written = std::size_t(0);
+        while (written < data.size())
         {
-            if (ofs_.is_open())
+            const auto result = write(fd_.Get(), data.data() + written, data.size() - written);
+            if (result < 0 && errno != EINTR)
             {
-                ofs_.close();
+                Discard("writing to", std::system_error(errno, std::system_category()));
             }
-            std::remove(name_.c_str()); // Best effort. We expect it to succeed, but we don't check whether it did
-            RaiseError("writing to", ex);
+            written += result > 0 ? result : 0;
         }
 
         data.clear();
         return;
     }
 
+    /**
+     * Appends a region of another file, copied by the kernel without passing through this process. On errors, if the
+     * source is not a regular file or a sealed memfd, and if the source ends before the region does, throws an
+     * exception derived from std::system_error.
+     *
+     * @param source The file to copy from, e.g. one a client on the same host passed.
+     * @param offset The offset of the region in the source.
+     * @param length The length of the region.
+     */
+    void CopyFrom(int source, std::uint64_t offset, std::uint64_t length)
+    {
+        auto zone = robl::TraceZone("file", "copy");
+        zone.SetValue(length);
+
+        try
+        {
+            if (!robl::IsCopySource(source))
+            {
+                throw std::system_error(std::make_error_code(std::errc::invalid_argument),
+                                        "the source is not a regular file or a sealed memfd");
+            }
+            if (robl::CopyFileRange(source, offset, length, fd_.Get()) < length)
+            {
+                throw std::system_error(std::make_error_code(std::errc::invalid_argument),
+                                        "the region ends beyond the source file");
+            }
+        }
+        catch (const std::system_error &ex)
+        {
+            Discard("copying to", ex);
+        }
+    }
+
     /**
      * Checks if there is no space left for writing.
      *
@@ -90,6 +134,14 @@ public:
     }
 
 private:
+    // Closes and removes the partly written file, then raises the error.
+    void Discard(const std::string &action_attempted, const std::system_error &err)
+    {
+        fd_.Reset();
+        std::remove(name_.c_str()); // Best effort. We expect it to succeed, but we don't check whether it did
+        RaiseError(action_attempted, err);
+    }
+
     /**
      * Raises an error with the specified action attempted and system error.
      *
@@ -123,7 +175,7 @@ private:
     }
 
     std::string name_;
-    std::ofstream ofs_;
+    robl::UniqueFd fd_;
     bool no_space_;
     bool permission_error_;
 };
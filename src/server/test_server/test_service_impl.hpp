@@ -2,20 +2,40 @@
 
 // standard headers
 #include <arpa/inet.h>
+#include <chrono>
 #include <filesystem>
+#include <map>
+#include <memory>
 #include <thread>
+#include <vector>
 
 // grpc headers
 #include <google/protobuf/util/field_mask_util.h>
+#include <grpcpp/support/proto_buffer_reader.h>
+#include <grpcpp/support/proto_buffer_writer.h>
 #include <robl/api/service.grpc.pb.h>
 
 // project headers
+#include "admission/admission_controller.hpp"
+#include "arena/arena_message_allocator.hpp"
+#include "marker_response_cache.hpp"
+#include "marker_store.hpp"
+#include "metrics/raw_methods.hpp"
 #include "sequential_file_writer.h"
+#include "shm/descriptor_channel.hpp"
+#include "shm/shared_memory.hpp"
+#include "trace/tracer.hpp"
+#include "wire/data_chunk_stream.hpp"
+#include "wire/serialize.hpp"
 
 /*=========================================================================*/
 
 using robl::api::ClientHeartBeat;
+using robl::api::DataChunk;
+using robl::api::ExportMarkersRequest;
 using robl::api::FileContent;
+using robl::api::IngestMarkersResponse;
+using robl::api::Marker;
 using robl::api::MarkerInfo;
 using robl::api::MarkerRequest;
 using robl::api::MarkerResponse;
@@ -27,34 +47,101 @@ using robl::api::TestService;
 
 /*=========================================================================*/
 
-class TestServiceImpl final : public TestService::Service
+// Unary methods are served through the callback API, so their messages come from the per-call arenas of
+// ArenaMessageAllocator. GetMarker works on raw buffers to hand out cached responses without serializing them again.
+// Streaming methods stay on the synchronous API.
+using TestServiceBase =
+    TestService::WithCallbackMethod_RegisterAccount<TestService::WithRawCallbackMethod_GetMarker<TestService::Service>>;
+
+class TestServiceImpl final : public TestServiceBase
 {
 public:
     TestServiceImpl(void)
         : root_path_(std::filesystem::current_path() / "uploads")
+        , admission_(AdmissionOptions())
     {
+        SetMessageAllocatorFor_RegisterAccount(&register_account_allocator_);
+        robl::RawMethods::Instance().Mark(robl::RpcMetrics::Side::Server, TestService::service_full_name(),
+                                          "GetMarker");
+        marker_store_.SetUpdateListener([this](std::uint64_t version) { marker_response_cache_.Invalidate(version); });
     }
 
+    /**
+     * Lets same-host clients upload by file descriptor: they pass the descriptor over the socket on the path, and the
+     * upload names regions of it instead of carrying the bytes. Returns false if the socket cannot be opened.
+     */
+    bool AcceptDescriptors(const std::string &path);
+
     // TestService rpc methods
-    grpc::Status RegisterAccount(grpc::ServerContext *context, const RegisterAccountRequest *request,
-                                 RegisterAccountResponse *response) override;
+    grpc::ServerUnaryReactor *RegisterAccount(grpc::CallbackServerContext *context,
+                                              const RegisterAccountRequest *request,
+                                              RegisterAccountResponse *response) override;
     grpc::Status HeartBeat(grpc::ServerContext *context,
                            grpc::ServerReaderWriter<ServerHeartBeat, ClientHeartBeat> *stream) override;
     grpc::Status UploadFile(grpc::ServerContext *context, grpc::ServerReaderWriter<Status, FileContent> *stream) override;
-    grpc::Status GetMarker(grpc::ServerContext *context, const MarkerRequest *request, MarkerResponse *response) override;
+    grpc::ServerUnaryReactor *GetMarker(grpc::CallbackServerContext *context, const grpc::ByteBuffer *request,
+                                        grpc::ByteBuffer *response) override;
+    grpc::Status IngestMarkers(grpc::ServerContext *context, grpc::ServerReader<MarkerInfo> *reader,
+                               IngestMarkersResponse *response) override;
+    grpc::Status ExportMarkers(grpc::ServerContext *context, const ExportMarkersRequest *request,
+                               grpc::ServerWriter<DataChunk> *writer) override;
 
 private:
+    static robl::AdmissionController::Options AdmissionOptions(void);
+
     std::filesystem::path root_path_;
+    MarkerStore marker_store_;
+    MarkerResponseCache marker_response_cache_;
+    robl::AdmissionController admission_;
+    std::unique_ptr<robl::DescriptorServer> descriptors_;
+
+    robl::ArenaMessageAllocator<RegisterAccountRequest, RegisterAccountResponse> register_account_allocator_;
 };
 
 /*=========================================================================*/
 
-inline grpc::Status TestServiceImpl::RegisterAccount(grpc::ServerContext *context, const RegisterAccountRequest *request,
-                                                     RegisterAccountResponse *response)
+inline robl::AdmissionController::Options TestServiceImpl::AdmissionOptions(void)
+{
+    // Uploads and ingestion hold a handler thread and write to disk or the store for their whole life, and an export
+    // holds a copy of the store, so only a few run at once. RegisterAccount and HeartBeat are always admitted.
+    auto options = robl::AdmissionController::Options();
+    options.method_limits["UploadFile"] = robl::AdmissionController::FixedLimit(64, std::chrono::seconds(1));
+    options.method_limits["IngestMarkers"] = robl::AdmissionController::FixedLimit(16, std::chrono::seconds(1));
+    options.method_limits["ExportMarkers"] = robl::AdmissionController::FixedLimit(4, std::chrono::seconds(1));
+    return options;
+}
+
+inline bool TestServiceImpl::AcceptDescriptors(const std::string &path)
+{
+    try
+    {
+        descriptors_ = std::make_unique<robl::DescriptorServer>(path);
+        return true;
+    }
+    catch (const std::system_error &ex)
+    {
+        std::cerr << "Same-host uploads by descriptor are off: " << ex.what() << std::endl;
+        return false;
+    }
+}
+
+inline grpc::ServerUnaryReactor *TestServiceImpl::RegisterAccount(grpc::CallbackServerContext *context,
+                                                                  const RegisterAccountRequest *request,
+                                                                  RegisterAccountResponse *response)
 {
+    auto *reactor = context->DefaultReactor();
+
+    const auto ticket = admission_.Admit("RegisterAccount", context);
+    if (!ticket.Admitted())
+    {
+        reactor->Finish(ticket.Reject(context));
+        return reactor;
+    }
+
     if (request->session_id() != -1)
     {
-        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "session_id is not -1");
+        reactor->Finish(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "session_id is not -1"));
+        return reactor;
     }
 
     response->set_result(0);
@@ -72,12 +159,19 @@ inline grpc::Status TestServiceImpl::RegisterAccount(grpc::ServerContext *contex
     }
     response->set_ip(inet_addr(request->ip_str().c_str()));
 
-    return grpc::Status::OK;
+    reactor->Finish(grpc::Status::OK);
+    return reactor;
 }
 
 inline grpc::Status TestServiceImpl::HeartBeat(grpc::ServerContext *context,
                                                grpc::ServerReaderWriter<ServerHeartBeat, ClientHeartBeat> *stream)
 {
+    const auto ticket = admission_.Admit("HeartBeat");
+    if (!ticket.Admitted())
+    {
+        return ticket.Reject(context);
+    }
+
     ServerHeartBeat serverHeartBeat;
     ClientHeartBeat clientHeartBeat;
 
@@ -104,20 +198,60 @@ inline grpc::Status TestServiceImpl::HeartBeat(grpc::ServerContext *context,
 inline grpc::Status TestServiceImpl::UploadFile(grpc::ServerContext *context,
                                                 grpc::ServerReaderWriter<Status, FileContent> *stream)
 {
+    const auto ticket = admission_.Admit("UploadFile");
+    if (!ticket.Admitted())
+    {
+        return ticket.Reject(context);
+    }
+
     FileContent content_part;
     SequentialFileWriter file_writer;
+    // The files which shared regions are copied from, by token, taken from the side channel once per upload.
+    auto sources = std::map<std::uint64_t, robl::UniqueFd>();
 
-    while (stream->Read(&content_part))
+    // The zones split the time of a chunk into waiting for it, writing it to the file and acknowledging it.
+    const auto read = [stream, &content_part]() {
+        const auto zone = robl::TraceZone("UploadFile", "read");
+        return stream->Read(&content_part);
+    };
+
+    while (read())
     {
+        const auto shared = content_part.has_shared();
+        const auto size = shared ? content_part.shared().length() : content_part.content().size();
         std::cout << "[UploadFile] name: " << content_part.name() << std::endl
-                  << "[UploadFile] content size: " << content_part.content().size() << std::endl;
+                  << "[UploadFile] content size: " << size << (shared ? " (shared)" : "") << std::endl;
+
+        auto *source = static_cast<robl::UniqueFd *>(nullptr);
+        if (shared)
+        {
+            source = &sources[content_part.shared().token()];
+            if (!source->Valid() && descriptors_ != nullptr)
+            {
+                *source = descriptors_->Duplicate(content_part.shared().token());
+                if (source->Valid() && !robl::IsCopySource(source->Get()))
+                {
+                    return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                                        "shared regions must be in a regular file or a sealed memfd");
+                }
+            }
+            if (!source->Valid())
+            {
+                return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "unknown shared region token");
+            }
+        }
 
         try
         {
             file_writer.OpenIfNecessary(root_path_ / content_part.name());
-            auto *const data = content_part.mutable_content();
-            const auto size = data->size();
-            file_writer.Write(*data);
+            if (shared)
+            {
+                file_writer.CopyFrom(source->Get(), content_part.shared().offset(), size);
+            }
+            else
+            {
+                file_writer.Write(*content_part.mutable_content());
+            }
 
             std::stringstream ss;
             ss << "Uploaded " << size << " bytes.";
@@ -125,6 +259,7 @@ inline grpc::Status TestServiceImpl::UploadFile(grpc::ServerContext *context,
             Status status;
             status.set_code(0);
             status.set_message(ss.str());
+            const auto zone = robl::TraceZone("UploadFile", "reply");
             stream->Write(status);
         }
         catch (const std::system_error &ex)
@@ -138,79 +273,189 @@ inline grpc::Status TestServiceImpl::UploadFile(grpc::ServerContext *context,
     return grpc::Status::OK;
 }
 
-inline grpc::Status TestServiceImpl::GetMarker(grpc::ServerContext *context, const MarkerRequest *request,
-                                               MarkerResponse *response)
+inline grpc::ServerUnaryReactor *TestServiceImpl::GetMarker(grpc::CallbackServerContext *context,
+                                                            const grpc::ByteBuffer *request, grpc::ByteBuffer *response)
 {
-    auto id = request->id();
-    if (!google::protobuf::util::FieldMaskUtil::IsValidFieldMask<MarkerInfo>(request->mask()))
+    auto *reactor = context->DefaultReactor();
+
+    const auto ticket = admission_.Admit("GetMarker", context);
+    if (!ticket.Admitted())
+    {
+        reactor->Finish(ticket.Reject(context));
+        return reactor;
+    }
+
+    // Deserialization consumes the buffer, so parse from a copy which only references the request slices.
+    auto request_buffer = grpc::ByteBuffer(*request);
+    auto marker_request = MarkerRequest();
+    if (!grpc::SerializationTraits<MarkerRequest>::Deserialize(&request_buffer, &marker_request).ok() ||
+        !google::protobuf::util::FieldMaskUtil::IsValidFieldMask<MarkerInfo>(marker_request.mask()))
+    {
+        reactor->Finish(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "invalid marker request"));
+        return reactor;
+    }
+
+    auto key = MarkerResponseCache::Key{ marker_request.id(), std::string(), marker_store_.Version() };
+    if (marker_request.mask().paths_size() > 0)
     {
-        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "invalid field mask");
+        auto canonical_mask = google::protobuf::FieldMask();
+        google::protobuf::util::FieldMaskUtil::ToCanonicalForm(marker_request.mask(), &canonical_mask);
+        key.mask = google::protobuf::util::FieldMaskUtil::ToString(canonical_mask);
     }
 
-    auto field_mask_1 = google::protobuf::FieldMask();
-    auto field_mask_2 = google::protobuf::FieldMask();
-    auto field_mask_3 = google::protobuf::FieldMask();
+    if (marker_response_cache_.Lookup(key, response))
+    {
+        reactor->Finish(grpc::Status::OK);
+        return reactor;
+    }
 
-    std::cout << ">>> 1: " << google::protobuf::util::FieldMaskUtil::ToString(field_mask_1) << std::endl;
+    // Build the response on a stack arena; it only lives until it is serialized.
+    char arena_block[4096];
+    auto arena_options = google::protobuf::ArenaOptions();
+    arena_options.initial_block = arena_block;
+    arena_options.initial_block_size = sizeof(arena_block);
+    google::protobuf::Arena arena(arena_options);
 
-    google::protobuf::util::FieldMaskUtil::AddPathToFieldMask<MarkerInfo>("total_count", &field_mask_1);
-    google::protobuf::util::FieldMaskUtil::AddPathToFieldMask<MarkerInfo>("markers", &field_mask_1);
-    std::cout << ">>> 2: " << google::protobuf::util::FieldMaskUtil::ToString(field_mask_1) << std::endl;
+    auto *marker_response = google::protobuf::Arena::CreateMessage<MarkerResponse>(&arena);
+    auto *marker_info = marker_response->mutable_marker_info();
+    if (!marker_store_.Find(marker_request.id(), marker_info->add_markers(), &key.version))
+    {
+        reactor->Finish(
+            grpc::Status(grpc::StatusCode::NOT_FOUND, "marker " + std::to_string(marker_request.id()) + " not found"));
+        return reactor;
+    }
+    marker_info->set_total_count(marker_store_.Size());
 
-    google::protobuf::util::FieldMaskUtil::FromFieldNumbers<MarkerInfo>({ 1, 2 }, &field_mask_2);
-    std::cout << ">>> 3: " << google::protobuf::util::FieldMaskUtil::ToString(field_mask_2) << std::endl;
+    if (marker_request.mask().paths_size() > 0)
+    {
+        google::protobuf::util::FieldMaskUtil::TrimMessage(marker_request.mask(), marker_info);
+    }
 
-    google::protobuf::util::FieldMaskUtil::ToCanonicalForm(field_mask_1, &field_mask_3);
-    std::cout << ">>> 4: " << google::protobuf::util::FieldMaskUtil::ToString(field_mask_3) << std::endl;
+    const auto status = robl::SerializeToByteBuffer(*marker_response, response);
+    if (status.ok())
+    {
+        marker_response_cache_.Insert(std::move(key), *response);
+    }
 
-    google::protobuf::util::FieldMaskUtil::GetFieldMaskForAllFields<MarkerInfo>(&field_mask_1);
-    std::cout << ">>> 5: " << google::protobuf::util::FieldMaskUtil::ToString(field_mask_1) << std::endl;
+    reactor->Finish(status);
+    return reactor;
+}
 
-    google::protobuf::util::FieldMaskUtil::Intersect(field_mask_1, field_mask_2, &field_mask_3);
-    std::cout << ">>> 6: " << google::protobuf::util::FieldMaskUtil::ToString(field_mask_3) << std::endl;
+inline grpc::Status TestServiceImpl::IngestMarkers(grpc::ServerContext *context, grpc::ServerReader<MarkerInfo> *reader,
+                                                   IngestMarkersResponse *response)
+{
+    const auto ticket = admission_.Admit("IngestMarkers");
+    if (!ticket.Admitted())
+    {
+        return ticket.Reject(context);
+    }
 
-    google::protobuf::util::FieldMaskUtil::Subtract<MarkerInfo>(field_mask_1, field_mask_2, &field_mask_3);
-    std::cout << ">>> 7: " << google::protobuf::util::FieldMaskUtil::ToString(field_mask_3) << std::endl;
+    // Frames are parsed into an arena which is dropped as a whole once their markers are merged into the store.
+    constexpr auto batch_size = std::size_t(64 * 1024);
+    constexpr auto max_errors = 32;
 
-    google::protobuf::util::FieldMaskUtil::Union(field_mask_1, field_mask_2, &field_mask_3);
-    std::cout << ">>> 8: " << google::protobuf::util::FieldMaskUtil::ToString(field_mask_3) << std::endl;
+    auto arena_options = google::protobuf::ArenaOptions();
+    arena_options.start_block_size = 256 * 1024;
+    arena_options.max_block_size = 4 * 1024 * 1024;
+    google::protobuf::Arena arena(arena_options);
 
-    std::cout << "IsPathInFieldMask(\"id\", field_mask_1): " << std::boolalpha
-              << google::protobuf::util::FieldMaskUtil::IsPathInFieldMask("id", field_mask_1) << std::endl;
+    auto batch = std::vector<const Marker *>();
+    batch.reserve(batch_size);
 
-    std::cout << "IsValidPath<MarkerInfo>(\"id\"): " << std::boolalpha
-              << google::protobuf::util::FieldMaskUtil::IsValidPath<MarkerInfo>("id") << std::endl;
+    auto ingested = std::uint64_t(0);
+    auto rejected = std::uint64_t(0);
+    auto frame_index = 0;
+    auto error = std::string();
+    const auto begin = std::chrono::steady_clock::now();
 
-    MarkerInfo marker_info;
-    marker_info.mutable_markers(1)->set_id(1);
-    marker_info.mutable_markers(1)->mutable_coordinate()->set_latitude(37.7749);
-    marker_info.mutable_markers(1)->mutable_coordinate()->set_longitude(-122.4194);
-    marker_info.mutable_markers(1)->set_radius(100.0);
-    marker_info.mutable_markers(1)->set_description("This is a marker");
+    const auto flush = [&]() {
+        if (!batch.empty())
+        {
+            ingested += batch.size();
+            response->set_store_version(marker_store_.ApplyBatch(batch));
+            batch.clear();
+        }
+        arena.Reset();
+    };
 
-    response->mutable_marker_info()->mutable_markers(1)->set_name("marker");
+    auto *frame = google::protobuf::Arena::CreateMessage<MarkerInfo>(&arena);
+    while (reader->Read(frame))
+    {
+        for (auto i = 0; i < frame->markers_size(); ++i)
+        {
+            const auto &marker = frame->markers(i);
+            if (!MarkerStore::Validate(marker, &error))
+            {
+                if (rejected++ < max_errors)
+                {
+                    response->add_errors("frame " + std::to_string(frame_index) + ", marker " +
+                                         std::to_string(i) + ": " + error);
+                }
+                continue;
+            }
+            batch.push_back(&marker);
+        }
+        ++frame_index;
 
-    auto options = google::protobuf::util::FieldMaskUtil::MergeOptions();
-    options.set_replace_message_fields(true);
-    options.set_replace_repeated_fields(true);
+        if (batch.size() >= batch_size)
+        {
+            flush();
+        }
+        frame = google::protobuf::Arena::CreateMessage<MarkerInfo>(&arena);
+    }
+    flush();
 
-    google::protobuf::util::FieldMaskUtil::MergeMessageTo(marker_info, field_mask_1, options,
-                                                          response->mutable_marker_info());
-    std::cout << response->DebugString() << std::endl;
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    response->set_ingested_count(ingested);
+    response->set_rejected_count(rejected);
+    response->set_markers_per_second(elapsed > 0.0 ? ingested / elapsed : 0.0);
+    if (response->store_version() == 0)
+    {
+        response->set_store_version(marker_store_.Version());
+    }
 
-    google::protobuf::util::FieldMaskUtil::TrimMessage(field_mask_2, response->mutable_marker_info());
-    std::cout << response->DebugString() << std::endl;
+    const auto cache_stats = marker_response_cache_.GetStats();
+    std::cout << "[IngestMarkers] ingested: " << ingested << ", rejected: " << rejected
+              << ", markers/s: " << response->markers_per_second() << std::endl
+              << "[GetMarker] cache hit ratio: " << cache_stats.HitRatio() << ", entries: " << cache_stats.entries
+              << ", bytes: " << cache_stats.bytes << "/" << cache_stats.capacity_bytes << std::endl;
 
-    // std::cout << "[GetMarker] id: " << id << std::endl << "[GetMarker] mask: " << field_mask_1 << std::endl;
+    return grpc::Status::OK;
+}
 
-    // auto *marker = response->mutable_marker();
+inline grpc::Status TestServiceImpl::ExportMarkers(grpc::ServerContext *context, const ExportMarkersRequest *request,
+                                                   grpc::ServerWriter<DataChunk> *writer)
+{
+    const auto ticket = admission_.Admit("ExportMarkers");
+    if (!ticket.Admitted())
+    {
+        return ticket.Reject(context);
+    }
+
+    // A chunk, with its tags, has to fit the default 4 MB receive limit of the clients.
+    constexpr auto max_chunk_size = std::size_t(4 * 1024 * 1024 - 1024);
+    const auto chunk_size = request->chunk_size() == 0 ? robl::kDefaultChunkSize : std::size_t(request->chunk_size());
+    if (chunk_size > max_chunk_size)
+    {
+        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                            "chunk_size is above " + std::to_string(max_chunk_size) + " bytes");
+    }
+
+    // The snapshot is the only copy of the markers; it is serialized chunk by chunk, straight into the stream.
+    google::protobuf::Arena arena;
+    auto *info = google::protobuf::Arena::CreateMessage<MarkerInfo>(&arena);
+    marker_store_.Export(info);
+
+    const auto begin = std::chrono::steady_clock::now();
+    if (!robl::WriteChunked(*info, writer, chunk_size))
+    {
+        return context->IsCancelled() ? grpc::Status::CANCELLED
+                                      : grpc::Status(grpc::StatusCode::INTERNAL, "the markers could not be sent");
+    }
 
-    // marker->set_id(id);
-    // marker->set_name("marker");
-    // marker->mutable_coordinate()->set_latitude(37.7749);
-    // marker->mutable_coordinate()->set_longitude(-122.4194);
-    // marker->set_radius(100.0);
-    // marker->set_description("This is a marker");
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    std::cout << "[ExportMarkers] markers: " << info->total_count() << ", bytes: " << info->ByteSizeLong()
+              << ", MB/s: " << (elapsed > 0.0 ? info->ByteSizeLong() / elapsed / 1e6 : 0.0) << std::endl;
 
     return grpc::Status::OK;
 }
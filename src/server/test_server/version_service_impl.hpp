@@ -0,0 +1,101 @@
+#pragma once
+
+// standard headers
+#include <chrono>
+#include <string>
+
+// grpc headers
+#include <grpcpp/grpcpp.h>
+#include <robl/api/service.grpc.pb.h>
+
+// project headers
+#include "metrics/raw_methods.hpp"
+#include "wire/header_echo.hpp"
+#include "wire/serialize.hpp"
+
+/*=========================================================================*/
+
+using robl::api::GetSoftwareReleaseRequest;
+using robl::api::GetSoftwareReleaseResponse;
+using robl::api::VersionService;
+
+/*=========================================================================*/
+
+using VersionServiceBase = VersionService::WithRawCallbackMethod_GetSoftwareRelease<VersionService::Service>;
+
+/**
+ * @class VersionServiceImpl
+ * @brief Tells which software release is running.
+ *
+ * The method works on raw buffers: the release is serialized once, and every response is assembled from it and from
+ * the request, which robl::RequestEcho echoes in the header without parsing it.
+ */
+class VersionServiceImpl final : public VersionServiceBase
+{
+public:
+    explicit VersionServiceImpl(bool echo_request = true)
+        : echo_request_(echo_request)
+        , release_status_(robl::SerializeToByteBuffer(Release(), &release_))
+    {
+        robl::RawMethods::Instance().Mark(robl::RpcMetrics::Side::Server, VersionService::service_full_name(),
+                                          "GetSoftwareRelease");
+    }
+
+    // VersionService rpc methods
+    grpc::ServerUnaryReactor *GetSoftwareRelease(grpc::CallbackServerContext *context, const grpc::ByteBuffer *request,
+                                                 grpc::ByteBuffer *response) override;
+
+private:
+    static GetSoftwareReleaseResponse Release(void);
+
+    const bool echo_request_;
+    grpc::ByteBuffer release_;
+    // Why the release could not be serialized, which every call then ends with.
+    const grpc::Status release_status_;
+};
+
+/*=========================================================================*/
+
+inline grpc::ServerUnaryReactor *VersionServiceImpl::GetSoftwareRelease(grpc::CallbackServerContext *context,
+                                                                        const grpc::ByteBuffer *request,
+                                                                        grpc::ByteBuffer *response)
+{
+    auto *reactor = context->DefaultReactor();
+
+    if (!release_status_.ok())
+    {
+        reactor->Finish(release_status_);
+        return reactor;
+    }
+
+    const auto echo = robl::RequestEcho(*request, GetSoftwareReleaseRequest::descriptor());
+    if (!echo.Valid())
+    {
+        reactor->Finish(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "invalid software release request"));
+        return reactor;
+    }
+
+    *response = echo.Respond(release_, echo_request_);
+    reactor->Finish(grpc::Status::OK);
+    return reactor;
+}
+
+inline GetSoftwareReleaseResponse VersionServiceImpl::Release(void)
+{
+    // The server counts as installed when it starts.
+    const auto installed = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch());
+
+    auto release = GetSoftwareReleaseResponse();
+    auto *version = release.mutable_version();
+    version->mutable_version()->set_major_version(0);
+    version->mutable_version()->set_minor_version(1);
+    version->mutable_version()->set_patch_level(0);
+    version->set_name("robl-0.1.0");
+    version->set_build_information(std::string("grpc ") + grpc::Version());
+    version->mutable_install_date()->set_seconds(installed.count());
+    release.set_detail("test_server");
+    return release;
+}
+
+/*=========================================================================*/